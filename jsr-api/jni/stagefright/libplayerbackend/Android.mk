@@ -13,6 +13,8 @@ LOCAL_SRC_FILES         := \
     AudioCodec.cpp \
     G711Codec.cpp \
     RtpAudioStream.cpp \
+    RtpVideoStream.cpp \
+    H264Packetizer.cpp \
 #    RtpAudioGroup.cpp \
 
 LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include
@@ -35,3 +37,22 @@ LOCAL_SHARED_LIBRARIES  := \
 ##    libstagefright \
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Build the h264packetizer_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+LOCAL_MODULE            := h264packetizer_test
+LOCAL_SRC_FILES         := \
+    tests/h264packetizer_test.cpp \
+    H264Packetizer.cpp \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include
+LOCAL_C_INCLUDES        += $(LOCAL_PATH)/../ortp-0.16.5/include
+LOCAL_C_INCLUDES        += $(LOCAL_PATH)/../ortp-0.16.5/src/tests
+
+LOCAL_SHARED_LIBRARIES  := \
+    liblog \
+    libOrtp \
+
+include $(BUILD_EXECUTABLE)
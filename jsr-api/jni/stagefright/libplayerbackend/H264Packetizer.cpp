@@ -0,0 +1,294 @@
+#include <string.h>
+
+#define LOG_TAG "H264Packetizer"
+#include <log.h>
+
+#include "H264Packetizer.h"
+
+namespace ortp {
+
+#define NAL_TYPE_MASK   0x1F
+#define NAL_NRI_MASK    0x60
+#define NAL_F_BIT       0x80
+#define NAL_STAP_A      24
+#define NAL_FU_A        28
+#define FU_START        0x80
+#define FU_END          0x40
+
+static const uint8_t g_startCode[4] = { 0, 0, 0, 1 };
+
+// Returns the first byte after the next Annex B start code, or NULL.
+static uint8_t *findNal(uint8_t *p, uint8_t *end)
+{
+    while (end - p >= 3) {
+        if (p[2] > 1) {
+            p += 3;
+        } else if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+            return p + 3;
+        } else {
+            ++p;
+        }
+    }
+    return NULL;
+}
+
+// A block that references [start, start + size) of the access unit.
+static mblk_t *slice(mblk_t *au, uint8_t *start, int size)
+{
+    mblk_t *m = dupb(au);
+    m->b_rptr = start;
+    m->b_wptr = start + size;
+    return m;
+}
+
+H264Packetizer::H264Packetizer()
+{
+    mMaxPayloadSize = DEFAULT_MAX_PAYLOAD;
+}
+
+void H264Packetizer::setMaxPayloadSize(int size)
+{
+    // A FU-A fragment needs room for its two header bytes and one of data.
+    mMaxPayloadSize = (size > 3) ? size : 3;
+}
+
+int H264Packetizer::packetize(mblk_t *au, queue_t *out)
+{
+    uint8_t *nals[MAX_STAP_NALS];
+    int sizes[MAX_STAP_NALS];
+    int count = 0;
+    int stapSize = 1;
+    int packets = 0;
+
+    uint8_t *end = au->b_wptr;
+    uint8_t *nal = findNal(au->b_rptr, end);
+    while (nal != NULL) {
+        uint8_t *next = findNal(nal, end);
+        uint8_t *nalEnd = (next != NULL) ? next - 3 : end;
+        // Zeros before a start code belong to the byte stream, not the NAL.
+        while (nalEnd > nal && nalEnd[-1] == 0) {
+            --nalEnd;
+        }
+        int size = nalEnd - nal;
+
+        if (size > 0) {
+            if (count > 0 && (size > mMaxPayloadSize || count == MAX_STAP_NALS ||
+                    stapSize + 2 + size > mMaxPayloadSize)) {
+                packets += aggregate(au, nals, sizes, count, out);
+                count = 0;
+                stapSize = 1;
+            }
+            if (size > mMaxPayloadSize) {
+                packets += fragment(au, nal, size, out);
+            } else {
+                nals[count] = nal;
+                sizes[count] = size;
+                ++count;
+                stapSize += 2 + size;
+            }
+        }
+        nal = next;
+    }
+    if (count > 0) {
+        packets += aggregate(au, nals, sizes, count, out);
+    }
+    return packets;
+}
+
+int H264Packetizer::fragment(mblk_t *au, uint8_t *nal, int size, queue_t *out)
+{
+    uint8_t indicator = (nal[0] & (NAL_F_BIT | NAL_NRI_MASK)) | NAL_FU_A;
+    uint8_t type = nal[0] & NAL_TYPE_MASK;
+
+    // The NAL header is carried in the FU indicator and header. Split the
+    // rest in fragments of even size rather than leaving a short last one.
+    uint8_t *data = nal + 1;
+    int left = size - 1;
+    int room = mMaxPayloadSize - 2;
+    int count = (left + room - 1) / room;
+    int chunk = (left + count - 1) / count;
+
+    for (int i = 0; i < count; ++i) {
+        int length = (left < chunk) ? left : chunk;
+        mblk_t *m = allocb(2, 0);
+        m->b_wptr[0] = indicator;
+        m->b_wptr[1] = type | (i == 0 ? FU_START : 0) | (i == count - 1 ? FU_END : 0);
+        m->b_wptr += 2;
+        m->b_cont = slice(au, data, length);
+        putq(out, m);
+        data += length;
+        left -= length;
+    }
+    return count;
+}
+
+int H264Packetizer::aggregate(mblk_t *au, uint8_t **nals, const int *sizes,
+    int count, queue_t *out)
+{
+    if (count == 1) {
+        // Single NAL unit packet: the payload is the NAL unit itself.
+        putq(out, slice(au, nals[0], sizes[0]));
+        return 1;
+    }
+
+    // STAP-A: the F bit is set if any unit has it, NRI is the highest one.
+    uint8_t header = NAL_STAP_A;
+    for (int i = 0; i < count; ++i) {
+        header |= nals[i][0] & NAL_F_BIT;
+        if ((nals[i][0] & NAL_NRI_MASK) > (header & NAL_NRI_MASK)) {
+            header = (header & ~NAL_NRI_MASK) | (nals[i][0] & NAL_NRI_MASK);
+        }
+    }
+
+    mblk_t *m = allocb(1, 0);
+    *m->b_wptr++ = header;
+    mblk_t *tail = m;
+    for (int i = 0; i < count; ++i) {
+        mblk_t *length = allocb(2, 0);
+        *length->b_wptr++ = sizes[i] >> 8;
+        *length->b_wptr++ = sizes[i];
+        tail->b_cont = length;
+        length->b_cont = slice(au, nals[i], sizes[i]);
+        tail = length->b_cont;
+    }
+    putq(out, m);
+    return 1;
+}
+
+H264Depacketizer::H264Depacketizer()
+{
+    mBuffer = NULL;
+    mCapacity = 0;
+    mStarted = false;
+    mDropped = 0;
+    reset(0);
+}
+
+H264Depacketizer::~H264Depacketizer()
+{
+    delete [] mBuffer;
+}
+
+bool H264Depacketizer::set(int frameCapacity)
+{
+    if (frameCapacity <= 0) {
+        return false;
+    }
+    delete [] mBuffer;
+    mBuffer = new uint8_t[frameCapacity];
+    mCapacity = frameCapacity;
+    mStarted = false;
+    reset(0);
+    return true;
+}
+
+void H264Depacketizer::reset(uint32_t timestamp)
+{
+    mTimestamp = timestamp;
+    mSize = 0;
+    mDone = false;
+    mCorrupted = false;
+    mInFragment = false;
+}
+
+bool H264Depacketizer::append(const uint8_t *data, int size, bool startCode)
+{
+    int needed = size + (startCode ? sizeof(g_startCode) : 0);
+    if (mCapacity - mSize < needed) {
+        LOGV("frame of %d bytes does not fit", mSize + needed);
+        return false;
+    }
+    if (startCode) {
+        memcpy(mBuffer + mSize, g_startCode, sizeof(g_startCode));
+        mSize += sizeof(g_startCode);
+    }
+    memcpy(mBuffer + mSize, data, size);
+    mSize += size;
+    return true;
+}
+
+bool H264Depacketizer::process(mblk_t *packet)
+{
+    unsigned char *payload;
+    int length = rtp_get_payload(packet, &payload);
+    if (length <= 0 || mBuffer == NULL) {
+        return false;
+    }
+
+    uint16_t sequence = rtp_get_seqnumber(packet);
+    uint32_t timestamp = rtp_get_timestamp(packet);
+    if (mStarted && (sequence == mSequence || (mDone && timestamp == mTimestamp))) {
+        // A duplicate, or a late packet of the frame already handed out.
+        return false;
+    }
+    bool gap = mStarted && sequence != (uint16_t)(mSequence + 1);
+    mSequence = sequence;
+
+    if (!mStarted || mDone || timestamp != mTimestamp) {
+        if (mStarted && !mDone) {
+            // The packet with the marker bit never came.
+            ++mDropped;
+        }
+        reset(timestamp);
+        mStarted = true;
+    }
+    // A gap at the start of a frame may have taken its first packets.
+    if (gap) {
+        mCorrupted = true;
+    }
+
+    if (!mCorrupted) {
+        int type = payload[0] & NAL_TYPE_MASK;
+        if (type >= 1 && type < NAL_STAP_A) {
+            mCorrupted = !append(payload, length, true);
+        } else if (type == NAL_STAP_A) {
+            uint8_t *p = payload + 1;
+            int left = length - 1;
+            while (left > 0 && !mCorrupted) {
+                int size = (left >= 2) ? (p[0] << 8 | p[1]) : 0;
+                if (size == 0 || size > left - 2) {
+                    LOGV("malformed STAP-A");
+                    mCorrupted = true;
+                    break;
+                }
+                mCorrupted = !append(p + 2, size, true);
+                p += 2 + size;
+                left -= 2 + size;
+            }
+        } else if (type == NAL_FU_A) {
+            uint8_t fu = (length >= 2) ? payload[1] : 0;
+            bool start = (fu & FU_START) != 0;
+            if (length < 2 || start == mInFragment) {
+                LOGV("unexpected FU-A fragment");
+                mCorrupted = true;
+            } else {
+                if (start) {
+                    uint8_t header = (payload[0] & (NAL_F_BIT | NAL_NRI_MASK)) |
+                        (fu & NAL_TYPE_MASK);
+                    mCorrupted = !append(&header, 1, true);
+                    mInFragment = true;
+                }
+                if (!mCorrupted) {
+                    mCorrupted = !append(payload + 2, length - 2, false);
+                }
+                if (fu & FU_END) {
+                    mInFragment = false;
+                }
+            }
+        }
+        // STAP-B, MTAP and FU-B only occur in interleaved mode; ignore them.
+    }
+
+    if (!rtp_get_markbit(packet)) {
+        return false;
+    }
+    mDone = true;
+    if (mCorrupted || mInFragment || mSize == 0) {
+        mCorrupted = true;
+        ++mDropped;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
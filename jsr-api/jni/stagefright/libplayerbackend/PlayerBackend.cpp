@@ -1,9 +1,11 @@
 #include <jni.h>
+#include <time.h>
 
 #define LOG_TAG "PlayerBackend"
 #include <log.h>
 
 #include "RtpAudioStream.h"
+#include "RtpVideoStream.h"
 
 
 namespace ortp {
@@ -13,6 +15,14 @@ static const char *g_ssrc = "ssrc_changed";
 
 extern void initRandom();
 
+// Monotonic time in microseconds, for the startup timings
+static unsigned long long nowUsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 void ssrc_cb(RtpSession *session)
 {
     LOGD("hey, the ssrc has changed!");
@@ -42,7 +52,7 @@ static void JNICALL closeSession(JNIEnv *env, jclass clasz, jint channel, jint n
 
     RtpSession *session = (RtpSession *)channel;
 
-    RtpAudioStream *stream = (RtpAudioStream *)nativeStream;
+    RtpStream *stream = (RtpStream *)nativeStream;
     if (stream != NULL) {
         delete stream;
     }
@@ -86,6 +96,7 @@ static jint JNICALL setAudioCodec(JNIEnv *env, jclass clasz, jstring jCodecSpec,
     int sampleRate = -1;
     int sampleCount = -1;
     int dtmfType = -1;
+    int cnType = -1;
     int mode = RtpAudioStream::NORMAL;
 
     if (!jCodecSpec) {
@@ -104,6 +115,10 @@ static jint JNICALL setAudioCodec(JNIEnv *env, jclass clasz, jstring jCodecSpec,
     if (sampleCount <= 0) {
         goto error;
     }
+    // Comfort noise has a static payload type only at 8kHz.
+    if (sampleRate == 8000) {
+        cnType = RtpAudioStream::CN_PAYLOAD_TYPE;
+    }
 
     // Create audio stream.
     if (isReceiving) {
@@ -112,11 +127,11 @@ static jint JNICALL setAudioCodec(JNIEnv *env, jclass clasz, jstring jCodecSpec,
         mode = RtpAudioStream::SEND_ONLY;
     }
     stream = new RtpAudioStream();
-    if (!stream->set(mode, codec, sampleRate, sampleCount, codecType, dtmfType)) {
+    if (!stream->set(mode, codec, sampleRate, sampleCount, codecType, dtmfType, cnType)) {
         goto error;
     }
 
-    return (int)stream;
+    return (int)static_cast<RtpStream *>(stream);
 
 error:
     delete stream;
@@ -124,14 +139,20 @@ error:
     return 0;
 }
 
-// TODO: implement me
 static jint JNICALL setVideoCodec(JNIEnv *env, jclass clasz, jint codec, jboolean isReceiving, jint channel)
 {
     LOGI("%s", __FUNCTION__);
 
     RtpSession *session = (RtpSession *)channel;
+    int mode = isReceiving ? RtpStream::RECEIVE_ONLY : RtpStream::SEND_ONLY;
 
-    return 0;
+    RtpVideoStream *stream = new RtpVideoStream();
+    if (!stream->set(mode, codec, session)) {
+        delete stream;
+        return 0;
+    }
+
+    return (int)static_cast<RtpStream *>(stream);
 }
 
 static jboolean JNICALL setDestination(JNIEnv *env, jclass clasz, jstring address,
@@ -162,32 +183,69 @@ static jboolean JNICALL enableSrtp(JNIEnv *env, jclass clasz, jboolean isReceivi
 {
     LOGI("%s", __FUNCTION__);
 
-    srtp_t srtp;
+    srtp_t sender;
+    srtp_t receiver;
     err_status_t status;
     srtp_policy_t policy;
+    srtp_policy_t rtxPolicy;
+    RtpSession *session = (RtpSession *)channel;
+
+    jsize size = env->GetArrayLength(key);
 
-    crypto_policy_set_aes_cm_128_hmac_sha1_32(&policy.rtp);
-    crypto_policy_set_aes_cm_128_hmac_sha1_32(&policy.rtcp);
+    /*
+     * the crypto suite follows from the length of the master key and
+     * salt: 30 octets for AES_CM_128_HMAC_SHA1_32, 28 and 44 octets for
+     * the AEAD_AES_128_GCM and AEAD_AES_256_GCM suites of RFC 7714
+     */
+    switch (size) {
+    case 28:
+        crypto_policy_set_aes_gcm_128_16_auth(&policy.rtp);
+        crypto_policy_set_aes_gcm_128_16_auth(&policy.rtcp);
+        break;
+    case 44:
+        crypto_policy_set_aes_gcm_256_16_auth(&policy.rtp);
+        crypto_policy_set_aes_gcm_256_16_auth(&policy.rtcp);
+        break;
+    case 30:
+        crypto_policy_set_aes_cm_128_hmac_sha1_32(&policy.rtp);
+        crypto_policy_set_aes_cm_128_hmac_sha1_32(&policy.rtcp);
+        break;
+    default:
+        LOGE("%s: unsupported master key length %d", __FUNCTION__, (int)size);
+        return false;
+    }
 
     jbyte *keyBytes = env->GetByteArrayElements(key, NULL);
-    jsize size = env->GetArrayLength(key);
     policy.ssrc.type = ssrc_specific;
     policy.ssrc.value = 0xcafebabe;
     policy.key = (unsigned char *)keyBytes;
-//    policy.key = (unsigned char *)malloc(sizeof(jbyte) * size);
-//    memcpy(policy.key, keyBytes, sizeof(jbyte) * size);
+    policy.window_size = 0; /* the default replay window */
     policy.next = NULL;
-    env->ReleaseByteArrayElements(key, keyBytes, JNI_ABORT);
 
-    status = ortp_srtp_create(&srtp, &policy);
+    /*
+     * the RTX packets (RFC 4588) are sent with an SSRC of their own,
+     * which needs its own stream with an SSRC specific policy
+     */
+    if (session->rtx.enabled && session->rtx.pt >= 0) {
+        rtxPolicy = policy;
+        rtxPolicy.ssrc.value = rtp_session_get_retransmission_ssrc(session);
+        policy.next = &rtxPolicy;
+    }
+
+    /*
+     * one session per direction, so that packets can be sent and
+     * received from different threads; the key is read by
+     * ortp_srtp_create_pair(), release it only afterwards
+     */
+    status = ortp_srtp_create_pair(&sender, &receiver, &policy);
+    env->ReleaseByteArrayElements(key, keyBytes, JNI_ABORT);
     if (status) {
         return false;
     }
 
-    RtpSession *session = (RtpSession *)channel;
     RtpTransport *rtpt;
     RtpTransport *rtcpt;
-    srtp_transport_new(srtp, &rtpt, &rtcpt);
+    srtp_transport_new_pair(sender, receiver, &rtpt, &rtcpt);
     rtp_session_set_transports(session, rtpt, rtcpt);
 
     return true;
@@ -198,9 +256,20 @@ static jboolean JNICALL disableSrtp(JNIEnv *env, jclass clasz, jboolean isReceiv
     LOGI("%s", __FUNCTION__);
 
     RtpSession *session = (RtpSession *)channel;
-    srtp_t srtp = (srtp_t)session->rtp.tr->data;
-    ortp_srtp_dealloc(srtp);
+    RtpTransport *rtpt = session->rtp.tr;
+    RtpTransport *rtcpt = session->rtcp.tr;
+    srtp_t sender;
+    srtp_t receiver;
+
+    if (rtpt == NULL) {
+        return false;
+    }
+    srtp_transport_get_sessions(rtpt, &sender, &receiver);
     rtp_session_set_transports(session, NULL, NULL);
+    srtp_transport_destroy(rtpt);
+    srtp_transport_destroy(rtcpt);
+    ortp_srtp_dealloc(sender);
+    ortp_srtp_dealloc(receiver);
     return true;
 }
 
@@ -312,22 +381,40 @@ extern "C" jint JNI_OnLoad(JavaVM *vm, void *reserved)
         return JNI_FALSE;
     }
 
+    unsigned long long start = nowUsec();
+
     // Init random
     initRandom();
+    unsigned long long randomDone = nowUsec();
 
     // Init oRTP library
     ortp_init();
+    unsigned long long ortpDone = nowUsec();
     ortp_scheduler_init();
+    unsigned long long schedulerDone = nowUsec();
 
-    // Init SRTP library
+    // Init SRTP library. The cipher self-tests run when a cipher is first
+    // used and the RNG tests run in the background, off the load path.
+    crypto_kernel_set_init_mode(crypto_kernel_init_deferred);
     int err = ortp_srtp_init();
     if (err != 0) {
         LOGE("Failed to init SRTP");
     }
+    unsigned long long srtpDone = nowUsec();
 
     // We register native methods in order to skip javah and use conveniently named functions.
     // Just this native initialization function uses name-mangling based method discovery.
     env->RegisterNatives(clazz, nativeMethods, sizeof(nativeMethods) / sizeof(nativeMethods[0]));
+    unsigned long long nativesDone = nowUsec();
+
+    crypto_kernel_init_stats_t stats;
+    crypto_kernel_get_init_stats(&stats);
+    LOGI("Startup took %llu us: random %llu, ortp %llu, scheduler %llu, srtp %llu "
+         "(rng %lu, ciphers %lu, auth %lu), natives %llu",
+         nativesDone - start, randomDone - start, ortpDone - randomDone,
+         schedulerDone - ortpDone, srtpDone - schedulerDone,
+         stats.rng_init_usec, stats.cipher_usec, stats.auth_usec,
+         nativesDone - srtpDone);
 
     return JNI_VERSION_1_4;
 }
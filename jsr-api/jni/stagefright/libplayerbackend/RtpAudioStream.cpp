@@ -1,3 +1,6 @@
+#include <math.h>
+#include <stdlib.h>
+
 #include <SystemClock.h>
 
 #include "RtpAudioStream.h"
@@ -8,7 +11,16 @@ namespace ortp {
 #define HISTORY_SIZE    80
 #define MEASURE_PERIOD  2000
 
-int gRandom = -1;
+// Voice activity detection works on the mean energy of a packet. Speech
+// stands 6dB above the tracked noise floor and above -60dBov, and keeps the
+// stream active for a while after it ends so that word tails are not cut.
+#define VAD_MIN_ENERGY  1024
+#define HANGOVER_TIME   200
+// During silence a SID frame is sent at this period, or earlier when the
+// noise level moves by SID_LEVEL_DELTA dB.
+#define SID_INTERVAL    200
+#define SID_LEVEL_DELTA 3
+#define MAX_LEVEL       127
 
 using namespace android;
 
@@ -27,7 +39,7 @@ RtpAudioStream::~RtpAudioStream()
 }
 
 bool RtpAudioStream::set(int mode, AudioCodec *codec, int sampleRate,
-    int sampleCount, int codecType, int dtmfType)
+    int sampleCount, int codecType, int dtmfType, int cnType)
 {
     if (mode < 0 || mode > LAST_MODE) {
         return false;
@@ -36,6 +48,7 @@ bool RtpAudioStream::set(int mode, AudioCodec *codec, int sampleRate,
 
     mCodecMagic = (0x8000 | codecType) << 16;
     mDtmfMagic = (dtmfType == -1) ? 0 : (0x8000 | dtmfType) << 16;
+    mCnMagic = (cnType == -1) ? 0 : (0x8000 | cnType) << 16;
 
     mTick = elapsedRealtime();
     mSampleRate = sampleRate / 1000;
@@ -52,16 +65,27 @@ bool RtpAudioStream::set(int mode, AudioCodec *codec, int sampleRate,
     mLatencyTimer = 0;
     mLatencyScore = 0;
 
-    // Initialize random bits.
-    if (gRandom != -1) {
-        read(gRandom, &mSequence, sizeof(mSequence));
-        read(gRandom, &mTimestamp, sizeof(mTimestamp));
-        read(gRandom, &mSsrc, sizeof(mSsrc));
+    // Initialize random bits, all from one request to the random source.
+    uint32_t bits[4];
+    if (rand_source_get_octet_string(bits, sizeof(bits)) == err_status_ok) {
+        mSequence = bits[0];
+        mTimestamp = bits[1];
+        mSsrc = bits[2];
+        mNoiseSeed = bits[3];
+    } else {
+        LOGE("Failed to get random bits");
     }
 
     mDtmfEvent = -1;
     mDtmfStart = 0;
 
+    mNoiseFloor = VAD_MIN_ENERGY;
+    mHangover = 0;
+    mSilent = false;
+    mSidTick = mTick;
+    mSidLevel = MAX_LEVEL;
+    mNoiseAmplitude = 0;
+
     // Only take over these things when succeeded.
     if (codec) {
         mCodec = codec;
@@ -86,6 +110,22 @@ bool RtpAudioStream::mix(int32_t *output, int head, int tail, int sampleRate)
         return false;
     }
 
+    // Between two SID frames nothing arrives: play comfort noise wherever
+    // the jitter buffer has no samples.
+    bool noisy = false;
+    if (mNoiseAmplitude > 0 && sampleRate == mSampleRate &&
+        tail - mBufferTail > 0) {
+        int from = (mBufferTail - head > 0) ? mBufferTail : head;
+        int count = (tail - from) * mSampleRate;
+        int16_t noise[count];
+        makeNoise(noise, count);
+        int32_t *p = &output[(from - head) * mSampleRate];
+        for (int i = 0; i < count; ++i) {
+            p[i] += noise[i];
+        }
+        noisy = true;
+    }
+
     if (head - mBufferHead < 0) {
         head = mBufferHead;
     }
@@ -93,7 +133,7 @@ bool RtpAudioStream::mix(int32_t *output, int head, int tail, int sampleRate)
         tail = mBufferTail;
     }
     if (tail - head <= 0) {
-        return false;
+        return noisy;
     }
 
     head *= mSampleRate;
@@ -110,6 +150,36 @@ bool RtpAudioStream::mix(int32_t *output, int head, int tail, int sampleRate)
     return true;
 }
 
+bool RtpAudioStream::detectVoice(uint32_t energy)
+{
+    // Follow the noise floor down at once and up by about 7dB per second,
+    // so that it settles under steady background noise but not under speech.
+    if (energy < mNoiseFloor) {
+        mNoiseFloor = (energy > VAD_MIN_ENERGY) ? energy : VAD_MIN_ENERGY;
+    } else {
+        mNoiseFloor += (mNoiseFloor >> 5) + 1;
+    }
+
+    if (energy > VAD_MIN_ENERGY && (energy >> 2) > mNoiseFloor) {
+        mHangover = HANGOVER_TIME;
+        return true;
+    }
+    if (mHangover > 0) {
+        mHangover -= mInterval;
+        return true;
+    }
+    return false;
+}
+
+void RtpAudioStream::makeNoise(int16_t *samples, int count)
+{
+    // White noise, uniform in [-mNoiseAmplitude, mNoiseAmplitude].
+    for (int i = 0; i < count; ++i) {
+        mNoiseSeed = mNoiseSeed * 1664525 + 1013904223;
+        samples[i] = (((int32_t)(mNoiseSeed >> 16) - 32768) * mNoiseAmplitude) >> 15;
+    }
+}
+
 void RtpAudioStream::encode(int tick, RtpAudioStream *chain)
 {
     if (tick - mTick >= mInterval) {
@@ -123,7 +193,6 @@ void RtpAudioStream::encode(int tick, RtpAudioStream *chain)
 
     tick = mTick;
     mTick += mInterval;
-    ++mSequence;
     mTimestamp += mSampleCount;
 
     if (mMode == RECEIVE_ONLY) {
@@ -136,6 +205,7 @@ void RtpAudioStream::encode(int tick, RtpAudioStream *chain)
         // Make sure duration is reasonable.
         if (duration >= 0 && duration < mSampleRate * 100) {
             duration += mSampleCount;
+            ++mSequence;
             int32_t buffer[4] = {
                 htonl(mDtmfMagic | mSequence),
                 htonl(mDtmfStart),
@@ -169,7 +239,11 @@ void RtpAudioStream::encode(int tick, RtpAudioStream *chain)
             mLogThrottle = mTick;
             LOGV("stream no data");
         }
-        return;
+        // With comfort noise, no data is plain silence and goes through the
+        // SID frames below.
+        if (mCnMagic == 0 || !mCodec) {
+            return;
+        }
     }
 
     // Cook the packet and send it out.
@@ -190,7 +264,52 @@ void RtpAudioStream::encode(int tick, RtpAudioStream *chain)
         return;
     }
 
-    buffer[0] = htonl(mCodecMagic | mSequence);
+    // Suppress the packets of silence, only sending a SID frame with the
+    // noise level to start the comfort noise and refresh it now and then.
+    bool marker = false;
+    if (mCnMagic != 0) {
+        int64_t sum = 0;
+        for (int i = 0; i < mSampleCount; ++i) {
+            sum += samples[i] * samples[i];
+        }
+        uint32_t energy = sum / mSampleCount;
+
+        if (!detectVoice(energy)) {
+            // The level is in -dBov, 0dBov being a full scale square wave.
+            int level = MAX_LEVEL;
+            if (energy > 0) {
+                level = -10.0f * log10f(energy / (32767.0f * 32767.0f));
+                if (level < 0) {
+                    level = 0;
+                } else if (level > MAX_LEVEL) {
+                    level = MAX_LEVEL;
+                }
+            }
+            if (mSilent && tick - mSidTick < SID_INTERVAL &&
+                abs(level - mSidLevel) < SID_LEVEL_DELTA) {
+                return;
+            }
+            mSilent = true;
+            mSidTick = tick;
+            mSidLevel = level;
+
+            ++mSequence;
+            buffer[0] = htonl(mCnMagic | mSequence);
+            buffer[1] = htonl(mTimestamp);
+            buffer[2] = mSsrc;
+            // The level alone, without spectral information.
+            ((uint8_t *)&buffer[3])[0] = level;
+////            sendto(mSocket, buffer, 13, MSG_DONTWAIT, (sockaddr *)&mRemote,
+////                sizeof(mRemote));
+            return;
+        }
+        // The first packet of a talkspurt carries the marker bit.
+        marker = mSilent;
+        mSilent = false;
+    }
+
+    ++mSequence;
+    buffer[0] = htonl(mCodecMagic | (marker ? 0x800000 : 0) | mSequence);
     buffer[1] = htonl(mTimestamp);
     buffer[2] = mSsrc;
     int length = mCodec->encode(&buffer[3], samples);
@@ -263,8 +382,11 @@ void RtpAudioStream::decode(int tick)
 
         // Do we need to check SSRC, sequence, and timestamp? They are not
         // reliable but at least they can be used to identify duplicates?
+        uint32_t magic = (length < 12) ? 0 :
+            ntohl(*(uint32_t *)buffer) & 0xC07F0000;
+        bool sid = (mCnMagic != 0 && magic == mCnMagic);
         if (length < 12 || length > (int)sizeof(buffer) ||
-            (ntohl(*(uint32_t *)buffer) & 0xC07F0000) != mCodecMagic) {
+            (magic != mCodecMagic && !sid)) {
             LOGV("stream malformed packet");
             LOGV("stream malformed packet");
             return;
@@ -277,7 +399,16 @@ void RtpAudioStream::decode(int tick)
             length -= buffer[length - 1];
         }
         length -= offset;
-        if (length >= 0) {
+        if (sid) {
+            // Turn the level back into the amplitude of a uniform noise
+            // with the same energy, and play it until the next talkspurt.
+            int level = (length > 0) ? (buffer[offset] & 0x7F) : MAX_LEVEL;
+            float amplitude = 32767.0f * sqrtf(3.0f) * powf(10.0f, -level / 20.0f);
+            mNoiseAmplitude = (amplitude < 32767.0f) ? (int)amplitude : 32767;
+            makeNoise(samples, mSampleCount);
+            length = mSampleCount;
+        } else if (length >= 0) {
+            mNoiseAmplitude = 0;
             //length = mCodec->decode(samples, &buffer[offset], length);
         }
     }
@@ -311,9 +442,9 @@ void RtpAudioStream::decode(int tick)
 }
 
 void initRandom() {
-    gRandom = open("/dev/urandom", O_RDONLY);
-    if (gRandom == -1) {
-        LOGE("urandom: %s", strerror(errno));
+    // Seeds the generator of the calling thread; the others seed on demand.
+    if (rand_source_init() != err_status_ok) {
+        LOGE("Failed to init the random source");
     }
 }
 
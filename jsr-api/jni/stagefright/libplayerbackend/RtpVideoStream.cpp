@@ -0,0 +1,115 @@
+#define LOG_TAG "RtpVideoStream"
+#include <log.h>
+
+#include "RtpVideoStream.h"
+
+namespace ortp {
+
+RtpVideoStream::RtpVideoStream()
+{
+    mMode = NORMAL;
+    mSession = NULL;
+    mProfile = NULL;
+    qinit(&mPayloads);
+}
+
+RtpVideoStream::~RtpVideoStream()
+{
+    flushq(&mPayloads, FLUSHALL);
+    releaseProfile();
+    LOGD("stream is dead");
+}
+
+// Gives the session back the default profile, as it may outlive the stream.
+void RtpVideoStream::releaseProfile()
+{
+    if (mProfile != NULL) {
+        rtp_session_set_profile(mSession, &av_profile);
+        rtp_profile_destroy(mProfile);
+        mProfile = NULL;
+    }
+}
+
+bool RtpVideoStream::set(int mode, int codec, RtpSession *session)
+{
+    if (mode < 0 || mode > LAST_MODE || session == NULL) {
+        return false;
+    }
+    if (codec != H264) {
+        LOGE("video codec %d is not supported", codec);
+        return false;
+    }
+    if (mode != SEND_ONLY &&
+        !mDepacketizer.set(H264Depacketizer::DEFAULT_FRAME_CAPACITY)) {
+        return false;
+    }
+    releaseProfile();
+    mMode = mode;
+    mSession = session;
+
+    // The clock rate of the payload type drives the jitter buffer. The
+    // dynamic payload type is set in a profile of our own: av_profile is
+    // shared by all the sessions of the process.
+    mProfile = rtp_profile_clone_full(&av_profile);
+    rtp_profile_set_payload(mProfile, H264_PAYLOAD_TYPE, &payload_type_h264);
+    rtp_session_set_profile(mSession, mProfile);
+    rtp_session_set_payload_type(mSession, H264_PAYLOAD_TYPE);
+
+    LOGD("stream is configured as H264 mode %d", mMode);
+    return true;
+}
+
+bool RtpVideoStream::send(uint8_t *accessUnit, int length, uint32_t timestamp,
+    void (*freefn)(void *))
+{
+    if (mMode == RECEIVE_ONLY || length <= 0) {
+        if (freefn) {
+            freefn(accessUnit);
+        }
+        return false;
+    }
+
+    mblk_t *au = esballoc(accessUnit, length, 0, freefn);
+    au->b_wptr += length;
+    int count = mPacketizer.packetize(au, &mPayloads);
+    // From now on the payloads hold the only references to the buffer.
+    freeb(au);
+    if (count == 0) {
+        LOGV("stream access unit without NAL units");
+        return false;
+    }
+
+    bool sent = true;
+    mblk_t *payload;
+    while ((payload = getq(&mPayloads)) != NULL) {
+        mblk_t *m = rtp_session_create_packet(mSession, RTP_FIXED_HEADER_SIZE, NULL, 0);
+        m->b_cont = payload;
+        rtp_set_markbit(m, qempty(&mPayloads));
+        if (rtp_session_sendm_with_ts(mSession, m, timestamp) < 0) {
+            sent = false;
+        }
+    }
+    return sent;
+}
+
+const uint8_t *RtpVideoStream::receive(uint32_t timestamp, int *length)
+{
+    *length = 0;
+    if (mMode == SEND_ONLY) {
+        return NULL;
+    }
+
+    mblk_t *m;
+    while ((m = rtp_session_recvm_with_ts(mSession, timestamp)) != NULL) {
+        bool complete = mDepacketizer.process(m);
+        freemsg(m);
+        if (complete) {
+            // Packets of the next frame stay queued for the next call.
+            *length = mDepacketizer.frameSize();
+            return mDepacketizer.frame();
+        }
+    }
+    return NULL;
+}
+
+} // namespace
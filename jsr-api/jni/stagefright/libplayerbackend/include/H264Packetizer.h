@@ -0,0 +1,85 @@
+#ifndef __H264_PACKETIZER_H__
+#define __H264_PACKETIZER_H__
+
+#include <stdint.h>
+
+#include <ortp/ortp.h>
+
+namespace ortp {
+
+// Splits H.264 access units into RTP payloads (RFC 6184, non-interleaved
+// mode). NAL units larger than the payload size are sent as FU-A fragments
+// and runs of small ones (SPS, PPS, SEI...) are aggregated into STAP-A
+// packets. The payloads reference the access unit buffer through dupb(),
+// only the FU-A and STAP-A headers are allocated.
+class H264Packetizer
+{
+public:
+    H264Packetizer();
+    void setMaxPayloadSize(int size);
+
+    // Appends the payloads of an Annex B access unit to out, in sending
+    // order. Each payload is a chain of blocks, to be linked after the RTP
+    // header. The access unit must be a single block; it is not freed.
+    // Returns the number of payloads.
+    int packetize(mblk_t *au, queue_t *out);
+
+    enum {
+        DEFAULT_MAX_PAYLOAD = 1200,
+        // Keeps a STAP-A packet, with its RTP header, within the iovec
+        // limit of rtp_sendmsg().
+        MAX_STAP_NALS = 12,
+    };
+
+private:
+    int fragment(mblk_t *au, uint8_t *nal, int size, queue_t *out);
+    int aggregate(mblk_t *au, uint8_t **nals, const int *sizes,
+        int count, queue_t *out);
+
+    int mMaxPayloadSize;
+};
+
+// Reassembles received H.264 RTP packets into Annex B access units, in a
+// contiguous frame buffer allocated once. A frame is complete when the
+// packet with the marker bit arrives; frames with a sequence gap are
+// dropped as a whole.
+class H264Depacketizer
+{
+public:
+    H264Depacketizer();
+    ~H264Depacketizer();
+    bool set(int frameCapacity);
+
+    // Takes one received RTP packet, in host byte order; it is not freed.
+    // Returns true if it completed a frame, which then stays available
+    // through frame() until the next call.
+    bool process(mblk_t *packet);
+
+    const uint8_t *frame() const { return mBuffer; }
+    int frameSize() const { return (mDone && !mCorrupted) ? mSize : 0; }
+    uint32_t frameTimestamp() const { return mTimestamp; }
+    int droppedFrames() const { return mDropped; }
+
+    enum {
+        DEFAULT_FRAME_CAPACITY = 256 * 1024,
+    };
+
+private:
+    void reset(uint32_t timestamp);
+    bool append(const uint8_t *data, int size, bool startCode);
+
+    uint8_t *mBuffer;
+    int mCapacity;
+    int mSize;
+    bool mDone;
+    bool mCorrupted;
+    bool mStarted;
+    bool mInFragment;
+    uint32_t mTimestamp;
+    uint16_t mSequence;
+    int mDropped;
+};
+
+} // namespace
+
+#endif
@@ -5,31 +5,33 @@
 #include <ortp/srtp.h>
 
 #include <AudioCodec.h>
+#include <RtpStream.h>
 
 
 namespace ortp {
 
-class RtpAudioStream
+class RtpAudioStream : public RtpStream
 {
 public:
     RtpAudioStream();
     ~RtpAudioStream();
     bool set(int mode, AudioCodec *codec, int sampleRate,
-        int sampleCount, int codecType, int dtmfType);
+        int sampleCount, int codecType, int dtmfType, int cnType);
 
     void sendDtmf(int event);
     bool mix(int32_t *output, int head, int tail, int sampleRate);
     void encode(int tick, RtpAudioStream *chain);
     void decode(int tick);
 
+    // The static payload type of comfort noise (RFC 3389) at 8kHz.
     enum {
-        NORMAL = 0,
-        SEND_ONLY = 1,
-        RECEIVE_ONLY = 2,
-        LAST_MODE = 2,
+        CN_PAYLOAD_TYPE = 13,
     };
 
 private:
+    bool detectVoice(uint32_t energy);
+    void makeNoise(int16_t *samples, int count);
+
     int mMode;
     AudioCodec *mCodec;
     uint32_t mCodecMagic;
@@ -55,6 +57,18 @@ private:
     int mDtmfEvent;
     int mDtmfStart;
 
+    // Discontinuous transmission: silence is sent as SID frames only.
+    uint32_t mCnMagic;
+    uint32_t mNoiseFloor;
+    int mHangover;
+    bool mSilent;
+    int mSidTick;
+    int mSidLevel;
+
+    // Comfort noise played between the SID frames received.
+    int mNoiseAmplitude;
+    uint32_t mNoiseSeed;
+
     RtpAudioStream *mNext;
 
 ////    friend class RtpAudioGroup;
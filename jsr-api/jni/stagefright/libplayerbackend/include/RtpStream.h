@@ -0,0 +1,23 @@
+#ifndef __RTP_STREAM_H__
+#define __RTP_STREAM_H__
+
+namespace ortp {
+
+// Common base of the native streams handed to Java as an int, so that
+// closeSession() can release either kind through the same pointer.
+class RtpStream
+{
+public:
+    virtual ~RtpStream() {}
+
+    enum {
+        NORMAL = 0,
+        SEND_ONLY = 1,
+        RECEIVE_ONLY = 2,
+        LAST_MODE = 2,
+    };
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef __RTP_VIDEO_STREAM_H__
+#define __RTP_VIDEO_STREAM_H__
+
+#include <ortp/ortp.h>
+
+#include <H264Packetizer.h>
+#include <RtpStream.h>
+
+
+namespace ortp {
+
+class RtpVideoStream : public RtpStream
+{
+public:
+    RtpVideoStream();
+    ~RtpVideoStream();
+    bool set(int mode, int codec, RtpSession *session);
+
+    // Sends one encoded access unit (Annex B) stamped with a 90kHz
+    // timestamp. The buffer is not copied: the packets reference it and
+    // freefn, which may be NULL, releases it once the last one is gone.
+    bool send(uint8_t *accessUnit, int length, uint32_t timestamp,
+        void (*freefn)(void *));
+    // Receives the packets due at timestamp. Returns a complete access unit,
+    // valid until the next call, or NULL.
+    const uint8_t *receive(uint32_t timestamp, int *length);
+
+    // The values of android.media.MediaRecorder.VideoEncoder.
+    enum {
+        H263 = 1,
+        H264 = 2,
+    };
+
+    // The dynamic payload type used for H.264 until it is negotiated.
+    enum {
+        H264_PAYLOAD_TYPE = 96,
+    };
+
+private:
+    void releaseProfile();
+
+    int mMode;
+    RtpSession *mSession;
+    RtpProfile *mProfile;
+    H264Packetizer mPacketizer;
+    H264Depacketizer mDepacketizer;
+    queue_t mPayloads;
+};
+
+} // namespace
+
+#endif
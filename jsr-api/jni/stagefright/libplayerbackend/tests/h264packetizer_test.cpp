@@ -0,0 +1,210 @@
+/*
+ * h264packetizer_test checks that H264Packetizer and H264Depacketizer
+ * (RFC 6184, non-interleaved mode) give back the access unit they are
+ * handed, over the packet layouts they produce:
+ *
+ * - a NAL unit larger than the payload size, sent as FU-A fragments;
+ * - more small NAL units than a STAP-A packet takes;
+ * - the frame losing a FU-A fragment in the middle is dropped, and the
+ *   next one goes through;
+ * - a STAP-A packet whose last length field is cut short is rejected.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include "H264Packetizer.h"
+#include "ortp_test.h"
+
+using namespace ortp;
+
+#define TEST_MAX_PAYLOAD 1200
+#define TEST_BIG_NAL 3000
+#define TEST_SMALL_NALS 30
+#define TEST_FRAME_CAPACITY (64 * 1024)
+
+#define NAL_STAP_A 24
+#define NAL_FU_A 28
+
+static int g_freed = 0;
+
+static void testFree(void *buffer)
+{
+    delete [] (uint8_t *)buffer;
+    ++g_freed;
+}
+
+// An access unit of NAL units of the given sizes, with 3 bytes start codes;
+// expected gets the same units with the 4 bytes start codes of the
+// depacketizer. Each unit starts with a NAL header of the given type.
+class TestAccessUnit
+{
+public:
+    TestAccessUnit() : mSize(0), mExpectedSize(0) {}
+
+    void add(int type, int size)
+    {
+        static const uint8_t startCode[4] = { 0, 0, 0, 1 };
+        memcpy(mData + mSize, startCode + 1, 3);
+        mSize += 3;
+        memcpy(mExpected + mExpectedSize, startCode, 4);
+        mExpectedSize += 4;
+        for (int i = 0; i < size; ++i) {
+            // No zeros, so that no start code shows up in the payload.
+            uint8_t byte = (i == 0) ? (0x60 | type) : (uint8_t)(1 + (mSize + i) % 251);
+            mData[mSize + i] = byte;
+            mExpected[mExpectedSize + i] = byte;
+        }
+        mSize += size;
+        mExpectedSize += size;
+    }
+
+    // A block over a copy of the access unit, freed through testFree().
+    mblk_t *block() const
+    {
+        uint8_t *buffer = new uint8_t[mSize];
+        memcpy(buffer, mData, mSize);
+        mblk_t *au = esballoc(buffer, mSize, 0, testFree);
+        au->b_wptr += mSize;
+        return au;
+    }
+
+    const uint8_t *expected() const { return mExpected; }
+    int expectedSize() const { return mExpectedSize; }
+
+private:
+    uint8_t mData[TEST_FRAME_CAPACITY];
+    int mSize;
+    uint8_t mExpected[TEST_FRAME_CAPACITY];
+    int mExpectedSize;
+};
+
+// A received RTP packet, in host byte order as the depacketizer takes it.
+static mblk_t *testPacket(mblk_t *payload, uint16_t sequence, uint32_t timestamp,
+    bool marker)
+{
+    mblk_t *packet = allocb(RTP_FIXED_HEADER_SIZE + msgdsize(payload), 0);
+    rtp_header_t *rtp = (rtp_header_t *)packet->b_wptr;
+    memset(rtp, 0, RTP_FIXED_HEADER_SIZE);
+    rtp->version = 2;
+    rtp->seq_number = sequence;
+    rtp->timestamp = timestamp;
+    rtp->markbit = marker ? 1 : 0;
+    packet->b_wptr += RTP_FIXED_HEADER_SIZE;
+    for (mblk_t *m = payload; m != NULL; m = m->b_cont) {
+        memcpy(packet->b_wptr, m->b_rptr, m->b_wptr - m->b_rptr);
+        packet->b_wptr += m->b_wptr - m->b_rptr;
+    }
+    return packet;
+}
+
+static uint16_t g_sequence = 0;
+
+// Sends the payloads of out to the depacketizer, but the one at index lost.
+// Returns what the last packet, with the marker bit, returned.
+static bool testReceive(H264Depacketizer *depacketizer, queue_t *out,
+    uint32_t timestamp, int lost)
+{
+    bool done = false;
+    mblk_t *payload;
+    for (int i = 0; (payload = getq(out)) != NULL; ++i) {
+        CHECK(msgdsize(payload) <= TEST_MAX_PAYLOAD);
+        mblk_t *packet = testPacket(payload, g_sequence++, timestamp, qempty(out));
+        freemsg(payload);
+        if (i != lost) {
+            done = depacketizer->process(packet);
+        }
+        freemsg(packet);
+    }
+    return done;
+}
+
+static void testRoundTrip(H264Packetizer *packetizer, H264Depacketizer *depacketizer,
+    const TestAccessUnit &unit, uint32_t timestamp, int packets)
+{
+    queue_t out;
+    qinit(&out);
+    int freed = g_freed;
+    mblk_t *au = unit.block();
+    CHECK(packetizer->packetize(au, &out) == packets);
+    CHECK(out.q_mcount == packets);
+    freeb(au);
+    // The payloads reference the access unit, they do not copy it.
+    CHECK(g_freed == freed);
+    CHECK(testReceive(depacketizer, &out, timestamp, -1));
+    CHECK(g_freed == freed + 1);
+    CHECK(depacketizer->frameTimestamp() == timestamp);
+    CHECK(depacketizer->frameSize() == unit.expectedSize());
+    CHECK(memcmp(depacketizer->frame(), unit.expected(), unit.expectedSize()) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    H264Packetizer packetizer;
+    H264Depacketizer depacketizer;
+    queue_t out;
+    mblk_t *au, *m;
+
+    test_init();
+    qinit(&out);
+    packetizer.setMaxPayloadSize(TEST_MAX_PAYLOAD);
+    CHECK(depacketizer.set(TEST_FRAME_CAPACITY));
+
+    // SPS and PPS in a STAP-A packet, then the slice in 3 even FU-A fragments.
+    TestAccessUnit big;
+    big.add(7, 10);
+    big.add(8, 4);
+    big.add(5, TEST_BIG_NAL);
+    au = big.block();
+    CHECK(packetizer.packetize(au, &out) == 4);
+    freeb(au);
+    m = getq(&out);
+    CHECK((m->b_rptr[0] & 0x1F) == NAL_STAP_A);
+    CHECK(msgdsize(m) == 1 + 2 + 10 + 2 + 4);
+    freemsg(m);
+    for (int i = 0; i < 3; ++i) {
+        m = getq(&out);
+        CHECK((m->b_rptr[0] & 0x1F) == NAL_FU_A);
+        CHECK((m->b_rptr[1] & 0x1F) == 5);
+        CHECK(((m->b_rptr[1] & 0x80) != 0) == (i == 0));
+        CHECK(((m->b_rptr[1] & 0x40) != 0) == (i == 2));
+        // The 2999 bytes after the NAL header, as 1000, 1000 and 999.
+        CHECK(msgdsize(m) == 2 + ((i < 2) ? 1000 : 999));
+        freemsg(m);
+    }
+    testRoundTrip(&packetizer, &depacketizer, big, 3000, 4);
+
+    // Small NAL units: no more than MAX_STAP_NALS in a STAP-A packet.
+    TestAccessUnit small;
+    for (int i = 0; i < TEST_SMALL_NALS; ++i) {
+        small.add(6, 5);
+    }
+    testRoundTrip(&packetizer, &depacketizer, small, 6000,
+        (TEST_SMALL_NALS + H264Packetizer::MAX_STAP_NALS - 1) / H264Packetizer::MAX_STAP_NALS);
+
+    // The middle FU-A fragment is lost: the frame is dropped, not handed out
+    // with a hole, and the next frame is complete again.
+    au = big.block();
+    packetizer.packetize(au, &out);
+    freeb(au);
+    CHECK(!testReceive(&depacketizer, &out, 9000, 2));
+    CHECK(depacketizer.frameSize() == 0);
+    CHECK(depacketizer.droppedFrames() == 1);
+    testRoundTrip(&packetizer, &depacketizer, big, 12000, 4);
+
+    // A STAP-A packet with a complete unit and one byte of a length field.
+    m = allocb(16, 0);
+    *m->b_wptr++ = 0x60 | NAL_STAP_A;
+    *m->b_wptr++ = 0;
+    *m->b_wptr++ = 2;
+    *m->b_wptr++ = 0x67;
+    *m->b_wptr++ = 0x42;
+    *m->b_wptr++ = 0;
+    mblk_t *packet = testPacket(m, g_sequence++, 15000, true);
+    freemsg(m);
+    CHECK(!depacketizer.process(packet));
+    freemsg(packet);
+    CHECK(depacketizer.frameSize() == 0);
+    CHECK(depacketizer.droppedFrames() == 2);
+
+    return test_done("h264packetizer_test");
+}
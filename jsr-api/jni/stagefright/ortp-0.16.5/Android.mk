@@ -17,6 +17,9 @@ LOCAL_SRC_FILES         := \
         src/rtpparse.c          \
         src/rtpsession.c        \
         src/rtpsession_inet.c   \
+        src/rtpmux.c            \
+        src/rtppipeline.c       \
+        src/rtpturn.c           \
         src/jitterctl.c         \
         src/rtpsignaltable.c    \
         src/rtptimer.c          \
@@ -30,6 +33,9 @@ LOCAL_SRC_FILES         := \
         src/rtcp.c              \
         src/utils.c             \
         src/rtcpparse.c         \
+        src/rtcpxr.c            \
+        src/ratecontrol.c       \
+        src/rtpretransmit.c     \
         src/event.c             \
         src/stun.c              \
         src/stun_udp.c          \
@@ -47,3 +53,116 @@ LOCAL_LD_FLAGS := -Wl,--rpath-link obj/local/armeabi/ -L$(LOCAL_PATH) -Lobj/loca
 LOCAL_SHARED_LIBRARIES  := libSrtp libcrypto
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Build the session_bench benchmark
+# ============================================================
+# run it as: session_bench [ -r rounds ] [ sessions ... ] > results.json
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+
+LOCAL_MODULE            := session_bench
+LOCAL_SRC_FILES         := \
+        src/tests/session_bench.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp
+
+include $(BUILD_EXECUTABLE)
+
+# Build the rtpmux_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+
+LOCAL_MODULE            := rtpmux_test
+LOCAL_SRC_FILES         := \
+        src/tests/rtpmux_test.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp
+
+include $(BUILD_EXECUTABLE)
+
+# Build the fanout_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+
+LOCAL_MODULE            := fanout_test
+LOCAL_SRC_FILES         := \
+        src/tests/fanout_test.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp
+
+include $(BUILD_EXECUTABLE)
+
+# Build the retransmit_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+LOCAL_MODULE            := retransmit_test
+LOCAL_SRC_FILES         := \
+        src/tests/retransmit_test.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp
+
+include $(BUILD_EXECUTABLE)
+
+# Build the rtcpxr_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+LOCAL_MODULE            := rtcpxr_test
+LOCAL_SRC_FILES         := \
+        src/tests/rtcpxr_test.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp
+
+include $(BUILD_EXECUTABLE)
+
+# Build the pipeline_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+LOCAL_MODULE            := pipeline_test
+LOCAL_SRC_FILES         := \
+        src/tests/pipeline_test.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_C_INCLUDES        += $(LOCAL_PATH)/../srtp-1.4.4/include
+LOCAL_C_INCLUDES        += $(LOCAL_PATH)/../srtp-1.4.4/crypto/include
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp libSrtp
+
+include $(BUILD_EXECUTABLE)
+
+# Build the rtpturn_test test
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+LOCAL_MODULE            := rtpturn_test
+LOCAL_SRC_FILES         := \
+        src/tests/rtpturn_test.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/src
+LOCAL_C_INCLUDES        += $(LOCAL_PATH)/../srtp-1.4.4/include
+LOCAL_C_INCLUDES        += $(LOCAL_PATH)/../srtp-1.4.4/crypto/include
+LOCAL_CFLAGS            := -DHAVE_CONFIG_H -D_REENTRANT -DORTP_INET6 -DIS_ANDROID=1
+
+LOCAL_SHARED_LIBRARIES  := libOrtp libSrtp
+
+include $(BUILD_EXECUTABLE)
@@ -42,6 +42,7 @@ struct _OrtpEventData{
 	union {
 		int telephone_event;
 		int payload_type;
+		int bitrate;
 	} info;
 };
 
@@ -63,6 +64,7 @@ OrtpEventType ortp_event_get_type(const OrtpEvent *ev);
 #define ORTP_EVENT_PAYLOAD_TYPE_CHANGED 	2
 #define ORTP_EVENT_TELEPHONE_EVENT		3
 #define ORTP_EVENT_RTCP_PACKET_RECEIVED		4
+#define ORTP_EVENT_TARGET_BITRATE_CHANGED	5
 OrtpEventData * ortp_event_get_data(OrtpEvent *ev);
 void ortp_event_destroy(OrtpEvent *ev);
 OrtpEvent *ortp_event_dup(OrtpEvent *ev);
@@ -41,7 +41,10 @@ typedef enum {
     RTCP_RR	= 201,
     RTCP_SDES	= 202,
     RTCP_BYE	= 203,
-    RTCP_APP	= 204
+    RTCP_APP	= 204,
+    RTCP_RTPFB	= 205,
+    RTCP_PSFB	= 206,
+    RTCP_XR	= 207
 } rtcp_type_t;
  
  
@@ -196,6 +199,116 @@ typedef struct rtcp_app{
 	char name[4];
 } rtcp_app_t;
 
+/* RTCP XR packets (RFC3611) */
+
+typedef enum {
+    RTCP_XR_STAT_SUMMARY	= 6,
+    RTCP_XR_VOIP_METRICS	= 7
+} rtcp_xr_block_type_t;
+
+typedef struct rtcp_xr_header{
+	rtcp_common_header_t ch;
+	uint32_t ssrc;
+} rtcp_xr_header_t;
+
+typedef struct rtcp_xr_block_header{
+	uint8_t bt;
+	uint8_t flags;	/* type specific */
+	uint16_t length;	/* in 32 bit words minus one */
+} rtcp_xr_block_header_t;
+
+#define RTCP_XR_STAT_SUMMARY_LOSS	0x80
+#define RTCP_XR_STAT_SUMMARY_DUP	0x40
+#define RTCP_XR_STAT_SUMMARY_JITTER	0x20
+
+typedef struct rtcp_xr_stat_summary{
+	rtcp_xr_block_header_t bh;
+	uint32_t ssrc;
+	uint16_t begin_seq;
+	uint16_t end_seq;
+	uint32_t lost_packets;
+	uint32_t dup_packets;
+	uint32_t min_jitter;
+	uint32_t max_jitter;
+	uint32_t mean_jitter;
+	uint32_t dev_jitter;
+	uint8_t min_ttl_or_hl;
+	uint8_t max_ttl_or_hl;
+	uint8_t mean_ttl_or_hl;
+	uint8_t dev_ttl_or_hl;
+} rtcp_xr_stat_summary_t;
+
+/* value of the level, R factor and MOS fields when they are not computed */
+#define RTCP_XR_UNAVAILABLE 127
+
+typedef struct rtcp_xr_voip_metrics{
+	rtcp_xr_block_header_t bh;
+	uint32_t ssrc;
+	uint8_t loss_rate;
+	uint8_t discard_rate;
+	uint8_t burst_density;
+	uint8_t gap_density;
+	uint16_t burst_duration;
+	uint16_t gap_duration;
+	uint16_t round_trip_delay;
+	uint16_t end_system_delay;
+	uint8_t signal_level;
+	uint8_t noise_level;
+	uint8_t rerl;
+	uint8_t gmin;
+	uint8_t r_factor;
+	uint8_t ext_r_factor;
+	uint8_t mos_lq;
+	uint8_t mos_cq;
+	uint8_t rx_config;
+	uint8_t reserved;
+	uint16_t jb_nominal;
+	uint16_t jb_maximum;
+	uint16_t jb_abs_max;
+} rtcp_xr_voip_metrics_t;
+
+/* RTCP transport layer feedback (RFC4585) */
+
+/* feedback message types, carried in the rc field of the common header */
+#define RTCP_RTPFB_NACK	1
+
+typedef struct rtcp_fb_header{
+	rtcp_common_header_t ch;
+	uint32_t packet_sender_ssrc;
+	uint32_t media_source_ssrc;
+} rtcp_fb_header_t;
+
+typedef struct rtcp_fb_nack_fci{
+	uint16_t pid;	/* first lost packet */
+	uint16_t blp;	/* bitmask of the following 16 lost packets */
+} rtcp_fb_nack_fci_t;
+
+#define rtcp_xr_block_get_type(bh)	((bh)->bt)
+#define rtcp_xr_block_get_length(bh)	ntohs((bh)->length)
+
+/**
+ * Call quality, either measured locally on the incoming stream or reported by
+ * the remote party in RTCP XR. Rates and densities are in the range 0..1,
+ * durations and delays in milliseconds.
+**/
+typedef struct _RtpQualityMetrics{
+	float loss_rate;	/**< packets lost since the beginning of reception */
+	float discard_rate;	/**< packets received but discarded by the jitter buffer */
+	float burst_density;	/**< loss and discard proportion within bursts */
+	float gap_density;	/**< loss and discard proportion within gaps */
+	int burst_duration;	/**< mean duration of bursts */
+	int gap_duration;	/**< mean duration of gaps */
+	int round_trip_delay;	/**< from LSR/DLSR of the last report block, -1 if unknown */
+	int end_system_delay;	/**< jitter buffer delay plus packetization */
+	int jb_nominal;	/**< nominal jitter buffer delay */
+	int jb_maximum;	/**< current jitter buffer delay */
+	int jb_abs_max;	/**< the jitter buffer delay cannot grow above this */
+	float mean_jitter;	/**< interarrival jitter over the last report interval */
+	float max_jitter;	/**< idem */
+	uint32_t lost_packets;	/**< packets lost during the last report interval */
+	uint32_t dup_packets;	/**< duplicated packets during the last report interval */
+} RtpQualityMetrics;
+
 struct _RtpSession;
 void rtp_session_rtcp_process_send(struct _RtpSession *s);
 void rtp_session_rtcp_process_recv(struct _RtpSession *s);
@@ -244,6 +357,20 @@ void rtcp_APP_get_name(const mblk_t *m, char *name);
 /* retrieve the data. when returning, data points directly into the mblk_t */
 void rtcp_APP_get_data(const mblk_t *m, uint8_t **data, int *len);
 
+/*XR accessors */
+bool_t rtcp_is_XR(const mblk_t *m);
+uint32_t rtcp_XR_get_ssrc(const mblk_t *m);
+/* returns the first report block of the given type, or NULL. The block points directly into the mblk_t */
+const rtcp_xr_block_header_t * rtcp_XR_get_block(const mblk_t *m, rtcp_xr_block_type_t type);
+
+/*RTPFB accessors */
+bool_t rtcp_is_RTPFB(const mblk_t *m);
+int rtcp_RTPFB_get_type(const mblk_t *m);
+uint32_t rtcp_RTPFB_get_packet_sender_ssrc(const mblk_t *m);
+uint32_t rtcp_RTPFB_get_media_source_ssrc(const mblk_t *m);
+/* returns the idx-th NACK FCI, or NULL. The FCI points directly into the mblk_t */
+const rtcp_fb_nack_fci_t * rtcp_RTPFB_NACK_get_fci(const mblk_t *m, int idx);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,64 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/**
+ * \file rtpmux.h
+ * \brief Running many RtpSession over a single shared UDP socket.
+ *
+ * A RtpSocketMux owns one bound UDP socket (plus a second one for RTCP unless
+ * rtcp-mux is used) and demultiplexes incoming datagrams to the RtpSession
+ * objects attached to it, using the remote address and the SSRC of the packet.
+ * Sessions attached to a mux do not open any socket of their own.
+**/
+
+#ifndef ortp_rtpmux_h
+#define ortp_rtpmux_h
+
+#include <ortp/rtpsession.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+typedef struct _RtpSocketMux RtpSocketMux;
+
+typedef struct _RtpSocketMuxStats{
+	uint64_t dispatched;	/* datagrams delivered to a session */
+	uint64_t unmatched;	/* datagrams for which no session was found */
+	uint64_t overflow;	/* datagrams dropped because a session did not read them */
+} RtpSocketMuxStats;
+
+RtpSocketMux *rtp_socket_mux_new(const char *addr, int port, bool_t rtcp_mux);
+void rtp_socket_mux_destroy(RtpSocketMux *mux);
+
+int rtp_socket_mux_add_session(RtpSocketMux *mux, RtpSession *session, const char *remote_addr, int rtp_port, int rtcp_port);
+void rtp_socket_mux_remove_session(RtpSocketMux *mux, RtpSession *session);
+
+int rtp_socket_mux_process(RtpSocketMux *mux);
+
+ortp_socket_t rtp_socket_mux_get_rtp_socket(const RtpSocketMux *mux);
+ortp_socket_t rtp_socket_mux_get_rtcp_socket(const RtpSocketMux *mux);
+int rtp_socket_mux_get_local_port(const RtpSocketMux *mux);
+const RtpSocketMuxStats *rtp_socket_mux_get_stats(const RtpSocketMux *mux);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
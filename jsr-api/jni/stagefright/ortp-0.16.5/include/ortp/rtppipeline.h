@@ -0,0 +1,71 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/**
+ * \file rtppipeline.h
+ * \brief Receiving and decrypting packets on dedicated I/O threads.
+ *
+ * A RtpPipeline runs a few I/O threads that read the sockets of the sessions
+ * attached to it and pass the packets through the session transports (SRTP
+ * unprotect included). Each packet is then handed over a lock-free single
+ * producer, single consumer queue to the thread that owns the session, its
+ * media worker, which parses, decodes and mixes it as usual through
+ * rtp_session_recvm_with_ts(). Crypto and media work thus run on different
+ * cores, and the sessions can be spread over one media worker per core.
+ *
+ * A session attached to a pipeline must be read by one thread only. When a
+ * session does not read its queue, its socket is left alone until there is
+ * room again, so that the kernel buffer absorbs the burst.
+**/
+
+#ifndef ortp_rtppipeline_h
+#define ortp_rtppipeline_h
+
+#include <ortp/rtpsession.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+typedef struct _RtpPipeline RtpPipeline;
+
+typedef struct _RtpPipelineStats{
+	uint64_t received;	/* packets received and decrypted by the I/O threads */
+	uint64_t delivered;	/* packets handed to the sessions */
+	uint64_t recv_errors;	/* receive or decryption failures */
+	uint64_t backpressure;	/* times a socket was left unread because its queue was full */
+	uint64_t io_time_us;	/* receive and decrypt stage, total and worst case */
+	uint64_t io_max_us;
+	uint64_t queue_time_us;	/* time spent in the queues, total and worst case */
+	uint64_t queue_max_us;
+} RtpPipelineStats;
+
+RtpPipeline *rtp_pipeline_new(int io_threads);
+void rtp_pipeline_destroy(RtpPipeline *pipeline);
+
+int rtp_pipeline_add_session(RtpPipeline *pipeline, RtpSession *session);
+void rtp_pipeline_remove_session(RtpPipeline *pipeline, RtpSession *session);
+
+void rtp_pipeline_get_stats(RtpPipeline *pipeline, RtpPipelineStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -114,7 +114,7 @@ typedef struct _RtpStream
 	struct sockaddr_in rem_addr;
 #endif
 	int rem_addrlen;
-	void *QoSHandle;
+	void *QoSHandle;
 	unsigned long QoSFlowID;
 	JitterControl jittctl;
 	uint32_t snd_time_offset;/*the scheduler time when the application send its first timestamp*/	
@@ -150,6 +150,103 @@ typedef struct _RtpStream
 	int ssrc_changed_thres;
 }RtpStream;
 
+/* state of the RTCP XR (RFC3611) measurements on the incoming stream */
+typedef struct _RtcpXrStats
+{
+	/* transition counters of the burst/gap model, RFC3611 appendix A.2 */
+	uint32_t c11,c13,c14,c22,c23,c33;
+	uint32_t pkt;	/* packets received since the last loss */
+	uint32_t lost;	/* losses in the current burst */
+	uint32_t received_total;
+	uint32_t lost_total;
+	uint32_t discarded_total;
+	/* statistics summary of the current report interval */
+	uint32_t lost_packets;
+	uint32_t dup_packets;
+	uint32_t min_jitter;
+	uint32_t max_jitter;
+	double sum_jitter;
+	double sum_sq_jitter;
+	uint32_t jitter_count;
+	uint16_t begin_seq;
+	uint16_t last_seq;
+	uint32_t last_ts;
+	uint32_t packet_duration;	/* in timestamp units */
+	int rtt;	/* in 1/65536 seconds, -1 when unknown */
+	RtpQualityMetrics remote;	/* as reported by the remote party */
+	bool_t remote_valid;
+	bool_t started;
+	bool_t enabled;
+} RtcpXrStats;
+
+#define RTP_RATE_WINDOW_SLOTS 10
+
+/* send rate over a sliding window, and target bitrate computed from the received RTCP reports */
+typedef struct _RtpRateControl
+{
+	uint32_t slot_bytes[RTP_RATE_WINDOW_SLOTS];	/* bytes sent in each 100ms slot */
+	uint64_t cur_slot;
+	uint64_t first_ms;	/* time of the first packet sent, in ms */
+	int min_bitrate;
+	int max_bitrate;
+	int target_bitrate;
+	int min_rtt;	/* in ms, -1 until known */
+	uint32_t last_jitter;	/* as reported by the peer, in timestamp units */
+	bool_t enabled;
+} RtpRateControl;
+
+#define RTP_NACK_MAX_MISSING 64
+
+typedef struct _RtpMissingPacket
+{
+	uint64_t detected_ms;
+	uint64_t nacked_ms;	/* time of the last NACK, 0 if none was sent yet */
+	uint16_t seq;
+	int nacks;
+} RtpMissingPacket;
+
+/* generic NACK generation (RFC4585) and decapsulation of RTX packets (RFC4588) on the incoming stream */
+typedef struct _RtpNackContext
+{
+	int nmissing;
+	uint64_t last_sent_ms;
+	uint16_t highest_seq;
+	int rtx_pt;	/* payload type of the RTX packets, -1 if none */
+	int rtx_apt;	/* payload type of the original packets */
+	bool_t started;
+	bool_t enabled;
+	RtpMissingPacket missing[RTP_NACK_MAX_MISSING];	/* in detection order */
+} RtpNackContext;
+
+/* the recently sent packets, indexed by sequence number, to answer NACKs.
+ The slots are filled on the send path and read on the receive path (RTCP),
+ so they are used with lock held; the retransmissions made on the receive
+ path wait in pending until the send path sends them. */
+typedef struct _RtpRtxBuffer
+{
+	struct _RtpRtxSlot *slots;
+	int size;	/* a power of two */
+	int pt;	/* payload type of the RTX packets, -1 to send the original packets again */
+	uint32_t ssrc;	/* of the RTX stream */
+	uint16_t seq;	/* of the RTX stream */
+	bool_t enabled;
+	ortp_mutex_t lock;
+	queue_t pending;
+} RtpRtxBuffer;
+
+/**
+ * Counters of the NACK/RTX machinery, see rtp_session_get_retransmission_stats().
+**/
+typedef struct _RtpRetransmissionStats
+{
+	uint32_t nack_sent;	/**< NACK packets sent */
+	uint32_t nack_received;	/**< NACK packets received about our stream */
+	uint32_t retransmitted;	/**< packets sent again in answer to a NACK */
+	uint32_t not_found;	/**< requested packets that were no longer buffered */
+	uint32_t recovered;	/**< missing packets that arrived late or retransmitted */
+	uint32_t abandoned;	/**< missing packets given up after too many NACKs */
+} RtpRetransmissionStats;
+
 typedef struct _RtcpStream
 {
 	ortp_socket_t socket;
@@ -162,12 +259,42 @@ typedef struct _RtcpStream
 	struct sockaddr_in rem_addr;
 #endif
 	int rem_addrlen;
+	mblk_t *sdes_cache; /* serialized SDES packet, rebuilt only when the source description changes */
+	mblk_t *report_buf; /* buffer in which SR/RR are filled in place */
+	ortp_mutex_t report_lock; /* reports are made from both the send and the receive paths */
+	ortp_mutex_t xr_lock; /* the XR measurements are made on the receive path and reported on the send path */
+	float avg_rtcp_size; /* RFC3550 avg_rtcp_size, in octets including UDP/IP headers */
+	int bandwidth; /* bandwidth for RTCP in bits/s, 0 to only use the minimal interval */
+	int clock_rate; /* used to express the report interval in timestamp units */
+	unsigned int rand_seed; /* rand_r() state of the report interval randomization */
 	bool_t enabled; /*tells whether we can send RTCP packets */
+	bool_t report_sent; /* false until the first compound packet is sent */
+	RtcpXrStats xr;
 } RtcpStream;
 
 typedef struct _RtpSession RtpSession;
 
 
+/* the part of a session that neither the scheduler nor the packet paths read: it is
+allocated apart, so that the RtpSession itself spans fewer cache lines */
+typedef struct _RtpSessionCold
+{
+	RtpSignalTable on_ssrc_changed;
+	RtpSignalTable on_payload_type_changed;
+	RtpSignalTable on_telephone_event_packet;
+	RtpSignalTable on_telephone_event;
+	RtpSignalTable on_timestamp_jump;
+	RtpSignalTable on_network_error;
+	RtpSignalTable on_rtcp_bye;
+	RtpSignalTable on_target_bitrate_changed;
+	struct _OList *signal_tables;
+	mblk_t *sd;
+	queue_t contributing_sources;
+	int dscp;
+	int multicast_ttl;
+	int multicast_loopback;
+} RtpSessionCold;
+
 /**
  * An object representing a bi-directional RTP session.
  * It holds sockets, jitter buffer, various counters (timestamp, sequence numbers...)
@@ -178,8 +305,9 @@ typedef struct _RtpSession RtpSession;
 **/
 struct _RtpSession
 {
-	RtpSession *next;	/* next RtpSession, when the session are enqueued by the scheduler */
+	RtpSession *next;	/* unused: the scheduler keeps its sessions in an array of slots */
 	int mask_pos;	/* the position in the scheduler mask of RtpSession : do not move this field: it is part of the ABI since the session_set macros use it*/
+	uint32_t flags;
         struct {
 	  RtpProfile *profile;
 	  int pt;
@@ -191,36 +319,28 @@ struct _RtpSession
 	int inc_same_ssrc_count;
 	int hw_recv_pt; /* recv payload type before jitter buffer */
 	int recv_buf_size;
-	RtpSignalTable on_ssrc_changed;
-	RtpSignalTable on_payload_type_changed;
-	RtpSignalTable on_telephone_event_packet;
-	RtpSignalTable on_telephone_event;
-	RtpSignalTable on_timestamp_jump;
-	RtpSignalTable on_network_error;
-	RtpSignalTable on_rtcp_bye;
-	struct _OList *signal_tables;
-	struct _OList *eventqs;
-	msgb_allocator_t allocator;
-	RtpStream rtp;
-	RtcpStream rtcp;
+	int headroom; /* bytes left free in front of the outgoing rtp packets, for the transport to prepend its header */
 	RtpSessionMode mode;
 	struct _RtpScheduler *sched;
-	uint32_t flags;
-	int dscp;
-	int multicast_ttl;
-	int multicast_loopback;
-	void * user_data;
+	bool_t symmetric_rtp;
+	bool_t permissive; /*use the permissive algorithm*/
+	bool_t use_connect; /* use connect() on the socket */
+	bool_t ssrc_set;
 	/* FIXME: Should be a table for all session participants. */
 	struct timeval last_recv_time; /* Time of receiving the RTP/RTCP packet. */
 	mblk_t *pending;
 	/* telephony events extension */
 	mblk_t *current_tev;		/* the pending telephony events */
-	mblk_t *sd;
-	queue_t contributing_sources;
-	bool_t symmetric_rtp;
-	bool_t permissive; /*use the permissive algorithm*/
-	bool_t use_connect; /* use connect() on the socket */
-	bool_t ssrc_set;
+	RtpSessionCold *cold;
+	struct _OList *eventqs;
+	void * user_data;
+	msgb_allocator_t allocator;
+	RtpStream rtp;
+	RtcpStream rtcp;
+	RtpRateControl rate_control;
+	RtpRtxBuffer rtx;
+	RtpRetransmissionStats retransmission_stats;
+	RtpNackContext nack;	/* last, most of it is only read when packets are lost */
 };
 	
 
@@ -315,6 +435,8 @@ int rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t userts
 /* high level recv and send functions */
 int rtp_session_recv_with_ts(RtpSession *session, uint8_t *buffer, int len, uint32_t ts, int *have_more);
 int rtp_session_send_with_ts(RtpSession *session, const uint8_t *buffer, int len, uint32_t userts);
+/* sends one payload to several sessions without copying it */
+int rtp_session_fanout_send_with_ts(RtpSession **sessions, int count, mblk_t *payload, uint32_t userts, bool_t marker);
 
 /* event API*/
 void rtp_session_register_event_queue(RtpSession *session, OrtpEvQueue *q);
@@ -326,6 +448,19 @@ float rtp_session_compute_send_bandwidth(RtpSession *session);
 float rtp_session_compute_recv_bandwidth(RtpSession *session);
 
 void rtp_session_send_rtcp_APP(RtpSession *session, uint8_t subtype, const char *name, const uint8_t *data, int datalen);
+void rtp_session_set_rtcp_bandwidth(RtpSession *session, int bitrate);
+void rtp_session_enable_rtcp_xr(RtpSession *session, bool_t yesno);
+void rtp_session_get_quality_metrics(RtpSession *session, RtpQualityMetrics *metrics);
+bool_t rtp_session_get_remote_quality_metrics(RtpSession *session, RtpQualityMetrics *metrics);
+
+float rtp_session_get_send_rate(const RtpSession *session);
+void rtp_session_enable_rate_control(RtpSession *session, bool_t yesno, int min_bitrate, int max_bitrate);
+int rtp_session_get_target_bitrate(const RtpSession *session);
+
+void rtp_session_enable_nack(RtpSession *session, bool_t yesno, int rtx_pt, int rtx_apt);
+void rtp_session_enable_retransmission(RtpSession *session, bool_t yesno, int packets, int rtx_pt);
+void rtp_session_get_retransmission_stats(const RtpSession *session, RtpRetransmissionStats *stats);
+uint32_t rtp_session_get_retransmission_ssrc(const RtpSession *session);
 
 uint32_t rtp_session_get_current_send_ts(RtpSession *session);
 uint32_t rtp_session_get_current_recv_ts(RtpSession *session);
@@ -0,0 +1,76 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/**
+ * \file rtpturn.h
+ * \brief Sending RTP and RTCP through a TURN relay in ChannelData messages.
+ *
+ * A RtpTurnManager binds a TURN channel (RFC5766) to the remote address of
+ * each session added to it, on the allocation the session sockets already
+ * have on the TURN server. Packets then go through the relay with a 4 bytes
+ * ChannelData header instead of the 36 bytes and more of Send and Data
+ * indications. The header is written in the headroom the session reserves in
+ * front of its packets, or sent from a buffer of its own along with them, so
+ * sending does not copy them, and it is stripped on receive by moving the
+ * start of the buffer. SRTP transports of the session are kept and protect
+ * the packets before they are relayed.
+ *
+ * The manager keeps the channel bindings, which also hold the permissions,
+ * and the allocations alive. Refreshes coming due close to each other are
+ * sent together, in one round over all sessions, and reuse the nonce of the
+ * previous requests.
+ * Only IPv4 is supported.
+**/
+
+#ifndef ortp_rtpturn_h
+#define ortp_rtpturn_h
+
+#include <ortp/rtpsession.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+typedef struct _RtpTurnManager RtpTurnManager;
+
+typedef struct _RtpTurnStats{
+	uint64_t sent;	/* packets sent in ChannelData messages */
+	uint64_t indications;	/* packets sent in Send indications, the channel not being bound yet */
+	uint64_t received;	/* packets received in ChannelData messages or Data indications */
+	uint64_t dropped;	/* datagrams that were neither for the channel nor from the server */
+	uint64_t requests;	/* ChannelBind and Refresh requests sent, retransmissions included */
+	uint64_t rounds;	/* rounds of refreshes */
+	uint64_t failures;	/* requests that failed or timed out */
+} RtpTurnStats;
+
+RtpTurnManager *rtp_turn_manager_new(const char *server_addr, int server_port, const char *username, const char *password);
+void rtp_turn_manager_destroy(RtpTurnManager *mgr);
+
+int rtp_turn_manager_add_session(RtpTurnManager *mgr, RtpSession *session);
+void rtp_turn_manager_remove_session(RtpTurnManager *mgr, RtpSession *session);
+
+int rtp_turn_manager_process(RtpTurnManager *mgr);
+
+void rtp_turn_manager_get_stats(RtpTurnManager *mgr, RtpTurnStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,12 +31,16 @@ extern "C"{
 err_status_t ortp_srtp_init(void);
 err_status_t ortp_srtp_deinit(void);
 err_status_t ortp_srtp_create(srtp_t *session, const srtp_policy_t *policy);
+err_status_t ortp_srtp_create_pair(srtp_t *sender, srtp_t *receiver, const srtp_policy_t *policy);
 err_status_t ortp_srtp_dealloc(srtp_t session);
 err_status_t ortp_srtp_add_stream(srtp_t session, const srtp_policy_t *policy);
 
 bool_t ortp_srtp_supported(void);
 
 int srtp_transport_new(srtp_t srtp, RtpTransport **rtpt, RtpTransport **rtcpt );
+int srtp_transport_new_pair(srtp_t sender, srtp_t receiver, RtpTransport **rtpt, RtpTransport **rtcpt );
+void srtp_transport_get_sessions(RtpTransport *tp, srtp_t *sender, srtp_t *receiver);
+void srtp_transport_destroy(RtpTransport *tp);
 
 #ifdef __cplusplus
 }
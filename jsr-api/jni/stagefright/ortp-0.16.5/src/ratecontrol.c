@@ -0,0 +1,181 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Send rate estimation and loss/delay based rate control driven by RTCP reports */
+
+#define LOG_TAG "oRTP-RateControl"
+
+#include "ortp/ortp.h"
+#include "ortp/rtpsession.h"
+#include "utils.h"
+#include "rtpsession_priv.h"
+
+#define RATE_SLOT_MS 100
+#define RATE_WINDOW_MS (RATE_SLOT_MS*RTP_RATE_WINDOW_SLOTS)
+
+/* above this loss fraction, the rate is decreased proportionally */
+#define RC_LOSS_HIGH 0.10
+/* below this loss fraction, the rate may be increased */
+#define RC_LOSS_LOW 0.02
+#define RC_INCREASE_FACTOR 1.08
+#define RC_DELAY_DECREASE_FACTOR 0.85
+/* queuing delay, in ms above the minimal RTT, considered as congestion */
+#define RC_DELAY_SLACK 40
+/* a jitter that doubles is only taken as congestion if it grew by this much, in ms */
+#define RC_JITTER_MIN_INCREASE 10
+
+static uint64_t rate_control_now_ms(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+/* clears the slots that fell out of the window */
+static void rate_window_advance(RtpRateControl *rc, uint64_t now){
+	uint64_t slot=now/RATE_SLOT_MS;
+	uint64_t i;
+	if (rc->first_ms==0){
+		rc->first_ms=now;
+		rc->cur_slot=slot;
+		return;
+	}
+	if (slot<=rc->cur_slot) return;
+	for (i=rc->cur_slot+1;i<=slot && i<=rc->cur_slot+RTP_RATE_WINDOW_SLOTS;i++)
+		rc->slot_bytes[i%RTP_RATE_WINDOW_SLOTS]=0;
+	rc->cur_slot=slot;
+}
+
+void rtp_session_rate_control_sent(RtpSession *session, int bytes){
+	RtpRateControl *rc=&session->rate_control;
+	rate_window_advance(rc,rate_control_now_ms());
+	rc->slot_bytes[rc->cur_slot%RTP_RATE_WINDOW_SLOTS]+=bytes;
+}
+
+/**
+ * Returns the send rate over the last second, in bits/s, including the
+ * IP and UDP headers.
+ * It only reads the rate window, so that it can be called from another
+ * thread than the one sending.
+ *@param session RtpSession
+**/
+float rtp_session_get_send_rate(const RtpSession *session){
+	const RtpRateControl *rc=&session->rate_control;
+	uint64_t now=rate_control_now_ms();
+	uint64_t now_slot=now/RATE_SLOT_MS;
+	uint64_t cur_slot=rc->cur_slot;
+	uint64_t slot,elapsed;
+	uint32_t total=0;
+
+	if (rc->first_ms==0) return 0;
+	/* the slots not updated since they left the window are skipped rather than cleared */
+	slot=cur_slot+1>RTP_RATE_WINDOW_SLOTS ? cur_slot+1-RTP_RATE_WINDOW_SLOTS : 0;
+	if (now_slot+1>RTP_RATE_WINDOW_SLOTS && slot<now_slot+1-RTP_RATE_WINDOW_SLOTS)
+		slot=now_slot+1-RTP_RATE_WINDOW_SLOTS;
+	for (;slot<=cur_slot;slot++) total+=rc->slot_bytes[slot%RTP_RATE_WINDOW_SLOTS];
+	/* the current slot is only partially elapsed */
+	elapsed=(RTP_RATE_WINDOW_SLOTS-1)*RATE_SLOT_MS + now%RATE_SLOT_MS;
+	if (now-rc->first_ms<elapsed) elapsed=now-rc->first_ms;
+	if (elapsed==0) elapsed=1;
+	return (float)total*8*1000/elapsed;
+}
+
+/**
+ * Enables the computation of a target bitrate from the RTCP reports sent by
+ * the remote party. Each time the target changes, the "target_bitrate_changed"
+ * signal is emitted with the new bitrate as argument, and a
+ * ORTP_EVENT_TARGET_BITRATE_CHANGED event is queued.
+ *@param session RtpSession
+ *@param yesno TRUE to enable the rate control.
+ *@param min_bitrate lower bound of the target, in bits/s.
+ *@param max_bitrate upper bound of the target and initial value, in bits/s.
+**/
+void rtp_session_enable_rate_control(RtpSession *session, bool_t yesno, int min_bitrate, int max_bitrate){
+	RtpRateControl *rc=&session->rate_control;
+	rc->enabled=yesno;
+	rc->min_bitrate=min_bitrate;
+	rc->max_bitrate=max_bitrate;
+	rc->target_bitrate=max_bitrate;
+	rc->min_rtt=-1;
+	rc->last_jitter=0;
+}
+
+/**
+ * Returns the last target bitrate computed by the rate control, in bits/s,
+ * or 0 if the rate control is not enabled.
+**/
+int rtp_session_get_target_bitrate(const RtpSession *session){
+	return session->rate_control.enabled ? session->rate_control.target_bitrate : 0;
+}
+
+static void rate_control_publish(RtpSession *session, int bitrate){
+	session->rate_control.target_bitrate=bitrate;
+	ortp_debug("New target bitrate: %i bits/s",bitrate);
+	rtp_signal_table_emit2(&session->cold->on_target_bitrate_changed,(long)bitrate);
+	if (session->eventqs!=NULL){
+		OrtpEvent *ev=ortp_event_new(ORTP_EVENT_TARGET_BITRATE_CHANGED);
+		OrtpEventData *d=ortp_event_get_data(ev);
+		d->info.bitrate=bitrate;
+		rtp_session_dispatch_event(session,ev);
+	}
+}
+
+/**
+ * Updates the target bitrate from a report block the remote party sent
+ * about our stream. The round trip delay must have been updated before.
+**/
+void rtp_session_rate_control_process_report(RtpSession *session, const report_block_t *rb){
+	RtpRateControl *rc=&session->rate_control;
+	float loss=report_block_get_fraction_lost(rb)/256.0f;
+	uint32_t jitter=report_block_get_interarrival_jitter(rb);
+	int rtt=(session->rtcp.xr.rtt>=0) ? (int)(((int64_t)session->rtcp.xr.rtt*1000)>>16) : -1;
+	bool_t delay_increase=FALSE;
+	double target=rc->target_bitrate;
+	float send_rate;
+	PayloadType *pt;
+	int clock_rate;
+
+	if (!rc->enabled) return;
+	/* the report block is about our stream: its jitter is in units of our clock */
+	pt=rtp_profile_get_payload(session->snd.profile,session->snd.pt);
+	clock_rate=(pt!=NULL) ? pt->clock_rate : session->rtcp.clock_rate;
+	if (rtt>=0){
+		if (rc->min_rtt<0 || rtt<rc->min_rtt) rc->min_rtt=rtt;
+		else if (rtt>rc->min_rtt+MAX(RC_DELAY_SLACK,rc->min_rtt/2)) delay_increase=TRUE;
+	}
+	/* the jitter reported by the peer doubled: queues are building up, unless
+	 it is still small enough to be the usual noise of a low jitter */
+	if (rc->last_jitter>0 && jitter>2*rc->last_jitter && clock_rate>0
+		&& (uint64_t)(jitter-rc->last_jitter)*1000>=(uint64_t)RC_JITTER_MIN_INCREASE*clock_rate)
+		delay_increase=TRUE;
+	rc->last_jitter=jitter;
+
+	send_rate=rtp_session_get_send_rate(session);
+	if (loss>RC_LOSS_HIGH){
+		target*=1-0.5*loss;
+	}else if (delay_increase){
+		target*=RC_DELAY_DECREASE_FACTOR;
+	}else if (loss<RC_LOSS_LOW){
+		target*=RC_INCREASE_FACTOR;
+		/* don't go far above what the application actually sends */
+		if (send_rate>0 && target>1.5*send_rate) target=MAX(1.5*send_rate,rc->target_bitrate);
+	}
+	if (target<rc->min_bitrate) target=rc->min_bitrate;
+	if (rc->max_bitrate>0 && target>rc->max_bitrate) target=rc->max_bitrate;
+	if ((int)target!=rc->target_bitrate) rate_control_publish(session,(int)target);
+}
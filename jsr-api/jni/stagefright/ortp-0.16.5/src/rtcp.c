@@ -36,6 +36,13 @@
 #define rtcp_bye_set_ssrc(b,pos,ssrc)	(b)->ssrc[pos]=htonl(ssrc)
 #define rtcp_bye_get_ssrc(b,pos)		ntohl((b)->ssrc[pos])
 
+/* RFC3550 6.3.1: e-3/2, compensates the timer reconsideration */
+#define RTCP_COMPENSATION 1.21828
+/* IPv4 + UDP headers, counted in avg_rtcp_size */
+#define RTCP_UDP_IP_OVERHEAD 28
+/* we only handle unicast sessions: us and the remote party */
+#define RTCP_SESSION_MEMBERS 2
+
 
 void rtcp_common_header_init(rtcp_common_header_t *ch, RtpSession *s,int type, int rc, int bytes_len){
 	rtcp_common_header_set_version(ch,2);
@@ -100,8 +107,9 @@ void rtp_session_set_source_description(RtpSession *session,
 	chunk=sdes_chunk_append_item(chunk, RTCP_SDES_TOOL, tool);
 	chunk=sdes_chunk_append_item(chunk, RTCP_SDES_NOTE, note);
 	chunk=sdes_chunk_pad(chunk);
-	if (session->sd!=NULL) freemsg(session->sd);
-	session->sd=m;
+	if (session->cold->sd!=NULL) freemsg(session->cold->sd);
+	session->cold->sd=m;
+	rtp_session_invalidate_sdes(session);
 }
 
 void
@@ -124,7 +132,8 @@ rtp_session_add_contributing_source(RtpSession *session, uint32_t csrc,
 	chunk=sdes_chunk_append_item(chunk, RTCP_SDES_TOOL, tool);
 	chunk=sdes_chunk_append_item(chunk, RTCP_SDES_NOTE, note);
 	chunk=sdes_chunk_pad(chunk);
-	putq(&session->contributing_sources,m);
+	putq(&session->cold->contributing_sources,m);
+	rtp_session_invalidate_sdes(session);
 }
 
 
@@ -140,18 +149,40 @@ mblk_t* rtp_session_create_rtcp_sdes_packet(RtpSession *session)
 	mp->b_wptr+=sizeof(rtcp_common_header_t);
 	
 	/* concatenate all sdes chunks */
-	sdes_chunk_set_ssrc(session->sd,session->snd.ssrc);
-	m=concatb(m,dupmsg(session->sd));
+	sdes_chunk_set_ssrc(session->cold->sd,session->snd.ssrc);
+	m=concatb(m,dupmsg(session->cold->sd));
 	rc++;
 	
-	q=&session->contributing_sources;
-    for (tmp=qbegin(q); !qend(q,tmp); tmp=qnext(q,mp)){
+	q=&session->cold->contributing_sources;
+    for (tmp=qbegin(q); !qend(q,tmp); tmp=qnext(q,tmp)){
 		m=concatb(m,dupmsg(tmp));
 		rc++;
 	}
 	rtcp_common_header_init(rtcp,session,RTCP_SDES,rc,msgdsize(mp));
     return mp;
 }
+
+/**
+ * Drops the serialized SDES packet, so that it is rebuilt from the current
+ * source description when the next compound packet is made.
+**/
+void rtp_session_invalidate_sdes(RtpSession *session){
+	ortp_mutex_lock(&session->rtcp.report_lock);
+	if (session->rtcp.sdes_cache!=NULL){
+		freemsg(session->rtcp.sdes_cache);
+		session->rtcp.sdes_cache=NULL;
+	}
+	ortp_mutex_unlock(&session->rtcp.report_lock);
+}
+
+static mblk_t *rtp_session_get_sdes(RtpSession *session){
+	if (session->rtcp.sdes_cache==NULL && session->cold->sd!=NULL){
+		mblk_t *m=rtp_session_create_rtcp_sdes_packet(session);
+		msgpullup(m,-1);
+		session->rtcp.sdes_cache=m;
+	}
+	return session->rtcp.sdes_cache;
+}
  
 
 mblk_t *rtcp_create_simple_bye_packet(uint32_t ssrc, const char *reason)
@@ -190,12 +221,14 @@ mblk_t *rtcp_create_simple_bye_packet(uint32_t ssrc, const char *reason)
 
 void rtp_session_remove_contributing_sources(RtpSession *session, uint32_t ssrc)
 {
-	queue_t *q=&session->contributing_sources;
+	queue_t *q=&session->cold->contributing_sources;
 	mblk_t *tmp;
 	for (tmp=qbegin(q); !qend(q,tmp); tmp=qnext(q,tmp)){
 		uint32_t csrc=sdes_chunk_get_ssrc(tmp);
 		if (csrc==ssrc) {
 			remq(q,tmp);
+			freemsg(tmp);
+			rtp_session_invalidate_sdes(session);
 			break;
 		}
 	}
@@ -299,33 +332,115 @@ static int rtcp_app_init(RtpSession *session, uint8_t *buf, uint8_t subtype, con
 	return sizeof(rtcp_app_t);
 }
 
-static mblk_t * make_rr(RtpSession *session){
-	mblk_t *cm=NULL;
-	mblk_t *sdes=NULL;
+/* returns the report buffer, emptied; a new one is allocated if the previous
+ report is still referenced by a packet that was not sent yet.
+ The send and the receive paths both make reports, possibly from two threads:
+ the report buffer, the SDES cache and the report statistics are used with
+ rtcp.report_lock held, from the making of the compound packet to its sending. */
+static mblk_t *rtcp_get_report_buffer(RtpSession *session){
+	mblk_t *m=session->rtcp.report_buf;
+	if (m==NULL || m->b_datap->db_ref>1){
+		if (m!=NULL) freemsg(m);
+		m=allocb(sizeof(rtcp_sr_t),0);
+		session->rtcp.report_buf=m;
+	}
+	m->b_rptr=m->b_wptr=m->b_datap->db_base;
+	return m;
+}
+
+/* the SR/RR is filled in place in the report buffer and the SDES comes from
+ the cache: only the message headers are allocated */
+static mblk_t * make_compound(RtpSession *session, bool_t is_sr){
+	mblk_t *rb=rtcp_get_report_buffer(session);
+	mblk_t *sdes;
+	mblk_t *cm;
 	
-	cm=allocb(sizeof(rtcp_sr_t),0);
-	cm->b_wptr+=rtcp_rr_init(session,cm->b_wptr,sizeof(rtcp_rr_t));
-	/* make a SDES packet */
-	if (session->sd!=NULL)
-		sdes=rtp_session_create_rtcp_sdes_packet(session);
-	/* link them */
-	cm->b_cont=sdes;
+	if (is_sr)
+		rb->b_wptr+=rtcp_sr_init(session,rb->b_wptr,sizeof(rtcp_sr_t));
+	else
+		rb->b_wptr+=rtcp_rr_init(session,rb->b_wptr,sizeof(rtcp_rr_t));
+	cm=dupb(rb);
+	sdes=rtp_session_get_sdes(session);
+	if (sdes!=NULL)
+		cm->b_cont=dupb(sdes);
+	if (session->rtcp.xr.enabled && session->rtp.stats.packet_recv>0)
+		concatb(cm,rtp_session_create_rtcp_xr_packet(session));
 	return cm;
 }
 
+#define make_rr(session)	make_compound(session,FALSE)
+#define make_sr(session)	make_compound(session,TRUE)
+
+/**
+ * Sends a feedback packet (RFC4585) right away, in a compound packet made of
+ * a SR or RR, the SDES and the feedback. The regular reports are not
+ * rescheduled.
+**/
+void rtp_session_rtcp_send_feedback(RtpSession *session, mblk_t *fb){
+	mblk_t *rb;
+	mblk_t *sdes;
+	mblk_t *cm;
+
+	ortp_mutex_lock(&session->rtcp.report_lock);
+	rb=rtcp_get_report_buffer(session);
+
+	if (session->rtp.stats.packet_sent>0)
+		rb->b_wptr+=rtcp_sr_init(session,rb->b_wptr,sizeof(rtcp_sr_t));
+	else
+		rb->b_wptr+=rtcp_rr_init(session,rb->b_wptr,sizeof(rtcp_rr_t));
+	cm=dupb(rb);
+	sdes=rtp_session_get_sdes(session);
+	if (sdes!=NULL)
+		cm->b_cont=dupb(sdes);
+	concatb(cm,fb);
+	rtp_session_rtcp_send(session,cm);
+	ortp_mutex_unlock(&session->rtcp.report_lock);
+}
+
+/**
+ * Sets the bandwidth available for RTCP, used to scale the report interval
+ * as described in RFC3550 section 6.2. It is usually 5% of the session
+ * bandwidth. With 0 (the default), the interval is drawn between 0.5 and
+ * 1.5 times RTCP_DEFAULT_REPORT_INTERVAL and divided by e-3/2 (RFC3550
+ * A.7), so reports are sent about every 4.1 seconds on average, and the
+ * first one after half of that.
+ *@param session RtpSession
+ *@param bitrate the RTCP bandwidth in bits per second.
+**/
+void rtp_session_set_rtcp_bandwidth(RtpSession *session, int bitrate){
+	session->rtcp.bandwidth=bitrate;
+	rtp_session_rtcp_schedule_next_report(session);
+}
 
-static mblk_t * make_sr(RtpSession *session){
-	mblk_t *cm=NULL;
-	mblk_t *sdes=NULL;
+/**
+ * Computes the interval until the next compound packet (RFC3550 6.3.1 and
+ * A.7), randomized so that the reports of the participants do not
+ * synchronize, and expressed in timestamp units.
+**/
+void rtp_session_rtcp_schedule_next_report(RtpSession *session){
+	RtcpStream *rtcp=&session->rtcp;
+	double td=RTCP_DEFAULT_REPORT_INTERVAL;
+	double t;
 	
-	cm=allocb(sizeof(rtcp_sr_t),0);
-	cm->b_wptr+=rtcp_sr_init(session,cm->b_wptr,sizeof(rtcp_sr_t));
-	/* make a SDES packet */
-	if (session->sd!=NULL)
-		sdes=rtp_session_create_rtcp_sdes_packet(session);
-	/* link them */
-	cm->b_cont=sdes;
-	return cm;
+	if (rtcp->report_sent==FALSE) td/=2;
+	if (rtcp->bandwidth>0 && rtcp->avg_rtcp_size>0){
+		double n=RTCP_SESSION_MEMBERS*rtcp->avg_rtcp_size*8/rtcp->bandwidth;
+		if (n>td) td=n;
+	}
+	t=td*(0.5+(double)(rand_r(&rtcp->rand_seed)&0xffff)/65536.0)/RTCP_COMPENSATION;
+	session->rtp.rtcp_report_snt_interval=(uint32_t)(t*rtcp->clock_rate);
+}
+
+static void rtp_session_rtcp_send_report(RtpSession *session, mblk_t *m){
+	RtcpStream *rtcp=&session->rtcp;
+	int size=msgdsize(m)+RTCP_UDP_IP_OVERHEAD;
+	if (rtcp->avg_rtcp_size==0) rtcp->avg_rtcp_size=size;
+	else rtcp->avg_rtcp_size=(size+15*rtcp->avg_rtcp_size)/16;
+	/* send the compound packet */
+	rtp_session_rtcp_send(session,m);
+	rtcp->report_sent=TRUE;
+	rtp_session_rtcp_schedule_next_report(session);
+	ortp_debug("Rtcp compound message sent.");
 }
 
 void rtp_session_rtcp_process_send(RtpSession *session){
@@ -335,21 +450,23 @@ void rtp_session_rtcp_process_send(RtpSession *session){
 		|| st->snd_last_ts - st->last_rtcp_report_snt_s > st->rtcp_report_snt_interval){
 		st->last_rtcp_report_snt_r=st->rcv_last_app_ts;
 		st->last_rtcp_report_snt_s=st->snd_last_ts;
+		ortp_mutex_lock(&session->rtcp.report_lock);
 		m=make_sr(session);
-		/* send the compound packet */
-		rtp_session_rtcp_send(session,m);
-		ortp_debug("Rtcp compound message sent.");
+		rtp_session_rtcp_send_report(session,m);
+		ortp_mutex_unlock(&session->rtcp.report_lock);
 	}
 }
 
 void rtp_session_rtcp_process_recv(RtpSession *session){
 	RtpStream *st=&session->rtp;
 	mblk_t *m=NULL;
+	rtp_session_nack_process(session);
 	if (st->rcv_last_app_ts - st->last_rtcp_report_snt_r > st->rtcp_report_snt_interval 
 		|| st->snd_last_ts - st->last_rtcp_report_snt_s > st->rtcp_report_snt_interval){
 		st->last_rtcp_report_snt_r=st->rcv_last_app_ts;
 		st->last_rtcp_report_snt_s=st->snd_last_ts;
 
+		ortp_mutex_lock(&session->rtcp.report_lock);
 		if (session->rtp.last_rtcp_packet_count<session->rtp.stats.packet_sent){
 			m=make_sr(session);
 			session->rtp.last_rtcp_packet_count=session->rtp.stats.packet_sent;
@@ -358,10 +475,9 @@ void rtp_session_rtcp_process_recv(RtpSession *session){
 			m=make_rr(session);
 		}
 		if (m!=NULL){
-			/* send the compound packet */
-			rtp_session_rtcp_send(session,m);
-			ortp_debug("Rtcp compound message sent.");
+			rtp_session_rtcp_send_report(session,m);
 		}
+		ortp_mutex_unlock(&session->rtcp.report_lock);
 	}
 }
 
@@ -22,6 +22,7 @@
 
 #include "ortp/ortp.h"
 #include "utils.h"
+#include "rtpsession_priv.h"
 
 
 /*in case of coumpound packet, set read pointer of m to the beginning of the next RTCP
@@ -289,6 +290,66 @@ void rtcp_APP_get_data(const mblk_t *m, uint8_t **data, int *len){
 	}
 }
 
+/* middle 32 bits of the NTP timestamp, the unit of LSR and DLSR */
+static uint32_t rtcp_ntp_middle(const struct timeval *tv){
+	return ((uint32_t)(tv->tv_sec + 0x83AA7E80)<<16) | (uint32_t)((((uint64_t)tv->tv_usec)<<16)/1000000);
+}
+
+static void rtcp_process_report_block(RtpSession *session, const report_block_t *rb, const struct timeval *now){
+	uint32_t lsr,dlsr,rtt;
+	lsr=report_block_get_last_SR_time(rb);
+	if (lsr!=0){
+		dlsr=report_block_get_last_SR_delay(rb);
+		rtt=rtcp_ntp_middle(now)-lsr-dlsr;
+		if ((int32_t)rtt>=0) session->rtcp.xr.rtt=(int)rtt;
+	}
+	rtp_session_rate_control_process_report(session,rb);
+}
+
+/* our stream may be reported in any block of a report from a multi-source session */
+static void rtcp_process_report_blocks(RtpSession *session, const mblk_t *m, bool_t is_sr, const struct timeval *now){
+	int i,rc=rtcp_common_header_get_rc(rtcp_get_common_header(m));
+	for(i=0;i<rc;i++){
+		const report_block_t *rb=is_sr ? rtcp_SR_get_report_block(m,i) : rtcp_RR_get_report_block(m,i);
+		if (rb==NULL) break;
+		if (report_block_get_ssrc(rb)==session->snd.ssrc){
+			rtcp_process_report_block(session,rb,now);
+			break;
+		}
+	}
+}
+
+/**
+ * Updates the session from a received compound packet: time of the last SR
+ * (for LSR/DLSR of our report blocks), round trip delay, rate control,
+ * RTCP XR metrics reported by the remote party, and NACKs to answer. The
+ * packet is left unmodified.
+**/
+void rtp_session_rtcp_process_incoming(RtpSession *session, mblk_t *m){
+	uint8_t *rptr=m->b_rptr;
+	struct timeval now;
+
+	if (m->b_cont!=NULL) return;
+	gettimeofday(&now,NULL);
+	do{
+		const rtcp_common_header_t *ch=rtcp_get_common_header(m);
+		if (ch==NULL || rtcp_common_header_get_version(ch)!=2) break;
+		if (rtcp_is_SR(m)){
+			const sender_info_t *si=rtcp_SR_get_sender_info(m);
+			session->rtp.last_rcv_SR_ts=(ntohl(si->ntp_timestamp_msw)<<16) | (ntohl(si->ntp_timestamp_lsw)>>16);
+			session->rtp.last_rcv_SR_time=now;
+			rtcp_process_report_blocks(session,m,TRUE,&now);
+		}else if (rtcp_is_RR(m)){
+			rtcp_process_report_blocks(session,m,FALSE,&now);
+		}else if (rtcp_is_XR(m)){
+			rtp_session_rtcp_xr_parse(session,m);
+		}else if (rtcp_is_RTPFB(m)){
+			rtp_session_rtx_process_nack(session,m);
+		}
+	}while(rtcp_next_packet(m));
+	m->b_rptr=rptr;
+}
+
 /*old functions: deprecated, but some useful code parts can be reused */
 /* Start from now this source code file was written by Nicola Baldo as an extension of 
   the oRTP library. Copyright (C) 2005 Nicola Baldo nicola@baldo.biz*/
@@ -495,7 +556,7 @@ void rtp_session_rtcp_parse(RtpSession *session, mblk_t *mp)
             }
         }
         if (rcv_ssrc_match) {
-            if (session->on_rtcp_bye.count > 0) {
+            if (session->cold->on_rtcp_bye.count > 0) {
                 /* Get reason. */
                 if (reason_space_len > 1) {
                     uint8_t *reasonbuf = (uint8_t *) rtcp
@@ -507,7 +568,7 @@ void rtp_session_rtcp_parse(RtpSession *session, mblk_t *mp)
                         ortp_debug("Incorrect RTCP BYE reason length");
                     }
                 }
-                rtp_signal_table_emit2(&session->on_rtcp_bye,
+                rtp_signal_table_emit2(&session->cold->on_rtcp_bye,
                     (long)reason);
                 if (reason)
                     ortp_free(reason);
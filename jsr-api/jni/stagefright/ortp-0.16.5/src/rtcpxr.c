@@ -0,0 +1,431 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* RTCP Extended Reports (RFC3611): Statistics Summary and VoIP Metrics blocks */
+
+#define LOG_TAG "oRTP-RTCPXR"
+
+#include "ortp/ortp.h"
+#include "ortp/rtpsession.h"
+#include "ortp/rtcp.h"
+#include "utils.h"
+#include "rtpsession_priv.h"
+#include <math.h>
+
+/* minimal gap length in packets, RFC3611 4.7.2 */
+#define RTCP_XR_GMIN 16
+/* sequence number jumps taken for a restart of the stream rather than losses, as MAX_DROPOUT and MAX_MISORDER in RFC3550 A.1 */
+#define RTCP_XR_MAX_DROPOUT 3000
+#define RTCP_XR_MAX_MISORDER 100
+
+#define RTCP_XR_PACKET_SIZE (sizeof(rtcp_xr_header_t)+sizeof(rtcp_xr_stat_summary_t)+sizeof(rtcp_xr_voip_metrics_t))
+
+/**
+ * Enables or disables the sending of RTCP XR Statistics Summary and VoIP
+ * Metrics blocks in the compound packets. The measurements returned by
+ * rtp_session_get_quality_metrics() are made in any case.
+ *@param session RtpSession
+ *@param yesno TRUE to send RTCP XR.
+**/
+void rtp_session_enable_rtcp_xr(RtpSession *session, bool_t yesno){
+	session->rtcp.xr.enabled=yesno;
+}
+
+void rtp_session_rtcp_xr_reset(RtpSession *session){
+	RtcpXrStats *xr=&session->rtcp.xr;
+	bool_t enabled=xr->enabled;
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	memset(xr,0,sizeof(RtcpXrStats));
+	xr->enabled=enabled;
+	xr->rtt=-1;
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+}
+
+/**
+ * Restarts the measurements of the incoming stream when its source changes.
+ * The round trip delay and what the remote party reported are kept.
+**/
+void rtp_session_rtcp_xr_new_source(RtpSession *session){
+	RtcpXrStats *xr=&session->rtcp.xr;
+	RtpQualityMetrics remote;
+	bool_t remote_valid;
+	bool_t enabled;
+	int rtt;
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	remote=xr->remote;
+	remote_valid=xr->remote_valid;
+	enabled=xr->enabled;
+	rtt=xr->rtt;
+	memset(xr,0,sizeof(RtcpXrStats));
+	xr->remote=remote;
+	xr->remote_valid=remote_valid;
+	xr->enabled=enabled;
+	xr->rtt=rtt;
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+}
+
+static void rtcp_xr_start_interval(RtcpXrStats *xr){
+	xr->begin_seq=xr->last_seq+1;
+	xr->lost_packets=0;
+	xr->dup_packets=0;
+	xr->min_jitter=0;
+	xr->max_jitter=0;
+	xr->sum_jitter=0;
+	xr->sum_sq_jitter=0;
+	xr->jitter_count=0;
+}
+
+/* the burst/gap model of RFC3611 appendix A.2 */
+static void rtcp_xr_packet_lost(RtcpXrStats *xr){
+	if (xr->pkt>=RTCP_XR_GMIN){
+		if (xr->lost==1) xr->c14++;
+		else xr->c13++;
+		xr->lost=1;
+		xr->c11+=xr->pkt;
+	}else{
+		xr->lost++;
+		if (xr->pkt==0) xr->c33++;
+		else{
+			xr->c23++;
+			xr->c22+=xr->pkt-1;
+		}
+	}
+	xr->pkt=0;
+	xr->lost_total++;
+	xr->lost_packets++;
+}
+
+/* called with rtcp.xr_lock held */
+static void rtcp_xr_add_packet(RtcpXrStats *xr, uint16_t seq, uint32_t ts, uint32_t jitter){
+	int16_t delta;
+
+	if (!xr->started){
+		xr->started=TRUE;
+		xr->last_seq=seq;
+		xr->begin_seq=seq;
+		xr->last_ts=ts;
+		xr->received_total++;
+		xr->pkt++;
+		return;
+	}
+	delta=(int16_t)(seq-xr->last_seq);
+	if (delta>RTCP_XR_MAX_DROPOUT || delta<-RTCP_XR_MAX_MISORDER){
+		/* the sender restarted its sequence: follow it without counting losses */
+		xr->last_seq=seq;
+		xr->begin_seq=seq;
+		xr->last_ts=ts;
+		xr->received_total++;
+		xr->pkt++;
+		return;
+	}
+	if (delta==0){
+		xr->dup_packets++;
+		return;
+	}
+	if (delta<0){
+		/* a late packet that was already counted as lost */
+		if (xr->lost_packets>0) xr->lost_packets--;
+		if (xr->lost_total>0) xr->lost_total--;
+		xr->received_total++;
+		return;
+	}
+	if (delta>1 && ts!=xr->last_ts){
+		xr->packet_duration=(ts-xr->last_ts)/delta;
+	}else if (delta==1 && ts!=xr->last_ts){
+		xr->packet_duration=ts-xr->last_ts;
+	}
+	while(--delta>0) rtcp_xr_packet_lost(xr);
+	xr->pkt++;
+	xr->received_total++;
+	xr->last_seq=seq;
+	xr->last_ts=ts;
+
+	if (xr->jitter_count==0 || jitter<xr->min_jitter) xr->min_jitter=jitter;
+	if (jitter>xr->max_jitter) xr->max_jitter=jitter;
+	xr->sum_jitter+=jitter;
+	xr->sum_sq_jitter+=(double)jitter*jitter;
+	xr->jitter_count++;
+}
+
+/**
+ * Feeds a received packet to the XR measurements. Called from the RTP parser
+ * once the packet has been accepted, before the jitter buffer.
+**/
+void rtp_session_rtcp_xr_new_packet(RtpSession *session, uint16_t seq, uint32_t ts){
+	uint32_t jitter=(uint32_t)session->rtp.jittctl.inter_jitter;
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	rtcp_xr_add_packet(&session->rtcp.xr,seq,ts,jitter);
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+}
+
+/* counts packets received but not played (late, or dropped by a full queue) */
+void rtp_session_rtcp_xr_discarded(RtpSession *session, int count){
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	session->rtcp.xr.discarded_total+=count;
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+}
+
+static int ts_to_ms(uint32_t ts, int clock_rate){
+	if (clock_rate<=0) return 0;
+	return (int)(((uint64_t)ts*1000)/clock_rate);
+}
+
+static void rtcp_xr_compute(RtpSession *session, RtpQualityMetrics *m){
+	RtcpXrStats *xr=&session->rtcp.xr;
+	JitterControl *jc=&session->rtp.jittctl;
+	int clock_rate=session->rtcp.clock_rate;
+	uint32_t expected=xr->received_total+xr->lost_total;
+	double c11=xr->c11, c13=xr->c13, c14=xr->c14, c22=xr->c22, c23=xr->c23, c33=xr->c33;
+	double pkt_ms=ts_to_ms(xr->packet_duration,clock_rate);
+
+	memset(m,0,sizeof(RtpQualityMetrics));
+	/* the packets received since the last loss are part of the current gap */
+	if (xr->pkt>=RTCP_XR_GMIN) c11+=xr->pkt;
+
+	if (expected>0){
+		m->loss_rate=(float)xr->lost_total/expected;
+		m->discard_rate=(float)xr->discarded_total/expected;
+	}
+	if (c11+c14>0)
+		m->gap_density=(float)(c14/(c11+c14));
+	if (c13>0){
+		/* c31=c13 and c32=c23 */
+		double ctotal=c11+c14+c13+c22+c23+c13+c23+c33;
+		double p32=c23/(c13+c23+c33);
+		double p23=(c22+c23<1) ? 1 : 1-c22/(c22+c23);
+		m->burst_density=(float)(p23/(p23+p32));
+		m->gap_duration=(int)((c11+c14+c13)*pkt_ms/c13);
+		m->burst_duration=(int)(ctotal*pkt_ms/c13)-m->gap_duration;
+	}else if (c33+c23>0){
+		/* only losses shorter than Gmin since the start: one long burst */
+		m->burst_density=(float)((c33+c23)/(c11+c22+c23+c33));
+		m->burst_duration=(int)((c11+c14+c22+c23+c33)*pkt_ms);
+	}else{
+		m->gap_duration=(int)((c11+c14)*pkt_ms);
+	}
+
+	m->round_trip_delay=(xr->rtt>=0) ? (int)(((int64_t)xr->rtt*1000)>>16) : -1;
+	m->jb_nominal=jc->jitt_comp;
+	m->jb_maximum=jc->enabled ? ts_to_ms(jc->adapt_jitt_comp_ts,clock_rate) : 0;
+	m->jb_abs_max=jc->adaptive ? (int)(session->rtp.max_rq_size*pkt_ms) : m->jb_maximum;
+	m->end_system_delay=m->jb_maximum+(int)pkt_ms;
+
+	if (xr->jitter_count>0){
+		m->mean_jitter=(float)(ts_to_ms((uint32_t)(xr->sum_jitter/xr->jitter_count),clock_rate));
+		m->max_jitter=(float)ts_to_ms(xr->max_jitter,clock_rate);
+	}
+	m->lost_packets=xr->lost_packets;
+	m->dup_packets=xr->dup_packets;
+}
+
+/**
+ * Retrieves the quality of the incoming stream, as measured locally.
+ * The interval values (jitter, lost and duplicated packets) cover the
+ * period since the last RTCP report.
+ *@param session RtpSession
+ *@param metrics the structure to fill.
+**/
+void rtp_session_get_quality_metrics(RtpSession *session, RtpQualityMetrics *metrics){
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	rtcp_xr_compute(session,metrics);
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+}
+
+/**
+ * Retrieves the quality of the outgoing stream, as reported by the remote
+ * party in its last RTCP XR packet.
+ *@param session RtpSession
+ *@param metrics the structure to fill.
+ *@return FALSE if no RTCP XR VoIP Metrics block was received yet.
+**/
+bool_t rtp_session_get_remote_quality_metrics(RtpSession *session, RtpQualityMetrics *metrics){
+	bool_t valid;
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	valid=session->rtcp.xr.remote_valid;
+	if (valid) *metrics=session->rtcp.xr.remote;
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+	return valid;
+}
+
+static uint8_t rate_to_xr(float rate){
+	int v=(int)(rate*256);
+	return (uint8_t)MIN(v,255);
+}
+
+static uint16_t ms_to_xr(int ms){
+	return htons((uint16_t)MAX(0,MIN(ms,65535)));
+}
+
+mblk_t *rtp_session_create_rtcp_xr_packet(RtpSession *session){
+	RtcpXrStats *xr=&session->rtcp.xr;
+	mblk_t *m=allocb(RTCP_XR_PACKET_SIZE,0);
+	rtcp_xr_header_t *h=(rtcp_xr_header_t*)m->b_wptr;
+	rtcp_xr_stat_summary_t *ss=(rtcp_xr_stat_summary_t*)(h+1);
+	rtcp_xr_voip_metrics_t *vm=(rtcp_xr_voip_metrics_t*)(ss+1);
+	RtpQualityMetrics q;
+	uint32_t mean=0,dev=0;
+
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	rtcp_xr_compute(session,&q);
+	rtcp_common_header_init(&h->ch,session,RTCP_XR,0,RTCP_XR_PACKET_SIZE);
+	h->ssrc=htonl(session->snd.ssrc);
+
+	if (xr->jitter_count>0){
+		double avg=xr->sum_jitter/xr->jitter_count;
+		double var=xr->sum_sq_jitter/xr->jitter_count-avg*avg;
+		mean=(uint32_t)avg;
+		dev=(var>0) ? (uint32_t)sqrt(var) : 0;
+	}
+	memset(ss,0,sizeof(rtcp_xr_stat_summary_t));
+	ss->bh.bt=RTCP_XR_STAT_SUMMARY;
+	ss->bh.flags=RTCP_XR_STAT_SUMMARY_LOSS|RTCP_XR_STAT_SUMMARY_DUP|RTCP_XR_STAT_SUMMARY_JITTER;
+	ss->bh.length=htons(sizeof(rtcp_xr_stat_summary_t)/4-1);
+	ss->ssrc=htonl(session->rcv.ssrc);
+	ss->begin_seq=htons(xr->begin_seq);
+	ss->end_seq=htons((uint16_t)(xr->last_seq+1));
+	ss->lost_packets=htonl(xr->lost_packets);
+	ss->dup_packets=htonl(xr->dup_packets);
+	ss->min_jitter=htonl(xr->min_jitter);
+	ss->max_jitter=htonl(xr->max_jitter);
+	ss->mean_jitter=htonl(mean);
+	ss->dev_jitter=htonl(dev);
+
+	vm->bh.bt=RTCP_XR_VOIP_METRICS;
+	vm->bh.flags=0;
+	vm->bh.length=htons(sizeof(rtcp_xr_voip_metrics_t)/4-1);
+	vm->ssrc=htonl(session->rcv.ssrc);
+	vm->loss_rate=rate_to_xr(q.loss_rate);
+	vm->discard_rate=rate_to_xr(q.discard_rate);
+	vm->burst_density=rate_to_xr(q.burst_density);
+	vm->gap_density=rate_to_xr(q.gap_density);
+	vm->burst_duration=ms_to_xr(q.burst_duration);
+	vm->gap_duration=ms_to_xr(q.gap_duration);
+	vm->round_trip_delay=ms_to_xr(q.round_trip_delay);
+	vm->end_system_delay=ms_to_xr(q.end_system_delay);
+	vm->signal_level=RTCP_XR_UNAVAILABLE;
+	vm->noise_level=RTCP_XR_UNAVAILABLE;
+	vm->rerl=RTCP_XR_UNAVAILABLE;
+	vm->gmin=RTCP_XR_GMIN;
+	vm->r_factor=RTCP_XR_UNAVAILABLE;
+	vm->ext_r_factor=RTCP_XR_UNAVAILABLE;
+	vm->mos_lq=RTCP_XR_UNAVAILABLE;
+	vm->mos_cq=RTCP_XR_UNAVAILABLE;
+	/* PLC unspecified, jitter buffer adaptive (3) or not (2) */
+	vm->rx_config=(session->rtp.jittctl.adaptive ? 3 : 2)<<4;
+	vm->reserved=0;
+	vm->jb_nominal=ms_to_xr(q.jb_nominal);
+	vm->jb_maximum=ms_to_xr(q.jb_maximum);
+	vm->jb_abs_max=ms_to_xr(q.jb_abs_max);
+
+	m->b_wptr+=RTCP_XR_PACKET_SIZE;
+	rtcp_xr_start_interval(xr);
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+	return m;
+}
+
+/* stores what the remote party reports about our outgoing stream */
+void rtp_session_rtcp_xr_parse(RtpSession *session, const mblk_t *m){
+	const rtcp_xr_voip_metrics_t *vm=(const rtcp_xr_voip_metrics_t*)rtcp_XR_get_block(m,RTCP_XR_VOIP_METRICS);
+	const rtcp_xr_stat_summary_t *ss=(const rtcp_xr_stat_summary_t*)rtcp_XR_get_block(m,RTCP_XR_STAT_SUMMARY);
+	RtpQualityMetrics *r=&session->rtcp.xr.remote;
+
+	ortp_mutex_lock(&session->rtcp.xr_lock);
+	if (vm!=NULL && ntohl(vm->ssrc)==session->snd.ssrc){
+		uint16_t rtd=ntohs(vm->round_trip_delay);
+		r->loss_rate=vm->loss_rate/256.0f;
+		r->discard_rate=vm->discard_rate/256.0f;
+		r->burst_density=vm->burst_density/256.0f;
+		r->gap_density=vm->gap_density/256.0f;
+		r->burst_duration=ntohs(vm->burst_duration);
+		r->gap_duration=ntohs(vm->gap_duration);
+		r->round_trip_delay=(rtd!=0) ? rtd : -1;
+		r->end_system_delay=ntohs(vm->end_system_delay);
+		r->jb_nominal=ntohs(vm->jb_nominal);
+		r->jb_maximum=ntohs(vm->jb_maximum);
+		r->jb_abs_max=ntohs(vm->jb_abs_max);
+		session->rtcp.xr.remote_valid=TRUE;
+	}
+	if (ss!=NULL && ntohl(ss->ssrc)==session->snd.ssrc){
+		PayloadType *pt=rtp_profile_get_payload(session->snd.profile,session->snd.pt);
+		int clock_rate=(pt!=NULL) ? pt->clock_rate : session->rtcp.clock_rate;
+		if (ss->bh.flags & RTCP_XR_STAT_SUMMARY_LOSS)
+			r->lost_packets=ntohl(ss->lost_packets);
+		if (ss->bh.flags & RTCP_XR_STAT_SUMMARY_DUP)
+			r->dup_packets=ntohl(ss->dup_packets);
+		if (ss->bh.flags & RTCP_XR_STAT_SUMMARY_JITTER){
+			r->mean_jitter=(float)ts_to_ms(ntohl(ss->mean_jitter),clock_rate);
+			r->max_jitter=(float)ts_to_ms(ntohl(ss->max_jitter),clock_rate);
+		}
+	}
+	ortp_mutex_unlock(&session->rtcp.xr_lock);
+}
+
+/*XR accessors */
+bool_t rtcp_is_XR(const mblk_t *m){
+	const rtcp_common_header_t *ch=rtcp_get_common_header(m);
+	if (ch!=NULL && rtcp_common_header_get_packet_type(ch)==RTCP_XR){
+		if (msgdsize(m)<sizeof(rtcp_common_header_t)+
+			(4*rtcp_common_header_get_length(ch))){
+			ortp_warning("Too short RTCP XR packet.");
+			return FALSE;
+		}
+		if (sizeof(rtcp_common_header_t)+4*rtcp_common_header_get_length(ch)
+			< sizeof(rtcp_xr_header_t)){
+			ortp_warning("Bad RTCP XR packet.");
+			return FALSE;
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+uint32_t rtcp_XR_get_ssrc(const mblk_t *m){
+	rtcp_xr_header_t *xr=(rtcp_xr_header_t*)m->b_rptr;
+	return ntohl(xr->ssrc);
+}
+
+const rtcp_xr_block_header_t * rtcp_XR_get_block(const mblk_t *m, rtcp_xr_block_type_t type){
+	rtcp_xr_header_t *xr=(rtcp_xr_header_t*)m->b_rptr;
+	uint8_t *rptr=(uint8_t*)(xr+1);
+	uint8_t *end=(uint8_t*)m->b_rptr+sizeof(rtcp_common_header_t)+
+		(4*rtcp_common_header_get_length(&xr->ch));
+	int min_size=0;
+
+	if (end>(uint8_t*)m->b_wptr) end=(uint8_t*)m->b_wptr;
+	if (type==RTCP_XR_STAT_SUMMARY) min_size=sizeof(rtcp_xr_stat_summary_t);
+	else if (type==RTCP_XR_VOIP_METRICS) min_size=sizeof(rtcp_xr_voip_metrics_t);
+
+	while(rptr+sizeof(rtcp_xr_block_header_t)<=end){
+		rtcp_xr_block_header_t *bh=(rtcp_xr_block_header_t*)rptr;
+		int size=4*(rtcp_xr_block_get_length(bh)+1);
+		if (rptr+size>end){
+			ortp_warning("RTCP XR block of type %i exceeds the packet.",bh->bt);
+			return NULL;
+		}
+		if (bh->bt==type){
+			if (size<min_size){
+				ortp_warning("Too short RTCP XR block of type %i.",bh->bt);
+				return NULL;
+			}
+			return bh;
+		}
+		rptr+=size;
+	}
+	return NULL;
+}
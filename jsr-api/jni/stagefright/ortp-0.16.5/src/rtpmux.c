@@ -0,0 +1,552 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define LOG_TAG "oRTP-Mux"
+
+#include "ortp/ortp.h"
+#include "ortp/rtpmux.h"
+#include "utils.h"
+#include "rtpsession_priv.h"
+
+#define RTP_MUX_DEFAULT_BUCKETS 256
+#define RTP_MUX_MAX_QUEUED 64	/* per session and per stream */
+#define RTP_MUX_MAX_BURST 256	/* datagrams read from a socket in one go */
+#define RTP_MUX_BIND_RETRIES 10	/* random ports tried when the RTCP port above is taken */
+
+struct _RtpMuxLeg;
+
+/* one hash table entry: a (remote address, SSRC) couple that routes to a session.
+ While the remote SSRC is not known yet the entry is a wildcard for its address,
+ and it takes the SSRC of the first packet that matches it. The entries are hashed
+ on the address only, so that a packet with an SSRC that no entry knows (a new
+ source, or RTX) still reaches a session of its address. */
+typedef struct _RtpMuxEntry{
+	struct _RtpMuxEntry *next;
+	struct _RtpMuxLeg *leg;
+#ifdef ORTP_INET6
+	struct sockaddr_storage addr;
+#else
+	struct sockaddr_in addr;
+#endif
+	socklen_t addrlen;
+	uint32_t ssrc;
+	bool_t ssrc_set;
+	bool_t is_rtcp;
+} RtpMuxEntry;
+
+typedef struct _RtpMuxLeg{
+	RtpSocketMux *mux;
+	RtpSession *session;
+	RtpTransport rtptr;
+	RtpTransport rtcptr;
+	RtpMuxEntry rtp_entry;
+	RtpMuxEntry rtcp_entry;
+	queue_t rtp_q;
+	queue_t rtcp_q;
+} RtpMuxLeg;
+
+struct _RtpSocketMux{
+	ortp_socket_t rtp_socket;
+	ortp_socket_t rtcp_socket;
+	int sockfamily;
+	int loc_port;
+	bool_t rtcp_mux;
+	RtpMuxEntry **buckets;
+	unsigned int nbuckets;	/* always a power of two */
+	unsigned int nentries;
+	mblk_t *cached_mp;
+	int recv_buf_size;
+	ortp_mutex_t lock;
+	RtpSocketMuxStats stats;
+};
+
+static unsigned int rtp_mux_hash(const struct sockaddr *addr, bool_t is_rtcp){
+	unsigned int h=2166136261u;
+	const uint8_t *p=NULL;
+	int len=0,i;
+	uint16_t port=0;
+
+	if (addr->sa_family==AF_INET){
+		const struct sockaddr_in *sin=(const struct sockaddr_in*)addr;
+		p=(const uint8_t*)&sin->sin_addr;
+		len=sizeof(sin->sin_addr);
+		port=sin->sin_port;
+	}
+#ifdef ORTP_INET6
+	else if (addr->sa_family==AF_INET6){
+		const struct sockaddr_in6 *sin6=(const struct sockaddr_in6*)addr;
+		p=(const uint8_t*)&sin6->sin6_addr;
+		len=sizeof(sin6->sin6_addr);
+		port=sin6->sin6_port;
+	}
+#endif
+	for(i=0;i<len;i++){
+		h=(h^p[i])*16777619u;
+	}
+	h=(h^port)*16777619u;
+	return h^is_rtcp;
+}
+
+static bool_t rtp_mux_addr_equal(const struct sockaddr *a, const struct sockaddr *b){
+	if (a->sa_family!=b->sa_family) return FALSE;
+	if (a->sa_family==AF_INET){
+		const struct sockaddr_in *sa=(const struct sockaddr_in*)a;
+		const struct sockaddr_in *sb=(const struct sockaddr_in*)b;
+		return sa->sin_port==sb->sin_port && sa->sin_addr.s_addr==sb->sin_addr.s_addr;
+	}
+#ifdef ORTP_INET6
+	if (a->sa_family==AF_INET6){
+		const struct sockaddr_in6 *sa=(const struct sockaddr_in6*)a;
+		const struct sockaddr_in6 *sb=(const struct sockaddr_in6*)b;
+		return sa->sin6_port==sb->sin6_port
+			&& memcmp(&sa->sin6_addr,&sb->sin6_addr,sizeof(sa->sin6_addr))==0;
+	}
+#endif
+	return FALSE;
+}
+
+static unsigned int rtp_mux_entry_bucket(RtpSocketMux *mux, const RtpMuxEntry *e){
+	return rtp_mux_hash((const struct sockaddr*)&e->addr,e->is_rtcp) & (mux->nbuckets-1);
+}
+
+static void rtp_mux_insert(RtpSocketMux *mux, RtpMuxEntry *e);
+
+static void rtp_mux_grow(RtpSocketMux *mux){
+	RtpMuxEntry **old=mux->buckets;
+	unsigned int oldsize=mux->nbuckets;
+	unsigned int i;
+
+	mux->nbuckets=oldsize*2;
+	mux->buckets=ortp_new0(RtpMuxEntry*,mux->nbuckets);
+	mux->nentries=0;
+	for(i=0;i<oldsize;i++){
+		RtpMuxEntry *e=old[i];
+		while(e!=NULL){
+			RtpMuxEntry *next=e->next;
+			rtp_mux_insert(mux,e);
+			e=next;
+		}
+	}
+	ortp_free(old);
+}
+
+static void rtp_mux_insert(RtpSocketMux *mux, RtpMuxEntry *e){
+	unsigned int b;
+	if (mux->nentries>=mux->nbuckets*2) rtp_mux_grow(mux);
+	b=rtp_mux_entry_bucket(mux,e);
+	e->next=mux->buckets[b];
+	mux->buckets[b]=e;
+	mux->nentries++;
+}
+
+static void rtp_mux_remove(RtpSocketMux *mux, RtpMuxEntry *e){
+	RtpMuxEntry **it=&mux->buckets[rtp_mux_entry_bucket(mux,e)];
+	while(*it!=NULL){
+		if (*it==e){
+			*it=e->next;
+			e->next=NULL;
+			mux->nentries--;
+			return;
+		}
+		it=&(*it)->next;
+	}
+}
+
+/* the entry of the source: the one that knows this SSRC, else one still waiting for
+ its remote SSRC, else any of the address. In the last case the SSRC is left to the
+ session to judge (SSRC change, RTX stream).*/
+static RtpMuxEntry *rtp_mux_lookup(RtpSocketMux *mux, const struct sockaddr *from, uint32_t ssrc, bool_t has_ssrc, bool_t is_rtcp){
+	unsigned int b=rtp_mux_hash(from,is_rtcp) & (mux->nbuckets-1);
+	RtpMuxEntry *wildcard=NULL;
+	RtpMuxEntry *other=NULL;
+	RtpMuxEntry *e;
+	for(e=mux->buckets[b];e!=NULL;e=e->next){
+		if (e->is_rtcp!=is_rtcp || !rtp_mux_addr_equal((const struct sockaddr*)&e->addr,from))
+			continue;
+		if (!e->ssrc_set){
+			if (wildcard==NULL) wildcard=e;
+		}else if (has_ssrc && e->ssrc==ssrc){
+			return e;
+		}else if (other==NULL) other=e;
+	}
+	if (wildcard!=NULL){
+		if (has_ssrc){
+			wildcard->ssrc=ssrc;
+			wildcard->ssrc_set=TRUE;
+		}
+		return wildcard;
+	}
+	return other;
+}
+
+/* route a datagram to the session it belongs to. Returns TRUE if mp was consumed.*/
+static bool_t rtp_mux_dispatch(RtpSocketMux *mux, mblk_t *mp, const struct sockaddr *from, bool_t from_rtcp_socket){
+	const uint8_t *p=mp->b_rptr;
+	int len=(int)(mp->b_wptr-mp->b_rptr);
+	bool_t is_rtcp=from_rtcp_socket;
+	bool_t has_ssrc=FALSE;
+	uint32_t ssrc=0;
+	RtpMuxEntry *e;
+	queue_t *q;
+
+	if (len>=8 && (p[0]>>6)==2){
+		/* RFC5761: RTCP packet types 192-223 cannot clash with RTP payload types in use */
+		if (!from_rtcp_socket && mux->rtcp_mux && p[1]>=192 && p[1]<=223)
+			is_rtcp=TRUE;
+		if (is_rtcp){
+			memcpy(&ssrc,p+4,sizeof(ssrc));
+			has_ssrc=TRUE;
+		}else if (len>=RTP_FIXED_HEADER_SIZE){
+			memcpy(&ssrc,p+8,sizeof(ssrc));
+			has_ssrc=TRUE;
+		}
+		ssrc=ntohl(ssrc);
+	}
+	e=rtp_mux_lookup(mux,from,ssrc,has_ssrc,is_rtcp);
+	if (e==NULL){
+		mux->stats.unmatched++;
+		return FALSE;
+	}
+	q=is_rtcp ? &e->leg->rtcp_q : &e->leg->rtp_q;
+	if (q->q_mcount>=RTP_MUX_MAX_QUEUED){
+		freemsg(getq(q));
+		mux->stats.overflow++;
+	}
+	putq(q,mp);
+	mux->stats.dispatched++;
+	return TRUE;
+}
+
+static int rtp_mux_drain(RtpSocketMux *mux, ortp_socket_t sock, bool_t from_rtcp_socket){
+	int count=0;
+	int err;
+#ifdef ORTP_INET6
+	struct sockaddr_storage from;
+#else
+	struct sockaddr_in from;
+#endif
+	socklen_t fromlen;
+	mblk_t *mp;
+
+	while(count<RTP_MUX_MAX_BURST){
+		if (mux->cached_mp==NULL)
+			mux->cached_mp=allocb(mux->recv_buf_size,0);
+		mp=mux->cached_mp;
+		fromlen=sizeof(from);
+		err=recvfrom(sock,(char*)mp->b_wptr,mux->recv_buf_size,0,(struct sockaddr*)&from,&fromlen);
+		if (err<=0){
+			if (err<0 && !is_would_block_error(getSocketErrorCode()))
+				ortp_warning("Error receiving on shared socket %i: %s",sock,getSocketError());
+			break;
+		}
+		mp->b_wptr+=err;
+		if (rtp_mux_dispatch(mux,mp,(struct sockaddr*)&from,from_rtcp_socket)){
+			mux->cached_mp=NULL;
+		}else{
+			/* nobody wants it, reuse the buffer */
+			mp->b_wptr=mp->b_rptr;
+		}
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Reads all datagrams pending on the shared socket(s) and queues them on the sessions
+ * they belong to. The application can call this function when the socket returned by
+ * rtp_socket_mux_get_rtp_socket() becomes readable, so that one wake-up serves all sessions.
+ * Calling it is optional: a session attached to the mux drains the shared socket itself
+ * when it has nothing queued.
+ * @param mux the shared socket
+ * @return the number of datagrams read.
+**/
+int rtp_socket_mux_process(RtpSocketMux *mux){
+	int count;
+	ortp_mutex_lock(&mux->lock);
+	count=rtp_mux_drain(mux,mux->rtp_socket,FALSE);
+	if (!mux->rtcp_mux && mux->rtcp_socket>=0)
+		count+=rtp_mux_drain(mux,mux->rtcp_socket,TRUE);
+	ortp_mutex_unlock(&mux->lock);
+	return count;
+}
+
+/* follows a change of the remote address of the session (rtp_session_set_remote_addr()
+ after the session was attached): the entry is moved to the new address and becomes a
+ wildcard again, since the stream received there may not have the SSRC of the old one.
+ The address of an entry is only written from the thread of its session, so it can be
+ compared without the lock.*/
+static void rtp_mux_entry_sync(RtpSocketMux *mux, RtpMuxEntry *e, const void *rem_addr, int rem_addrlen){
+	if (rem_addrlen<=0 || ((int)e->addrlen==rem_addrlen
+		&& rtp_mux_addr_equal((const struct sockaddr*)&e->addr,(const struct sockaddr*)rem_addr)))
+		return;
+	ortp_mutex_lock(&mux->lock);
+	rtp_mux_remove(mux,e);
+	memcpy(&e->addr,rem_addr,rem_addrlen);
+	e->addrlen=rem_addrlen;
+	e->ssrc_set=FALSE;
+	e->ssrc=0;
+	rtp_mux_insert(mux,e);
+	ortp_mutex_unlock(&mux->lock);
+}
+
+static void rtp_mux_leg_sync(RtpMuxLeg *leg){
+	RtpSession *session=leg->session;
+	rtp_mux_entry_sync(leg->mux,&leg->rtp_entry,&session->rtp.rem_addr,session->rtp.rem_addrlen);
+	/* with rtcp-mux, RTCP comes from the RTP address whatever the rtcp port given */
+	if (leg->mux->rtcp_mux)
+		rtp_mux_entry_sync(leg->mux,&leg->rtcp_entry,&session->rtp.rem_addr,session->rtp.rem_addrlen);
+	else rtp_mux_entry_sync(leg->mux,&leg->rtcp_entry,&session->rtcp.rem_addr,session->rtcp.rem_addrlen);
+}
+
+static int rtp_mux_recvfrom(RtpMuxLeg *leg, queue_t *q, const RtpMuxEntry *e, mblk_t *m, struct sockaddr *from, socklen_t *fromlen){
+	RtpSocketMux *mux=leg->mux;
+	mblk_t *pkt;
+
+	rtp_mux_leg_sync(leg);
+	ortp_mutex_lock(&mux->lock);
+	if (qempty(q)){
+		rtp_mux_drain(mux,mux->rtp_socket,FALSE);
+		if (!mux->rtcp_mux && mux->rtcp_socket>=0)
+			rtp_mux_drain(mux,mux->rtcp_socket,TRUE);
+	}
+	pkt=getq(q);
+	ortp_mutex_unlock(&mux->lock);
+	if (pkt==NULL) return 0; /* would block */
+
+	if (from!=NULL && fromlen!=NULL && *fromlen>=e->addrlen){
+		memcpy(from,&e->addr,e->addrlen);
+		*fromlen=e->addrlen;
+	}
+	/* the datagram was read in a block of its own: give it to the session as is */
+	return rtp_transport_hand_over(m,pkt);
+}
+
+static int rtp_mux_sendto(ortp_socket_t sock, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	if (m->b_cont!=NULL)
+		msgpullup(m,-1);
+	return sendto(sock,(char*)m->b_rptr,(int)(m->b_wptr-m->b_rptr),flags,to,tolen);
+}
+
+static int rtp_mux_rtp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	RtpMuxLeg *leg=(RtpMuxLeg*)t->data;
+	rtp_mux_leg_sync(leg);
+	return rtp_mux_sendto(leg->mux->rtp_socket,m,flags,to,tolen);
+}
+
+static int rtp_mux_rtcp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	RtpMuxLeg *leg=(RtpMuxLeg*)t->data;
+	return rtp_mux_sendto(leg->mux->rtcp_socket,m,flags,to,tolen);
+}
+
+static int rtp_mux_rtp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	RtpMuxLeg *leg=(RtpMuxLeg*)t->data;
+	return rtp_mux_recvfrom(leg,&leg->rtp_q,&leg->rtp_entry,m,from,fromlen);
+}
+
+static int rtp_mux_rtcp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	RtpMuxLeg *leg=(RtpMuxLeg*)t->data;
+	return rtp_mux_recvfrom(leg,&leg->rtcp_q,&leg->rtcp_entry,m,from,fromlen);
+}
+
+static ortp_socket_t rtp_mux_rtp_getsocket(RtpTransport *t){
+	return ((RtpMuxLeg*)t->data)->mux->rtp_socket;
+}
+
+static ortp_socket_t rtp_mux_rtcp_getsocket(RtpTransport *t){
+	return ((RtpMuxLeg*)t->data)->mux->rtcp_socket;
+}
+
+/**
+ * Creates a shared socket bound to addr:port.
+ * If rtcp_mux is TRUE, RTP and RTCP are received and sent on the same port (RFC5761),
+ * otherwise a second socket is bound on port+1 for RTCP.
+ * @param addr the local address to bind
+ * @param port the local port, or -1 to let oRTP choose one randomly
+ * @param rtcp_mux whether RTCP is multiplexed with RTP
+ * @return the new RtpSocketMux, or NULL if the socket(s) could not be bound.
+**/
+RtpSocketMux *rtp_socket_mux_new(const char *addr, int port, bool_t rtcp_mux){
+	RtpSocketMux *mux;
+	ortp_socket_t sock;
+	ortp_socket_t rtcp_sock;
+	bool_t random_port=(port<=0);
+	int sockfamily;
+	int retry;
+
+	for(retry=0;;retry++){
+		if (!random_port)
+			sock=rtp_session_create_and_bind(addr,port,&sockfamily,FALSE);
+		else
+			sock=rtp_session_create_and_bind_random(addr,&sockfamily,&port);
+		if (sock==-1){
+			ortp_error("Could not bind shared RTP socket to %s port %i",addr,port);
+			return NULL;
+		}
+		if (rtcp_mux){
+			rtcp_sock=sock;
+			break;
+		}
+		rtcp_sock=rtp_session_create_and_bind(addr,port+1,&sockfamily,FALSE);
+		if (rtcp_sock!=-1) break;
+		close_socket(sock);
+		/* a random port can be tried again, with another port above it */
+		if (!random_port || retry>=RTP_MUX_BIND_RETRIES){
+			ortp_error("Could not bind shared RTCP socket to %s port %i",addr,port+1);
+			return NULL;
+		}
+	}
+	mux=ortp_new0(RtpSocketMux,1);
+	mux->rtp_socket=sock;
+	mux->rtcp_socket=rtcp_sock;
+	mux->sockfamily=sockfamily;
+	mux->loc_port=port;
+	mux->rtcp_mux=rtcp_mux;
+	mux->nbuckets=RTP_MUX_DEFAULT_BUCKETS;
+	mux->buckets=ortp_new0(RtpMuxEntry*,mux->nbuckets);
+	mux->recv_buf_size=UDP_MAX_SIZE;
+	ortp_mutex_init(&mux->lock,NULL);
+	return mux;
+}
+
+/**
+ * Closes the shared socket(s) and frees the mux.
+ * All sessions must have been removed with rtp_socket_mux_remove_session() before.
+**/
+void rtp_socket_mux_destroy(RtpSocketMux *mux){
+	if (mux->nentries>0)
+		ortp_warning("rtp_socket_mux_destroy(): %i sessions still attached.",mux->nentries/2);
+	if (mux->rtcp_socket>=0 && mux->rtcp_socket!=mux->rtp_socket)
+		close_socket(mux->rtcp_socket);
+	if (mux->rtp_socket>=0)
+		close_socket(mux->rtp_socket);
+	if (mux->cached_mp!=NULL) freemsg(mux->cached_mp);
+	ortp_mutex_destroy(&mux->lock);
+	ortp_free(mux->buckets);
+	ortp_free(mux);
+}
+
+static void rtp_mux_entry_init(RtpMuxEntry *e, RtpMuxLeg *leg, const void *addr, int addrlen, bool_t is_rtcp){
+	RtpSession *session=leg->session;
+	e->leg=leg;
+	e->next=NULL;
+	memcpy(&e->addr,addr,addrlen);
+	e->addrlen=addrlen;
+	e->is_rtcp=is_rtcp;
+	/* if the application already told us the remote SSRC, route on it right away */
+	e->ssrc_set=session->ssrc_set;
+	e->ssrc=session->ssrc_set ? session->rcv.ssrc : 0;
+}
+
+/**
+ * Attaches a session to the shared socket and sets its remote address.
+ * This replaces rtp_session_set_local_addr() and rtp_session_set_remote_addr() for this
+ * session: no socket is opened for it. Incoming packets are routed to the session using
+ * the remote address and the SSRC of the remote stream, learnt from the first packet
+ * received from remote_addr unless the session already knows it.
+ * The session must be removed with rtp_socket_mux_remove_session() before being destroyed.
+ * @param mux the shared socket
+ * @param session a freshly created rtp session
+ * @param remote_addr the remote IP address
+ * @param rtp_port the remote rtp port
+ * @param rtcp_port the remote rtcp port, ignored when the mux uses rtcp-mux.
+ * @return 0 on success.
+**/
+int rtp_socket_mux_add_session(RtpSocketMux *mux, RtpSession *session, const char *remote_addr, int rtp_port, int rtcp_port){
+	RtpMuxLeg *leg;
+
+	if (session->rtp.socket>=0 || (session->flags & RTP_SESSION_USING_SHARED_SOCKET)){
+		ortp_error("rtp_socket_mux_add_session(): session already has a socket.");
+		return -1;
+	}
+	session->flags|=RTP_SESSION_USING_SHARED_SOCKET;
+	session->rtp.sockfamily=mux->sockfamily;
+	session->rtcp.sockfamily=mux->sockfamily;
+	session->rtp.loc_port=mux->loc_port;
+	if (mux->rtcp_mux) rtcp_port=rtp_port;
+	if (rtp_session_set_remote_addr_full(session,remote_addr,rtp_port,rtcp_port)!=0){
+		session->flags&=~RTP_SESSION_USING_SHARED_SOCKET;
+		return -1;
+	}
+
+	leg=ortp_new0(RtpMuxLeg,1);
+	leg->mux=mux;
+	leg->session=session;
+	qinit(&leg->rtp_q);
+	qinit(&leg->rtcp_q);
+	leg->rtptr.data=leg;
+	leg->rtptr.t_getsocket=rtp_mux_rtp_getsocket;
+	leg->rtptr.t_sendto=rtp_mux_rtp_sendto;
+	leg->rtptr.t_recvfrom=rtp_mux_rtp_recvfrom;
+	leg->rtcptr.data=leg;
+	leg->rtcptr.t_getsocket=rtp_mux_rtcp_getsocket;
+	leg->rtcptr.t_sendto=rtp_mux_rtcp_sendto;
+	leg->rtcptr.t_recvfrom=rtp_mux_rtcp_recvfrom;
+	rtp_mux_entry_init(&leg->rtp_entry,leg,&session->rtp.rem_addr,session->rtp.rem_addrlen,FALSE);
+	rtp_mux_entry_init(&leg->rtcp_entry,leg,&session->rtcp.rem_addr,session->rtcp.rem_addrlen,TRUE);
+
+	ortp_mutex_lock(&mux->lock);
+	rtp_mux_insert(mux,&leg->rtp_entry);
+	rtp_mux_insert(mux,&leg->rtcp_entry);
+	ortp_mutex_unlock(&mux->lock);
+
+	rtp_session_set_transports(session,&leg->rtptr,&leg->rtcptr);
+	return 0;
+}
+
+/**
+ * Detaches a session from the shared socket. Packets queued for it are discarded.
+**/
+void rtp_socket_mux_remove_session(RtpSocketMux *mux, RtpSession *session){
+	RtpMuxLeg *leg;
+	if (!(session->flags & RTP_SESSION_USING_SHARED_SOCKET) || session->rtp.tr==NULL
+		|| session->rtp.tr->t_getsocket!=rtp_mux_rtp_getsocket){
+		ortp_warning("rtp_socket_mux_remove_session(): session is not attached to a shared socket.");
+		return;
+	}
+	leg=(RtpMuxLeg*)session->rtp.tr->data;
+	return_if_fail(leg->mux==mux);
+
+	ortp_mutex_lock(&mux->lock);
+	rtp_mux_remove(mux,&leg->rtp_entry);
+	rtp_mux_remove(mux,&leg->rtcp_entry);
+	flushq(&leg->rtp_q,FLUSHALL);
+	flushq(&leg->rtcp_q,FLUSHALL);
+	ortp_mutex_unlock(&mux->lock);
+
+	rtp_session_set_transports(session,NULL,NULL);
+	session->flags&=~RTP_SESSION_USING_SHARED_SOCKET;
+	session->rtp.loc_port=0;
+	ortp_free(leg);
+}
+
+ortp_socket_t rtp_socket_mux_get_rtp_socket(const RtpSocketMux *mux){
+	return mux->rtp_socket;
+}
+
+ortp_socket_t rtp_socket_mux_get_rtcp_socket(const RtpSocketMux *mux){
+	return mux->rtcp_socket;
+}
+
+int rtp_socket_mux_get_local_port(const RtpSocketMux *mux){
+	return mux->loc_port;
+}
+
+const RtpSocketMuxStats *rtp_socket_mux_get_stats(const RtpSocketMux *mux){
+	return &mux->stats;
+}
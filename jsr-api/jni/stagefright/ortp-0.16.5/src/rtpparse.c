@@ -61,6 +61,7 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	int msgsize;
 	RtpStream *rtpstream=&session->rtp;
 	rtp_stats_t *stats=&rtpstream->stats;
+	bool_t retransmitted=FALSE;
 	
 	msgsize=mp->b_wptr-mp->b_rptr;
 
@@ -124,6 +125,17 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 
 	for (i=0;i<rtp->cc;i++)
 		rtp->csrc[i]=ntohl(rtp->csrc[i]);
+	/* a RTX packet comes with its own SSRC: restore the original packet before the SSRC checks */
+	if (session->nack.rtx_pt>=0 && rtp->paytype==session->nack.rtx_pt){
+		if (!rtp_session_rtx_decapsulate(session,mp)){
+			ortp_debug("Discarding RTX packet.");
+			stats->bad++;
+			ortp_global_stats.bad++;
+			freemsg(mp);
+			return;
+		}
+		retransmitted=TRUE;
+	}
 	/*the goal of the following code is to lock on an incoming SSRC to avoid
 	receiving "mixed streams"*/
 	if (session->ssrc_set){
@@ -147,7 +159,9 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 				}
 				session->rtp.rcv_last_ts = rtp->timestamp;
 				session->rcv.ssrc=rtp->ssrc;
-				rtp_signal_table_emit(&session->on_ssrc_changed);
+				/* the sequence of the new source has nothing to do with the old one */
+				rtp_session_rtcp_xr_new_source(session);
+				rtp_signal_table_emit(&session->cold->on_ssrc_changed);
 			}else{
 				/*discard the packet*/
 				ortp_debug("Receiving packet with unknown ssrc.");
@@ -176,6 +190,9 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 		}
 	}
 	
+	rtp_session_rtcp_xr_new_packet(session,rtp->seq_number,rtp->timestamp);
+	rtp_session_nack_new_packet(session,rtp->seq_number);
+
 	/* update some statistics */
 	{
 		poly32_t *extseq=(poly32_t*)&rtpstream->hwrcv_extseq;
@@ -192,6 +209,7 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	if (rtp->paytype==session->rcv.telephone_events_pt){
 		queue_packet(&session->rtp.tev_rq,session->rtp.max_rq_size,mp,rtp,&i);
 		stats->discarded+=i;
+		rtp_session_rtcp_xr_discarded(session,i);
 		ortp_global_stats.discarded+=i;
 		return;
 	}
@@ -202,13 +220,15 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 		rtp_session_update_payload_type(session,rtp->paytype);
 	}
 	
-	jitter_control_new_packet(&session->rtp.jittctl,rtp->timestamp,local_str_ts);
+	/* a retransmitted packet is late by design, it would distort the jitter estimation */
+	if (!retransmitted)
+		jitter_control_new_packet(&session->rtp.jittctl,rtp->timestamp,local_str_ts);
 
 	if (session->flags & RTP_SESSION_FIRST_PACKET_DELIVERED) {
 		/* detect timestamp important jumps in the future, to workaround stupid rtp senders */
 		if (RTP_TIMESTAMP_IS_NEWER_THAN(rtp->timestamp,session->rtp.rcv_last_ts+session->rtp.ts_jump)){
 			ortp_debug("rtp_parse: timestamp jump ?");
-			rtp_signal_table_emit2(&session->on_timestamp_jump,(long)&rtp->timestamp);
+			rtp_signal_table_emit2(&session->cold->on_timestamp_jump,(long)&rtp->timestamp);
 		}
 		else if (RTP_TIMESTAMP_IS_STRICTLY_NEWER_THAN(session->rtp.rcv_last_ts,rtp->timestamp)){
 			/* don't queue packets older than the last returned packet to the application*/
@@ -218,12 +238,13 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 			
 			if ( RTP_TIMESTAMP_IS_STRICTLY_NEWER_THAN(session->rtp.rcv_last_ts, rtp->timestamp + session->rtp.ts_jump) ){
 				ortp_warning("rtp_parse: negative timestamp jump");
-				rtp_signal_table_emit2(&session->on_timestamp_jump,
+				rtp_signal_table_emit2(&session->cold->on_timestamp_jump,
 							(long)&rtp->timestamp);
 			}
 			ortp_debug("rtp_parse: discarding too old packet (ts=%i)",rtp->timestamp);
 			freemsg(mp);
 			stats->outoftime++;
+			rtp_session_rtcp_xr_discarded(session,1);
 			ortp_global_stats.outoftime++;
 			return;
 		}
@@ -231,6 +252,7 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	
 	queue_packet(&session->rtp.rq,session->rtp.max_rq_size,mp,rtp,&i);
 	stats->discarded+=i;
+	rtp_session_rtcp_xr_discarded(session,i);
 	ortp_global_stats.discarded+=i;
 }
 
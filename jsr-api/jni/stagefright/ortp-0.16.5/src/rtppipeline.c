@@ -0,0 +1,521 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define LOG_TAG "oRTP-Pipeline"
+
+#include "ortp/ortp.h"
+#include "ortp/rtppipeline.h"
+#include "utils.h"
+#include "rtpsession_priv.h"
+
+#ifndef WIN32
+
+#include <poll.h>
+
+#define RTP_PIPELINE_RTP_QUEUE 64	/* packets queued per session, a power of two */
+#define RTP_PIPELINE_RTCP_QUEUE 16
+#define RTP_PIPELINE_MAX_BURST 32	/* datagrams read from a socket in one go */
+#define RTP_PIPELINE_POLL_MS 20	/* how soon added and removed sessions are taken into account */
+#define RTP_PIPELINE_STALL_MS 5	/* how soon a full queue is checked again */
+#define RTP_PIPELINE_CACHE_LINE 64
+
+typedef struct _RtpPipelineSlot{
+	mblk_t *mp;
+	uint64_t queued_us;
+#ifdef ORTP_INET6
+	struct sockaddr_storage from;
+#else
+	struct sockaddr_in from;
+#endif
+	socklen_t fromlen;
+} RtpPipelineSlot;
+
+/* single producer (the I/O thread), single consumer (the media worker) ring.
+ Each side only writes its own index, and the memory barriers order the slot
+ accesses with the index updates. */
+typedef struct _RtpPipelineQueue{
+	RtpPipelineSlot *slots;
+	unsigned int mask;
+	volatile unsigned int head;
+	char pad[RTP_PIPELINE_CACHE_LINE];	/* keeps head and tail on different cache lines */
+	volatile unsigned int tail;
+} RtpPipelineQueue;
+
+struct _RtpPipelineLeg;
+
+typedef struct _RtpPipelineStream{
+	struct _RtpPipelineLeg *leg;
+	RtpTransport tr;	/* installed on the session */
+	RtpTransport *orig;	/* the transport it replaces, if any */
+	ortp_socket_t socket;
+	int recv_buf_size;
+	RtpPipelineQueue q;
+	mblk_t *cached_mp;	/* owned by the I/O thread */
+	/* owned by the media worker */
+	uint64_t delivered;
+	uint64_t queue_time_us;
+	uint64_t queue_max_us;
+} RtpPipelineStream;
+
+typedef struct _RtpPipelineLeg{
+	struct _RtpPipelineLeg *next;
+	struct _RtpPipelineIo *io;
+	RtpSession *session;
+	RtpPipelineStream rtp;
+	RtpPipelineStream rtcp;
+	bool_t use_connect;
+} RtpPipelineLeg;
+
+typedef struct _RtpPipelineIo{
+	RtpPipeline *pipeline;
+	ortp_thread_t thread;
+	ortp_mutex_t lock;
+	RtpPipelineLeg *legs;	/* protected by lock */
+	int nlegs;
+	unsigned int generation;	/* changes whenever legs does */
+	/* owned by the I/O thread */
+	struct pollfd *fds;
+	RtpPipelineStream **streams;
+	int maxfds;
+	uint64_t received;
+	uint64_t recv_errors;
+	uint64_t backpressure;
+	uint64_t io_time_us;
+	uint64_t io_max_us;
+} RtpPipelineIo;
+
+struct _RtpPipeline{
+	RtpPipelineIo *ios;
+	int nios;
+	volatile bool_t running;
+	ortp_mutex_t lock;
+	RtpPipelineStats removed;	/* what the removed sessions had counted */
+};
+
+static uint64_t rtp_pipeline_now_us(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (uint64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+static void rtp_pipeline_queue_init(RtpPipelineQueue *q, unsigned int size){
+	q->slots=ortp_new0(RtpPipelineSlot,size);
+	q->mask=size-1;
+	q->head=0;
+	q->tail=0;
+}
+
+static bool_t rtp_pipeline_queue_full(RtpPipelineQueue *q){
+	unsigned int tail=q->tail;
+	/* the worker is done with a slot once tail moved past it */
+	__sync_synchronize();
+	return q->head-tail>q->mask;
+}
+
+static void rtp_pipeline_queue_push(RtpPipelineQueue *q){
+	/* publish the slot before the new head */
+	__sync_synchronize();
+	q->head++;
+}
+
+static RtpPipelineSlot *rtp_pipeline_queue_peek(RtpPipelineQueue *q){
+	if (q->tail==q->head) return NULL;
+	__sync_synchronize();
+	return &q->slots[q->tail & q->mask];
+}
+
+static void rtp_pipeline_queue_pop(RtpPipelineQueue *q){
+	__sync_synchronize();
+	q->tail++;
+}
+
+static void rtp_pipeline_queue_uninit(RtpPipelineQueue *q){
+	while(q->tail!=q->head){
+		freemsg(q->slots[q->tail & q->mask].mp);
+		q->tail++;
+	}
+	ortp_free(q->slots);
+}
+
+/* the receive and decrypt stage: reads a socket through the session transport
+ until it would block or the queue is full. Called with io->lock held. */
+static void rtp_pipeline_io_drain(RtpPipelineIo *io, RtpPipelineStream *st){
+	int count;
+	for(count=0;count<RTP_PIPELINE_MAX_BURST;count++){
+		RtpPipelineSlot *slot;
+		uint64_t start,end;
+		int err,errnum;
+
+		if (rtp_pipeline_queue_full(&st->q)){
+			/* leave the rest in the socket buffer until the worker catches up */
+			io->backpressure++;
+			return;
+		}
+		slot=&st->q.slots[st->q.head & st->q.mask];
+		if (st->cached_mp==NULL)
+			st->cached_mp=allocb(st->recv_buf_size,0);
+		slot->fromlen=sizeof(slot->from);
+		errno=0;
+		start=rtp_pipeline_now_us();
+		if (st->orig!=NULL)
+			err=st->orig->t_recvfrom(st->orig,st->cached_mp,0,(struct sockaddr*)&slot->from,&slot->fromlen);
+		else
+			err=recvfrom(st->socket,(char*)st->cached_mp->b_wptr,st->recv_buf_size,0,(struct sockaddr*)&slot->from,&slot->fromlen);
+		end=rtp_pipeline_now_us();
+		if (err>0){
+			st->cached_mp->b_wptr+=err;
+			slot->mp=st->cached_mp;
+			slot->queued_us=end;
+			st->cached_mp=NULL;
+			rtp_pipeline_queue_push(&st->q);
+			io->received++;
+			io->io_time_us+=end-start;
+			if (end-start>io->io_max_us) io->io_max_us=end-start;
+			continue;
+		}
+		errnum=getSocketErrorCode();
+		if (err<0 && errnum==0){
+			/* the transport rejected the datagram, e.g. SRTP authentication failed */
+			io->recv_errors++;
+			continue;
+		}
+		if (err<0 && !is_would_block_error(errnum)){
+			io->recv_errors++;
+			ortp_warning("Error receiving on socket %i: %s",st->socket,getSocketError());
+		}
+		return;
+	}
+}
+
+/* lists the sockets to wait for, except those whose queue is full. Called with io->lock held. */
+static int rtp_pipeline_io_prepare(RtpPipelineIo *io, bool_t *stalled){
+	RtpPipelineLeg *leg;
+	int nfds=0;
+	int i;
+
+	if (io->maxfds<io->nlegs*2){
+		io->maxfds=io->nlegs*2;
+		io->fds=ortp_realloc(io->fds,io->maxfds*sizeof(struct pollfd));
+		io->streams=ortp_realloc(io->streams,io->maxfds*sizeof(RtpPipelineStream*));
+	}
+	for(leg=io->legs;leg!=NULL;leg=leg->next){
+		RtpPipelineStream *st[2]={&leg->rtp,&leg->rtcp};
+		for(i=0;i<2;i++){
+			if (st[i]->socket<0) continue;
+			if (rtp_pipeline_queue_full(&st[i]->q)){
+				*stalled=TRUE;
+				continue;
+			}
+			io->fds[nfds].fd=st[i]->socket;
+			io->fds[nfds].events=POLLIN;
+			io->fds[nfds].revents=0;
+			io->streams[nfds]=st[i];
+			nfds++;
+		}
+	}
+	return nfds;
+}
+
+static void *rtp_pipeline_io_run(void *data){
+	RtpPipelineIo *io=(RtpPipelineIo*)data;
+
+	while(io->pipeline->running){
+		unsigned int generation;
+		bool_t stalled=FALSE;
+		int nfds,ret,i;
+
+		ortp_mutex_lock(&io->lock);
+		nfds=rtp_pipeline_io_prepare(io,&stalled);
+		generation=io->generation;
+		ortp_mutex_unlock(&io->lock);
+
+		ret=poll(io->fds,nfds,stalled ? RTP_PIPELINE_STALL_MS : RTP_PIPELINE_POLL_MS);
+		if (ret<=0){
+			if (ret<0 && errno!=EINTR)
+				ortp_warning("poll() failed: %s",getSocketError());
+			continue;
+		}
+		ortp_mutex_lock(&io->lock);
+		/* sessions removed in the meantime must not be touched */
+		if (generation==io->generation){
+			for(i=0;i<nfds;i++){
+				if (io->fds[i].revents & (POLLIN|POLLERR))
+					rtp_pipeline_io_drain(io,io->streams[i]);
+			}
+		}
+		ortp_mutex_unlock(&io->lock);
+	}
+	return NULL;
+}
+
+/* the media worker side: hands a queued packet to rtp_session_rtp_recv() or rtp_session_rtcp_recv() */
+static int rtp_pipeline_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	RtpPipelineStream *st=(RtpPipelineStream*)t->data;
+	RtpPipelineSlot *slot=rtp_pipeline_queue_peek(&st->q);
+	uint64_t waited;
+	int len;
+
+	if (slot==NULL) return 0; /* would block */
+
+	if (from!=NULL && fromlen!=NULL && *fromlen>=slot->fromlen){
+		memcpy(from,&slot->from,slot->fromlen);
+		*fromlen=slot->fromlen;
+	}
+	waited=rtp_pipeline_now_us()-slot->queued_us;
+	/* the block filled by the I/O thread becomes the one of the session */
+	len=rtp_transport_hand_over(m,slot->mp);
+	slot->mp=NULL;
+	rtp_pipeline_queue_pop(&st->q);
+
+	st->delivered++;
+	st->queue_time_us+=waited;
+	if (waited>st->queue_max_us) st->queue_max_us=waited;
+	return len;
+}
+
+static int rtp_pipeline_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	RtpPipelineStream *st=(RtpPipelineStream*)t->data;
+	if (st->orig!=NULL)
+		return st->orig->t_sendto(st->orig,m,flags,to,tolen);
+	/* the sockets are never connected here: no remote address yet, nothing to send to */
+	if (to==NULL || tolen==0) return 0;
+	if (m->b_cont!=NULL)
+		msgpullup(m,-1);
+	return sendto(st->socket,(char*)m->b_rptr,(int)(m->b_wptr-m->b_rptr),flags,to,tolen);
+}
+
+static ortp_socket_t rtp_pipeline_getsocket(RtpTransport *t){
+	return ((RtpPipelineStream*)t->data)->socket;
+}
+
+/**
+ * Creates a pipeline and starts its I/O threads.
+ * @param io_threads the number of I/O threads; sessions are spread over them.
+ * @return the new RtpPipeline.
+**/
+RtpPipeline *rtp_pipeline_new(int io_threads){
+	RtpPipeline *pipeline=ortp_new0(RtpPipeline,1);
+	int i;
+
+	if (io_threads<1) io_threads=1;
+	pipeline->nios=io_threads;
+	pipeline->ios=ortp_new0(RtpPipelineIo,io_threads);
+	pipeline->running=TRUE;
+	ortp_mutex_init(&pipeline->lock,NULL);
+	for(i=0;i<io_threads;i++){
+		RtpPipelineIo *io=&pipeline->ios[i];
+		io->pipeline=pipeline;
+		ortp_mutex_init(&io->lock,NULL);
+		ortp_thread_create(&io->thread,NULL,rtp_pipeline_io_run,io);
+	}
+	return pipeline;
+}
+
+/**
+ * Stops the I/O threads and frees the pipeline.
+ * All sessions must have been removed with rtp_pipeline_remove_session() before.
+**/
+void rtp_pipeline_destroy(RtpPipeline *pipeline){
+	int i;
+	pipeline->running=FALSE;
+	for(i=0;i<pipeline->nios;i++){
+		RtpPipelineIo *io=&pipeline->ios[i];
+		ortp_thread_join(io->thread,NULL);
+		if (io->nlegs>0)
+			ortp_warning("rtp_pipeline_destroy(): %i sessions still attached.",io->nlegs);
+		ortp_mutex_destroy(&io->lock);
+		if (io->fds!=NULL) ortp_free(io->fds);
+		if (io->streams!=NULL) ortp_free(io->streams);
+	}
+	ortp_mutex_destroy(&pipeline->lock);
+	ortp_free(pipeline->ios);
+	ortp_free(pipeline);
+}
+
+static void rtp_pipeline_stream_init(RtpPipelineStream *st, RtpPipelineLeg *leg, RtpTransport *orig, ortp_socket_t sock, int recv_buf_size, unsigned int queue_size){
+	st->leg=leg;
+	st->orig=orig;
+	st->socket=(orig!=NULL) ? orig->t_getsocket(orig) : sock;
+	st->recv_buf_size=recv_buf_size;
+	st->tr.data=st;
+	st->tr.t_getsocket=rtp_pipeline_getsocket;
+	st->tr.t_sendto=rtp_pipeline_sendto;
+	st->tr.t_recvfrom=rtp_pipeline_recvfrom;
+	rtp_pipeline_queue_init(&st->q,queue_size);
+}
+
+static void rtp_pipeline_stream_uninit(RtpPipelineStream *st){
+	rtp_pipeline_queue_uninit(&st->q);
+	if (st->cached_mp!=NULL) freemsg(st->cached_mp);
+}
+
+/**
+ * Attaches a session to the pipeline, on the I/O thread with the fewest sessions.
+ * The session must already have its sockets, and its transports if any (SRTP):
+ * from now on the I/O thread receives through them, while the application keeps
+ * sending through them. With SRTP, the sending and receiving sides must not share
+ * a srtp_t session, see srtp_transport_new_pair().
+ * Afterwards, only one thread, the media worker of the session, may receive from it.
+ * Sessions attached to a RtpSocketMux or with connected sockets are refused.
+ * @param pipeline the pipeline
+ * @param session the rtp session
+ * @return 0 on success.
+**/
+int rtp_pipeline_add_session(RtpPipeline *pipeline, RtpSession *session){
+	RtpPipelineLeg *leg;
+	RtpPipelineIo *io=&pipeline->ios[0];
+	RtpTransport *rtptr=rtp_session_using_transport(session,rtp) ? session->rtp.tr : NULL;
+	RtpTransport *rtcptr=rtp_session_using_transport(session,rtcp) ? session->rtcp.tr : NULL;
+	int i;
+
+	if (rtptr!=NULL && rtptr->t_recvfrom==rtp_pipeline_recvfrom){
+		ortp_error("rtp_pipeline_add_session(): session already in a pipeline.");
+		return -1;
+	}
+	if (session->flags & RTP_SESSION_USING_SHARED_SOCKET){
+		ortp_error("rtp_pipeline_add_session(): the socket of this session is read by its RtpSocketMux.");
+		return -1;
+	}
+	if (session->flags & (RTP_SOCKET_CONNECTED|RTCP_SOCKET_CONNECTED)){
+		ortp_error("rtp_pipeline_add_session(): connected sockets are not supported.");
+		return -1;
+	}
+	if (rtptr==NULL && session->rtp.socket<0){
+		ortp_error("rtp_pipeline_add_session(): session has no socket.");
+		return -1;
+	}
+
+	leg=ortp_new0(RtpPipelineLeg,1);
+	leg->session=session;
+	/* the sockets must stay unconnected so that all packets go through the queues */
+	leg->use_connect=session->use_connect;
+	session->use_connect=FALSE;
+	rtp_pipeline_stream_init(&leg->rtp,leg,rtptr,session->rtp.socket,session->recv_buf_size,RTP_PIPELINE_RTP_QUEUE);
+	rtp_pipeline_stream_init(&leg->rtcp,leg,rtcptr,session->rtcp.socket,RTCP_MAX_RECV_BUFSIZE,RTP_PIPELINE_RTCP_QUEUE);
+	rtp_session_set_transports(session,&leg->rtp.tr,leg->rtcp.socket>=0 ? &leg->rtcp.tr : NULL);
+
+	for(i=1;i<pipeline->nios;i++){
+		if (pipeline->ios[i].nlegs<io->nlegs) io=&pipeline->ios[i];
+	}
+	leg->io=io;
+	ortp_mutex_lock(&io->lock);
+	leg->next=io->legs;
+	io->legs=leg;
+	io->nlegs++;
+	io->generation++;
+	ortp_mutex_unlock(&io->lock);
+	return 0;
+}
+
+static void rtp_pipeline_stream_add_stats(const RtpPipelineStream *st, RtpPipelineStats *stats){
+	stats->delivered+=st->delivered;
+	stats->queue_time_us+=st->queue_time_us;
+	if (st->queue_max_us>stats->queue_max_us) stats->queue_max_us=st->queue_max_us;
+}
+
+/**
+ * Detaches a session from the pipeline and gives it its own transports back.
+ * Packets queued for it are discarded. This must be called from its media worker.
+**/
+void rtp_pipeline_remove_session(RtpPipeline *pipeline, RtpSession *session){
+	RtpPipelineLeg *leg;
+	RtpPipelineLeg **it;
+	RtpPipelineIo *io;
+
+	if (!rtp_session_using_transport(session,rtp) || session->rtp.tr->t_recvfrom!=rtp_pipeline_recvfrom){
+		ortp_warning("rtp_pipeline_remove_session(): session is not in a pipeline.");
+		return;
+	}
+	leg=((RtpPipelineStream*)session->rtp.tr->data)->leg;
+	io=leg->io;
+	return_if_fail(io->pipeline==pipeline);
+
+	/* once unlinked under the lock, the I/O thread does not reference it anymore */
+	ortp_mutex_lock(&io->lock);
+	for(it=&io->legs;*it!=NULL;it=&(*it)->next){
+		if (*it==leg){
+			*it=leg->next;
+			break;
+		}
+	}
+	io->nlegs--;
+	io->generation++;
+	ortp_mutex_unlock(&io->lock);
+
+	ortp_mutex_lock(&pipeline->lock);
+	rtp_pipeline_stream_add_stats(&leg->rtp,&pipeline->removed);
+	rtp_pipeline_stream_add_stats(&leg->rtcp,&pipeline->removed);
+	ortp_mutex_unlock(&pipeline->lock);
+
+	rtp_session_set_transports(session,leg->rtp.orig,leg->rtcp.orig);
+	session->use_connect=leg->use_connect;
+	rtp_pipeline_stream_uninit(&leg->rtp);
+	rtp_pipeline_stream_uninit(&leg->rtcp);
+	ortp_free(leg);
+}
+
+/**
+ * Gets the counters of the pipeline, summed over its I/O threads and sessions.
+ * The values read while packets flow are approximate.
+**/
+void rtp_pipeline_get_stats(RtpPipeline *pipeline, RtpPipelineStats *stats){
+	int i;
+
+	ortp_mutex_lock(&pipeline->lock);
+	*stats=pipeline->removed;
+	ortp_mutex_unlock(&pipeline->lock);
+	for(i=0;i<pipeline->nios;i++){
+		RtpPipelineIo *io=&pipeline->ios[i];
+		RtpPipelineLeg *leg;
+		ortp_mutex_lock(&io->lock);
+		stats->received+=io->received;
+		stats->recv_errors+=io->recv_errors;
+		stats->backpressure+=io->backpressure;
+		stats->io_time_us+=io->io_time_us;
+		if (io->io_max_us>stats->io_max_us) stats->io_max_us=io->io_max_us;
+		for(leg=io->legs;leg!=NULL;leg=leg->next){
+			rtp_pipeline_stream_add_stats(&leg->rtp,stats);
+			rtp_pipeline_stream_add_stats(&leg->rtcp,stats);
+		}
+		ortp_mutex_unlock(&io->lock);
+	}
+}
+
+#else
+
+RtpPipeline *rtp_pipeline_new(int io_threads){
+	ortp_error("rtp_pipeline_new(): not supported on this platform.");
+	return NULL;
+}
+
+void rtp_pipeline_destroy(RtpPipeline *pipeline){
+}
+
+int rtp_pipeline_add_session(RtpPipeline *pipeline, RtpSession *session){
+	return -1;
+}
+
+void rtp_pipeline_remove_session(RtpPipeline *pipeline, RtpSession *session){
+}
+
+void rtp_pipeline_get_stats(RtpPipeline *pipeline, RtpPipelineStats *stats){
+	memset(stats,0,sizeof(*stats));
+}
+
+#endif
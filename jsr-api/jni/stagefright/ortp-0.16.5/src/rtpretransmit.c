@@ -0,0 +1,490 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Generic NACK (RFC4585) generation and retransmission of the sent packets, possibly as RTX (RFC4588) */
+
+#define LOG_TAG "oRTP-Retransmit"
+
+#include "ortp/ortp.h"
+#include "ortp/rtpsession.h"
+#include "ortp/rtcp.h"
+#include "utils.h"
+#include "rtpsession_priv.h"
+
+/* minimal delay between two NACK packets */
+#define NACK_MIN_INTERVAL_MS 20
+/* delay before asking again for a packet when the round trip delay is not known */
+#define NACK_DEFAULT_RETRY_MS 100
+/* added to the round trip delay before asking again for a packet */
+#define NACK_RTT_MARGIN_MS 10
+#define NACK_MAX_RETRIES 3
+/* after this delay, a missing packet would be too late for the jitter buffer anyway */
+#define NACK_MAX_AGE_MS 1000
+/* FCI entries in one NACK packet */
+#define NACK_MAX_FCI 16
+/* the packets older than this are not retransmitted */
+#define RTX_MAX_AGE_MS 1000
+#define RTX_DEFAULT_PACKETS 256
+
+typedef struct _RtpRtxSlot{
+	mblk_t *packet;	/* references the sent packet, header in network byte order */
+	uint64_t sent_ms;
+	uint64_t rtx_ms;	/* time of the last retransmission, 0 if none */
+} RtpRtxSlot;
+
+static uint64_t retransmit_now_ms(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+/* the round trip delay in ms, -1 if unknown */
+static int retransmit_rtt_ms(RtpSession *session){
+	if (session->rtcp.xr.rtt<0) return -1;
+	return (int)(((int64_t)session->rtcp.xr.rtt*1000)>>16);
+}
+
+/**
+ * Enables the sending of generic NACKs (RFC4585) for the packets missing in
+ * the incoming stream. A packet is asked for again after a round trip delay,
+ * at most NACK_MAX_RETRIES times, and NACK packets are not sent more often
+ * than every NACK_MIN_INTERVAL_MS.
+ *@param session RtpSession
+ *@param yesno TRUE to send NACKs.
+ *@param rtx_pt the payload type of the RTX packets (RFC4588) sent by the
+ * remote party, or -1 if it sends the original packets again.
+ *@param rtx_apt the payload type of the original packets, restored in the
+ * RTX packets received.
+**/
+void rtp_session_enable_nack(RtpSession *session, bool_t yesno, int rtx_pt, int rtx_apt){
+	RtpNackContext *nc=&session->nack;
+	nc->enabled=yesno;
+	nc->rtx_pt=yesno ? rtx_pt : -1;
+	nc->rtx_apt=rtx_apt;
+	nc->nmissing=0;
+	nc->started=FALSE;
+}
+
+static void rtx_buffer_flush(RtpRtxBuffer *rb){
+	int i;
+	for (i=0;i<rb->size;i++){
+		if (rb->slots[i].packet!=NULL){
+			freemsg(rb->slots[i].packet);
+			rb->slots[i].packet=NULL;
+		}
+	}
+}
+
+/**
+ * Keeps the last sent packets to answer the NACKs of the remote party. The
+ * packets are kept by reference, not copied: the payload buffers given with
+ * rtp_session_create_packet_with_data() or rtp_session_create_packet_in_place()
+ * must not be reused by the application while they can be retransmitted.
+ * The NACKs are received on the RTCP receive path, but the packets asked for
+ * are sent on the send path, with the next packet of the stream.
+ * With RTX, the retransmissions are sent with their own SSRC, returned by
+ * rtp_session_get_retransmission_ssrc(). When the session is protected with
+ * SRTP and a policy for specific SSRCs, that SSRC needs a policy too: enable
+ * the retransmission first, then add it along with the one of the session.
+ *@param session RtpSession
+ *@param yesno TRUE to answer NACKs.
+ *@param packets the number of packets kept, rounded up to a power of two; 0 for the default.
+ *@param rtx_pt the payload type of the RTX stream (RFC4588), sent with its
+ * own SSRC and sequence numbers; -1 to send the original packets again.
+**/
+void rtp_session_enable_retransmission(RtpSession *session, bool_t yesno, int packets, int rtx_pt){
+	RtpRtxBuffer *rb=&session->rtx;
+	RtpRtxSlot *slots=NULL;
+	int size=0;
+
+	if (yesno){
+		if (packets<=0) packets=RTX_DEFAULT_PACKETS;
+		for (size=1;size<packets && size<(1<<15);size<<=1);
+		slots=ortp_new0(RtpRtxSlot,size);
+	}
+	ortp_mutex_lock(&rb->lock);
+	rtp_session_retransmission_uninit(session);
+	rb->enabled=yesno;
+	if (yesno){
+		rb->slots=slots;
+		rb->size=size;
+		rb->pt=rtx_pt;
+		rb->ssrc=uint32_t_random();
+		rb->seq=(uint16_t)uint32_t_random();
+	}
+	ortp_mutex_unlock(&rb->lock);
+}
+
+/**
+ * Returns the SSRC of the RTX stream (RFC4588) of the session, meaningful
+ * once rtp_session_enable_retransmission() was called with a RTX payload type.
+**/
+uint32_t rtp_session_get_retransmission_ssrc(const RtpSession *session){
+	return session->rtx.ssrc;
+}
+
+/**
+ * Returns the counters of the NACKs sent and received and of the
+ * retransmitted packets.
+**/
+void rtp_session_get_retransmission_stats(const RtpSession *session, RtpRetransmissionStats *stats){
+	*stats=session->retransmission_stats;
+}
+
+void rtp_session_retransmission_uninit(RtpSession *session){
+	RtpRtxBuffer *rb=&session->rtx;
+	if (rb->slots!=NULL){
+		rtx_buffer_flush(rb);
+		ortp_free(rb->slots);
+		rb->slots=NULL;
+	}
+	rb->size=0;
+	flushq(&rb->pending,FLUSHALL);
+}
+
+void rtp_session_retransmission_reset(RtpSession *session){
+	RtpRtxBuffer *rb=&session->rtx;
+	session->nack.nmissing=0;
+	session->nack.started=FALSE;
+	ortp_mutex_lock(&rb->lock);
+	if (rb->slots!=NULL) rtx_buffer_flush(rb);
+	flushq(&rb->pending,FLUSHALL);
+	ortp_mutex_unlock(&rb->lock);
+}
+
+/*
+ * Receiver side
+ */
+
+static bool_t nack_remove_missing(RtpNackContext *nc, uint16_t seq){
+	int i;
+	for (i=0;i<nc->nmissing;i++){
+		if (nc->missing[i].seq==seq){
+			nc->nmissing--;
+			memmove(&nc->missing[i],&nc->missing[i+1],(nc->nmissing-i)*sizeof(RtpMissingPacket));
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static void nack_add_missing(RtpNackContext *nc, uint16_t seq, uint64_t now){
+	RtpMissingPacket *mp;
+	if (nc->nmissing==RTP_NACK_MAX_MISSING){
+		/* forget the oldest one */
+		nc->nmissing--;
+		memmove(&nc->missing[0],&nc->missing[1],nc->nmissing*sizeof(RtpMissingPacket));
+	}
+	mp=&nc->missing[nc->nmissing++];
+	mp->seq=seq;
+	mp->detected_ms=now;
+	mp->nacked_ms=0;
+	mp->nacks=0;
+}
+
+/**
+ * Updates the list of the missing packets with the sequence number of a
+ * received packet (in host byte order).
+**/
+void rtp_session_nack_new_packet(RtpSession *session, uint16_t seq){
+	RtpNackContext *nc=&session->nack;
+	int16_t diff;
+
+	if (!nc->enabled) return;
+	if (!nc->started){
+		nc->highest_seq=seq;
+		nc->started=TRUE;
+		return;
+	}
+	diff=(int16_t)(seq-nc->highest_seq);
+	if (diff>0){
+		if (diff>RTP_NACK_MAX_MISSING){
+			/* a jump rather than losses, for example a new source: don't ask for anything */
+			nc->nmissing=0;
+		}else if (diff>1){
+			uint64_t now=retransmit_now_ms();
+			uint16_t s;
+			for (s=nc->highest_seq+1;s!=seq;s++) nack_add_missing(nc,s,now);
+		}
+		nc->highest_seq=seq;
+	}else if (diff<0){
+		if (nack_remove_missing(nc,seq)) session->retransmission_stats.recovered++;
+	}
+}
+
+/**
+ * Sends a NACK for the missing packets that were not asked for yet, or were
+ * asked for more than a round trip delay ago.
+**/
+void rtp_session_nack_process(RtpSession *session){
+	RtpNackContext *nc=&session->nack;
+	rtcp_fb_nack_fci_t fci[NACK_MAX_FCI];
+	int nfci=0;
+	int rtt;
+	int retry;
+	uint64_t now;
+	int i;
+
+	if (!nc->enabled || nc->nmissing==0) return;
+	now=retransmit_now_ms();
+	if (now-nc->last_sent_ms<NACK_MIN_INTERVAL_MS) return;
+	rtt=retransmit_rtt_ms(session);
+	retry=(rtt>=0) ? rtt+NACK_RTT_MARGIN_MS : NACK_DEFAULT_RETRY_MS;
+
+	for (i=0;i<nc->nmissing;){
+		RtpMissingPacket *mp=&nc->missing[i];
+		if (now-mp->detected_ms>NACK_MAX_AGE_MS || (mp->nacks>=NACK_MAX_RETRIES && now-mp->nacked_ms>=(uint64_t)retry)){
+			session->retransmission_stats.abandoned++;
+			nack_remove_missing(nc,mp->seq);
+			continue;
+		}
+		if (mp->nacks<NACK_MAX_RETRIES && (mp->nacked_ms==0 || now-mp->nacked_ms>=(uint64_t)retry)){
+			uint16_t offset=(nfci>0) ? (uint16_t)(mp->seq-fci[nfci-1].pid) : 0;
+			if (offset>=1 && offset<=16){
+				fci[nfci-1].blp|=1<<(offset-1);
+			}else if (nfci<NACK_MAX_FCI){
+				fci[nfci].pid=mp->seq;
+				fci[nfci].blp=0;
+				nfci++;
+			}else{
+				i++;
+				continue;
+			}
+			mp->nacked_ms=now;
+			mp->nacks++;
+		}
+		i++;
+	}
+	if (nfci>0){
+		int size=sizeof(rtcp_fb_header_t)+nfci*sizeof(rtcp_fb_nack_fci_t);
+		mblk_t *m=allocb(size,0);
+		rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_wptr;
+		rtcp_fb_nack_fci_t *out=(rtcp_fb_nack_fci_t*)(fb+1);
+		rtcp_common_header_init(&fb->ch,session,RTCP_RTPFB,RTCP_RTPFB_NACK,size);
+		fb->packet_sender_ssrc=htonl(session->snd.ssrc);
+		fb->media_source_ssrc=htonl(session->rcv.ssrc);
+		for (i=0;i<nfci;i++){
+			out[i].pid=htons(fci[i].pid);
+			out[i].blp=htons(fci[i].blp);
+		}
+		m->b_wptr+=size;
+		rtp_session_rtcp_send_feedback(session,m);
+		nc->last_sent_ms=now;
+		session->retransmission_stats.nack_sent++;
+	}
+}
+
+/**
+ * Turns a received RTX packet (in host byte order) back into the original
+ * packet: the original sequence number, SSRC and payload type are restored
+ * and the OSN field is removed. Returns FALSE if the packet is malformed or
+ * the original stream is not known yet.
+**/
+bool_t rtp_session_rtx_decapsulate(RtpSession *session, mblk_t *mp){
+	rtp_header_t *rtp=(rtp_header_t*)mp->b_rptr;
+	int header_size=RTP_FIXED_HEADER_SIZE+4*rtp->cc;
+	uint8_t *osn=mp->b_rptr+header_size;
+
+	if (!session->ssrc_set || mp->b_wptr-osn<2) return FALSE;
+	rtp->seq_number=(osn[0]<<8) | osn[1];
+	rtp->ssrc=session->rcv.ssrc;
+	rtp->paytype=session->nack.rtx_apt;
+	/* RTX packets are rare: move the payload rather than misalign the header */
+	memmove(osn,osn+2,mp->b_wptr-osn-2);
+	mp->b_wptr-=2;
+	return TRUE;
+}
+
+/*
+ * Sender side
+ */
+
+/**
+ * Keeps a reference to a packet about to be sent, header already in network
+ * byte order.
+**/
+void rtp_session_rtx_store(RtpSession *session, mblk_t *m, uint16_t seq){
+	RtpRtxBuffer *rb=&session->rtx;
+	RtpRtxSlot *slot;
+	mblk_t *old=NULL;
+	mblk_t *dup=dupmsg(m);
+	uint64_t now=retransmit_now_ms();
+
+	ortp_mutex_lock(&rb->lock);
+	if (rb->slots!=NULL){
+		slot=&rb->slots[seq & (rb->size-1)];
+		old=slot->packet;
+		slot->packet=dup;
+		slot->sent_ms=now;
+		slot->rtx_ms=0;
+		dup=NULL;
+	}
+	ortp_mutex_unlock(&rb->lock);
+	if (old!=NULL) freemsg(old);
+	if (dup!=NULL) freemsg(dup);
+}
+
+/**
+ * Sends the retransmissions queued by rtp_session_rtx_process_nack(), from
+ * the send path so that the transport (SRTP) is only used by one thread.
+**/
+void rtp_session_rtx_send_pending(RtpSession *session){
+	RtpRtxBuffer *rb=&session->rtx;
+	queue_t q;
+	mblk_t *m;
+
+	qinit(&q);
+	ortp_mutex_lock(&rb->lock);
+	while((m=getq(&rb->pending))!=NULL) putq(&q,m);
+	ortp_mutex_unlock(&rb->lock);
+	while((m=getq(&q))!=NULL){
+		if (rtp_session_rtp_send_raw(session,m)>=0) session->retransmission_stats.retransmitted++;
+	}
+}
+
+/* the RTX packet of a buffered packet: a new header and the OSN, followed by the original payload.
+ It is made on the receive path while the send path may free other references to the
+ buffers of the original packet, so the payload is copied rather than referenced. */
+static mblk_t *rtx_make_packet(RtpSession *session, RtpRtxBuffer *rb, mblk_t *orig){
+	rtp_header_t *ortp=(rtp_header_t*)orig->b_rptr;
+	int header_size=RTP_FIXED_HEADER_SIZE+4*ortp->cc;
+	rtp_header_t *rtp;
+	mblk_t *h;
+	mblk_t *b;
+
+	if (orig->b_wptr-orig->b_rptr<header_size) return NULL;
+	h=rtp_session_alloc_send_block(session,msgdsize(orig)+2);
+	memcpy(h->b_wptr,orig->b_rptr,header_size);
+	rtp=(rtp_header_t*)h->b_wptr;
+	rtp->paytype=rb->pt;
+	rtp->ssrc=htonl(rb->ssrc);
+	rtp->seq_number=htons(rb->seq++);
+	h->b_wptr+=header_size;
+	/* the original sequence number, still in network byte order */
+	memcpy(h->b_wptr,&ortp->seq_number,2);
+	h->b_wptr+=2;
+	memcpy(h->b_wptr,orig->b_rptr+header_size,orig->b_wptr-orig->b_rptr-header_size);
+	h->b_wptr+=orig->b_wptr-orig->b_rptr-header_size;
+	for (b=orig->b_cont;b!=NULL;b=b->b_cont){
+		memcpy(h->b_wptr,b->b_rptr,b->b_wptr-b->b_rptr);
+		h->b_wptr+=b->b_wptr-b->b_rptr;
+	}
+	return h;
+}
+
+/* called with rb->lock held */
+static void rtx_resend(RtpSession *session, uint16_t seq, uint64_t now, int rtt){
+	RtpRtxBuffer *rb=&session->rtx;
+	RtpRtxSlot *slot=&rb->slots[seq & (rb->size-1)];
+	mblk_t *m;
+
+	if (slot->packet==NULL || ntohs(((rtp_header_t*)slot->packet->b_rptr)->seq_number)!=seq
+		|| now-slot->sent_ms>RTX_MAX_AGE_MS){
+		session->retransmission_stats.not_found++;
+		return;
+	}
+	/* several NACKs may be received for the same loss before the retransmission arrives */
+	if (slot->rtx_ms!=0 && now-slot->rtx_ms<(uint64_t)(rtt>=0 ? rtt : NACK_MIN_INTERVAL_MS)) return;
+	if (rb->pt>=0) m=rtx_make_packet(session,rb,slot->packet);
+	else m=copymsg(slot->packet);
+	if (m==NULL) return;
+	slot->rtx_ms=now;
+	if (rb->pending.q_mcount>=rb->size){
+		/* the stream is not being sent: don't keep more than the ring */
+		freemsg(m);
+		return;
+	}
+	putq(&rb->pending,m);
+}
+
+/**
+ * Retransmits the packets asked for in a received RTPFB packet.
+**/
+void rtp_session_rtx_process_nack(RtpSession *session, const mblk_t *m){
+	const rtcp_fb_nack_fci_t *fci;
+	uint64_t now;
+	int rtt;
+	int i;
+
+	if (rtcp_RTPFB_get_type(m)!=RTCP_RTPFB_NACK
+		|| rtcp_RTPFB_get_media_source_ssrc(m)!=session->snd.ssrc) return;
+	session->retransmission_stats.nack_received++;
+	if (!session->rtx.enabled) return;
+	now=retransmit_now_ms();
+	rtt=retransmit_rtt_ms(session);
+	ortp_mutex_lock(&session->rtx.lock);
+	if (session->rtx.slots!=NULL){
+		for (i=0;(fci=rtcp_RTPFB_NACK_get_fci(m,i))!=NULL;i++){
+			uint16_t pid=ntohs(fci->pid);
+			uint16_t blp=ntohs(fci->blp);
+			int bit;
+			rtx_resend(session,pid,now,rtt);
+			for (bit=0;bit<16;bit++){
+				if (blp & (1<<bit)) rtx_resend(session,pid+bit+1,now,rtt);
+			}
+		}
+	}
+	ortp_mutex_unlock(&session->rtx.lock);
+}
+
+/*
+ * RTPFB parsing
+ */
+
+bool_t rtcp_is_RTPFB(const mblk_t *m){
+	const rtcp_common_header_t *ch=rtcp_get_common_header(m);
+	if (ch!=NULL && rtcp_common_header_get_packet_type(ch)==RTCP_RTPFB){
+		if (msgdsize(m)<sizeof(rtcp_common_header_t)+
+			(4*rtcp_common_header_get_length(ch))){
+			ortp_warning("Too short RTCP RTPFB packet.");
+			return FALSE;
+		}
+		if (sizeof(rtcp_common_header_t)+4*rtcp_common_header_get_length(ch)
+			< sizeof(rtcp_fb_header_t)){
+			ortp_warning("Bad RTCP RTPFB packet.");
+			return FALSE;
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+int rtcp_RTPFB_get_type(const mblk_t *m){
+	rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_rptr;
+	return rtcp_common_header_get_rc(&fb->ch);
+}
+
+uint32_t rtcp_RTPFB_get_packet_sender_ssrc(const mblk_t *m){
+	rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_rptr;
+	return ntohl(fb->packet_sender_ssrc);
+}
+
+uint32_t rtcp_RTPFB_get_media_source_ssrc(const mblk_t *m){
+	rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_rptr;
+	return ntohl(fb->media_source_ssrc);
+}
+
+const rtcp_fb_nack_fci_t * rtcp_RTPFB_NACK_get_fci(const mblk_t *m, int idx){
+	rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_rptr;
+	int size=sizeof(rtcp_common_header_t)+4*rtcp_common_header_get_length(&fb->ch);
+	int offset=sizeof(rtcp_fb_header_t)+idx*sizeof(rtcp_fb_nack_fci_t);
+	if (offset+(int)sizeof(rtcp_fb_nack_fci_t)>size
+		|| m->b_rptr+offset+sizeof(rtcp_fb_nack_fci_t)>m->b_wptr) return NULL;
+	return (const rtcp_fb_nack_fci_t*)(m->b_rptr+offset);
+}
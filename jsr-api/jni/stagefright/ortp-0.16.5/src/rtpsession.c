@@ -34,6 +34,15 @@
 #include "utils.h"
 #include "rtpsession_priv.h"
 
+#ifdef HAVE_SRTP
+#undef PACKAGE_BUGREPORT
+#undef PACKAGE_NAME
+#undef PACKAGE_STRING
+#undef PACKAGE_TARNAME
+#undef PACKAGE_VERSION
+#include <rand_source.h>
+#endif
+
 #if (_WIN32_WINNT >= 0x0600)
 #include <delayimp.h>
 #undef ExternC /* avoid redefinition... */
@@ -49,7 +58,8 @@ extern int rtcp_rr_init(RtpSession *session, char *buf, int size);
 /* this function initialize all session parameter's that depend on the payload type */
 static void payload_type_changed(RtpSession *session, PayloadType *pt){
 	jitter_control_set_payload(&session->rtp.jittctl,pt);
-	session->rtp.rtcp_report_snt_interval=RTCP_DEFAULT_REPORT_INTERVAL*pt->clock_rate;
+	session->rtcp.clock_rate=pt->clock_rate;
+	rtp_session_rtcp_schedule_next_report(session);
 	rtp_session_set_time_jump_limit(session,session->rtp.time_jump);
 	if (pt->type==PAYLOAD_VIDEO){
 		session->permissive=TRUE;
@@ -97,7 +107,12 @@ extern void rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_ts,
 		struct sockaddr *addr, socklen_t addrlen);
 
 
-static uint32_t uint32_t_random(){
+uint32_t uint32_t_random(void){
+#ifdef HAVE_SRTP
+	uint32_t r;
+	if (rand_source_get_octet_string(&r,sizeof(r))==err_status_ok)
+		return r;
+#endif
 	return random();
 }
 
@@ -228,6 +243,11 @@ rtp_session_init (RtpSession * session, int mode)
 	    return;
 	}
 	memset (session, 0, sizeof (RtpSession));
+	session->cold=ortp_new0(RtpSessionCold,1);
+	ortp_mutex_init(&session->rtcp.report_lock,NULL);
+	ortp_mutex_init(&session->rtcp.xr_lock,NULL);
+	ortp_mutex_init(&session->rtx.lock,NULL);
+	qinit(&session->rtx.pending);
 	session->mode = (RtpSessionMode) mode;
 	if ((mode == RTP_SESSION_RECVONLY) || (mode == RTP_SESSION_SENDRECV))
 	{
@@ -248,6 +268,9 @@ rtp_session_init (RtpSession * session, int mode)
 	rtp_session_set_profile (session, &av_profile); /*the default profile to work with */
 	session->rtp.socket=-1;
 	session->rtcp.socket=-1;
+	session->rtcp.rand_seed=uint32_t_random();
+	session->rtcp.xr.rtt=-1;
+	session->nack.rtx_pt=-1;
 #ifndef WIN32
 	session->rtp.snd_socket_size=0;	/*use OS default value unless on windows where they are definitely too short*/
 	session->rtp.rcv_socket_size=0;
@@ -255,21 +278,22 @@ rtp_session_init (RtpSession * session, int mode)
 	session->rtp.snd_socket_size=session->rtp.rcv_socket_size=65536;
 #endif
 	session->rtp.ssrc_changed_thres=50;
-	session->dscp=RTP_DEFAULT_DSCP;
-	session->multicast_ttl=RTP_DEFAULT_MULTICAST_TTL;
-	session->multicast_loopback=RTP_DEFAULT_MULTICAST_LOOPBACK;
+	session->cold->dscp=RTP_DEFAULT_DSCP;
+	session->cold->multicast_ttl=RTP_DEFAULT_MULTICAST_TTL;
+	session->cold->multicast_loopback=RTP_DEFAULT_MULTICAST_LOOPBACK;
 	qinit(&session->rtp.rq);
 	qinit(&session->rtp.tev_rq);
-	qinit(&session->contributing_sources);
+	qinit(&session->cold->contributing_sources);
 	session->eventqs=NULL;
 	/* init signal tables */
-	rtp_signal_table_init (&session->on_ssrc_changed, session,"ssrc_changed");
-	rtp_signal_table_init (&session->on_payload_type_changed, session,"payload_type_changed");
-	rtp_signal_table_init (&session->on_telephone_event, session,"telephone-event");
-	rtp_signal_table_init (&session->on_telephone_event_packet, session,"telephone-event_packet");
-	rtp_signal_table_init (&session->on_timestamp_jump,session,"timestamp_jump");
-	rtp_signal_table_init (&session->on_network_error,session,"network_error");
-	rtp_signal_table_init (&session->on_rtcp_bye,session,"rtcp_bye");
+	rtp_signal_table_init (&session->cold->on_ssrc_changed, session,"ssrc_changed");
+	rtp_signal_table_init (&session->cold->on_payload_type_changed, session,"payload_type_changed");
+	rtp_signal_table_init (&session->cold->on_telephone_event, session,"telephone-event");
+	rtp_signal_table_init (&session->cold->on_telephone_event_packet, session,"telephone-event_packet");
+	rtp_signal_table_init (&session->cold->on_timestamp_jump,session,"timestamp_jump");
+	rtp_signal_table_init (&session->cold->on_network_error,session,"network_error");
+	rtp_signal_table_init (&session->cold->on_rtcp_bye,session,"rtcp_bye");
+	rtp_signal_table_init (&session->cold->on_target_bitrate_changed,session,"target_bitrate_changed");
 	wait_point_init(&session->snd.wp);
 	wait_point_init(&session->rcv.wp);
 	/*defaults send payload type to 0 (pcmu)*/
@@ -535,7 +559,7 @@ rtp_session_signal_connect (RtpSession * session, const char *signal_name,
 			    RtpCallback cb, unsigned long user_data)
 {
 	OList *elem;
-	for (elem=session->signal_tables;elem!=NULL;elem=o_list_next(elem)){
+	for (elem=session->cold->signal_tables;elem!=NULL;elem=o_list_next(elem)){
 		RtpSignalTable *s=(RtpSignalTable*) elem->data;
 		if (strcmp(signal_name,s->signal_name)==0){
 			return rtp_signal_table_add(s,cb,user_data);
@@ -559,7 +583,7 @@ rtp_session_signal_disconnect_by_callback (RtpSession * session, const char *sig
 					   RtpCallback cb)
 {
 	OList *elem;
-	for (elem=session->signal_tables;elem!=NULL;elem=o_list_next(elem)){
+	for (elem=session->cold->signal_tables;elem!=NULL;elem=o_list_next(elem)){
 		RtpSignalTable *s=(RtpSignalTable*) elem->data;
 		if (strcmp(signal_name,s->signal_name)==0){
 			return rtp_signal_table_remove_by_callback(s,cb);
@@ -597,6 +621,7 @@ void
 rtp_session_set_ssrc (RtpSession * session, uint32_t ssrc)
 {
 	session->snd.ssrc = ssrc;
+	rtp_session_invalidate_sdes(session);
 }
 
 
@@ -702,6 +727,14 @@ static void rtp_header_init_from_session(rtp_header_t *rtp, RtpSession *session)
 	rtp->seq_number=session->rtp.snd_seq;
 }
 
+/* allocates a block for an outgoing packet, leaving the headroom the transport asked for in front of it */
+mblk_t *rtp_session_alloc_send_block(RtpSession *session, int size){
+	mblk_t *mp=allocb(session->headroom+size,BPRI_MED);
+	mp->b_rptr+=session->headroom;
+	mp->b_wptr=mp->b_rptr;
+	return mp;
+}
+
 /**
  *	Allocates a new rtp packet. In the header, ssrc and payload_type according to the session's
  *	context. Timestamp is not set, it will be set when the packet is going to be
@@ -720,7 +753,7 @@ mblk_t * rtp_session_create_packet(RtpSession *session,int header_size, const ui
 	int msglen=header_size+payload_size;
 	rtp_header_t *rtp;
 	
-	mp=allocb(msglen,BPRI_MED);
+	mp=rtp_session_alloc_send_block(session,msglen);
 	rtp=(rtp_header_t*)mp->b_rptr;
 	rtp_header_init_from_session(rtp,session);
 	/*copy the payload, if any */
@@ -754,7 +787,7 @@ mblk_t * rtp_session_create_packet_with_data(RtpSession *session, uint8_t *paylo
 	int header_size=RTP_FIXED_HEADER_SIZE; /* revisit when support for csrc is done */
 	rtp_header_t *rtp;
 	
-	mp=allocb(header_size,BPRI_MED);
+	mp=rtp_session_alloc_send_block(session,header_size);
 	rtp=(rtp_header_t*)mp->b_rptr;
 	rtp_header_init_from_session(rtp,session);
 	mp->b_wptr+=header_size;
@@ -833,6 +866,11 @@ __rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t packet_t
 		/*ortp_message("rtp_session_send_with_ts: packet_time=%i time=%i",packet_time,sched->time_);*/
 		if (TIME_IS_STRICTLY_NEWER_THAN (packet_time, sched->time_))
 		{
+			if (session->flags & RTP_SESSION_IN_SCHEDULER){
+				RtpSchedSlot *slot=rtp_scheduler_slot(sched,session);
+				slot->snd_time=packet_time;
+				slot->snd_wakeup=TRUE;
+			}
 			wait_point_wakeup_at(&session->snd.wp,packet_time,(session->flags & RTP_SESSION_BLOCKING_MODE)!=0);	
 			session_set_clr(&sched->w_sessions,session);	/* the session has written */
 		}
@@ -932,7 +970,7 @@ static void payload_type_changed_notify(RtpSession *session, int paytype){
 	PayloadType *pt = rtp_profile_get_payload(session->rcv.profile,paytype);
 	if (pt) {
 		session->rcv.pt = paytype;
-		rtp_signal_table_emit (&session->on_payload_type_changed);
+		rtp_signal_table_emit (&session->cold->on_payload_type_changed);
 	}
 }
 
@@ -1014,7 +1052,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 		int msgsize=msgdsize(mp);
 		ortp_global_stats.recv += msgsize;
 		stream->stats.recv += msgsize;
-		rtp_signal_table_emit2(&session->on_telephone_event_packet,(long)mp);
+		rtp_signal_table_emit2(&session->cold->on_telephone_event_packet,(long)mp);
 		rtp_session_check_telephone_events(session,mp);
 		freemsg(mp);
 		mp=NULL;
@@ -1052,6 +1090,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 	
 	stream->stats.outoftime+=rejected;
 	ortp_global_stats.outoftime+=rejected;
+	rtp_session_rtcp_xr_discarded(session,rejected);
 
 	goto end;
 
@@ -1111,6 +1150,11 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 		
 		if (TIME_IS_STRICTLY_NEWER_THAN (packet_time, sched->time_))
 		{
+			if (session->flags & RTP_SESSION_IN_SCHEDULER){
+				RtpSchedSlot *slot=rtp_scheduler_slot(sched,session);
+				slot->rcv_time=packet_time;
+				slot->rcv_wakeup=TRUE;
+			}
 			wait_point_wakeup_at(&session->rcv.wp,packet_time, (session->flags & RTP_SESSION_BLOCKING_MODE)!=0);
 			session_set_clr(&sched->r_sessions,session);
 		}
@@ -1337,10 +1381,19 @@ void rtp_session_uninit (RtpSession * session)
 	if (session->current_tev!=NULL) freemsg(session->current_tev);
 	if (session->rtp.cached_mp!=NULL) freemsg(session->rtp.cached_mp);
 	if (session->rtcp.cached_mp!=NULL) freemsg(session->rtcp.cached_mp);
-	if (session->sd!=NULL) freemsg(session->sd);
-
-	session->signal_tables = o_list_free(session->signal_tables);
+	if (session->cold->sd!=NULL) freemsg(session->cold->sd);
+	if (session->rtcp.sdes_cache!=NULL) freemsg(session->rtcp.sdes_cache);
+	if (session->rtcp.report_buf!=NULL) freemsg(session->rtcp.report_buf);
+	ortp_mutex_destroy(&session->rtcp.report_lock);
+	ortp_mutex_destroy(&session->rtcp.xr_lock);
+	rtp_session_retransmission_uninit(session);
+	ortp_mutex_destroy(&session->rtx.lock);
+	flushq(&session->cold->contributing_sources, FLUSHALL);
+
+	session->cold->signal_tables = o_list_free(session->cold->signal_tables);
 	msgb_allocator_uninit(&session->allocator);
+	ortp_free(session->cold);
+	session->cold=NULL;
 
 #if (_WIN32_WINNT >= 0x0600)
 	if (session->rtp.QoSFlowID != 0)
@@ -1430,6 +1483,8 @@ void rtp_session_reset (RtpSession * session)
 	rtp_session_clear_send_error_code(session);
 	rtp_session_clear_recv_error_code(session);
 	rtp_stats_reset(&session->rtp.stats);
+	rtp_session_rtcp_xr_reset(session);
+	rtp_session_retransmission_reset(session);
 	rtp_session_resync(session);
 	session->ssrc_set=FALSE;
 }
@@ -1644,11 +1699,15 @@ uint32_t rtp_session_ts_to_time (RtpSession * session, uint32_t timestamp)
 }
 
 
-/* time is the number of miliseconds elapsed since the start of the scheduler */
+/* time is the number of miliseconds elapsed since the start of the scheduler.
+ Called by the scheduler when the slot of the session says a wait point is due. */
 void rtp_session_process (RtpSession * session, uint32_t time, RtpScheduler *sched)
 {
+	RtpSchedSlot *slot=rtp_scheduler_slot(sched,session);
+
 	wait_point_lock(&session->snd.wp);
 	if (wait_point_check(&session->snd.wp,time)){
+		slot->snd_wakeup=FALSE;
 		session_set_set(&sched->w_sessions,session);
 		wait_point_wakeup(&session->snd.wp);
 	}
@@ -1656,6 +1715,7 @@ void rtp_session_process (RtpSession * session, uint32_t time, RtpScheduler *sch
 	
 	wait_point_lock(&session->rcv.wp);
 	if (wait_point_check(&session->rcv.wp,time)){
+		slot->rcv_wakeup=FALSE;
 		session_set_set(&sched->r_sessions,session);
 		wait_point_wakeup(&session->rcv.wp);
 	}
@@ -23,6 +23,7 @@
 #include "utils.h"
 #include "ortp/rtpsession.h"
 #include "rtpsession_priv.h"
+#include "scheduler.h"
 
 #if defined(WIN32) || defined(_WIN32_WCE)
 #include "ortp-config-win32.h"
@@ -41,7 +42,16 @@
 #define USE_SENDMSG 1
 #endif
 
-#define can_connect(s)	( (s)->use_connect && !(s)->symmetric_rtp)
+#ifdef __linux__
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#ifdef __NR_sendmmsg
+/* called through syscall(): older C libraries do not have sendmmsg() */
+#define USE_SENDMMSG 1
+#endif
+#endif
+
+#define can_connect(s)	( (s)->use_connect && !(s)->symmetric_rtp && !((s)->flags & RTP_SESSION_USING_SHARED_SOCKET))
 
 static bool_t try_connect(int fd, const struct sockaddr *dest, socklen_t addrlen){
 	if (connect(fd,dest,addrlen)<0){
@@ -51,7 +61,7 @@ static bool_t try_connect(int fd, const struct sockaddr *dest, socklen_t addrlen
 	return TRUE;
 }
 
-static ortp_socket_t create_and_bind(const char *addr, int port, int *sock_family, bool_t reuse_addr){
+ortp_socket_t rtp_session_create_and_bind(const char *addr, int port, int *sock_family, bool_t reuse_addr){
 	int err;
 	int optval = 1;
 	ortp_socket_t sock=-1;
@@ -211,7 +221,7 @@ static void set_socket_sizes(int sock, unsigned int sndbufsz, unsigned int rcvbu
 	}
 }
 
-static ortp_socket_t create_and_bind_random(const char *localip, int *sock_family, int *port){
+ortp_socket_t rtp_session_create_and_bind_random(const char *localip, int *sock_family, int *port){
 	int retry;
 	ortp_socket_t sock = -1;
 	for (retry=0;retry<100;retry++)
@@ -223,13 +233,13 @@ static ortp_socket_t create_and_bind_random(const char *localip, int *sock_famil
 		}
 		while ((localport < 5000) || (localport > 0xffff));
 		/*do not set REUSEADDR in case of random allocation */
-		sock = create_and_bind(localip, localport, sock_family,FALSE);
+		sock = rtp_session_create_and_bind(localip, localport, sock_family,FALSE);
 		if (sock!=-1) {
 			*port=localport;
 			return sock;
 		}
 	}
-	ortp_warning("create_and_bind_random: Could not find a random port for %s !",localip);
+	ortp_warning("rtp_session_create_and_bind_random: Could not find a random port for %s !",localip);
 	return -1;
 }
 
@@ -265,16 +275,16 @@ rtp_session_set_local_addr (RtpSession * session, const char * addr, int port)
 #endif
 	/* try to bind the rtp port */
 	if (port>0)
-		sock=create_and_bind(addr,port,&sockfamily,reuse_addr);
+		sock=rtp_session_create_and_bind(addr,port,&sockfamily,reuse_addr);
 	else
-		sock=create_and_bind_random(addr,&sockfamily,&port);
+		sock=rtp_session_create_and_bind_random(addr,&sockfamily,&port);
 	if (sock!=-1){
 		set_socket_sizes(sock,session->rtp.snd_socket_size,session->rtp.rcv_socket_size);
 		session->rtp.sockfamily=sockfamily;
 		session->rtp.socket=sock;
 		session->rtp.loc_port=port;
 		/*try to bind rtcp port */
-		sock=create_and_bind(addr,port+1,&sockfamily,reuse_addr);
+		sock=rtp_session_create_and_bind(addr,port+1,&sockfamily,reuse_addr);
 		if (sock!=-1){
 			session->rtcp.sockfamily=sockfamily;
 			session->rtcp.socket=sock;
@@ -309,7 +319,7 @@ int rtp_session_set_multicast_ttl(RtpSession *session, int ttl)
     int retval;
     
     // Store new TTL if one is specified
-    if (ttl>0) session->multicast_ttl = ttl;
+    if (ttl>0) session->cold->multicast_ttl = ttl;
     
     // Don't do anything if socket hasn't been created yet
     if (session->rtp.socket < 0) return 0;
@@ -318,24 +328,24 @@ int rtp_session_set_multicast_ttl(RtpSession *session, int ttl)
         case AF_INET: {
  
 			retval= setsockopt(session->rtp.socket, IPPROTO_IP, IP_MULTICAST_TTL,
-						 (SOCKET_OPTION_VALUE)  &session->multicast_ttl, sizeof(session->multicast_ttl));
+						 (SOCKET_OPTION_VALUE)  &session->cold->multicast_ttl, sizeof(session->cold->multicast_ttl));
             
 			if (retval<0) break;
 
 			retval= setsockopt(session->rtcp.socket, IPPROTO_IP, IP_MULTICAST_TTL,
-					 (SOCKET_OPTION_VALUE)	   &session->multicast_ttl, sizeof(session->multicast_ttl));
+					 (SOCKET_OPTION_VALUE)	   &session->cold->multicast_ttl, sizeof(session->cold->multicast_ttl));
 
  		} break;
 #ifdef ORTP_INET6
         case AF_INET6: {
 
 			retval= setsockopt(session->rtp.socket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, 
-					 (SOCKET_OPTION_VALUE)&session->multicast_ttl, sizeof(session->multicast_ttl));
+					 (SOCKET_OPTION_VALUE)&session->cold->multicast_ttl, sizeof(session->cold->multicast_ttl));
 					
 			if (retval<0) break;
 			
 			retval= setsockopt(session->rtcp.socket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, 
-					 (SOCKET_OPTION_VALUE) &session->multicast_ttl, sizeof(session->multicast_ttl));
+					 (SOCKET_OPTION_VALUE) &session->cold->multicast_ttl, sizeof(session->cold->multicast_ttl));
 
         } break;
 #endif
@@ -360,7 +370,7 @@ int rtp_session_set_multicast_ttl(RtpSession *session, int ttl)
 **/
 int rtp_session_get_multicast_ttl(RtpSession *session)
 {
-	return session->multicast_ttl;
+	return session->cold->multicast_ttl;
 }
 
 
@@ -381,10 +391,10 @@ int rtp_session_set_multicast_loopback(RtpSession *session, int yesno)
     // Store new loopback state if one is specified
     if (yesno==0) {
     	// Don't loop back
-    	session->multicast_loopback = 0;
+    	session->cold->multicast_loopback = 0;
     } else if (yesno>0) {
     	// Do loop back
-    	session->multicast_loopback = 1;
+    	session->cold->multicast_loopback = 1;
     }
      
     // Don't do anything if socket hasn't been created yet
@@ -394,24 +404,24 @@ int rtp_session_set_multicast_loopback(RtpSession *session, int yesno)
         case AF_INET: {
  
 			retval= setsockopt(session->rtp.socket, IPPROTO_IP, IP_MULTICAST_LOOP,
-						 (SOCKET_OPTION_VALUE)   &session->multicast_loopback, sizeof(session->multicast_loopback));
+						 (SOCKET_OPTION_VALUE)   &session->cold->multicast_loopback, sizeof(session->cold->multicast_loopback));
             
 			if (retval<0) break;
 
 			retval= setsockopt(session->rtcp.socket, IPPROTO_IP, IP_MULTICAST_LOOP,
-						 (SOCKET_OPTION_VALUE)   &session->multicast_loopback, sizeof(session->multicast_loopback));
+						 (SOCKET_OPTION_VALUE)   &session->cold->multicast_loopback, sizeof(session->cold->multicast_loopback));
 
  		} break;
 #ifdef ORTP_INET6
         case AF_INET6: {
 
 			retval= setsockopt(session->rtp.socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, 
-				 (SOCKET_OPTION_VALUE)	&session->multicast_loopback, sizeof(session->multicast_loopback));
+				 (SOCKET_OPTION_VALUE)	&session->cold->multicast_loopback, sizeof(session->cold->multicast_loopback));
 					
 			if (retval<0) break;
 			
 			retval= setsockopt(session->rtcp.socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, 
-				 (SOCKET_OPTION_VALUE)	&session->multicast_loopback, sizeof(session->multicast_loopback));
+				 (SOCKET_OPTION_VALUE)	&session->cold->multicast_loopback, sizeof(session->cold->multicast_loopback));
 
         } break;
 #endif
@@ -436,7 +446,7 @@ int rtp_session_set_multicast_loopback(RtpSession *session, int yesno)
 **/
 int rtp_session_get_multicast_loopback(RtpSession *session)
 {
-	return session->multicast_loopback;
+	return session->cold->multicast_loopback;
 }
 
 /**
@@ -457,7 +467,7 @@ int rtp_session_set_dscp(RtpSession *session, int dscp){
 #endif
 
 	// Store new DSCP value if one is specified
-	if (dscp>=0) session->dscp = dscp;
+	if (dscp>=0) session->cold->dscp = dscp;
 	
 	// Don't do anything if socket hasn't been created yet
 	if (session->rtp.socket < 0) return 0;
@@ -476,13 +486,13 @@ int rtp_session_set_dscp(RtpSession *session, int dscp){
 		}
 		else
 		{
-			if (session->dscp==0)
+			if (session->cold->dscp==0)
 				tos=QOSTrafficTypeBestEffort;
-			else if (session->dscp==0x8)
+			else if (session->cold->dscp==0x8)
 				tos=QOSTrafficTypeBackground;
-			else if (session->dscp==0x28)
+			else if (session->cold->dscp==0x28)
 				tos=QOSTrafficTypeAudioVideo;
-			else if (session->dscp==0x38)
+			else if (session->cold->dscp==0x38)
 				tos=QOSTrafficTypeVoice;
 			else
 				tos=QOSTrafficTypeExcellentEffort; /* 0x28 */
@@ -522,7 +532,7 @@ int rtp_session_set_dscp(RtpSession *session, int dscp){
 	} else {
 #endif
 		// DSCP value is in the upper six bits of the TOS field
-		tos = (session->dscp << 2) & 0xFC;
+		tos = (session->cold->dscp << 2) & 0xFC;
 		switch (session->rtp.sockfamily) {
 			case AF_INET:
 			retval = setsockopt(session->rtp.socket, IPPROTO_IP, IP_TOS, (SOCKET_OPTION_VALUE)&tos, sizeof(tos));
@@ -562,7 +572,7 @@ int rtp_session_set_dscp(RtpSession *session, int dscp){
 **/
 int rtp_session_get_dscp(const RtpSession *session)
 {
-	return session->dscp;
+	return session->cold->dscp;
 }
 
 
@@ -646,7 +656,7 @@ rtp_session_set_remote_addr_full (RtpSession * session, const char * addr, int r
 		return -1;
 	}
 #endif
-	if (session->rtp.socket == -1){
+	if (session->rtp.socket == -1 && !(session->flags & RTP_SESSION_USING_SHARED_SOCKET)){
 		/* the session has not its socket bound, do it */
 		ortp_debug ("Setting random local addresses.");
 #ifdef ORTP_INET6
@@ -772,6 +782,33 @@ void rtp_session_set_transports(RtpSession *session, struct _RtpTransport *rtptr
 	else session->flags&=~(RTP_SESSION_USING_TRANSPORT);
 }
 
+/* For RtpTransport t_recvfrom() functions that already hold the datagram in a block of
+ their own: gives that block to m instead of copying it, and frees pkt together with the
+ buffer m had. m is left with b_wptr at the start of the datagram, since the caller
+ advances it by the returned length. Falls back to a copy when m already holds data.*/
+int rtp_transport_hand_over(mblk_t *m, mblk_t *pkt){
+	int len=(int)(pkt->b_wptr-pkt->b_rptr);
+	dblk_t *db;
+
+	if (m->b_wptr!=m->b_rptr || m->b_cont!=NULL || pkt->b_cont!=NULL){
+		if (pkt->b_cont!=NULL) msgpullup(pkt,-1);
+		len=(int)(pkt->b_wptr-pkt->b_rptr);
+		if (len>(int)(m->b_datap->db_lim-m->b_wptr)){
+			ortp_warning("Datagram of %i bytes too large for the receive buffer, truncated.",len);
+			len=(int)(m->b_datap->db_lim-m->b_wptr);
+		}
+		memcpy(m->b_wptr,pkt->b_rptr,len);
+		freemsg(pkt);
+		return len;
+	}
+	db=m->b_datap;
+	m->b_datap=pkt->b_datap;
+	m->b_rptr=m->b_wptr=pkt->b_rptr;
+	pkt->b_datap=db;
+	freemsg(pkt);
+	return len;
+}
+
 
 
 /**
@@ -796,10 +833,15 @@ void rtp_session_flush_sockets(RtpSession *session){
 	  {
 		mblk_t *trashmp=esballoc(trash,sizeof(trash),0,NULL);
 		
-	    while (session->rtp.tr->t_recvfrom(session->rtp.tr,trashmp,0,(struct sockaddr *)&from,&fromlen)>0){};
+	    /* a transport may move the start of the buffer to strip its header: rewind it each time */
+	    while (session->rtp.tr->t_recvfrom(session->rtp.tr,trashmp,0,(struct sockaddr *)&from,&fromlen)>0){
+		trashmp->b_rptr=trashmp->b_wptr=trashmp->b_datap->db_base;
+	    };
 
 	    if (session->rtcp.tr)
-	      while (session->rtcp.tr->t_recvfrom(session->rtcp.tr,trashmp,0,(struct sockaddr *)&from,&fromlen)>0){};
+	      while (session->rtcp.tr->t_recvfrom(session->rtcp.tr,trashmp,0,(struct sockaddr *)&from,&fromlen)>0){
+		trashmp->b_rptr=trashmp->b_wptr=trashmp->b_datap->db_base;
+	      };
 		freemsg(trashmp);
 	    return;
 	  }
@@ -846,6 +888,7 @@ static void update_sent_bytes(RtpSession*s, int nbytes){
 		gettimeofday(&s->rtp.send_bw_start,NULL);
 	}
 	s->rtp.sent_bytes+=nbytes+IP_UDP_OVERHEAD;
+	rtp_session_rate_control_sent(s,nbytes+IP_UDP_OVERHEAD);
 }
 
 static void update_recv_bytes(RtpSession*s, int nbytes){
@@ -855,24 +898,15 @@ static void update_recv_bytes(RtpSession*s, int nbytes){
 	s->rtp.recv_bytes+=nbytes+IP_UDP_OVERHEAD;
 }
 
+/* sends a packet whose header is already in network byte order */
 int
-rtp_session_rtp_send (RtpSession * session, mblk_t * m)
+rtp_session_rtp_send_raw (RtpSession * session, mblk_t * m)
 {
 	int error;
-	int i;
-	rtp_header_t *hdr;
 	struct sockaddr *destaddr=(struct sockaddr*)&session->rtp.rem_addr;
 	socklen_t destlen=session->rtp.rem_addrlen;
 	ortp_socket_t sockfd=session->rtp.socket;
 
-	hdr = (rtp_header_t *) m->b_rptr;
-	/* perform host to network conversions */
-	hdr->ssrc = htonl (hdr->ssrc);
-	hdr->timestamp = htonl (hdr->timestamp);
-	hdr->seq_number = htons (hdr->seq_number);
-	for (i = 0; i < hdr->cc; i++)
-		hdr->csrc[i] = htonl (hdr->csrc[i]);
-
 	if (session->flags & RTP_SOCKET_CONNECTED) {
 		destaddr=NULL;
 		destlen=0;
@@ -891,8 +925,8 @@ rtp_session_rtp_send (RtpSession * session, mblk_t * m)
 #endif
 	}
 	if (error < 0){
-		if (session->on_network_error.count>0){
-			rtp_signal_table_emit3(&session->on_network_error,(long)"Error sending RTP packet",INT_TO_POINTER(getSocketErrorCode()));
+		if (session->cold->on_network_error.count>0){
+			rtp_signal_table_emit3(&session->cold->on_network_error,(long)"Error sending RTP packet",INT_TO_POINTER(getSocketErrorCode()));
 		}else ortp_warning ("Error sending rtp packet: %s ; socket=%i", getSocketError(), sockfd);
 		session->rtp.send_errno=getSocketErrorCode();
 	}else{
@@ -902,6 +936,222 @@ rtp_session_rtp_send (RtpSession * session, mblk_t * m)
 	return error;
 }
 
+int
+rtp_session_rtp_send (RtpSession * session, mblk_t * m)
+{
+	int i;
+	int error;
+	rtp_header_t *hdr;
+	uint16_t seq;
+
+	hdr = (rtp_header_t *) m->b_rptr;
+	seq = hdr->seq_number;
+	/* perform host to network conversions */
+	hdr->ssrc = htonl (hdr->ssrc);
+	hdr->timestamp = htonl (hdr->timestamp);
+	hdr->seq_number = htons (hdr->seq_number);
+	for (i = 0; i < hdr->cc; i++)
+		hdr->csrc[i] = htonl (hdr->csrc[i]);
+
+	/* the transports copy the packet before modifying it (SRTP), so the
+	 buffers referenced for retransmission keep the clear packet */
+	if (!session->rtx.enabled) return rtp_session_rtp_send_raw(session,m);
+	rtp_session_rtx_store(session,m,seq);
+	error=rtp_session_rtp_send_raw(session,m);
+	/* the retransmissions asked for since the last packet sent */
+	rtp_session_rtx_send_pending(session);
+	return error;
+}
+
+/* the session state updates of __rtp_session_sendm_with_ts(), without waiting for the scheduler.
+ The header is written in host byte order. */
+static void rtp_session_fanout_prepare(RtpSession *session, rtp_header_t *rtp, uint32_t ts, bool_t marker, int packsize){
+	RtpStream *stream=&session->rtp;
+	if (session->flags & RTP_SESSION_SEND_NOT_STARTED){
+		stream->snd_ts_offset=ts;
+		if ((session->flags & RTP_SESSION_RECV_NOT_STARTED)
+			|| session->mode==RTP_SESSION_SENDONLY){
+			gettimeofday(&session->last_recv_time,NULL);
+		}
+		if (session->flags & RTP_SESSION_SCHEDULED){
+			stream->snd_time_offset=session->sched->time_;
+		}
+		rtp_session_unset_flag(session,RTP_SESSION_SEND_NOT_STARTED);
+	}
+	rtp->version=2;
+	rtp->padbit=0;
+	rtp->extbit=0;
+	rtp->markbit=marker ? 1 : 0;
+	rtp->cc=0;
+	rtp->paytype=session->snd.pt;
+	rtp->ssrc=session->snd.ssrc;
+	rtp->timestamp=ts;
+	rtp->seq_number=stream->snd_seq++;
+	stream->snd_last_ts=ts;
+
+	ortp_global_stats.sent+=packsize;
+	stream->sent_payload_bytes+=packsize-RTP_FIXED_HEADER_SIZE;
+	stream->stats.sent+=packsize;
+	ortp_global_stats.packet_sent++;
+	stream->stats.packet_sent++;
+}
+
+#ifdef USE_SENDMMSG
+
+#define RTP_FANOUT_BATCH 32
+
+/* same layout as the kernel's struct mmsghdr */
+typedef struct _RtpMmsgHdr{
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+} RtpMmsgHdr;
+
+/* the socket on which the packet can be written as is, -1 if it must go through the session's transport
+ or be kept for retransmission by rtp_session_rtp_send() */
+static ortp_socket_t rtp_session_fanout_socket(RtpSession *session){
+	if (session->rtx.enabled) return -1;
+	if (rtp_session_using_transport(session,rtp)){
+		/* the shared socket transport sends packets untouched */
+		if (session->flags & RTP_SESSION_USING_SHARED_SOCKET)
+			return session->rtp.tr->t_getsocket(session->rtp.tr);
+		return -1;
+	}
+	if (session->rtp.rem_addrlen<=0 && !(session->flags & RTP_SOCKET_CONNECTED))
+		return -1;
+	return session->rtp.socket;
+}
+
+/* sends the count messages, and sets errs[i] to 0 or to the error of message i.
+ A message that fails does not stop the batch: sendmmsg() stops at the first one
+ that fails, which is then skipped and the rest sent with another call.
+ Returns the number of messages sent.*/
+static int rtp_fanout_sendmmsg(ortp_socket_t sock, RtpMmsgHdr *msgs, int count, int *errs){
+	int done=0;
+	int nsent=0;
+	bool_t use_sendmsg=FALSE;
+	while(done<count){
+		int err;
+		if (!use_sendmsg){
+			err=syscall(__NR_sendmmsg,sock,msgs+done,count-done,0);
+			if (err>0){
+				nsent+=err;
+				for (;err>0;err--) errs[done++]=0;
+				continue;
+			}
+			if (err<0 && errno==ENOSYS){
+				/* kernel older than 3.0 */
+				use_sendmsg=TRUE;
+				continue;
+			}
+			errs[done]=(err<0) ? errno : EAGAIN;
+		}else if (sendmsg(sock,&msgs[done].msg_hdr,0)<0){
+			errs[done]=errno;
+		}else{
+			errs[done]=0;
+			nsent++;
+		}
+		done++;
+	}
+	return nsent;
+}
+
+/* sends to count sessions sharing sock, the payload being referenced by every message */
+static int rtp_session_fanout_batch(RtpSession **sessions, int count, ortp_socket_t sock, mblk_t *payload, uint32_t ts, bool_t marker){
+	rtp_header_t hdrs[RTP_FANOUT_BATCH];
+	struct iovec iov[RTP_FANOUT_BATCH][2];
+	RtpMmsgHdr msgs[RTP_FANOUT_BATCH];
+	int errs[RTP_FANOUT_BATCH];
+	int plen=(int)(payload->b_wptr-payload->b_rptr);
+	int packsize=RTP_FIXED_HEADER_SIZE+plen;
+	int i,sent;
+
+	for (i=0;i<count;i++){
+		RtpSession *session=sessions[i];
+		rtp_header_t *hdr=&hdrs[i];
+		rtp_session_fanout_prepare(session,hdr,ts,marker,packsize);
+		hdr->ssrc=htonl(hdr->ssrc);
+		hdr->timestamp=htonl(hdr->timestamp);
+		hdr->seq_number=htons(hdr->seq_number);
+		iov[i][0].iov_base=hdr;
+		iov[i][0].iov_len=RTP_FIXED_HEADER_SIZE;
+		iov[i][1].iov_base=payload->b_rptr;
+		iov[i][1].iov_len=plen;
+		memset(&msgs[i],0,sizeof(RtpMmsgHdr));
+		if (!(session->flags & RTP_SOCKET_CONNECTED)){
+			msgs[i].msg_hdr.msg_name=&session->rtp.rem_addr;
+			msgs[i].msg_hdr.msg_namelen=session->rtp.rem_addrlen;
+		}
+		msgs[i].msg_hdr.msg_iov=iov[i];
+		msgs[i].msg_hdr.msg_iovlen=2;
+	}
+	sent=rtp_fanout_sendmmsg(sock,msgs,count,errs);
+	for (i=0;i<count;i++){
+		RtpSession *session=sessions[i];
+		if (errs[i]==0){
+			update_sent_bytes(session,packsize);
+		}else{
+			if (session->cold->on_network_error.count>0){
+				rtp_signal_table_emit3(&session->cold->on_network_error,(long)"Error sending RTP packet",INT_TO_POINTER(errs[i]));
+			}else ortp_warning ("Error sending rtp packet: %s ; socket=%i", strerror(errs[i]), sock);
+			session->rtp.send_errno=errs[i];
+		}
+		rtp_session_rtcp_process_send(session);
+	}
+	return sent>0 ? sent : 0;
+}
+#endif
+
+/**
+ * Sends the same payload, stamped with timestamp userts, to several sessions.
+ * Each session writes its own RTP header (SSRC, sequence number, timestamp)
+ * while the payload is shared: it is neither copied nor modified.
+ * Consecutive sessions of the array that use the same socket (for example
+ * sessions attached to the same RtpSocketMux) are sent in a single
+ * sendmmsg() call where available. Sessions whose transport modifies the
+ * packets (SRTP), or that keep them for retransmission, get a reference to
+ * the payload through dupb() and are sent one by one.
+ * Unlike rtp_session_sendm_with_ts(), this function never blocks on the
+ * scheduler.
+ *
+ *@param sessions the destination sessions
+ *@param count the number of sessions
+ *@param payload the payload, without RTP header. It is freed by this function.
+ *@param userts the timestamp of the payload
+ *@param marker the value of the marker bit
+ *@return the number of sessions to which the packet was sent.
+**/
+int rtp_session_fanout_send_with_ts(RtpSession **sessions, int count, mblk_t *payload, uint32_t userts, bool_t marker){
+	int i=0;
+	int nsent=0;
+	int packsize;
+
+	if (payload->b_cont!=NULL) msgpullup(payload,-1);
+	packsize=RTP_FIXED_HEADER_SIZE+(int)(payload->b_wptr-payload->b_rptr);
+	while(i<count){
+		RtpSession *session=sessions[i];
+		mblk_t *m;
+#ifdef USE_SENDMMSG
+		ortp_socket_t sock=rtp_session_fanout_socket(session);
+		if (sock>=0){
+			int n=1;
+			while(i+n<count && n<RTP_FANOUT_BATCH && rtp_session_fanout_socket(sessions[i+n])==sock) n++;
+			nsent+=rtp_session_fanout_batch(&sessions[i],n,sock,payload,userts,marker);
+			i+=n;
+			continue;
+		}
+#endif
+		m=rtp_session_alloc_send_block(session,RTP_FIXED_HEADER_SIZE);
+		rtp_session_fanout_prepare(session,(rtp_header_t*)m->b_wptr,userts,marker,packsize);
+		m->b_wptr+=RTP_FIXED_HEADER_SIZE;
+		m->b_cont=dupb(payload);
+		if (rtp_session_rtp_send(session,m)>=0) nsent++;
+		rtp_session_rtcp_process_send(session);
+		i++;
+	}
+	freemsg(payload);
+	return nsent;
+}
+
 int
 rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 {
@@ -937,8 +1187,8 @@ rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 		}
 		if (error < 0){
 			char host[65];
-			if (session->on_network_error.count>0){
-				rtp_signal_table_emit3(&session->on_network_error,(long)"Error sending RTCP packet",INT_TO_POINTER(getSocketErrorCode()));
+			if (session->cold->on_network_error.count>0){
+				rtp_signal_table_emit3(&session->cold->on_network_error,(long)"Error sending RTCP packet",INT_TO_POINTER(getSocketErrorCode()));
 			}else ortp_warning ("Error sending rtcp packet: %s ; socket=%i; addr=%s", getSocketError(), session->rtcp.socket, ortp_inet_ntoa((struct sockaddr*)&session->rtcp.rem_addr,session->rtcp.rem_addrlen,host,sizeof(host)) );
 		}
 	}else ortp_debug("Not sending rtcp report: sockfd=%i, rem_addrlen=%i, connected=%i",sockfd,session->rtcp.rem_addrlen,using_connected_socket);
@@ -1009,8 +1259,8 @@ rtp_session_rtp_recv (RtpSession * session, uint32_t user_ts)
 			}
 			else if (!is_would_block_error(errnum))
 			{
-				if (session->on_network_error.count>0){
-					rtp_signal_table_emit3(&session->on_network_error,(long)"Error receiving RTP packet",INT_TO_POINTER(getSocketErrorCode()));
+				if (session->cold->on_network_error.count>0){
+					rtp_signal_table_emit3(&session->cold->on_network_error,(long)"Error receiving RTP packet",INT_TO_POINTER(getSocketErrorCode()));
 				}else ortp_warning("Error receiving RTP packet: %s, err num  [%i],error [%i]",getSocketError(),errnum,error);
 			}
 			/* don't free the cached_mp, it will be reused next time */
@@ -1021,6 +1271,7 @@ rtp_session_rtp_recv (RtpSession * session, uint32_t user_ts)
 }
 
 void rtp_session_notify_inc_rtcp(RtpSession *session, mblk_t *m){
+	rtp_session_rtcp_process_incoming(session,m);
 	if (session->eventqs!=NULL){
 		OrtpEvent *ev=ortp_event_new(ORTP_EVENT_RTCP_PACKET_RECEIVED);
 		OrtpEventData *d=ortp_event_get_data(ev);
@@ -1097,8 +1348,8 @@ rtp_session_rtcp_recv (RtpSession * session)
 			}
 			else if (!is_would_block_error(errnum))
 			{
-				if (session->on_network_error.count>0){
-					rtp_signal_table_emit3(&session->on_network_error,(long)"Error receiving RTCP packet",INT_TO_POINTER(errnum));
+				if (session->cold->on_network_error.count>0){
+					rtp_signal_table_emit3(&session->cold->on_network_error,(long)"Error receiving RTCP packet",INT_TO_POINTER(errnum));
 				}else ortp_warning("Error receiving RTCP packet: %s.",getSocketError());
 				session->rtp.recv_errno=errnum;
 			}
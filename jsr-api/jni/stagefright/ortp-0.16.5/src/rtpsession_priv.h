@@ -33,7 +33,8 @@ typedef enum {
 	RTP_SESSION_USING_EXT_SOCKETS=1<<7, /* the session is using externaly supplied sockets */
 	RTP_SOCKET_CONNECTED=1<<8,
 	RTCP_SOCKET_CONNECTED=1<<9,
-	RTP_SESSION_USING_TRANSPORT=1<<10
+	RTP_SESSION_USING_TRANSPORT=1<<10,
+	RTP_SESSION_USING_SHARED_SOCKET=1<<11 /* the session sends and receives through a RtpSocketMux */
 }RtpSessionFlags;
 
 #define rtp_session_using_transport(s, stream) (((s)->flags & RTP_SESSION_USING_TRANSPORT) && (s->stream.tr != 0))
@@ -44,6 +45,7 @@ mblk_t * rtp_getq(queue_t *q, uint32_t ts, int *rejected);
 int rtp_session_rtp_recv(RtpSession * session, uint32_t ts);
 int rtp_session_rtcp_recv(RtpSession * session);
 int rtp_session_rtp_send (RtpSession * session, mblk_t * m);
+mblk_t *rtp_session_alloc_send_block(RtpSession *session, int size);
 int rtp_session_rtcp_send (RtpSession * session, mblk_t * m);
 
 void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_ts, struct sockaddr *addr, socklen_t addrlen);
@@ -51,4 +53,42 @@ void rtp_session_rtcp_parse(RtpSession *session, mblk_t *mp);
 
 void rtp_session_dispatch_event(RtpSession *session, OrtpEvent *ev);
 
+void rtp_session_rtcp_schedule_next_report(RtpSession *session);
+void rtp_session_invalidate_sdes(RtpSession *session);
+void rtp_session_rtcp_process_incoming(RtpSession *session, mblk_t *m);
+void rtcp_common_header_init(rtcp_common_header_t *ch, RtpSession *s,int type, int rc, int bytes_len);
+
+void rtp_session_rtcp_xr_reset(RtpSession *session);
+void rtp_session_rtcp_xr_new_source(RtpSession *session);
+void rtp_session_rtcp_xr_new_packet(RtpSession *session, uint16_t seq, uint32_t ts);
+void rtp_session_rtcp_xr_discarded(RtpSession *session, int count);
+mblk_t *rtp_session_create_rtcp_xr_packet(RtpSession *session);
+void rtp_session_rtcp_xr_parse(RtpSession *session, const mblk_t *m);
+
+void rtp_session_rate_control_sent(RtpSession *session, int bytes);
+void rtp_session_rate_control_process_report(RtpSession *session, const report_block_t *rb);
+
+int rtp_session_rtp_send_raw(RtpSession *session, mblk_t *m);
+void rtp_session_rtcp_send_feedback(RtpSession *session, mblk_t *fb);
+void rtp_session_nack_new_packet(RtpSession *session, uint16_t seq);
+void rtp_session_nack_process(RtpSession *session);
+bool_t rtp_session_rtx_decapsulate(RtpSession *session, mblk_t *mp);
+void rtp_session_rtx_store(RtpSession *session, mblk_t *m, uint16_t seq);
+void rtp_session_rtx_send_pending(RtpSession *session);
+void rtp_session_rtx_process_nack(RtpSession *session, const mblk_t *m);
+void rtp_session_retransmission_reset(RtpSession *session);
+void rtp_session_retransmission_uninit(RtpSession *session);
+
+uint32_t uint32_t_random(void);
+
+ortp_socket_t rtp_session_create_and_bind(const char *addr, int port, int *sock_family, bool_t reuse_addr);
+ortp_socket_t rtp_session_create_and_bind_random(const char *localip, int *sock_family, int *port);
+
+int rtp_transport_hand_over(mblk_t *m, mblk_t *pkt);
+
+bool_t srtp_transport_set_lower(RtpTransport *tp, RtpTransport *lower);
+
+struct _RtpTurnManager;
+int rtp_turn_manager_process_at(struct _RtpTurnManager *mgr, uint64_t now);
+
 #endif
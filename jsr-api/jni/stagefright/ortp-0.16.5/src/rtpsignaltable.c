@@ -28,7 +28,7 @@ void rtp_signal_table_init(RtpSignalTable *table,RtpSession *session, const char
 	memset(table,0,sizeof(RtpSignalTable));
 	table->session=session;
 	table->signal_name=signal_name;
-	session->signal_tables=o_list_append(session->signal_tables,(void*)table);
+	session->cold->signal_tables=o_list_append(session->cold->signal_tables,(void*)table);
 }
 
 int rtp_signal_table_add(RtpSignalTable *table,RtpCallback cb, unsigned long user_data)
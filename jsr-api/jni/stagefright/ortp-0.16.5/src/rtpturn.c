@@ -0,0 +1,637 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define LOG_TAG "oRTP-TURN"
+
+#include "ortp/ortp.h"
+#include "ortp/rtpturn.h"
+#include "ortp/stun.h"
+#include "utils.h"
+#include "rtpsession_priv.h"
+
+#include <sys/uio.h>
+
+#define TURN_CHANNEL_HEADER_SIZE 4
+#define TURN_CHANNEL_MIN 0x4000
+#define TURN_CHANNEL_MAX 0x7FFE
+#define TURN_MAGIC_COOKIE 0x2112A442
+/* a channel binding lasts 10 minutes and the permission it installs 5 minutes */
+#define TURN_CHANNEL_REFRESH_MS (4*60*1000)
+#define TURN_DEFAULT_LIFETIME 600	/* seconds, of an allocation */
+#define TURN_LIFETIME_MARGIN 60
+/* refreshes due within this window are sent in the same round */
+#define TURN_ROUND_WINDOW_MS (30*1000)
+#define TURN_RTO_MS 500
+#define TURN_MAX_TRIES 5
+#define TURN_RETRY_MS (10*1000)	/* after a failed refresh */
+#define TURN_MAX_AUTH_TRIES 2
+/* blocks of a message sent without copying them, the header included */
+#define TURN_MAX_IOV 8
+
+typedef struct _RtpTurnTransaction{
+	UInt96 tr_id;
+	uint16_t method;
+	bool_t active;
+	int tries;
+	int auth_tries;
+	int rto_ms;
+	uint64_t next_ms;	/* retransmission time */
+} RtpTurnTransaction;
+
+struct _RtpTurnLeg;
+
+typedef struct _RtpTurnChannel{
+	struct _RtpTurnChannel *next;
+	struct _RtpTurnLeg *leg;
+	RtpTransport tr;	/* the transport of the session */
+	RtpTransport relay;	/* sends and receives through the server, under orig */
+	RtpTransport *orig;	/* the transport it wraps (SRTP), if any */
+	ortp_socket_t socket;
+	uint16_t number;
+	StunAddress4 peer;
+	struct sockaddr_in peer_addr;
+	volatile bool_t bound;
+	RtpTurnTransaction bind;
+	RtpTurnTransaction refresh;
+	uint64_t bind_due_ms;
+	uint64_t refresh_due_ms;
+	/* updated by the thread of the session */
+	uint64_t sent;
+	uint64_t indications;
+	uint64_t received;
+	uint64_t dropped;
+} RtpTurnChannel;
+
+typedef struct _RtpTurnLeg{
+	RtpTurnManager *mgr;
+	RtpSession *session;
+	RtpTurnChannel rtp;
+	RtpTurnChannel rtcp;
+	int headroom;
+} RtpTurnLeg;
+
+struct _RtpTurnManager{
+	struct sockaddr_in server;
+	StunAtrString username;
+	StunAtrString password;
+	StunAtrString realm;
+	StunAtrString nonce;
+	bool_t has_nonce;
+	uint16_t next_number;
+	RtpTurnChannel *channels;
+	int nlegs;
+	ortp_mutex_t lock;
+	RtpTurnStats stats;	/* the manager counters, and those of the removed sessions */
+};
+
+static uint64_t rtp_turn_now_ms(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+static bool_t rtp_turn_is_server(RtpTurnManager *mgr, const struct sockaddr *addr){
+	const struct sockaddr_in *sin=(const struct sockaddr_in*)addr;
+	return addr->sa_family==AF_INET && sin->sin_port==mgr->server.sin_port
+		&& sin->sin_addr.s_addr==mgr->server.sin_addr.s_addr;
+}
+
+static bool_t rtp_turn_is_peer(RtpTurnChannel *ch, const struct sockaddr *addr){
+	const struct sockaddr_in *sin=(const struct sockaddr_in*)addr;
+	return addr->sa_family==AF_INET && sin->sin_port==ch->peer_addr.sin_port
+		&& sin->sin_addr.s_addr==ch->peer_addr.sin_addr.s_addr;
+}
+
+static void rtp_turn_set_xor_peer(StunAtrAddress4 *atr, const StunAddress4 *peer){
+	atr->pad=0;
+	atr->family=IPv4Family;
+	atr->ipv4.port=peer->port^(TURN_MAGIC_COOKIE>>16);
+	atr->ipv4.addr=peer->addr^TURN_MAGIC_COOKIE;
+}
+
+/* sends a ChannelBind or Refresh request, with the credentials once the server gave its nonce.
+ Called with mgr->lock held. */
+static void rtp_turn_send_request(RtpTurnManager *mgr, RtpTurnChannel *ch, RtpTurnTransaction *tx, bool_t retransmission, uint64_t now){
+	StunMessage req;
+	char buf[STUN_MAX_MESSAGE_SIZE];
+	int len;
+
+	stunBuildReqSimple(&req,NULL,FALSE,FALSE,0);
+	if (retransmission) memcpy(&req.msgHdr.tr_id,&tx->tr_id,sizeof(tx->tr_id));
+	else memcpy(&tx->tr_id,&req.msgHdr.tr_id,sizeof(tx->tr_id));
+	req.msgHdr.msgType=(tx->method|STUN_REQUEST);
+	if (tx->method==TURN_METHOD_CHANNELBIND){
+		req.hasChannelNumberAttributes=TRUE;
+		req.channelNumberAttributes.channelNumber=ch->number;
+		req.hasXorPeerAddress=TRUE;
+		rtp_turn_set_xor_peer(&req.xorPeerAddress,&ch->peer);
+	}else{
+		req.hasLifetimeAttributes=TRUE;
+		req.lifetimeAttributes.lifetime=TURN_DEFAULT_LIFETIME;
+	}
+	if (mgr->has_nonce){
+		req.hasUsername=TRUE;
+		memcpy(&req.username,&mgr->username,sizeof(req.username));
+		req.hasRealm=TRUE;
+		memcpy(&req.realmName,&mgr->realm,sizeof(req.realmName));
+		req.hasNonce=TRUE;
+		memcpy(&req.nonceName,&mgr->nonce,sizeof(req.nonceName));
+		req.hasMessageIntegrity=TRUE;
+	}
+	len=stunEncodeMessage(&req,buf,sizeof(buf),&mgr->password);
+	if (sendto(ch->socket,buf,len,0,(struct sockaddr*)&mgr->server,sizeof(mgr->server))<0)
+		ortp_warning("Could not send TURN request: %s",getSocketError());
+	mgr->stats.requests++;
+	tx->tries++;
+	tx->next_ms=now+tx->rto_ms;
+	tx->rto_ms*=2;
+}
+
+static void rtp_turn_start_transaction(RtpTurnManager *mgr, RtpTurnChannel *ch, RtpTurnTransaction *tx, uint64_t now){
+	tx->active=TRUE;
+	tx->tries=0;
+	tx->auth_tries=0;
+	tx->rto_ms=TURN_RTO_MS;
+	rtp_turn_send_request(mgr,ch,tx,FALSE,now);
+}
+
+static void rtp_turn_transaction_failed(RtpTurnManager *mgr, RtpTurnChannel *ch, RtpTurnTransaction *tx, const char *reason, uint64_t now){
+	uint64_t retry=now+TURN_RETRY_MS;
+	ortp_warning("TURN %s for channel 0x%x failed: %s",tx->method==TURN_METHOD_CHANNELBIND ? "ChannelBind" : "Refresh",ch->number,reason);
+	tx->active=FALSE;
+	mgr->stats.failures++;
+	/* the binding or allocation may still be valid for a while: try again later */
+	if (tx==&ch->bind) ch->bind_due_ms=retry;
+	else ch->refresh_due_ms=retry;
+}
+
+/* Called with mgr->lock held. */
+static void rtp_turn_process_response(RtpTurnManager *mgr, RtpTurnChannel *ch, const StunMessage *resp, uint64_t now){
+	RtpTurnTransaction *tx=NULL;
+
+	if (ch->bind.active && memcmp(&resp->msgHdr.tr_id,&ch->bind.tr_id,sizeof(UInt96))==0)
+		tx=&ch->bind;
+	else if (ch->refresh.active && memcmp(&resp->msgHdr.tr_id,&ch->refresh.tr_id,sizeof(UInt96))==0)
+		tx=&ch->refresh;
+	if (tx==NULL) return;
+
+	if (STUN_IS_SUCCESS_RESP(resp->msgHdr.msgType)){
+		tx->active=FALSE;
+		if (tx==&ch->bind){
+			ch->bound=TRUE;
+			ch->bind_due_ms=now+TURN_CHANNEL_REFRESH_MS;
+		}else{
+			uint32_t lifetime=resp->hasLifetimeAttributes ? resp->lifetimeAttributes.lifetime : TURN_DEFAULT_LIFETIME;
+			lifetime=(lifetime>2*TURN_LIFETIME_MARGIN) ? lifetime-TURN_LIFETIME_MARGIN : lifetime/2;
+			ch->refresh_due_ms=now+(uint64_t)lifetime*1000;
+		}
+		return;
+	}
+	if (!STUN_IS_ERR_RESP(resp->msgHdr.msgType)) return;
+	/* 401 Unauthorized or 438 Stale Nonce: send again with the new nonce, kept for the other requests */
+	if (resp->hasErrorCode && resp->errorCode.errorClass==4
+		&& (resp->errorCode.number==1 || resp->errorCode.number==38)
+		&& resp->hasRealm && resp->hasNonce && tx->auth_tries<TURN_MAX_AUTH_TRIES){
+		memcpy(&mgr->realm,&resp->realmName,sizeof(mgr->realm));
+		memcpy(&mgr->nonce,&resp->nonceName,sizeof(mgr->nonce));
+		mgr->has_nonce=TRUE;
+		tx->auth_tries++;
+		tx->tries=0;
+		tx->rto_ms=TURN_RTO_MS;
+		rtp_turn_send_request(mgr,ch,tx,FALSE,now);
+		return;
+	}
+	rtp_turn_transaction_failed(mgr,ch,tx,resp->hasErrorCode ? resp->errorCode.reason : "error response",now);
+}
+
+/* handles a STUN message from the server. Returns the size of the data of a Data indication,
+ copied at the place of the message, or 0. */
+static int rtp_turn_process_stun(RtpTurnChannel *ch, mblk_t *m, int len, struct sockaddr *from, socklen_t *fromlen){
+	RtpTurnManager *mgr=ch->leg->mgr;
+	StunMessage msg;
+
+	memset(&msg,0,sizeof(msg));
+	if (!stunParseMessage((char*)m->b_wptr,len,&msg)){
+		ch->dropped++;
+		return 0;
+	}
+	if (msg.msgHdr.msgType==(TURN_INDICATION_DATA|STUN_INDICATION)){
+		/* peer data that came before the channel was bound */
+		if (!msg.hasData || !msg.hasXorPeerAddress) return 0;
+		if (from!=NULL && fromlen!=NULL && *fromlen>=(socklen_t)sizeof(struct sockaddr_in)){
+			struct sockaddr_in *sin=(struct sockaddr_in*)from;
+			memset(sin,0,sizeof(*sin));
+			sin->sin_family=AF_INET;
+			sin->sin_port=htons(msg.xorPeerAddress.ipv4.port^(TURN_MAGIC_COOKIE>>16));
+			sin->sin_addr.s_addr=htonl(msg.xorPeerAddress.ipv4.addr^TURN_MAGIC_COOKIE);
+			*fromlen=sizeof(*sin);
+		}
+		memcpy(m->b_wptr,msg.data.value,msg.data.sizeValue);
+		ch->received++;
+		return msg.data.sizeValue;
+	}
+	ortp_mutex_lock(&mgr->lock);
+	rtp_turn_process_response(mgr,ch,&msg,rtp_turn_now_ms());
+	ortp_mutex_unlock(&mgr->lock);
+	return 0;
+}
+
+/* receives a datagram relayed by the server, without its ChannelData header or Data indication */
+static int rtp_turn_relay_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	RtpTurnChannel *ch=(RtpTurnChannel*)t->data;
+	struct sockaddr_storage src;
+	socklen_t srclen;
+	int err;
+
+	while(1){
+		uint8_t *p=m->b_wptr;
+		srclen=sizeof(src);
+		err=recvfrom(ch->socket,(char*)p,(int)(m->b_datap->db_lim-m->b_wptr),flags,(struct sockaddr*)&src,&srclen);
+		if (err<=0) return err;
+		if (!rtp_turn_is_server(ch->leg->mgr,(struct sockaddr*)&src)){
+			ch->dropped++;
+			continue;
+		}
+		if (err>=TURN_CHANNEL_HEADER_SIZE && (p[0]&0xC0)==0x40){
+			uint16_t number=(p[0]<<8)|p[1];
+			int len=(p[2]<<8)|p[3];
+			if (number==ch->number && len<=err-TURN_CHANNEL_HEADER_SIZE){
+				/* strip the header by starting the buffer after it, the caller moves b_wptr by len */
+				m->b_rptr+=TURN_CHANNEL_HEADER_SIZE;
+				m->b_wptr+=TURN_CHANNEL_HEADER_SIZE;
+				if (from!=NULL && fromlen!=NULL && *fromlen>=(socklen_t)sizeof(ch->peer_addr)){
+					memcpy(from,&ch->peer_addr,sizeof(ch->peer_addr));
+					*fromlen=sizeof(ch->peer_addr);
+				}
+				ch->received++;
+				return len;
+			}
+		}else if ((p[0]&0xC0)==0){
+			int len=rtp_turn_process_stun(ch,m,err,from,fromlen);
+			if (len>0) return len;
+			continue;
+		}
+		ch->dropped++;
+	}
+}
+
+/* sends the header and the blocks of the message in one datagram, without copying them */
+static int rtp_turn_send_chain(RtpTurnChannel *ch, uint8_t *header, mblk_t *m){
+	RtpTurnManager *mgr=ch->leg->mgr;
+	struct iovec iov[TURN_MAX_IOV];
+	struct msghdr msg;
+	mblk_t *it;
+	int n=(header!=NULL) ? 1 : 0;
+
+	for(it=m;it!=NULL;it=it->b_cont) n++;
+	if (n>TURN_MAX_IOV)
+		msgpullup(m,-1);
+	n=0;
+	if (header!=NULL){
+		iov[n].iov_base=header;
+		iov[n].iov_len=TURN_CHANNEL_HEADER_SIZE;
+		n++;
+	}
+	for(it=m;it!=NULL;it=it->b_cont,n++){
+		iov[n].iov_base=it->b_rptr;
+		iov[n].iov_len=it->b_wptr-it->b_rptr;
+	}
+	memset(&msg,0,sizeof(msg));
+	msg.msg_name=(void*)&mgr->server;
+	msg.msg_namelen=sizeof(mgr->server);
+	msg.msg_iov=iov;
+	msg.msg_iovlen=n;
+	return sendmsg(ch->socket,&msg,0);
+}
+
+/* Send indication, used until the channel is bound or for another destination than the peer */
+static int rtp_turn_send_indication(RtpTurnChannel *ch, mblk_t *m, const struct sockaddr *to){
+	RtpTurnManager *mgr=ch->leg->mgr;
+	StunMessage ind;
+	StunAddress4 peer=ch->peer;
+	char buf[STUN_MAX_MESSAGE_SIZE];
+	int size=msgdsize(m);
+	int len;
+	mblk_t *it;
+
+	if (to!=NULL){
+		const struct sockaddr_in *sin=(const struct sockaddr_in*)to;
+		if (to->sa_family!=AF_INET){
+			ortp_warning("TURN relay only supports IPv4 peers.");
+			return -1;
+		}
+		peer.port=ntohs(sin->sin_port);
+		peer.addr=ntohl(sin->sin_addr.s_addr);
+	}
+	if (size>=(int)sizeof(ind.data.value)) return -1;
+	stunBuildReqSimple(&ind,NULL,FALSE,FALSE,0);
+	ind.msgHdr.msgType=(TURN_INDICATION_SEND|STUN_INDICATION);
+	ind.hasXorPeerAddress=TRUE;
+	rtp_turn_set_xor_peer(&ind.xorPeerAddress,&peer);
+	ind.hasData=TRUE;
+	ind.data.sizeValue=0;
+	for(it=m;it!=NULL;it=it->b_cont){
+		int n=(int)(it->b_wptr-it->b_rptr);
+		memcpy(ind.data.value+ind.data.sizeValue,it->b_rptr,n);
+		ind.data.sizeValue+=n;
+	}
+	len=stunEncodeMessage(&ind,buf,sizeof(buf),NULL);
+	ch->indications++;
+	return sendto(ch->socket,buf,len,0,(struct sockaddr*)&mgr->server,sizeof(mgr->server));
+}
+
+/* sends a datagram through the server, in a ChannelData message once the channel is bound */
+static int rtp_turn_relay_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	RtpTurnChannel *ch=(RtpTurnChannel*)t->data;
+	int len=msgdsize(m);
+	uint8_t header[TURN_CHANNEL_HEADER_SIZE];
+	uint8_t *h=header;
+	int err;
+
+	if (!ch->bound || (to!=NULL && !rtp_turn_is_peer(ch,to)))
+		return rtp_turn_send_indication(ch,m,to);
+	ch->sent++;
+	/* the space in front of the packet is ours, even if the block is shared with a retransmission buffer */
+	if (m->b_rptr-m->b_datap->db_base>=TURN_CHANNEL_HEADER_SIZE)
+		h=m->b_rptr-TURN_CHANNEL_HEADER_SIZE;
+	h[0]=ch->number>>8;
+	h[1]=ch->number&0xFF;
+	h[2]=len>>8;
+	h[3]=len&0xFF;
+	if (h==header)
+		return rtp_turn_send_chain(ch,header,m);
+	/* in the headroom: sent in one piece with the packet */
+	m->b_rptr-=TURN_CHANNEL_HEADER_SIZE;
+	err=rtp_turn_send_chain(ch,NULL,m);
+	m->b_rptr+=TURN_CHANNEL_HEADER_SIZE;
+	return err;
+}
+
+static int rtp_turn_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	RtpTurnChannel *ch=(RtpTurnChannel*)t->data;
+	if (ch->orig!=NULL)
+		return ch->orig->t_sendto(ch->orig,m,flags,to,tolen);
+	return rtp_turn_relay_sendto(&ch->relay,m,flags,to,tolen);
+}
+
+static int rtp_turn_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	RtpTurnChannel *ch=(RtpTurnChannel*)t->data;
+	if (ch->orig!=NULL)
+		return ch->orig->t_recvfrom(ch->orig,m,flags,from,fromlen);
+	return rtp_turn_relay_recvfrom(&ch->relay,m,flags,from,fromlen);
+}
+
+static ortp_socket_t rtp_turn_getsocket(RtpTransport *t){
+	return ((RtpTurnChannel*)t->data)->socket;
+}
+
+/**
+ * Creates a manager for the sessions relayed by a TURN server.
+ * @param server_addr the TURN server name or IPv4 address
+ * @param server_port the TURN server port, usually 3478
+ * @param username the long-term credentials for the server
+ * @param password the long-term credentials for the server
+ * @return the new RtpTurnManager, or NULL if the server address could not be resolved.
+**/
+RtpTurnManager *rtp_turn_manager_new(const char *server_addr, int server_port, const char *username, const char *password){
+	RtpTurnManager *mgr;
+	uint32_t ip;
+	uint16_t port;
+
+	if (!stunParseHostName(server_addr,&ip,&port,(uint16_t)server_port)){
+		ortp_error("Could not resolve TURN server %s",server_addr);
+		return NULL;
+	}
+	mgr=ortp_new0(RtpTurnManager,1);
+	mgr->server.sin_family=AF_INET;
+	mgr->server.sin_port=htons(port);
+	mgr->server.sin_addr.s_addr=htonl(ip);
+	snprintf(mgr->username.value,sizeof(mgr->username.value),"%s",username);
+	mgr->username.sizeValue=strlen(mgr->username.value);
+	snprintf(mgr->password.value,sizeof(mgr->password.value),"%s",password);
+	mgr->password.sizeValue=strlen(mgr->password.value);
+	mgr->next_number=TURN_CHANNEL_MIN;
+	ortp_mutex_init(&mgr->lock,NULL);
+	return mgr;
+}
+
+/**
+ * Frees the manager.
+ * All sessions must have been removed with rtp_turn_manager_remove_session() before.
+**/
+void rtp_turn_manager_destroy(RtpTurnManager *mgr){
+	if (mgr->nlegs>0)
+		ortp_warning("rtp_turn_manager_destroy(): %i sessions still attached.",mgr->nlegs);
+	ortp_mutex_destroy(&mgr->lock);
+	ortp_free(mgr);
+}
+
+/* Called with mgr->lock held. */
+static void rtp_turn_channel_init(RtpTurnManager *mgr, RtpTurnChannel *ch, RtpTurnLeg *leg, RtpTransport *orig, ortp_socket_t sock, const struct sockaddr_in *peer, uint64_t now){
+	ch->leg=leg;
+	ch->orig=orig;
+	ch->socket=sock;
+	ch->number=mgr->next_number;
+	mgr->next_number=(mgr->next_number>=TURN_CHANNEL_MAX) ? TURN_CHANNEL_MIN : mgr->next_number+1;
+	memcpy(&ch->peer_addr,peer,sizeof(ch->peer_addr));
+	ch->peer.port=ntohs(peer->sin_port);
+	ch->peer.addr=ntohl(peer->sin_addr.s_addr);
+	ch->tr.data=ch;
+	ch->tr.t_getsocket=rtp_turn_getsocket;
+	ch->tr.t_sendto=rtp_turn_sendto;
+	ch->tr.t_recvfrom=rtp_turn_recvfrom;
+	ch->relay.data=ch;
+	ch->relay.t_getsocket=rtp_turn_getsocket;
+	ch->relay.t_sendto=rtp_turn_relay_sendto;
+	ch->relay.t_recvfrom=rtp_turn_relay_recvfrom;
+	ch->relay.session=leg->session;
+	ch->bind.method=TURN_METHOD_CHANNELBIND;
+	ch->refresh.method=TURN_METHOD_REFRESH;
+	/* the allocation is taken as just made */
+	ch->refresh_due_ms=now+(uint64_t)(TURN_DEFAULT_LIFETIME-TURN_LIFETIME_MARGIN)*1000;
+	ch->next=mgr->channels;
+	mgr->channels=ch;
+	rtp_turn_start_transaction(mgr,ch,&ch->bind,now);
+}
+
+static void rtp_turn_channel_unlink(RtpTurnManager *mgr, RtpTurnChannel *ch){
+	RtpTurnChannel **it;
+	for(it=&mgr->channels;*it!=NULL;it=&(*it)->next){
+		if (*it==ch){
+			*it=ch->next;
+			return;
+		}
+	}
+}
+
+static void rtp_turn_channel_add_stats(const RtpTurnChannel *ch, RtpTurnStats *stats){
+	stats->sent+=ch->sent;
+	stats->indications+=ch->indications;
+	stats->received+=ch->received;
+	stats->dropped+=ch->dropped;
+}
+
+/**
+ * Makes a session send and receive through the TURN server, and binds channels to its
+ * remote RTP and RTCP addresses. The session sockets must each have an allocation on
+ * the server already, made just before; the remote addresses must be set and IPv4.
+ * Until a channel is bound, packets go in Send indications.
+ * A session with SRTP transports keeps them: they protect the packets, which the
+ * manager then relays. Other transports are refused.
+ * The session must be removed with rtp_turn_manager_remove_session() before being destroyed.
+ * @param mgr the manager
+ * @param session the rtp session
+ * @return 0 on success.
+**/
+int rtp_turn_manager_add_session(RtpTurnManager *mgr, RtpSession *session){
+	RtpTurnLeg *leg;
+	RtpTransport *rtptr=rtp_session_using_transport(session,rtp) ? session->rtp.tr : NULL;
+	RtpTransport *rtcptr=rtp_session_using_transport(session,rtcp) ? session->rtcp.tr : NULL;
+	bool_t has_rtcp;
+	uint64_t now=rtp_turn_now_ms();
+
+	if (rtptr!=NULL && rtptr->t_sendto==rtp_turn_sendto){
+		ortp_error("rtp_turn_manager_add_session(): session already relayed.");
+		return -1;
+	}
+	if (session->flags & RTP_SESSION_USING_SHARED_SOCKET){
+		ortp_error("rtp_turn_manager_add_session(): the socket of this session is shared by its RtpSocketMux.");
+		return -1;
+	}
+	if (session->rtp.socket<0 || session->rtp.rem_addrlen<=0 || ((struct sockaddr*)&session->rtp.rem_addr)->sa_family!=AF_INET){
+		ortp_error("rtp_turn_manager_add_session(): session needs a socket and an IPv4 remote address.");
+		return -1;
+	}
+	has_rtcp=session->rtcp.socket>=0 && session->rtcp.rem_addrlen>0
+		&& ((struct sockaddr*)&session->rtcp.rem_addr)->sa_family==AF_INET;
+
+	leg=ortp_new0(RtpTurnLeg,1);
+	/* the wrapped transports do their I/O through the relay */
+	if ((rtptr!=NULL && !srtp_transport_set_lower(rtptr,&leg->rtp.relay))
+		|| (has_rtcp && rtcptr!=NULL && !srtp_transport_set_lower(rtcptr,&leg->rtcp.relay))){
+		ortp_error("rtp_turn_manager_add_session(): the transport of this session cannot be relayed.");
+		if (rtptr!=NULL) srtp_transport_set_lower(rtptr,NULL);
+		ortp_free(leg);
+		return -1;
+	}
+	leg->mgr=mgr;
+	leg->session=session;
+	leg->headroom=session->headroom;
+	session->headroom+=TURN_CHANNEL_HEADER_SIZE;
+
+	ortp_mutex_lock(&mgr->lock);
+	rtp_turn_channel_init(mgr,&leg->rtp,leg,rtptr,session->rtp.socket,(struct sockaddr_in*)&session->rtp.rem_addr,now);
+	if (has_rtcp)
+		rtp_turn_channel_init(mgr,&leg->rtcp,leg,rtcptr,session->rtcp.socket,(struct sockaddr_in*)&session->rtcp.rem_addr,now);
+	mgr->nlegs++;
+	ortp_mutex_unlock(&mgr->lock);
+
+	rtp_session_set_transports(session,&leg->rtp.tr,has_rtcp ? &leg->rtcp.tr : rtcptr);
+	return 0;
+}
+
+/**
+ * Gives back its sockets, or its own transports, to a session. The channels are left
+ * to expire on the server.
+**/
+void rtp_turn_manager_remove_session(RtpTurnManager *mgr, RtpSession *session){
+	RtpTurnLeg *leg;
+
+	if (!rtp_session_using_transport(session,rtp) || session->rtp.tr->t_sendto!=rtp_turn_sendto){
+		ortp_warning("rtp_turn_manager_remove_session(): session is not relayed.");
+		return;
+	}
+	leg=((RtpTurnChannel*)session->rtp.tr->data)->leg;
+	return_if_fail(leg->mgr==mgr);
+
+	ortp_mutex_lock(&mgr->lock);
+	rtp_turn_channel_unlink(mgr,&leg->rtp);
+	rtp_turn_channel_add_stats(&leg->rtp,&mgr->stats);
+	if (leg->rtcp.leg!=NULL){
+		rtp_turn_channel_unlink(mgr,&leg->rtcp);
+		rtp_turn_channel_add_stats(&leg->rtcp,&mgr->stats);
+	}
+	mgr->nlegs--;
+	ortp_mutex_unlock(&mgr->lock);
+
+	if (leg->rtp.orig!=NULL) srtp_transport_set_lower(leg->rtp.orig,NULL);
+	if (leg->rtcp.orig!=NULL) srtp_transport_set_lower(leg->rtcp.orig,NULL);
+	rtp_session_set_transports(session,leg->rtp.orig,(leg->rtcp.leg!=NULL) ? leg->rtcp.orig : session->rtcp.tr);
+	session->headroom=leg->headroom;
+	ortp_free(leg);
+}
+
+/**
+ * Retransmits the pending requests, and refreshes the channel bindings and the allocations.
+ * As soon as one of them is due, all those due within the next 30 seconds are refreshed
+ * in the same round, so that the refreshes of many sessions are grouped instead of
+ * spreading wake-ups and nonce challenges over time.
+ * The application calls this function periodically, every second or so, from any thread.
+ * @param mgr the manager
+ * @return the number of requests sent.
+**/
+int rtp_turn_manager_process(RtpTurnManager *mgr){
+	return rtp_turn_manager_process_at(mgr,rtp_turn_now_ms());
+}
+
+/* rtp_turn_manager_process() at a given time, in ms of the gettimeofday() clock */
+int rtp_turn_manager_process_at(RtpTurnManager *mgr, uint64_t now){
+	RtpTurnChannel *ch;
+	uint64_t before;
+	bool_t due=FALSE;
+
+	ortp_mutex_lock(&mgr->lock);
+	before=mgr->stats.requests;
+	for(ch=mgr->channels;ch!=NULL;ch=ch->next){
+		RtpTurnTransaction *txs[2]={&ch->bind,&ch->refresh};
+		int i;
+		for(i=0;i<2;i++){
+			RtpTurnTransaction *tx=txs[i];
+			if (!tx->active || now<tx->next_ms) continue;
+			if (tx->tries>=TURN_MAX_TRIES) rtp_turn_transaction_failed(mgr,ch,tx,"timeout",now);
+			else rtp_turn_send_request(mgr,ch,tx,TRUE,now);
+		}
+		if ((!ch->bind.active && ch->bind_due_ms<=now) || (!ch->refresh.active && ch->refresh_due_ms<=now))
+			due=TRUE;
+	}
+	if (due){
+		for(ch=mgr->channels;ch!=NULL;ch=ch->next){
+			if (!ch->bind.active && ch->bind_due_ms<=now+TURN_ROUND_WINDOW_MS)
+				rtp_turn_start_transaction(mgr,ch,&ch->bind,now);
+			if (!ch->refresh.active && ch->refresh_due_ms<=now+TURN_ROUND_WINDOW_MS)
+				rtp_turn_start_transaction(mgr,ch,&ch->refresh,now);
+		}
+		mgr->stats.rounds++;
+	}
+	before=mgr->stats.requests-before;
+	ortp_mutex_unlock(&mgr->lock);
+	return (int)before;
+}
+
+/**
+ * Gets the counters of the manager, summed over its sessions.
+**/
+void rtp_turn_manager_get_stats(RtpTurnManager *mgr, RtpTurnStats *stats){
+	RtpTurnChannel *ch;
+	ortp_mutex_lock(&mgr->lock);
+	*stats=mgr->stats;
+	for(ch=mgr->channels;ch!=NULL;ch=ch->next)
+		rtp_turn_channel_add_stats(ch,stats);
+	ortp_mutex_unlock(&mgr->lock);
+}
@@ -28,13 +28,13 @@ extern void rtp_session_process (RtpSession * session, uint32_t time, RtpSchedul
 
 void rtp_scheduler_init(RtpScheduler *sched)
 {
-	sched->list=0;
 	sched->time_=0;
 	/* default to the posix timer */
 	rtp_scheduler_set_timer(sched,&posix_timer);
 	ortp_mutex_init(&sched->lock,NULL);
 	ortp_cond_init(&sched->unblock_select_cond,NULL);
 	sched->max_sessions=sizeof(SessionSet)*8;
+	sched->slots=ortp_new0(RtpSchedSlot,sched->max_sessions);
 	session_set_init(&sched->all_sessions);
 	sched->all_max=0;
 	session_set_init(&sched->r_sessions);
@@ -92,14 +92,31 @@ void rtp_scheduler_destroy(RtpScheduler *sched)
 	ortp_mutex_destroy(&sched->lock);
 	//g_mutex_free(sched->unblock_select_mutex);
 	ortp_cond_destroy(&sched->unblock_select_cond);
+	ortp_free(sched->slots);
 	ortp_free(sched);
 }
 
+/* processes the sessions whose wait points are due; called with the scheduler lock held */
+void rtp_scheduler_tick(RtpScheduler *sched)
+{
+	RtpSchedSlot *slot=sched->slots;
+	RtpSchedSlot *end=sched->slots+sched->all_max+1;
+	uint32_t time=sched->time_;
+
+	for (;slot<end;slot++){
+		if (slot->session==NULL) continue;
+		if ((slot->snd_wakeup && TIME_IS_NEWER_THAN(time,slot->snd_time))
+			|| (slot->rcv_wakeup && TIME_IS_NEWER_THAN(time,slot->rcv_time))){
+			ortp_debug("scheduler: processing session=0x%x.\n",slot->session);
+			rtp_session_process(slot->session,time,sched);
+		}
+	}
+}
+
 void * rtp_scheduler_schedule(void * psched)
 {
 	RtpScheduler *sched=(RtpScheduler*) psched;
 	RtpTimer *timer=sched->timer;
-	RtpSession *current;
 
 	/* take this lock to prevent the thread to start until g_thread_create() returns
 		because we need sched->thread to be initialized */
@@ -111,15 +128,8 @@ void * rtp_scheduler_schedule(void * psched)
 	{
 		/* do the processing here: */
 		ortp_mutex_lock(&sched->lock);
-		
-		current=sched->list;
 		/* processing all scheduled rtp sessions */
-		while (current!=NULL)
-		{
-			ortp_debug("scheduler: processing session=0x%x.\n",current);
-			rtp_session_process(current,sched->time_,sched);
-			current=current->next;
-		}
+		rtp_scheduler_tick(sched);
 		/* wake up all the threads that are sleeping in _select()  */
 		ortp_cond_broadcast(&sched->unblock_select_cond);
 		ortp_mutex_unlock(&sched->lock);
@@ -137,36 +147,35 @@ void * rtp_scheduler_schedule(void * psched)
 
 void rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session)
 {
-	RtpSession *oldfirst;
+	RtpSchedSlot *slot;
 	int i;
 	if (session->flags & RTP_SESSION_IN_SCHEDULER){
 		/* the rtp session is already scheduled, so return silently */
 		return;
 	}
 	rtp_scheduler_lock(sched);
-	/* enqueue the session to the list of scheduled sessions */
-	oldfirst=sched->list;
-	sched->list=session;
-	session->next=oldfirst;
-	if (sched->max_sessions==0){
-		ortp_error("rtp_scheduler_add_session: max_session=0 !");
-	}
 	/* find a free pos in the session mask*/
 	for (i=0;i<sched->max_sessions;i++){
-		if (!ORTP_FD_ISSET(i,&sched->all_sessions.rtpset)){
-			session->mask_pos=i;
-			session_set_set(&sched->all_sessions,session);
-			/* make a new session scheduled not blockable if it has not started*/
-			if (session->flags & RTP_SESSION_RECV_NOT_STARTED) 
-				session_set_set(&sched->r_sessions,session);
-			if (session->flags & RTP_SESSION_SEND_NOT_STARTED) 
-				session_set_set(&sched->w_sessions,session);
-			if (i>sched->all_max){
-				sched->all_max=i;
-			}
-			break;
-		}
+		if (!ORTP_FD_ISSET(i,&sched->all_sessions.rtpset)) break;
 	}
+	if (i==sched->max_sessions){
+		ortp_error("rtp_scheduler_add_session: no room for more than %i sessions !",sched->max_sessions);
+		rtp_scheduler_unlock(sched);
+		return;
+	}
+	session->mask_pos=i;
+	session_set_set(&sched->all_sessions,session);
+	/* make a new session scheduled not blockable if it has not started*/
+	if (session->flags & RTP_SESSION_RECV_NOT_STARTED) 
+		session_set_set(&sched->r_sessions,session);
+	if (session->flags & RTP_SESSION_SEND_NOT_STARTED) 
+		session_set_set(&sched->w_sessions,session);
+	if (i>sched->all_max){
+		sched->all_max=i;
+	}
+	slot=rtp_scheduler_slot(sched,session);
+	memset(slot,0,sizeof(*slot));
+	slot->session=session;
 	
 	rtp_session_set_flag(session,RTP_SESSION_IN_SCHEDULER);
 	rtp_scheduler_unlock(sched);
@@ -174,8 +183,6 @@ void rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session)
 
 void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session)
 {
-	RtpSession *tmp;
-	int cond=1;
 	return_if_fail(session!=NULL); 
 	if (!(session->flags & RTP_SESSION_IN_SCHEDULER)){
 		/* the rtp session is not scheduled, so return silently */
@@ -183,28 +190,7 @@ void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session)
 	}
 
 	rtp_scheduler_lock(sched);
-	tmp=sched->list;
-	if (tmp==session){
-		sched->list=tmp->next;
-		rtp_session_unset_flag(session,RTP_SESSION_IN_SCHEDULER);
-		session_set_clr(&sched->all_sessions,session);
-		rtp_scheduler_unlock(sched);
-		return;
-	}
-	/* go the position of session in the list */
-	while(cond){
-		if (tmp!=NULL){
-			if (tmp->next==session){
-				tmp->next=tmp->next->next;
-				cond=0;
-			}
-			else tmp=tmp->next;
-		}else {
-			/* the session was not found ! */
-			ortp_warning("rtp_scheduler_remove_session: the session was not found in the scheduler list!");
-			cond=0;
-		}
-	}
+	rtp_scheduler_slot(sched,session)->session=NULL;
 	rtp_session_unset_flag(session,RTP_SESSION_IN_SCHEDULER);
 	/* delete the bit in the mask */
 	session_set_clr(&sched->all_sessions,session);
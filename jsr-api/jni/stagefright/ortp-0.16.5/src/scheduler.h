@@ -25,9 +25,22 @@
 #include "rtptimer.h"
 
 
+/* what the scheduler reads of a session at each tick. The slots are kept in an array
+indexed by the session mask_pos, so that a tick walks a few contiguous bytes per session
+instead of the RtpSession structures. The wake-up times are copies of those of the wait
+points, written under the wait point lock; the scheduler only takes the lock when one
+is due. */
+typedef struct _RtpSchedSlot {
+	RtpSession *session;	/* NULL if the slot is free */
+	uint32_t snd_time;
+	uint32_t rcv_time;
+	bool_t snd_wakeup;
+	bool_t rcv_wakeup;
+} RtpSchedSlot;
+
 struct _RtpScheduler {
  
-	RtpSession *list;	/* list of scheduled sessions*/
+	RtpSchedSlot *slots;	/* the scheduled sessions, max_sessions of them */
 	SessionSet	all_sessions;  /* mask of scheduled sessions */
 	int		all_max;		/* the highest pos in the all mask */
 	SessionSet  r_sessions;		/* mask of sessions that have a recv event */
@@ -59,9 +72,11 @@ void rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session);
 void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session);
 
 void * rtp_scheduler_schedule(void * sched);
+void rtp_scheduler_tick(RtpScheduler *sched);
 
 #define rtp_scheduler_lock(sched)	ortp_mutex_lock(&(sched)->lock)
 #define rtp_scheduler_unlock(sched)	ortp_mutex_unlock(&(sched)->lock)
+#define rtp_scheduler_slot(sched,session)	(&(sched)->slots[(session)->mask_pos])
 
 /* void rtp_scheduler_add_set(RtpScheduler *sched, SessionSet *set); */
 
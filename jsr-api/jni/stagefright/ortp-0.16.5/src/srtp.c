@@ -25,6 +25,7 @@
 #include "ortp-config.h"
 #endif
 #include "ortp/ortp.h"
+#include "rtpsession_priv.h"
 
 #ifdef HAVE_SRTP
 
@@ -37,8 +38,16 @@
 
 #define SRTP_PAD_BYTES 64 /*?? */
 
+/* the srtp sessions of a transport: the same one, or one per direction */
+typedef struct _SrtpTransportData{
+	srtp_t sender;
+	srtp_t receiver;
+	RtpTransport *lower;	/* does the I/O instead of the session socket, if set */
+}SrtpTransportData;
+
 static int  srtp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
-	srtp_t srtp=(srtp_t)t->data;
+	SrtpTransportData *data=(SrtpTransportData*)t->data;
+	srtp_t srtp=data->sender;
 	int slen;
 	err_status_t err;
 	/* enlarge the buffer for srtp to write its data */
@@ -46,6 +55,10 @@ static int  srtp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sock
 	slen=m->b_wptr-m->b_rptr;
 	err=srtp_protect(srtp,m->b_rptr,&slen);
 	if (err==err_status_ok){
+		if (data->lower!=NULL){
+			m->b_wptr=m->b_rptr+slen;
+			return data->lower->t_sendto(data->lower,m,flags,to,tolen);
+		}
 		return sendto(t->session->rtp.socket,m->b_rptr,slen,flags,to,tolen);
 	}
 	ortp_error("srtp_protect() failed");
@@ -53,10 +66,14 @@ static int  srtp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sock
 }
 
 static int srtp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
-	srtp_t srtp=(srtp_t)t->data;
+	SrtpTransportData *data=(SrtpTransportData*)t->data;
+	srtp_t srtp=data->receiver;
 	int err;
 	int slen;
-	err=recvfrom(t->session->rtp.socket,m->b_wptr,m->b_datap->db_lim-m->b_datap->db_base,flags,from,fromlen);
+	if (data->lower!=NULL)
+		err=data->lower->t_recvfrom(data->lower,m,flags,from,fromlen);
+	else
+		err=recvfrom(t->session->rtp.socket,m->b_wptr,m->b_datap->db_lim-m->b_datap->db_base,flags,from,fromlen);
 	if (err>0){
 
 		/* keep NON-RTP data unencrypted */
@@ -82,12 +99,17 @@ static int srtp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr
 }
 
 static int  srtcp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
-	srtp_t srtp=(srtp_t)t->data;
+	SrtpTransportData *data=(SrtpTransportData*)t->data;
+	srtp_t srtp=data->sender;
 	int slen;
 	/* enlarge the buffer for srtp to write its data */
 	msgpullup(m,msgdsize(m)+SRTP_PAD_BYTES);
 	slen=m->b_wptr-m->b_rptr;
 	if (srtp_protect_rtcp(srtp,m->b_rptr,&slen)==err_status_ok){
+		if (data->lower!=NULL){
+			m->b_wptr=m->b_rptr+slen;
+			return data->lower->t_sendto(data->lower,m,flags,to,tolen);
+		}
 		return sendto(t->session->rtcp.socket,m->b_rptr,slen,flags,to,tolen);
 	}
 	ortp_error("srtp_protect_rtcp() failed");
@@ -95,10 +117,14 @@ static int  srtcp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct soc
 }
 
 static int srtcp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
-	srtp_t srtp=(srtp_t)t->data;
+	SrtpTransportData *data=(SrtpTransportData*)t->data;
+	srtp_t srtp=data->receiver;
 	int err;
 	int slen;
-	err=recvfrom(t->session->rtcp.socket,m->b_wptr,m->b_datap->db_lim-m->b_datap->db_base,flags,from,fromlen);
+	if (data->lower!=NULL)
+		err=data->lower->t_recvfrom(data->lower,m,flags,from,fromlen);
+	else
+		err=recvfrom(t->session->rtcp.socket,m->b_wptr,m->b_datap->db_lim-m->b_datap->db_base,flags,from,fromlen);
 	if (err>0){
 		slen=err;
 		if (srtp_unprotect_rtcp(srtp,m->b_wptr,&slen)==err_status_ok)
@@ -123,25 +149,48 @@ srtcp_getsocket(RtpTransport *t)
   return t->session->rtcp.socket;
 }
 
+static void *srtp_transport_data_new(srtp_t sender, srtp_t receiver){
+	SrtpTransportData *data=ortp_new(SrtpTransportData,1);
+	data->sender=sender;
+	data->receiver=receiver;
+	data->lower=NULL;
+	return data;
+}
+
 /**
  * Creates a pair of Secure-RTP/Secure-RTCP RtpTransport's.
  * oRTP relies on libsrtp (see http://srtp.sf.net ) for secure RTP encryption.
  * This function creates a RtpTransport object to be used to the RtpSession using
  * rtp_session_set_transport().
+ * The srtp_t session is used for both directions, so the transports must not
+ * send and receive from different threads; see srtp_transport_new_pair().
  * @srtp: the srtp_t session to be used
  * 
 **/
 int srtp_transport_new(srtp_t srtp, RtpTransport **rtpt, RtpTransport **rtcpt ){
+	return srtp_transport_new_pair(srtp,srtp,rtpt,rtcpt);
+}
+
+/**
+ * Creates a pair of Secure-RTP/Secure-RTCP RtpTransport's that protect outgoing
+ * packets with one srtp_t session and unprotect incoming packets with another,
+ * as created by ortp_srtp_create_pair(). Since the two sessions share no state,
+ * the RtpSession can send and receive from different threads.
+ * @sender: the srtp_t session for outgoing packets
+ * @receiver: the srtp_t session for incoming packets
+ *
+**/
+int srtp_transport_new_pair(srtp_t sender, srtp_t receiver, RtpTransport **rtpt, RtpTransport **rtcpt ){
 	if (rtpt) {
 		(*rtpt)=ortp_new(RtpTransport,1);
-		(*rtpt)->data=srtp;
+		(*rtpt)->data=srtp_transport_data_new(sender,receiver);
 		(*rtpt)->t_getsocket=srtp_getsocket;
 		(*rtpt)->t_sendto=srtp_sendto;
 		(*rtpt)->t_recvfrom=srtp_recvfrom;
 	}
 	if (rtcpt) {
 		(*rtcpt)=ortp_new(RtpTransport,1);
-		(*rtcpt)->data=srtp;
+		(*rtcpt)->data=srtp_transport_data_new(sender,receiver);
 		(*rtcpt)->t_getsocket=srtcp_getsocket;
 		(*rtcpt)->t_sendto=srtcp_sendto;
 		(*rtcpt)->t_recvfrom=srtcp_recvfrom;
@@ -149,6 +198,35 @@ int srtp_transport_new(srtp_t srtp, RtpTransport **rtpt, RtpTransport **rtcpt ){
 	return 0;
 }
 
+/**
+ * Returns the srtp_t sessions used by a transport created with
+ * srtp_transport_new() or srtp_transport_new_pair(); both are the same session
+ * in the former case.
+**/
+void srtp_transport_get_sessions(RtpTransport *tp, srtp_t *sender, srtp_t *receiver){
+	SrtpTransportData *data=(SrtpTransportData*)tp->data;
+	if (sender) *sender=data->sender;
+	if (receiver) *receiver=data->receiver;
+}
+
+/* Makes a SRTP transport send and receive through another transport instead of the
+ session socket, e.g. a TURN relay; NULL gives it the socket back.
+ Returns FALSE if tp is not a SRTP transport. */
+bool_t srtp_transport_set_lower(RtpTransport *tp, RtpTransport *lower){
+	if (tp->t_sendto!=srtp_sendto && tp->t_sendto!=srtcp_sendto) return FALSE;
+	((SrtpTransportData*)tp->data)->lower=lower;
+	return TRUE;
+}
+
+/**
+ * Frees a transport created with srtp_transport_new() or
+ * srtp_transport_new_pair(). The srtp_t sessions are not deallocated.
+**/
+void srtp_transport_destroy(RtpTransport *tp){
+	ortp_free(tp->data);
+	ortp_free(tp);
+}
+
 err_status_t ortp_srtp_init(void)
 {
 	return srtp_init(0);
@@ -164,6 +242,11 @@ err_status_t ortp_srtp_create(srtp_t *session, const srtp_policy_t *policy)
 	return srtp_create(session, policy);
 }
 
+err_status_t ortp_srtp_create_pair(srtp_t *sender, srtp_t *receiver, const srtp_policy_t *policy)
+{
+	return srtp_create_pair(sender, receiver, policy);
+}
+
 err_status_t ortp_srtp_dealloc(srtp_t session)
 {
 	return srtp_dealloc(session);
@@ -185,6 +268,21 @@ int srtp_transport_new(void *i, RtpTransport **rtpt, RtpTransport **rtcpt ){
 	return -1;
 }
 
+int srtp_transport_new_pair(void *sender, void *receiver, RtpTransport **rtpt, RtpTransport **rtcpt ){
+	ortp_error("srtp_transport_new_pair: oRTP has not been compiled with SRTP support.");
+	return -1;
+}
+
+void srtp_transport_get_sessions(RtpTransport *tp, void **sender, void **receiver){
+}
+
+void srtp_transport_destroy(RtpTransport *tp){
+}
+
+bool_t srtp_transport_set_lower(RtpTransport *tp, RtpTransport *lower){
+	return FALSE;
+}
+
 bool_t ortp_srtp_supported(void){
 	return FALSE;
 }
@@ -194,6 +292,11 @@ int ortp_srtp_create(void *i, const void *policy)
 	return -1;
 }
 
+int ortp_srtp_create_pair(void *sender, void *receiver, const void *policy)
+{
+	return -1;
+}
+
 int ortp_srtp_dealloc(void *session)
 {
 	return -1;
@@ -256,14 +256,13 @@ stunParseAtrIntegrity( char* body, unsigned int hdrLen,  StunAtrIntegrity *resul
 static bool_t 
 turnParseAtrChannelNumber( char* body, unsigned int hdrLen,  TurnAtrChannelNumber *result )
 {
-   if ( hdrLen >= sizeof(result) )
+   if ( hdrLen != 4 )
    {
       ortp_error("stun: Incorrect size for TA_CHANNELNUMBER");
       return FALSE;
    }
    else
    {
-      if (hdrLen % 4 != 0) return FALSE;
       memcpy(&result->channelNumber, body, 2);
       body+=2;
       result->channelNumber = ntohs(result->channelNumber);
@@ -277,7 +276,7 @@ turnParseAtrChannelNumber( char* body, unsigned int hdrLen,  TurnAtrChannelNumbe
 static bool_t 
 turnParseAtrLifetime( char* body, unsigned int hdrLen,  TurnAtrLifetime *result )
 {
-   if ( hdrLen != sizeof(result) )
+   if ( hdrLen != 4 )
    {
       ortp_error("stun: Incorrect size for TA_LIFETIME");
       return FALSE;
@@ -951,6 +950,37 @@ encodeAtrLifeTime(char* ptr, const TurnAtrLifetime *atr)
    return ptr;
 }
 
+static char* 
+encodeAtrChannelNumber(char* ptr, const TurnAtrChannelNumber *atr)
+{
+   ptr = encode16(ptr, TA_CHANNELNUMBER);
+   ptr = encode16(ptr, 4);
+   ptr = encode16(ptr, atr->channelNumber);
+   ptr = encode16(ptr, atr->rffu);
+   return ptr;
+}
+
+static char* 
+encodeAtrData(char* ptr, const TurnAtrData *atr)
+{
+   int padding;
+   int i;
+
+   ptr = encode16(ptr, TA_DATA);
+   ptr = encode16(ptr, atr->sizeValue);
+   ptr = encode(ptr, atr->value, atr->sizeValue);
+
+   padding = atr->sizeValue % 4;
+   if (padding>0)
+   {
+     for (i=0;i<4-padding;i++)
+     {
+       *ptr++ = 0;
+     }
+   }
+   return ptr;
+}
+
 static char* 
 encodeAtrDontFragment(char* ptr)
 {
@@ -1016,6 +1046,21 @@ stunEncodeMessage( const StunMessage *msg,
       ortp_debug("stun: Encoding TA_DONTFRAGMENT: DF\n");
       ptr = encodeAtrDontFragment (ptr);
    }		  
+   if (msg->hasChannelNumberAttributes)
+   {
+      ortp_debug("stun: Encoding TA_CHANNELNUMBER: 0x%x\n", msg->channelNumberAttributes.channelNumber );
+      ptr = encodeAtrChannelNumber (ptr, &msg->channelNumberAttributes);
+   }
+   if (msg->hasXorPeerAddress)
+   {
+      ortp_debug("stun: Encoding TA_XORPEERADDRESS: %s\n", ipaddr(&msg->xorPeerAddress.ipv4) );
+      ptr = encodeAtrAddress4 (ptr, TA_XORPEERADDRESS, &msg->xorPeerAddress);
+   }
+   if (msg->hasData)
+   {
+      ortp_debug("stun: Encoding TA_DATA: %i bytes\n", msg->data.sizeValue );
+      ptr = encodeAtrData (ptr, &msg->data);
+   }
    if (msg->hasMappedAddress)
    {
       ortp_debug("stun: Encoding SA_MAPPEDADDRESS: %s\n", ipaddr(&msg->mappedAddress.ipv4) );
@@ -328,7 +328,7 @@ int rtp_session_read_telephone_event(RtpSession *session,
 static void notify_tev(RtpSession *session, telephone_event_t *event){
 	OrtpEvent *ev;
 	OrtpEventData *evd;
-	rtp_signal_table_emit2(&session->on_telephone_event,(long)(long)event[0].event);
+	rtp_signal_table_emit2(&session->cold->on_telephone_event,(long)(long)event[0].event);
 	if (session->eventqs!=NULL){
 		ev=ortp_event_new(ORTP_EVENT_TELEPHONE_EVENT);
 		evd=ortp_event_get_data(ev);
@@ -0,0 +1,154 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * fanout_test checks rtp_session_fanout_send_with_ts() over loopback, with
+ * sessions attached to one RtpSocketMux so that they are sent in one batch:
+ * a destination that cannot be sent to (port 0) in the middle of the batch
+ * must not keep the packet from reaching the destinations after it. A
+ * session with retransmission enabled keeps what it sends, and answers a
+ * NACK with its next packet.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "ortp/ortp.h"
+#include "ortp/rtpmux.h"
+#include "rtpsession_priv.h"
+#include "ortp_test.h"
+
+#define TEST_SESSIONS 6
+#define TEST_BAD_SESSION 2
+#define TEST_RTX_SESSION 4
+#define TEST_PAYLOAD_SIZE 160
+#define TEST_RTX_PT 97
+
+/* a plain non blocking UDP socket bound to a random loopback port */
+static int test_socket_new(int *port){
+	struct sockaddr_in addr;
+	socklen_t addrlen=sizeof(addr);
+	int sock=socket(AF_INET,SOCK_DGRAM,0);
+	CHECK(sock>=0);
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family=AF_INET;
+	addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+	CHECK(bind(sock,(struct sockaddr*)&addr,sizeof(addr))==0);
+	CHECK(getsockname(sock,(struct sockaddr*)&addr,&addrlen)==0);
+	CHECK(fcntl(sock,F_SETFL,O_NONBLOCK)==0);
+	*port=ntohs(addr.sin_port);
+	return sock;
+}
+
+static int test_count_received(int sock, uint32_t ssrc){
+	uint8_t buf[1500];
+	int count=0;
+	int len;
+	while((len=recv(sock,buf,sizeof(buf),0))>0){
+		CHECK(len==RTP_FIXED_HEADER_SIZE+TEST_PAYLOAD_SIZE);
+		CHECK(ntohl(((rtp_header_t*)buf)->ssrc)==ssrc);
+		count++;
+	}
+	return count;
+}
+
+static mblk_t *test_payload_new(void){
+	mblk_t *payload=allocb(TEST_PAYLOAD_SIZE,0);
+	memset(payload->b_wptr,0x55,TEST_PAYLOAD_SIZE);
+	payload->b_wptr+=TEST_PAYLOAD_SIZE;
+	return payload;
+}
+
+/* a NACK of the session stream for the packet pid */
+static mblk_t *test_make_nack(RtpSession *session, uint16_t pid){
+	int size=sizeof(rtcp_fb_header_t)+sizeof(rtcp_fb_nack_fci_t);
+	mblk_t *m=allocb(size,0);
+	rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_wptr;
+	rtcp_fb_nack_fci_t *fci=(rtcp_fb_nack_fci_t*)(fb+1);
+	rtcp_common_header_init(&fb->ch,session,RTCP_RTPFB,RTCP_RTPFB_NACK,size);
+	fb->packet_sender_ssrc=htonl(0x12345678);
+	fb->media_source_ssrc=htonl(session->snd.ssrc);
+	fci->pid=htons(pid);
+	fci->blp=0;
+	m->b_wptr+=size;
+	return m;
+}
+
+int main(int argc, char *argv[]){
+	RtpSocketMux *mux;
+	RtpSession *sessions[TEST_SESSIONS];
+	int socks[TEST_SESSIONS];
+	mblk_t *nack;
+	uint8_t buf[1500];
+	uint16_t seq,osn;
+	int i,port;
+
+	test_init();
+
+	mux=rtp_socket_mux_new("127.0.0.1",-1,TRUE);
+	CHECK(mux!=NULL);
+	for(i=0;i<TEST_SESSIONS;i++){
+		sessions[i]=rtp_session_new(RTP_SESSION_SENDONLY);
+		rtp_session_set_payload_type(sessions[i],0);
+		rtp_session_set_ssrc(sessions[i],0x1000+i);
+		socks[i]=test_socket_new(&port);
+		/* UDP cannot send to port 0: the packet to this one fails */
+		if (i==TEST_BAD_SESSION) port=0;
+		CHECK(rtp_socket_mux_add_session(mux,sessions[i],"127.0.0.1",port,0)==0);
+	}
+	rtp_session_enable_retransmission(sessions[TEST_RTX_SESSION],TRUE,16,TEST_RTX_PT);
+
+	CHECK(rtp_session_fanout_send_with_ts(sessions,TEST_SESSIONS,test_payload_new(),0,FALSE)==TEST_SESSIONS-1);
+	usleep(50000);
+	for(i=0;i<TEST_SESSIONS;i++){
+		if (i==TEST_BAD_SESSION){
+			CHECK(test_count_received(socks[i],0x1000+i)==0);
+			CHECK(sessions[i]->rtp.send_errno!=0);
+		}else{
+			CHECK(test_count_received(socks[i],0x1000+i)==1);
+			CHECK(sessions[i]->rtp.send_errno==0);
+		}
+	}
+
+	/* the packet asked for again goes out after the next one */
+	seq=sessions[TEST_RTX_SESSION]->rtp.snd_seq-1;
+	nack=test_make_nack(sessions[TEST_RTX_SESSION],seq);
+	rtp_session_rtx_process_nack(sessions[TEST_RTX_SESSION],nack);
+	freemsg(nack);
+	CHECK(rtp_session_fanout_send_with_ts(sessions,TEST_SESSIONS,test_payload_new(),TEST_PAYLOAD_SIZE,FALSE)==TEST_SESSIONS-1);
+	usleep(50000);
+	CHECK(recv(socks[TEST_RTX_SESSION],buf,sizeof(buf),0)==RTP_FIXED_HEADER_SIZE+TEST_PAYLOAD_SIZE);
+	CHECK(ntohs(((rtp_header_t*)buf)->seq_number)==(uint16_t)(seq+1));
+	CHECK(recv(socks[TEST_RTX_SESSION],buf,sizeof(buf),0)==RTP_FIXED_HEADER_SIZE+2+TEST_PAYLOAD_SIZE);
+	CHECK(((rtp_header_t*)buf)->paytype==TEST_RTX_PT);
+	CHECK(ntohl(((rtp_header_t*)buf)->ssrc)==rtp_session_get_retransmission_ssrc(sessions[TEST_RTX_SESSION]));
+	memcpy(&osn,buf+RTP_FIXED_HEADER_SIZE,2);
+	CHECK(ntohs(osn)==seq);
+	CHECK(buf[RTP_FIXED_HEADER_SIZE+2]==0x55);
+
+	for(i=0;i<TEST_SESSIONS;i++){
+		rtp_socket_mux_remove_session(mux,sessions[i]);
+		rtp_session_destroy(sessions[i]);
+		close(socks[i]);
+	}
+	rtp_socket_mux_destroy(mux);
+	return test_done("fanout_test");
+}
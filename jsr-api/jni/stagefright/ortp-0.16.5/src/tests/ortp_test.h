@@ -0,0 +1,50 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* what the tests of src/tests have in common: each one is a program that exits
+ with a non zero status on the first failed check, and prints "<name>: ok" on success. */
+
+#ifndef ortp_test_h
+#define ortp_test_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ortp/ortp.h"
+
+#define CHECK(cond) do{ \
+	if (!(cond)){ \
+		fprintf(stderr,"%s:%i: check failed: %s\n",__FILE__,__LINE__,#cond); \
+		exit(1); \
+	} \
+}while(0)
+
+static inline void test_init(void){
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_ERROR|ORTP_FATAL);
+}
+
+static inline int test_done(const char *name){
+	ortp_exit();
+	printf("%s: ok\n",name);
+	return 0;
+}
+
+#endif
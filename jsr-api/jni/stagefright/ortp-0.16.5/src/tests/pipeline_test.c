@@ -0,0 +1,137 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * pipeline_test checks a session attached to a RtpPipeline over loopback.
+ * The session only receives and has no remote address:
+ *
+ * - the SRTP packets it is sent are received and decrypted by the I/O
+ *   threads, and handed to the session with their payload in clear;
+ * - the RTCP packets it makes, with no remote address to send them to,
+ *   are not sent and raise no network error.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include <unistd.h>
+
+#include "ortp/ortp.h"
+#include "ortp/rtppipeline.h"
+#include "ortp/srtp.h"
+#include "ortp_test.h"
+
+#define TEST_PAYLOAD_SIZE 160
+#define TEST_PACKETS 50
+#define TEST_SSRC 0x5eed5eed
+
+static unsigned char test_key[30]={
+	0xe1,0xf9,0x7a,0x0d,0x3e,0x01,0x8b,0xe0,0xd6,0x4f,0xa3,0x2c,0x06,0xde,0x41,0x39,
+	0x0e,0xc6,0x75,0xad,0x49,0x8a,0xfe,0xeb,0xb6,0x96,0x0b,0x3a,0xab,0xe6
+};
+
+static int test_network_errors=0;
+
+static void test_on_network_error(RtpSession *session, unsigned long msg, unsigned long errnum, unsigned long user_data){
+	test_network_errors++;
+}
+
+static srtp_t test_srtp_new(void){
+	srtp_policy_t policy;
+	srtp_t srtp;
+	memset(&policy,0,sizeof(policy));
+	crypto_policy_set_rtp_default(&policy.rtp);
+	crypto_policy_set_rtcp_default(&policy.rtcp);
+	policy.ssrc.type=ssrc_specific;
+	policy.ssrc.value=TEST_SSRC;
+	policy.key=test_key;
+	policy.next=NULL;
+	CHECK(ortp_srtp_create(&srtp,&policy)==err_status_ok);
+	return srtp;
+}
+
+int main(int argc, char *argv[]){
+	RtpPipeline *pipeline;
+	RtpSession *sender,*receiver;
+	RtpTransport *srtpt,*rrtpt;
+	srtp_t ssrtp,rsrtp;
+	RtpPipelineStats stats;
+	uint8_t payload[TEST_PAYLOAD_SIZE];
+	int i,count=0;
+
+	test_init();
+	CHECK(ortp_srtp_init()==err_status_ok);
+
+	receiver=rtp_session_new(RTP_SESSION_RECVONLY);
+	rtp_session_set_payload_type(receiver,0);
+	rtp_session_enable_adaptive_jitter_compensation(receiver,FALSE);
+	rtp_session_set_jitter_compensation(receiver,0);
+	CHECK(rtp_session_set_local_addr(receiver,"127.0.0.1",-1)==0);
+	rtp_session_signal_connect(receiver,"network_error",(RtpCallback)test_on_network_error,0);
+	rsrtp=test_srtp_new();
+	srtp_transport_new(rsrtp,&rrtpt,NULL);
+	rtp_session_set_transports(receiver,rrtpt,NULL);
+
+	sender=rtp_session_new(RTP_SESSION_SENDONLY);
+	rtp_session_set_payload_type(sender,0);
+	rtp_session_set_ssrc(sender,TEST_SSRC);
+	CHECK(rtp_session_set_local_addr(sender,"127.0.0.1",-1)==0);
+	CHECK(rtp_session_set_remote_addr(sender,"127.0.0.1",rtp_session_get_local_port(receiver))==0);
+	ssrtp=test_srtp_new();
+	srtp_transport_new(ssrtp,&srtpt,NULL);
+	rtp_session_set_transports(sender,srtpt,NULL);
+
+	pipeline=rtp_pipeline_new(2);
+	CHECK(pipeline!=NULL);
+	CHECK(rtp_pipeline_add_session(pipeline,receiver)==0);
+
+	/* receive and decrypt on the I/O threads */
+	for(i=0;i<TEST_PACKETS;i++){
+		memset(payload,i,sizeof(payload));
+		CHECK(rtp_session_send_with_ts(sender,payload,sizeof(payload),i*TEST_PAYLOAD_SIZE)>0);
+	}
+	usleep(100000);
+	for(i=0;i<TEST_PACKETS;i++){
+		mblk_t *mp=rtp_session_recvm_with_ts(receiver,i*TEST_PAYLOAD_SIZE);
+		unsigned char *data;
+		if (mp==NULL) continue;
+		CHECK(rtp_get_payload(mp,&data)==TEST_PAYLOAD_SIZE);
+		CHECK(data[0]==i && data[TEST_PAYLOAD_SIZE-1]==i);
+		freemsg(mp);
+		count++;
+	}
+	CHECK(count==TEST_PACKETS);
+	rtp_pipeline_get_stats(pipeline,&stats);
+	CHECK(stats.received>=TEST_PACKETS);
+	CHECK(stats.delivered==stats.received);
+	CHECK(stats.recv_errors==0);
+
+	/* no remote address: the RTCP packets stay here */
+	rtp_session_send_rtcp_APP(receiver,0,"test",(const uint8_t*)"data",4);
+	CHECK(test_network_errors==0);
+
+	rtp_pipeline_remove_session(pipeline,receiver);
+	rtp_pipeline_destroy(pipeline);
+	rtp_session_destroy(sender);
+	rtp_session_destroy(receiver);
+	srtp_transport_destroy(srtpt);
+	srtp_transport_destroy(rrtpt);
+	ortp_srtp_dealloc(ssrtp);
+	ortp_srtp_dealloc(rsrtp);
+	return test_done("pipeline_test");
+}
@@ -0,0 +1,231 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * retransmit_test checks the NACK (RFC4585) and RTX (RFC4588) machinery
+ * between two sessions connected by transports that keep what is sent in a
+ * queue, so that packets can be dropped and handed over in any order:
+ *
+ * - the receiver sends one NACK for two consecutive lost packets;
+ * - the sender answers it with two RTX packets, queued until its next packet
+ *   is sent, and cannot answer for a packet that left its ring;
+ * - the receiver turns the RTX packets back into the original ones.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include "ortp/ortp.h"
+#include "rtpsession_priv.h"
+#include "ortp_test.h"
+
+#define TEST_PAYLOAD_SIZE 160
+#define TEST_PACKETS 20
+#define TEST_RING 16
+#define TEST_RTX_PT 97
+#define TEST_LOST 17	/* TEST_LOST and TEST_LOST+1 are lost */
+
+typedef struct _TestLeg{
+	RtpTransport tr;
+	queue_t q;
+} TestLeg;
+
+static ortp_socket_t test_getsocket(RtpTransport *t){
+	return -1;
+}
+
+/* keeps a copy of the packet, in one block */
+static int test_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	TestLeg *leg=(TestLeg*)t->data;
+	mblk_t *copy=copymsg(m);
+	msgpullup(copy,-1);
+	putq(&leg->q,copy);
+	return msgdsize(m);
+}
+
+static int test_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	TestLeg *leg=(TestLeg*)t->data;
+	struct sockaddr_in *sin=(struct sockaddr_in*)from;
+	mblk_t *p=getq(&leg->q);
+	int len;
+
+	if (p==NULL) return 0;
+	len=p->b_wptr-p->b_rptr;
+	memcpy(m->b_wptr,p->b_rptr,len);
+	freemsg(p);
+	memset(sin,0,sizeof(*sin));
+	sin->sin_family=AF_INET;
+	sin->sin_port=htons(5004);
+	sin->sin_addr.s_addr=htonl(0x0a000001);
+	*fromlen=sizeof(*sin);
+	return len;
+}
+
+static void test_leg_init(TestLeg *leg){
+	memset(leg,0,sizeof(*leg));
+	leg->tr.data=leg;
+	leg->tr.t_getsocket=test_getsocket;
+	leg->tr.t_sendto=test_sendto;
+	leg->tr.t_recvfrom=test_recvfrom;
+	qinit(&leg->q);
+}
+
+static void test_send(RtpSession *sender, int i){
+	uint8_t payload[TEST_PAYLOAD_SIZE];
+	memset(payload,i,sizeof(payload));
+	CHECK(rtp_session_send_with_ts(sender,payload,sizeof(payload),i*TEST_PAYLOAD_SIZE)>0);
+}
+
+static uint16_t test_seq(mblk_t *m){
+	return ntohs(((rtp_header_t*)m->b_rptr)->seq_number);
+}
+
+/* looks for the NACK in the RTCP compound packets sent by the receiver */
+static mblk_t *test_find_nack(queue_t *q){
+	mblk_t *m;
+	while((m=getq(q))!=NULL){
+		do{
+			if (rtcp_is_RTPFB(m) && rtcp_RTPFB_get_type(m)==RTCP_RTPFB_NACK) return m;
+		}while(rtcp_next_packet(m));
+		freemsg(m);
+	}
+	return NULL;
+}
+
+/* a NACK of the sender stream for one packet and the following ones in blp */
+static mblk_t *test_make_nack(RtpSession *sender, uint16_t pid, uint16_t blp){
+	int size=sizeof(rtcp_fb_header_t)+sizeof(rtcp_fb_nack_fci_t);
+	mblk_t *m=allocb(size,0);
+	rtcp_fb_header_t *fb=(rtcp_fb_header_t*)m->b_wptr;
+	rtcp_fb_nack_fci_t *fci=(rtcp_fb_nack_fci_t*)(fb+1);
+	rtcp_common_header_init(&fb->ch,sender,RTCP_RTPFB,RTCP_RTPFB_NACK,size);
+	fb->packet_sender_ssrc=htonl(0x12345678);
+	fb->media_source_ssrc=htonl(sender->snd.ssrc);
+	fci->pid=htons(pid);
+	fci->blp=htons(blp);
+	m->b_wptr+=size;
+	return m;
+}
+
+int main(int argc, char *argv[]){
+	RtpSession *sender,*receiver;
+	TestLeg srtp,rrtp,rrtcp;
+	RtpRetransmissionStats stats;
+	mblk_t *sent[TEST_PACKETS+1];
+	mblk_t *m,*nack;
+	const rtcp_fb_nack_fci_t *fci;
+	uint16_t seq0,osn;
+	int i;
+
+	test_init();
+
+	test_leg_init(&srtp);
+	test_leg_init(&rrtp);
+	test_leg_init(&rrtcp);
+	sender=rtp_session_new(RTP_SESSION_SENDONLY);
+	rtp_session_set_payload_type(sender,0);
+	rtp_session_set_transports(sender,&srtp.tr,NULL);
+	rtp_session_enable_retransmission(sender,TRUE,TEST_RING,TEST_RTX_PT);
+	receiver=rtp_session_new(RTP_SESSION_RECVONLY);
+	rtp_session_set_payload_type(receiver,0);
+	rtp_session_enable_adaptive_jitter_compensation(receiver,FALSE);
+	rtp_session_set_jitter_compensation(receiver,0);
+	rtp_session_set_transports(receiver,&rrtp.tr,&rrtcp.tr);
+	rtp_session_enable_nack(receiver,TRUE,TEST_RTX_PT,0);
+
+	for(i=0;i<TEST_PACKETS;i++){
+		test_send(sender,i);
+		sent[i]=getq(&srtp.q);
+		CHECK(sent[i]!=NULL);
+	}
+	seq0=test_seq(sent[0]);
+	for(i=0;i<TEST_PACKETS;i++){
+		if (i==TEST_LOST || i==TEST_LOST+1) continue;
+		putq(&rrtp.q,dupmsg(sent[i]));
+	}
+	rtp_session_rtp_recv(receiver,0);
+
+	/* NACK generation: one FCI for the two lost packets */
+	rtp_session_nack_process(receiver);
+	nack=test_find_nack(&rrtcp.q);
+	CHECK(nack!=NULL);
+	fci=rtcp_RTPFB_NACK_get_fci(nack,0);
+	CHECK(fci!=NULL);
+	CHECK(ntohs(fci->pid)==(uint16_t)(seq0+TEST_LOST));
+	CHECK(ntohs(fci->blp)==1);
+	CHECK(rtcp_RTPFB_NACK_get_fci(nack,1)==NULL);
+	/* not asked for again before a round trip delay */
+	rtp_session_nack_process(receiver);
+	CHECK(test_find_nack(&rrtcp.q)==NULL);
+	rtp_session_get_retransmission_stats(receiver,&stats);
+	CHECK(stats.nack_sent==1);
+
+	/* the RTX ring: the retransmissions wait for the next packet sent */
+	rtp_session_rtx_process_nack(sender,nack);
+	CHECK(srtp.q.q_mcount==0);
+	test_send(sender,TEST_PACKETS);
+	sent[TEST_PACKETS]=getq(&srtp.q);
+	CHECK(sent[TEST_PACKETS]!=NULL && test_seq(sent[TEST_PACKETS])==(uint16_t)(seq0+TEST_PACKETS));
+	CHECK(srtp.q.q_mcount==2);
+	for(i=0;i<2;i++){
+		rtp_header_t *rtp;
+		m=getq(&srtp.q);
+		rtp=(rtp_header_t*)m->b_rptr;
+		CHECK(rtp->paytype==TEST_RTX_PT);
+		CHECK(ntohl(rtp->ssrc)==rtp_session_get_retransmission_ssrc(sender));
+		CHECK(m->b_wptr-m->b_rptr==RTP_FIXED_HEADER_SIZE+2+TEST_PAYLOAD_SIZE);
+		memcpy(&osn,m->b_rptr+RTP_FIXED_HEADER_SIZE,2);
+		CHECK(ntohs(osn)==(uint16_t)(seq0+TEST_LOST+i));
+		CHECK(memcmp(m->b_rptr+RTP_FIXED_HEADER_SIZE+2,sent[TEST_LOST+i]->b_rptr+RTP_FIXED_HEADER_SIZE,TEST_PAYLOAD_SIZE)==0);
+		putq(&rrtp.q,m);
+	}
+	/* the first packet was overwritten in the ring by the TEST_RING-th one */
+	freemsg(nack);
+	nack=test_make_nack(sender,seq0,0);
+	rtp_session_rtx_process_nack(sender,nack);
+	freemsg(nack);
+	rtp_session_get_retransmission_stats(sender,&stats);
+	CHECK(stats.nack_received==2);
+	CHECK(stats.retransmitted==2);
+	CHECK(stats.not_found==1);
+
+	/* RTX unwrapping: the receiver gets the original packets back */
+	rtp_session_rtp_recv(receiver,0);
+	rtp_session_get_retransmission_stats(receiver,&stats);
+	CHECK(stats.recovered==2);
+	for(i=0;i<TEST_PACKETS;i++){
+		unsigned char *payload;
+		rtp_header_t *rtp;
+		m=rtp_session_recvm_with_ts(receiver,i*TEST_PAYLOAD_SIZE);
+		CHECK(m!=NULL);
+		rtp=(rtp_header_t*)m->b_rptr;
+		CHECK(rtp->seq_number==(uint16_t)(seq0+i));
+		CHECK(rtp->paytype==0);
+		CHECK(rtp->ssrc==sender->snd.ssrc);
+		CHECK(rtp_get_payload(m,&payload)==TEST_PAYLOAD_SIZE);
+		CHECK(payload[0]==i && payload[TEST_PAYLOAD_SIZE-1]==i);
+		freemsg(m);
+	}
+
+	for(i=0;i<=TEST_PACKETS;i++) freemsg(sent[i]);
+	rtp_session_destroy(sender);
+	rtp_session_destroy(receiver);
+	flushq(&rrtp.q,FLUSHALL);
+	flushq(&rrtcp.q,FLUSHALL);
+	return test_done("retransmit_test");
+}
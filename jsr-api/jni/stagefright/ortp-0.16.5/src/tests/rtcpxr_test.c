@@ -0,0 +1,187 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * rtcpxr_test checks the RTCP XR (RFC3611) measurements of the incoming
+ * stream and the processing of the received reports:
+ *
+ * - a known loss pattern gives the burst/gap densities and durations of the
+ *   model of RFC3611 appendix A.2;
+ * - the VoIP Metrics block sent carries them to the remote party;
+ * - a restart of the sequence, or a new source, is not counted as losses;
+ * - the round trip delay is taken from the report block of our stream, in
+ *   whatever position it is in the report.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include <math.h>
+
+#include "ortp/ortp.h"
+#include "rtpsession_priv.h"
+#include "ortp_test.h"
+
+#define TEST_PAYLOAD_SIZE 160	/* 20ms at 8000Hz */
+#define TEST_SSRC 0x5eed5eed
+#define TEST_OTHER_SSRC 0x0ddba11
+#define TEST_RTT 6553	/* about 100ms, in 1/65536 seconds */
+
+#define TEST_CLOSE(a,b) (fabs((a)-(b))<0.0001)
+
+static RtpSession *test_session_new(void){
+	RtpSession *session=rtp_session_new(RTP_SESSION_SENDRECV);
+	rtp_session_set_payload_type(session,0);
+	return session;
+}
+
+static void test_receive(RtpSession *session, int first, int last){
+	int i;
+	for(i=first;i<=last;i++)
+		rtp_session_rtcp_xr_new_packet(session,(uint16_t)i,i*TEST_PAYLOAD_SIZE);
+}
+
+/* parses a RTP packet as if it had just been received */
+static void test_parse(RtpSession *session, uint32_t ssrc, uint16_t seq){
+	mblk_t *mp=allocb(RTP_FIXED_HEADER_SIZE+TEST_PAYLOAD_SIZE,0);
+	rtp_header_t *rtp=(rtp_header_t*)mp->b_wptr;
+	struct sockaddr_in sin;
+
+	memset(mp->b_wptr,0,RTP_FIXED_HEADER_SIZE+TEST_PAYLOAD_SIZE);
+	rtp->version=2;
+	rtp->paytype=0;
+	rtp->seq_number=htons(seq);
+	rtp->timestamp=htonl(seq*TEST_PAYLOAD_SIZE);
+	rtp->ssrc=htonl(ssrc);
+	mp->b_wptr+=RTP_FIXED_HEADER_SIZE+TEST_PAYLOAD_SIZE;
+	memset(&sin,0,sizeof(sin));
+	sin.sin_family=AF_INET;
+	rtp_session_rtp_parse(session,mp,0,(struct sockaddr*)&sin,sizeof(sin));
+}
+
+/* middle 32 bits of the current NTP time, the unit of LSR and DLSR */
+static uint32_t test_ntp_middle(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return ((uint32_t)(tv.tv_sec + 0x83AA7E80)<<16) | (uint32_t)((((uint64_t)tv.tv_usec)<<16)/1000000);
+}
+
+/* a RR from a session receiving two sources, ours in the second block */
+static mblk_t *test_make_rr(RtpSession *session){
+	int size=sizeof(rtcp_rr_t)+sizeof(report_block_t);
+	mblk_t *m=allocb(size,0);
+	rtcp_rr_t *rr=(rtcp_rr_t*)m->b_wptr;
+
+	memset(rr,0,size);
+	rtcp_common_header_init(&rr->ch,session,RTCP_RR,2,size);
+	rr->ssrc=htonl(TEST_OTHER_SSRC);
+	rr->rb[0].ssrc=htonl(TEST_OTHER_SSRC+1);
+	rr->rb[0].lsr=htonl(1);
+	rr->rb[1].ssrc=htonl(session->snd.ssrc);
+	rr->rb[1].lsr=htonl(test_ntp_middle()-TEST_RTT);
+	rr->rb[1].delay_snc_last_sr=0;
+	m->b_wptr+=size;
+	return m;
+}
+
+int main(int argc, char *argv[]){
+	RtpSession *receiver,*sender;
+	RtpQualityMetrics q;
+	mblk_t *m;
+	int i;
+
+	test_init();
+
+	/*
+	 * received 0-99, lost 100, received 101-149, lost 150, received 151,
+	 * lost 152-153, received 154-253: with Gmin=16, one isolated loss in the
+	 * gap (c14=1), one burst of three losses around one received packet
+	 * (c13=1 c23=1 c33=1), and c11=249 packets received in the gap.
+	 */
+	receiver=test_session_new();
+	test_receive(receiver,0,99);
+	test_receive(receiver,101,149);
+	test_receive(receiver,151,151);
+	test_receive(receiver,154,253);
+	rtp_session_get_quality_metrics(receiver,&q);
+	CHECK(TEST_CLOSE(q.loss_rate,4.0/254));
+	/* c14/(c11+c14) */
+	CHECK(TEST_CLOSE(q.gap_density,1.0/250));
+	/* p23=1, p32=c23/(c13+c23+c33)=1/3: p23/(p23+p32) */
+	CHECK(TEST_CLOSE(q.burst_density,0.75));
+	/* (c11+c14+c13)/c13 packets of 20ms, then the rest of the 255 transitions */
+	CHECK(q.gap_duration==5020);
+	CHECK(q.burst_duration==80);
+	CHECK(q.lost_packets==4);
+
+	/* the VoIP Metrics block brings them to the sender */
+	sender=test_session_new();
+	rtp_session_set_ssrc(sender,TEST_SSRC);
+	receiver->rcv.ssrc=TEST_SSRC;
+	CHECK(!rtp_session_get_remote_quality_metrics(sender,&q));
+	m=rtp_session_create_rtcp_xr_packet(receiver);
+	CHECK(rtcp_is_XR(m));
+	rtp_session_rtcp_xr_parse(sender,m);
+	freemsg(m);
+	CHECK(rtp_session_get_remote_quality_metrics(sender,&q));
+	CHECK(TEST_CLOSE(q.burst_density,192/256.0));
+	CHECK(TEST_CLOSE(q.gap_density,1/256.0));
+	CHECK(q.gap_duration==5020);
+	CHECK(q.burst_duration==80);
+	CHECK(q.lost_packets==4);
+	/* a new report interval starts */
+	rtp_session_get_quality_metrics(receiver,&q);
+	CHECK(q.lost_packets==0);
+	rtp_session_destroy(sender);
+	rtp_session_destroy(receiver);
+
+	/* the sender restarts its sequence far away */
+	receiver=test_session_new();
+	test_receive(receiver,0,9);
+	test_receive(receiver,10000,10009);
+	rtp_session_get_quality_metrics(receiver,&q);
+	CHECK(q.loss_rate==0);
+	CHECK(q.lost_packets==0);
+	rtp_session_destroy(receiver);
+
+	/* a new source has a sequence of its own, even close to the old one */
+	receiver=test_session_new();
+	rtp_session_enable_adaptive_jitter_compensation(receiver,FALSE);
+	rtp_session_set_ssrc_changed_threshold(receiver,0);
+	for(i=0;i<10;i++) test_parse(receiver,TEST_SSRC,(uint16_t)i);
+	for(i=0;i<10;i++) test_parse(receiver,TEST_OTHER_SSRC,(uint16_t)(1000+i));
+	CHECK(receiver->rcv.ssrc==TEST_OTHER_SSRC);
+	rtp_session_get_quality_metrics(receiver,&q);
+	CHECK(q.loss_rate==0);
+	CHECK(q.lost_packets==0);
+	rtp_session_destroy(receiver);
+
+	/* the round trip delay, from the second report block */
+	sender=test_session_new();
+	rtp_session_set_ssrc(sender,TEST_SSRC);
+	rtp_session_get_quality_metrics(sender,&q);
+	CHECK(q.round_trip_delay==-1);
+	m=test_make_rr(sender);
+	rtp_session_rtcp_process_incoming(sender,m);
+	freemsg(m);
+	rtp_session_get_quality_metrics(sender,&q);
+	CHECK(q.round_trip_delay>=99 && q.round_trip_delay<200);
+	rtp_session_destroy(sender);
+
+	return test_done("rtcpxr_test");
+}
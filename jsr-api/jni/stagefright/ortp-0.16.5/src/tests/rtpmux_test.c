@@ -0,0 +1,141 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * rtpmux_test checks the demultiplexing done by RtpSocketMux over loopback:
+ *
+ * - two sessions attached to one shared socket, fed by two senders with
+ *   different SSRCs, each receive their own stream and nothing else;
+ * - after the remote address of one of them is changed, it receives the
+ *   stream of the new remote, and nothing more from the old one;
+ * - when the remote of the other one changes its SSRC, the packets are still
+ *   routed to it, and it switches to the new SSRC as it would on its own socket.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include <unistd.h>
+
+#include "ortp/ortp.h"
+#include "ortp/rtpmux.h"
+#include "ortp_test.h"
+
+#define TEST_PAYLOAD_SIZE 160
+#define TEST_PACKETS 20
+#define TEST_SSRC_THRES 5
+
+static RtpSession *test_sender_new(uint32_t ssrc, int mux_port){
+	RtpSession *s=rtp_session_new(RTP_SESSION_SENDONLY);
+	rtp_session_set_payload_type(s,0);
+	rtp_session_set_ssrc(s,ssrc);
+	CHECK(rtp_session_set_local_addr(s,"127.0.0.1",-1)==0);
+	CHECK(rtp_session_set_remote_addr(s,"127.0.0.1",mux_port)==0);
+	return s;
+}
+
+static RtpSession *test_receiver_new(RtpSocketMux *mux, RtpSession *sender){
+	RtpSession *s=rtp_session_new(RTP_SESSION_RECVONLY);
+	rtp_session_set_payload_type(s,0);
+	rtp_session_enable_adaptive_jitter_compensation(s,FALSE);
+	rtp_session_set_jitter_compensation(s,0);
+	CHECK(rtp_socket_mux_add_session(mux,s,"127.0.0.1",rtp_session_get_local_port(sender),0)==0);
+	return s;
+}
+
+static void test_send(RtpSession *sender, uint8_t fill, uint32_t ts){
+	uint8_t payload[TEST_PAYLOAD_SIZE];
+	int i;
+	memset(payload,fill,sizeof(payload));
+	for(i=0;i<TEST_PACKETS;i++)
+		CHECK(rtp_session_send_with_ts(sender,payload,sizeof(payload),ts+i*TEST_PAYLOAD_SIZE)>0);
+}
+
+/* reads what the session has up to timestamp ts_end, checking every packet comes from ssrc */
+static int test_receive(RtpSession *receiver, uint32_t ssrc, uint8_t fill, uint32_t ts, uint32_t ts_end){
+	int count=0;
+	for(;ts<=ts_end;ts+=TEST_PAYLOAD_SIZE){
+		mblk_t *mp=rtp_session_recvm_with_ts(receiver,ts);
+		unsigned char *payload;
+		if (mp==NULL) continue;
+		CHECK(ntohl(((rtp_header_t*)mp->b_rptr)->ssrc)==ssrc);
+		CHECK(rtp_get_payload(mp,&payload)==TEST_PAYLOAD_SIZE);
+		CHECK(payload[0]==fill && payload[TEST_PAYLOAD_SIZE-1]==fill);
+		freemsg(mp);
+		count++;
+	}
+	return count;
+}
+
+int main(int argc, char *argv[]){
+	RtpSocketMux *mux;
+	RtpSession *s1,*s2,*s3,*ra,*rb;
+	const RtpSocketMuxStats *stats;
+	uint32_t end=(TEST_PACKETS-1)*TEST_PAYLOAD_SIZE;
+	uint32_t ts2=TEST_PACKETS*TEST_PAYLOAD_SIZE*2;
+	uint32_t ts3=TEST_PACKETS*TEST_PAYLOAD_SIZE*4;
+
+	test_init();
+
+	mux=rtp_socket_mux_new("127.0.0.1",-1,TRUE);
+	CHECK(mux!=NULL);
+	s1=test_sender_new(0x11111111,rtp_socket_mux_get_local_port(mux));
+	s2=test_sender_new(0x22222222,rtp_socket_mux_get_local_port(mux));
+	s3=test_sender_new(0x33333333,rtp_socket_mux_get_local_port(mux));
+	ra=test_receiver_new(mux,s1);
+	rb=test_receiver_new(mux,s2);
+
+	/* two streams interleaved on the shared socket */
+	test_send(s1,'a',0);
+	test_send(s2,'b',0);
+	usleep(50000);
+	CHECK(test_receive(ra,0x11111111,'a',0,end)==TEST_PACKETS);
+	CHECK(test_receive(rb,0x22222222,'b',0,end)==TEST_PACKETS);
+	stats=rtp_socket_mux_get_stats(mux);
+	CHECK(stats->dispatched==2*TEST_PACKETS);
+	CHECK(stats->unmatched==0);
+
+	/* rb now talks to s3: its entry must follow, and s2 is not routed to it anymore */
+	CHECK(rtp_session_set_remote_addr(rb,"127.0.0.1",rtp_session_get_local_port(s3))==0);
+	rtp_session_reset(rb);
+	test_send(s2,'b',ts2);
+	test_send(s3,'c',ts2);
+	usleep(50000);
+	CHECK(test_receive(rb,0x33333333,'c',ts2,ts2+end)==TEST_PACKETS);
+	CHECK(stats->unmatched==TEST_PACKETS);
+	CHECK(test_receive(ra,0x11111111,'a',ts2,ts2+end)==0);
+
+	/* s1 changes its SSRC: ra drops the first packets, then follows the new one */
+	rtp_session_set_ssrc_changed_threshold(ra,TEST_SSRC_THRES);
+	rtp_session_set_ssrc(s1,0x44444444);
+	test_send(s1,'d',ts3);
+	usleep(50000);
+	CHECK(test_receive(ra,0x44444444,'d',ts3,ts3+end)==TEST_PACKETS-TEST_SSRC_THRES);
+	CHECK(stats->unmatched==TEST_PACKETS);
+	CHECK(stats->dispatched==4*TEST_PACKETS);
+
+	rtp_socket_mux_remove_session(mux,ra);
+	rtp_socket_mux_remove_session(mux,rb);
+	rtp_socket_mux_destroy(mux);
+	rtp_session_destroy(ra);
+	rtp_session_destroy(rb);
+	rtp_session_destroy(s1);
+	rtp_session_destroy(s2);
+	rtp_session_destroy(s3);
+	return test_done("rtpmux_test");
+}
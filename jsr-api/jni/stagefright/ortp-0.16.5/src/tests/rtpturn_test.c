@@ -0,0 +1,426 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * rtpturn_test checks sessions relayed by a RtpTurnManager, the test playing
+ * the TURN server on a loopback socket:
+ *
+ * - the ChannelBind requests are sent again with the nonce of a 401
+ *   Unauthorized, then of a 438 Stale Nonce answer, which later requests
+ *   reuse;
+ * - until the channel is bound, packets go in Send indications, and the
+ *   data of Data indications is received;
+ * - then packets go in ChannelData messages, whose header is stripped on
+ *   receive; messages for another channel, longer than their datagram or
+ *   not from the server are dropped;
+ * - refreshes due within the round window are sent in the same round;
+ * - a session with SRTP transports keeps them under the relay.
+ *
+ * It exits with a non zero status on the first failed check.
+ */
+
+#include "ortp/ortp.h"
+#include "ortp/rtpturn.h"
+#include "ortp/stun.h"
+#include "ortp/srtp.h"
+#include "rtpsession_priv.h"
+#include "ortp_test.h"
+
+#define TEST_PEER_PORT 5004
+#define TEST_PAYLOAD_SIZE 160
+#define TEST_PACKET_SIZE (RTP_FIXED_HEADER_SIZE+TEST_PAYLOAD_SIZE)
+#define TEST_SRTP_TAG_SIZE 10
+#define TEST_SSRC 0x5eed5eed
+#define TEST_METHOD(type) ((type)&0x3EEF)
+
+static unsigned char test_key[30]={
+	0xe1,0xf9,0x7a,0x0d,0x3e,0x01,0x8b,0xe0,0xd6,0x4f,0xa3,0x2c,0x06,0xde,0x41,0x39,
+	0x0e,0xc6,0x75,0xad,0x49,0x8a,0xfe,0xeb,0xb6,0x96,0x0b,0x3a,0xab,0xe6
+};
+
+static ortp_socket_t test_server;
+static struct sockaddr_in test_server_addr;
+
+/* the channels bound by the requests received, by the local port they came from */
+typedef struct _TestChannel{
+	int port;
+	uint16_t number;
+} TestChannel;
+
+static TestChannel test_channels[8];
+static int test_nchannels=0;
+
+static void test_server_init(void){
+	socklen_t len=sizeof(test_server_addr);
+	struct timeval tv={1,0};
+
+	test_server=socket(AF_INET,SOCK_DGRAM,0);
+	CHECK(test_server>=0);
+	memset(&test_server_addr,0,sizeof(test_server_addr));
+	test_server_addr.sin_family=AF_INET;
+	test_server_addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+	CHECK(bind(test_server,(struct sockaddr*)&test_server_addr,sizeof(test_server_addr))==0);
+	CHECK(getsockname(test_server,(struct sockaddr*)&test_server_addr,&len)==0);
+	setsockopt(test_server,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+}
+
+static uint16_t test_channel_of(int port){
+	int i;
+	for(i=0;i<test_nchannels;i++)
+		if (test_channels[i].port==port) return test_channels[i].number;
+	return 0;
+}
+
+static struct sockaddr_in test_local_addr(int port){
+	struct sockaddr_in sin;
+	memset(&sin,0,sizeof(sin));
+	sin.sin_family=AF_INET;
+	sin.sin_port=htons(port);
+	sin.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+	return sin;
+}
+
+/* the next datagram sent to the server */
+static int test_server_recv(uint8_t *buf, int size, struct sockaddr_in *from){
+	socklen_t fromlen=sizeof(*from);
+	int n=recvfrom(test_server,(char*)buf,size,0,(struct sockaddr*)from,&fromlen);
+	CHECK(n>0);
+	return n;
+}
+
+static void test_server_recv_request(StunMessage *req, struct sockaddr_in *from){
+	char buf[STUN_MAX_MESSAGE_SIZE];
+	int n=test_server_recv((uint8_t*)buf,sizeof(buf),from);
+	memset(req,0,sizeof(*req));
+	CHECK(stunParseMessage(buf,n,req));
+	CHECK(STUN_IS_REQUEST(req->msgHdr.msgType));
+	if (TEST_METHOD(req->msgHdr.msgType)==TURN_METHOD_CHANNELBIND){
+		int port=ntohs(from->sin_port);
+		CHECK(req->hasChannelNumberAttributes && req->hasXorPeerAddress);
+		if (test_channel_of(port)==0){
+			test_channels[test_nchannels].port=port;
+			test_channels[test_nchannels].number=req->channelNumberAttributes.channelNumber;
+			test_nchannels++;
+		}
+		CHECK(test_channel_of(port)==req->channelNumberAttributes.channelNumber);
+	}
+}
+
+static void test_server_send(const void *buf, int len, const struct sockaddr_in *to){
+	CHECK(sendto(test_server,buf,len,0,(const struct sockaddr*)to,sizeof(*to))==len);
+}
+
+/* answers a request with success (code 0), or with an error and a new nonce */
+static void test_server_reply(const StunMessage *req, const struct sockaddr_in *to, int code, const char *nonce){
+	StunMessage resp;
+	char buf[STUN_MAX_MESSAGE_SIZE];
+	int len;
+
+	memset(&resp,0,sizeof(resp));
+	resp.msgHdr=req->msgHdr;
+	if (code==0){
+		resp.msgHdr.msgType=TEST_METHOD(req->msgHdr.msgType)|STUN_SUCCESS_RESP;
+		if (TEST_METHOD(req->msgHdr.msgType)==TURN_METHOD_REFRESH){
+			resp.hasLifetimeAttributes=TRUE;
+			resp.lifetimeAttributes.lifetime=600;
+		}
+	}else{
+		resp.msgHdr.msgType=TEST_METHOD(req->msgHdr.msgType)|STUN_ERR_RESP;
+		resp.hasErrorCode=TRUE;
+		resp.errorCode.errorClass=code/100;
+		resp.errorCode.number=code%100;
+		strcpy(resp.errorCode.reason,"Try again");
+		resp.errorCode.sizeReason=strlen(resp.errorCode.reason);
+		resp.hasRealm=TRUE;
+		strcpy(resp.realmName.value,"test");
+		resp.realmName.sizeValue=strlen(resp.realmName.value);
+		resp.hasNonce=TRUE;
+		strcpy(resp.nonceName.value,nonce);
+		resp.nonceName.sizeValue=strlen(nonce);
+	}
+	len=stunEncodeMessage(&resp,buf,sizeof(buf),NULL);
+	test_server_send(buf,len,to);
+}
+
+static bool_t test_has_nonce(const StunMessage *req, const char *nonce){
+	return req->hasNonce && req->hasUsername && req->hasMessageIntegrity
+		&& req->nonceName.sizeValue==strlen(nonce) && memcmp(req->nonceName.value,nonce,strlen(nonce))==0;
+}
+
+/* receives n requests of the given method and answers them */
+static void test_server_answer(int n, int method, int code, const char *nonce, const char *expected_nonce){
+	int i;
+	for(i=0;i<n;i++){
+		StunMessage req;
+		struct sockaddr_in from;
+		test_server_recv_request(&req,&from);
+		CHECK(TEST_METHOD(req.msgHdr.msgType)==method);
+		if (expected_nonce!=NULL) CHECK(test_has_nonce(&req,expected_nonce));
+		else CHECK(!req.hasNonce);
+		test_server_reply(&req,&from,code,nonce);
+	}
+}
+
+static int test_make_rtp(uint8_t *buf, uint16_t seq){
+	rtp_header_t *rtp=(rtp_header_t*)buf;
+	memset(buf,0,TEST_PACKET_SIZE);
+	rtp->version=2;
+	rtp->paytype=0;
+	rtp->seq_number=htons(seq);
+	rtp->timestamp=htonl(seq*TEST_PAYLOAD_SIZE);
+	rtp->ssrc=htonl(0x12345678);
+	memset(buf+RTP_FIXED_HEADER_SIZE,seq,TEST_PAYLOAD_SIZE);
+	return TEST_PACKET_SIZE;
+}
+
+/* a ChannelData message carrying a RTP packet, its length field claiming extra bytes more */
+static int test_make_channel_data(uint8_t *buf, uint16_t number, uint16_t seq, int extra, int padding){
+	int len=test_make_rtp(buf+4,seq);
+	buf[0]=number>>8;
+	buf[1]=number&0xFF;
+	buf[2]=(len+extra)>>8;
+	buf[3]=(len+extra)&0xFF;
+	memset(buf+4+len,0,padding);
+	return 4+len+padding;
+}
+
+static void test_send(RtpSession *session, int i){
+	uint8_t payload[TEST_PAYLOAD_SIZE];
+	memset(payload,i,sizeof(payload));
+	CHECK(rtp_session_send_with_ts(session,payload,sizeof(payload),i*TEST_PAYLOAD_SIZE)>0);
+}
+
+/* the server answers arrive on the RTP and RTCP sockets of the session */
+static void test_session_recv(RtpSession *session){
+	rtp_session_rtp_recv(session,0);
+	rtp_session_rtcp_recv(session);
+}
+
+static void test_check_recv(RtpSession *session, int i){
+	mblk_t *mp=rtp_session_recvm_with_ts(session,i*TEST_PAYLOAD_SIZE);
+	unsigned char *payload;
+	CHECK(mp!=NULL);
+	CHECK(rtp_get_seqnumber(mp)==i);
+	CHECK(rtp_get_payload(mp,&payload)==TEST_PAYLOAD_SIZE);
+	CHECK(payload[0]==i && payload[TEST_PAYLOAD_SIZE-1]==i);
+	freemsg(mp);
+}
+
+static RtpSession *test_session_new(void){
+	RtpSession *session=rtp_session_new(RTP_SESSION_SENDRECV);
+	rtp_session_set_payload_type(session,0);
+	rtp_session_enable_adaptive_jitter_compensation(session,FALSE);
+	rtp_session_set_jitter_compensation(session,0);
+	/* no compound reports in the middle of the exchanges with the server */
+	rtp_session_enable_rtcp(session,FALSE);
+	CHECK(rtp_session_set_local_addr(session,"127.0.0.1",-1)==0);
+	CHECK(rtp_session_set_remote_addr(session,"127.0.0.1",TEST_PEER_PORT)==0);
+	return session;
+}
+
+static uint64_t test_now_ms(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+static int test_dummy_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	return msgdsize(m);
+}
+
+int main(int argc, char *argv[]){
+	RtpTurnManager *mgr;
+	RtpSession *session,*other,*secure;
+	RtpTurnStats stats;
+	RtpTransport dummy,*srtpt,*srtcpt;
+	srtp_policy_t policy;
+	srtp_t sender,receiver;
+	StunMessage msg;
+	struct sockaddr_in from,rtpaddr;
+	uint8_t buf[STUN_MAX_MESSAGE_SIZE];
+	uint64_t now;
+	uint16_t number;
+	int n,port;
+	ortp_socket_t stranger;
+
+	test_init();
+	CHECK(ortp_srtp_init()==err_status_ok);
+	test_server_init();
+	mgr=rtp_turn_manager_new("127.0.0.1",ntohs(test_server_addr.sin_port),"user","secret");
+	CHECK(mgr!=NULL);
+
+	session=test_session_new();
+	port=rtp_session_get_local_port(session);
+	rtpaddr=test_local_addr(port);
+	CHECK(rtp_turn_manager_add_session(mgr,session)==0);
+	CHECK(rtp_turn_manager_add_session(mgr,session)==-1);
+
+	/* the ChannelBind requests, RTP and RTCP, are challenged */
+	test_server_answer(2,TURN_METHOD_CHANNELBIND,401,"nonce1",NULL);
+	CHECK(test_nchannels==2);
+	number=test_channel_of(port);
+	CHECK(number!=0 && test_channel_of(port+1)!=0 && test_channel_of(port+1)!=number);
+
+	/* not bound yet: a Send indication to the peer */
+	test_send(session,0);
+	n=test_server_recv(buf,sizeof(buf),&from);
+	memset(&msg,0,sizeof(msg));
+	CHECK(stunParseMessage((char*)buf,n,&msg));
+	CHECK(msg.msgHdr.msgType==(TURN_INDICATION_SEND|STUN_INDICATION));
+	CHECK(msg.hasXorPeerAddress && (msg.xorPeerAddress.ipv4.port^0x2112)==TEST_PEER_PORT);
+	CHECK(msg.hasData && msg.data.sizeValue==TEST_PACKET_SIZE);
+	CHECK((uint8_t)msg.data.value[RTP_FIXED_HEADER_SIZE]==0);
+
+	/* and a Data indication from the peer */
+	msg.msgHdr.msgType=(TURN_INDICATION_DATA|STUN_INDICATION);
+	test_make_rtp((uint8_t*)msg.data.value,0);
+	n=stunEncodeMessage(&msg,(char*)buf,sizeof(buf),NULL);
+	test_server_send(buf,n,&rtpaddr);
+
+	/* 401, then 438: sent again with the new nonce each time */
+	test_session_recv(session);
+	test_check_recv(session,0);
+	test_server_answer(2,TURN_METHOD_CHANNELBIND,438,"nonce2","nonce1");
+	test_session_recv(session);
+	test_server_answer(2,TURN_METHOD_CHANNELBIND,0,NULL,"nonce2");
+	test_session_recv(session);
+	rtp_turn_manager_get_stats(mgr,&stats);
+	CHECK(stats.requests==6);
+	CHECK(stats.failures==0);
+	CHECK(stats.indications==1);
+	CHECK(stats.received==1);
+
+	/* bound: ChannelData messages, from the headroom of RTP packets or beside RTCP ones */
+	test_send(session,1);
+	n=test_server_recv(buf,sizeof(buf),&from);
+	CHECK(ntohs(from.sin_port)==port);
+	CHECK(n==4+TEST_PACKET_SIZE);
+	CHECK(((buf[0]<<8)|buf[1])==number && ((buf[2]<<8)|buf[3])==TEST_PACKET_SIZE);
+	CHECK(buf[4+RTP_FIXED_HEADER_SIZE]==1);
+	rtp_session_enable_rtcp(session,TRUE);
+	rtp_session_send_rtcp_APP(session,0,"test",(const uint8_t*)"data",4);
+	rtp_session_enable_rtcp(session,FALSE);
+	n=test_server_recv(buf,sizeof(buf),&from);
+	CHECK(ntohs(from.sin_port)==port+1);
+	CHECK(((buf[0]<<8)|buf[1])==test_channel_of(port+1) && ((buf[2]<<8)|buf[3])==n-4);
+
+	/* ChannelData stripping */
+	n=test_make_channel_data(buf,test_channel_of(port+1),1,0,0);
+	test_server_send(buf,n,&rtpaddr);
+	n=test_make_channel_data(buf,number,1,4,0);
+	test_server_send(buf,n,&rtpaddr);
+	stranger=socket(AF_INET,SOCK_DGRAM,0);
+	n=test_make_channel_data(buf,number,1,0,0);
+	CHECK(sendto(stranger,(char*)buf,n,0,(struct sockaddr*)&rtpaddr,sizeof(rtpaddr))==n);
+	close_socket(stranger);
+	/* the padding to a multiple of 4 bytes is not part of the packet */
+	n=test_make_channel_data(buf,number,1,0,4);
+	test_server_send(buf,n,&rtpaddr);
+	rtp_session_rtp_recv(session,0);
+	test_check_recv(session,1);
+	rtp_turn_manager_get_stats(mgr,&stats);
+	CHECK(stats.sent==2);
+	CHECK(stats.received==2);
+	CHECK(stats.dropped==3);
+
+	/* a second session: the nonce is reused, no challenge */
+	other=test_session_new();
+	CHECK(rtp_turn_manager_add_session(mgr,other)==0);
+	test_server_answer(2,TURN_METHOD_CHANNELBIND,0,NULL,"nonce2");
+	test_session_recv(other);
+	now=test_now_ms();
+
+	/* rounds: the bindings are refreshed after 4 minutes, the allocations after 9 */
+	CHECK(rtp_turn_manager_process_at(mgr,now+230*1000)==0);
+	CHECK(rtp_turn_manager_process_at(mgr,now+241*1000)==4);
+	test_server_answer(4,TURN_METHOD_CHANNELBIND,0,NULL,"nonce2");
+	test_session_recv(session);
+	test_session_recv(other);
+	rtp_turn_manager_get_stats(mgr,&stats);
+	CHECK(stats.rounds==1);
+	/* the bindings due again bring the allocations due within 30 seconds */
+	CHECK(rtp_turn_manager_process_at(mgr,now+515*1000)==8);
+	for(n=0;n<8;n++){
+		StunMessage req;
+		test_server_recv_request(&req,&from);
+		CHECK(test_has_nonce(&req,"nonce2"));
+		if (TEST_METHOD(req.msgHdr.msgType)==TURN_METHOD_REFRESH)
+			CHECK(req.hasLifetimeAttributes);
+		test_server_reply(&req,&from,0,NULL);
+	}
+	test_session_recv(session);
+	test_session_recv(other);
+	/* the answers, received now, set the next round 4 minutes from now */
+	CHECK(rtp_turn_manager_process_at(mgr,now+230*1000)==0);
+	rtp_turn_manager_get_stats(mgr,&stats);
+	CHECK(stats.rounds==2);
+	CHECK(stats.failures==0);
+	rtp_turn_manager_remove_session(mgr,other);
+	CHECK(other->rtp.tr==NULL);
+	rtp_session_destroy(other);
+
+	/* only SRTP transports can be wrapped */
+	other=test_session_new();
+	memset(&dummy,0,sizeof(dummy));
+	dummy.t_sendto=test_dummy_sendto;
+	rtp_session_set_transports(other,&dummy,NULL);
+	CHECK(rtp_turn_manager_add_session(mgr,other)==-1);
+	CHECK(other->rtp.tr==&dummy);
+	rtp_session_destroy(other);
+
+	/* SRTP under the relay: protected before being framed, unprotected once stripped */
+	memset(&policy,0,sizeof(policy));
+	crypto_policy_set_rtp_default(&policy.rtp);
+	crypto_policy_set_rtcp_default(&policy.rtcp);
+	policy.ssrc.type=ssrc_specific;
+	policy.ssrc.value=TEST_SSRC;
+	policy.key=test_key;
+	CHECK(ortp_srtp_create_pair(&sender,&receiver,&policy)==err_status_ok);
+	srtp_transport_new_pair(sender,receiver,&srtpt,&srtcpt);
+	secure=test_session_new();
+	rtp_session_set_ssrc(secure,TEST_SSRC);
+	rtp_session_set_transports(secure,srtpt,srtcpt);
+	port=rtp_session_get_local_port(secure);
+	CHECK(rtp_turn_manager_add_session(mgr,secure)==0);
+	test_server_answer(2,TURN_METHOD_CHANNELBIND,0,NULL,"nonce2");
+	test_session_recv(secure);
+	test_send(secure,0);
+	n=test_server_recv(buf,sizeof(buf),&from);
+	CHECK(ntohs(from.sin_port)==port);
+	CHECK(n==4+TEST_PACKET_SIZE+TEST_SRTP_TAG_SIZE);
+	CHECK(((buf[0]<<8)|buf[1])==test_channel_of(port) && ((buf[2]<<8)|buf[3])==n-4);
+	/* the payload is encrypted */
+	CHECK(buf[4+RTP_FIXED_HEADER_SIZE]!=0 || buf[5+RTP_FIXED_HEADER_SIZE]!=0);
+	test_server_send(buf,n,&from);
+	rtp_session_rtp_recv(secure,0);
+	test_check_recv(secure,0);
+	rtp_turn_manager_remove_session(mgr,secure);
+	CHECK(secure->rtp.tr==srtpt && secure->rtcp.tr==srtcpt);
+	rtp_session_destroy(secure);
+	srtp_transport_destroy(srtpt);
+	srtp_transport_destroy(srtcpt);
+	ortp_srtp_dealloc(sender);
+	ortp_srtp_dealloc(receiver);
+
+	rtp_turn_manager_remove_session(mgr,session);
+	rtp_session_destroy(session);
+	rtp_turn_manager_destroy(mgr);
+	close_socket(test_server);
+	return test_done("rtpturn_test");
+}
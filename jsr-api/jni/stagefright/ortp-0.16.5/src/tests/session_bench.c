@@ -0,0 +1,304 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * session_bench measures what a large number of sessions costs per session,
+ * in time and in cache misses, for the two loops that visit every session:
+ *
+ * - tick: one scheduler tick over sessions that all wait for a later
+ *   timestamp, which is the usual state of the sessions between two packets.
+ *   The sessions are spread over as many schedulers as needed, since one
+ *   holds at most the size of a SessionSet.
+ * - packet: one packet sent and one received by each session in turn, through
+ *   a transport that drops what it is given and hands over a packet prepared
+ *   for the session, so that no system call is timed.
+ *
+ * Each loop is run over every session a number of rounds (-r), and the time and
+ * the cache misses per session and per round are written as JSON. Cache misses
+ * are read with perf_event_open(); they are null where it is not available.
+ *
+ * usage: session_bench [ -r rounds ] [ sessions ... ]
+ */
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ortp/ortp.h"
+#include "scheduler.h"
+#include "rtpsession_priv.h"
+
+#define BENCH_PAYLOAD_SIZE 160	/* 20ms of G.711 */
+#define BENCH_DEFAULT_ROUNDS 50
+#define BENCH_TICK_MS 10
+
+static const int bench_default_sessions[]={1000,2000,5000,10000};
+
+typedef struct _BenchLeg{
+	RtpTransport tr;
+	uint8_t packet[RTP_FIXED_HEADER_SIZE+BENCH_PAYLOAD_SIZE];
+	bool_t pending;
+	uint16_t seq;
+	uint32_t ts;
+} BenchLeg;
+
+static ortp_socket_t bench_getsocket(RtpTransport *t){
+	return -1;
+}
+
+static int bench_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	BenchLeg *leg=(BenchLeg*)t->data;
+	/* each packet sent is answered by one for the session to receive */
+	leg->pending=TRUE;
+	return msgdsize(m);
+}
+
+static int bench_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	BenchLeg *leg=(BenchLeg*)t->data;
+	rtp_header_t *rtp=(rtp_header_t*)leg->packet;
+	struct sockaddr_in *sin=(struct sockaddr_in*)from;
+
+	if (!leg->pending) return 0;
+	leg->pending=FALSE;
+	rtp->seq_number=htons(leg->seq++);
+	rtp->timestamp=htonl(leg->ts);
+	leg->ts+=BENCH_PAYLOAD_SIZE;
+	memcpy(m->b_wptr,leg->packet,sizeof(leg->packet));
+	memset(sin,0,sizeof(*sin));
+	sin->sin_family=AF_INET;
+	sin->sin_port=htons(5004);
+	sin->sin_addr.s_addr=htonl(0x0a000001);
+	*fromlen=sizeof(*sin);
+	return sizeof(leg->packet);
+}
+
+static int bench_misses_open(void){
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr,0,sizeof(attr));
+	attr.type=PERF_TYPE_HARDWARE;
+	attr.size=sizeof(attr);
+	attr.config=PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled=1;
+	attr.exclude_kernel=1;
+	attr.exclude_hv=1;
+	return syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+#else
+	return -1;
+#endif
+}
+
+static void bench_misses_start(int fd){
+#ifdef __linux__
+	if (fd<0) return;
+	ioctl(fd,PERF_EVENT_IOC_RESET,0);
+	ioctl(fd,PERF_EVENT_IOC_ENABLE,0);
+#endif
+}
+
+static long long bench_misses_stop(int fd){
+	long long count=-1;
+#ifdef __linux__
+	if (fd<0) return -1;
+	ioctl(fd,PERF_EVENT_IOC_DISABLE,0);
+	if (read(fd,&count,sizeof(count))!=sizeof(count)) count=-1;
+#endif
+	return count;
+}
+
+static uint64_t bench_now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void bench_print(const char *loop, int nsessions, int rounds, uint64_t ns, long long misses, bool_t last){
+	double visits=(double)nsessions*rounds;
+	printf("    {\"loop\": \"%s\", \"sessions\": %d, \"rounds\": %d, \"ns_per_session\": %.1f, ",
+		loop,nsessions,rounds,ns/visits);
+	if (misses<0) printf("\"misses_per_session\": null}");
+	else printf("\"misses_per_session\": %.2f}",misses/visits);
+	printf("%s\n",last ? "" : ",");
+}
+
+static RtpSession **bench_sessions_new(int nsessions, BenchLeg **legs){
+	RtpSession **sessions=ortp_new0(RtpSession*,nsessions);
+	BenchLeg *l=ortp_new0(BenchLeg,nsessions);
+	int i;
+
+	for(i=0;i<nsessions;i++){
+		RtpSession *s=rtp_session_new(RTP_SESSION_SENDRECV);
+		rtp_header_t *rtp=(rtp_header_t*)l[i].packet;
+		rtp_session_set_payload_type(s,0);
+		rtp_session_enable_rtcp(s,FALSE);
+		rtp_session_enable_adaptive_jitter_compensation(s,FALSE);
+		rtp_session_set_jitter_compensation(s,0);
+		l[i].tr.data=&l[i];
+		l[i].tr.t_getsocket=bench_getsocket;
+		l[i].tr.t_sendto=bench_sendto;
+		l[i].tr.t_recvfrom=bench_recvfrom;
+		rtp->version=2;
+		rtp->paytype=0;
+		rtp->ssrc=htonl(0x1000+i);
+		l[i].seq=(uint16_t)i;
+		rtp_session_set_transports(s,&l[i].tr,NULL);
+		sessions[i]=s;
+	}
+	*legs=l;
+	return sessions;
+}
+
+static void bench_sessions_destroy(RtpSession **sessions, BenchLeg *legs, int nsessions){
+	int i;
+	for(i=0;i<nsessions;i++)
+		rtp_session_destroy(sessions[i]);
+	ortp_free(sessions);
+	ortp_free(legs);
+}
+
+static void bench_tick(int nsessions, int rounds, int fd, bool_t last){
+	BenchLeg *legs;
+	RtpSession **sessions=bench_sessions_new(nsessions,&legs);
+	int per_sched=sizeof(SessionSet)*8;
+	int nscheds=(nsessions+per_sched-1)/per_sched;
+	RtpScheduler **scheds=ortp_new0(RtpScheduler*,nscheds);
+	uint64_t start,ns;
+	long long misses;
+	int i,r;
+
+	for(i=0;i<nscheds;i++)
+		scheds[i]=rtp_scheduler_new();
+	for(i=0;i<nsessions;i++){
+		RtpSession *s=sessions[i];
+		RtpScheduler *sched=scheds[i/per_sched];
+		s->sched=sched;
+		rtp_session_set_flag(s,RTP_SESSION_SCHEDULED);
+		rtp_scheduler_add_session(sched,s);
+		/* start the stream, then wait for a packet one minute ahead */
+		freemsg(rtp_session_recvm_with_ts(s,0));
+		freemsg(rtp_session_recvm_with_ts(s,8000*60));
+	}
+	start=bench_now_ns();
+	bench_misses_start(fd);
+	for(r=0;r<rounds;r++){
+		for(i=0;i<nscheds;i++){
+			rtp_scheduler_tick(scheds[i]);
+			scheds[i]->time_+=BENCH_TICK_MS;
+		}
+	}
+	misses=bench_misses_stop(fd);
+	ns=bench_now_ns()-start;
+	bench_print("tick",nsessions,rounds,ns,misses,last);
+
+	/* rtp_session_destroy() takes the sessions out of their scheduler */
+	bench_sessions_destroy(sessions,legs,nsessions);
+	for(i=0;i<nscheds;i++)
+		rtp_scheduler_destroy(scheds[i]);
+	ortp_free(scheds);
+}
+
+static void bench_packet(int nsessions, int rounds, int fd, bool_t last){
+	BenchLeg *legs;
+	RtpSession **sessions=bench_sessions_new(nsessions,&legs);
+	uint8_t payload[BENCH_PAYLOAD_SIZE];
+	uint64_t start,ns;
+	long long misses;
+	int i,r,received=0;
+
+	memset(payload,0xff,sizeof(payload));
+	/* a first round outside of the measure, to get the streams started */
+	for(i=0;i<nsessions;i++){
+		rtp_session_send_with_ts(sessions[i],payload,sizeof(payload),0);
+		freemsg(rtp_session_recvm_with_ts(sessions[i],0));
+	}
+	start=bench_now_ns();
+	bench_misses_start(fd);
+	for(r=1;r<=rounds;r++){
+		uint32_t ts=r*BENCH_PAYLOAD_SIZE;
+		for(i=0;i<nsessions;i++){
+			mblk_t *mp;
+			rtp_session_send_with_ts(sessions[i],payload,sizeof(payload),ts);
+			mp=rtp_session_recvm_with_ts(sessions[i],ts);
+			if (mp!=NULL){
+				received++;
+				freemsg(mp);
+			}
+		}
+	}
+	misses=bench_misses_stop(fd);
+	ns=bench_now_ns()-start;
+	bench_print("packet",nsessions,rounds,ns,misses,last);
+	if (received<nsessions*rounds*9/10)
+		fprintf(stderr,"warning: only %d packets of %d were received\n",received,nsessions*rounds);
+	bench_sessions_destroy(sessions,legs,nsessions);
+}
+
+static void usage(const char *prog){
+	fprintf(stderr,"usage: %s [ -r rounds ] [ sessions ... ]\n",prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]){
+	int rounds=BENCH_DEFAULT_ROUNDS;
+	int nsizes=0;
+	int *sizes=ortp_new0(int,argc+(int)(sizeof(bench_default_sessions)/sizeof(int)));
+	int fd;
+	int i;
+
+	for(i=1;i<argc;i++){
+		if (strcmp(argv[i],"-r")==0){
+			if (++i==argc) usage(argv[0]);
+			rounds=atoi(argv[i]);
+		}else if (atoi(argv[i])>0){
+			sizes[nsizes++]=atoi(argv[i]);
+		}else usage(argv[0]);
+	}
+	if (rounds<=0) usage(argv[0]);
+	if (nsizes==0){
+		nsizes=sizeof(bench_default_sessions)/sizeof(int);
+		memcpy(sizes,bench_default_sessions,sizeof(bench_default_sessions));
+	}
+
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_ERROR|ORTP_FATAL);
+	fd=bench_misses_open();
+	if (fd<0) fprintf(stderr,"warning: cache misses are not available here\n");
+
+	printf("{\n  \"benchmark\": \"session_bench\",\n");
+	printf("  \"sizeof_session\": %d, \"sizeof_session_cold\": %d, \"sizeof_sched_slot\": %d,\n",
+		(int)sizeof(RtpSession),(int)sizeof(RtpSessionCold),(int)sizeof(RtpSchedSlot));
+	printf("  \"results\": [\n");
+	for(i=0;i<nsizes;i++){
+		bench_tick(sizes[i],rounds,fd,FALSE);
+		bench_packet(sizes[i],rounds,fd,i==nsizes-1);
+	}
+	printf("  ]\n}\n");
+
+	if (fd>=0) close(fd);
+	ortp_free(sizes);
+	ortp_exit();
+	return 0;
+}
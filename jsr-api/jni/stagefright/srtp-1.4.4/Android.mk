@@ -1,5 +1,23 @@
 LOCAL_PATH:= $(call my-dir)
 
+# The ciphers and hashes with ARMv8 crypto extension code paths
+# ============================================================
+# the instructions are detected at run time; only these files are
+# built with the extension allowed, the rest of libSrtp does not use it
+include $(CLEAR_VARS)
+LOCAL_MODULE            := libSrtpHw
+LOCAL_SRC_FILES         := \
+    crypto/cipher/aes_icm_hw.c \
+    crypto/cipher/aes_gcm.c \
+    crypto/hash/sha1_hw.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/crypto/include
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_CFLAGS += -march=armv8-a+crypto
+endif
+
+include $(BUILD_STATIC_LIBRARY)
+
 # Copy the srtp library
 # ============================================================
 include $(CLEAR_VARS)
@@ -30,6 +48,7 @@ LOCAL_SRC_FILES         := \
     srtp/srtp.c \
 
 LOCAL_C_INCLUDES        := $(LOCAL_PATH)/include $(LOCAL_PATH)/crypto/include $(JNI_H_INCLUDE)
+LOCAL_WHOLE_STATIC_LIBRARIES := libSrtpHw
 LOCAL_LDLIBS := -llog
 #LOCAL_SHARED_LIBRARIES  := liblog
 LOCAL_PRELINK_MODULE    := false
@@ -1788,6 +1788,98 @@ void aes_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key) {
     aes_final_round(plaintext, exp_key + 10);
 }
 
+/*
+ * aes_encrypt_blocks(blocks, num_blocks, exp_key) encrypts num_blocks
+ * independent blocks in place.  The rounds are applied to all of the
+ * blocks before moving on to the next round key, so that the table
+ * lookups of different blocks can overlap.
+ */
+
+void aes_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_expanded_key_t exp_key) {
+    int i, r;
+
+    for (i = 0; i < num_blocks; i++)
+        v128_xor_eq(&blocks[i], exp_key + 0);
+
+    for (r = 1; r < 10; r++)
+        for (i = 0; i < num_blocks; i++)
+            aes_round(&blocks[i], exp_key + r);
+
+    for (i = 0; i < num_blocks; i++)
+        aes_final_round(&blocks[i], exp_key + 10);
+}
+
+/*
+ * aes_expand_key(key, key_len, exp_key) expands a 128 or 256 bit key
+ * into the encryption round keys of exp_key, following the key
+ * schedule of FIPS-197 section 5.2
+ */
+
+err_status_t aes_expand_key(const uint8_t *key, int key_len,
+        aes_key_t *exp_key) {
+    uint8_t *w = exp_key->round[0].v8;
+    int nk, total, i;
+    gf2_8 rc = 1;
+
+    if (key_len == 16)
+        exp_key->num_rounds = 10;
+    else if (key_len == 32)
+        exp_key->num_rounds = 14;
+    else
+        return err_status_bad_param;
+
+    nk = key_len / 4;
+    total = 4 * (exp_key->num_rounds + 1);
+    for (i = 0; i < key_len; i++)
+        w[i] = key[i];
+
+    for (i = nk; i < total; i++) {
+        uint8_t t0 = w[4 * i - 4], t1 = w[4 * i - 3];
+        uint8_t t2 = w[4 * i - 2], t3 = w[4 * i - 1];
+
+        if (i % nk == 0) {
+            uint8_t tmp = t0;
+            t0 = aes_sbox[t1] ^ rc;
+            t1 = aes_sbox[t2];
+            t2 = aes_sbox[t3];
+            t3 = aes_sbox[tmp];
+            rc = gf2_8_shift(rc);
+        } else if (nk > 6 && i % nk == 4) {
+            t0 = aes_sbox[t0];
+            t1 = aes_sbox[t1];
+            t2 = aes_sbox[t2];
+            t3 = aes_sbox[t3];
+        }
+        w[4 * i + 0] = w[4 * (i - nk) + 0] ^ t0;
+        w[4 * i + 1] = w[4 * (i - nk) + 1] ^ t1;
+        w[4 * i + 2] = w[4 * (i - nk) + 2] ^ t2;
+        w[4 * i + 3] = w[4 * (i - nk) + 3] ^ t3;
+    }
+
+    return err_status_ok;
+}
+
+/*
+ * aes_key_encrypt_blocks() is aes_encrypt_blocks() for a key expanded
+ * with aes_expand_key(), i.e. with 10 or 14 rounds
+ */
+
+void aes_key_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_key_t *exp_key) {
+    int i, r;
+
+    for (i = 0; i < num_blocks; i++)
+        v128_xor_eq(&blocks[i], &exp_key->round[0]);
+
+    for (r = 1; r < exp_key->num_rounds; r++)
+        for (i = 0; i < num_blocks; i++)
+            aes_round(&blocks[i], &exp_key->round[r]);
+
+    for (i = 0; i < num_blocks; i++)
+        aes_final_round(&blocks[i], &exp_key->round[exp_key->num_rounds]);
+}
+
 void aes_decrypt(v128_t *plaintext, const aes_expanded_key_t exp_key) {
 
     /* add in the subkey */
@@ -0,0 +1,867 @@
+/*
+ * aes_gcm.c
+ *
+ * AES Galois/Counter Mode (NIST SP 800-38D), as used by the AEAD
+ * transforms of SRTP (RFC 7714)
+ *
+ * GHASH is computed with the carry-less multiply instructions of the
+ * CPU (PCLMULQDQ on x86, PMULL on ARMv8) when they are available, and
+ * with 4-bit tables otherwise; the same holds for AES.
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "aes_gcm.h"
+#include "alloc.h"
+#define LOG_TAG "Srtp-1.4.4"
+
+/*
+ * AES_GCM_X86 and AES_GCM_ARM select the instruction set of the
+ * accelerated code, as AES_ICM_HW_X86 and AES_ICM_HW_ARM do in
+ * aes_icm_hw.c; on ARM the compiler must be given the crypto
+ * extensions (-march=armv8-a+crypto).
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define AES_GCM_X86 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#elif (defined(__aarch64__) || defined(__arm__)) && defined(__ARM_FEATURE_CRYPTO)
+#define AES_GCM_ARM 1
+#include <arm_neon.h>
+#include <stdio.h>
+#endif
+
+debug_module_t mod_aes_gcm = { 0, /* debugging is off by default */
+"aes gcm" /* printable module name       */
+};
+
+/*
+ * generic GHASH, with the 4-bit tables of Shoup's method: hh[i], hl[i]
+ * hold the high and low halves of i*H, where i is a 4-bit polynomial
+ */
+
+static const uint64_t ghash_last4[16] = { 0x0000, 0x1c20, 0x3840, 0x2460,
+        0x7080, 0x6ca0, 0x48c0, 0x54e0, 0xe100, 0xfd20, 0xd940, 0xc560,
+        0x9180, 0x8da0, 0xa9c0, 0xb5e0 };
+
+static uint64_t load_be64(const uint8_t *p) {
+    return ((uint64_t) p[0] << 56) | ((uint64_t) p[1] << 48)
+            | ((uint64_t) p[2] << 40) | ((uint64_t) p[3] << 32)
+            | ((uint64_t) p[4] << 24) | ((uint64_t) p[5] << 16)
+            | ((uint64_t) p[6] << 8) | (uint64_t) p[7];
+}
+
+static void store_be64(uint8_t *p, uint64_t x) {
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        p[i] = (uint8_t) x;
+        x >>= 8;
+    }
+}
+
+static void ghash_init_tables(aes_gcm_ctx_t *c) {
+    uint64_t vh = load_be64(c->h.v8);
+    uint64_t vl = load_be64(c->h.v8 + 8);
+    int i, j;
+
+    c->hh[0] = c->hl[0] = 0;
+    c->hh[8] = vh;
+    c->hl[8] = vl;
+    for (i = 4; i > 0; i >>= 1) {
+        uint64_t t = (vl & 1) * 0xe1000000U;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (t << 32);
+        c->hh[i] = vh;
+        c->hl[i] = vl;
+    }
+    for (i = 2; i <= 8; i *= 2) {
+        vh = c->hh[i];
+        vl = c->hl[i];
+        for (j = 1; j < i; j++) {
+            c->hh[i + j] = vh ^ c->hh[j];
+            c->hl[i + j] = vl ^ c->hl[j];
+        }
+    }
+}
+
+static void ghash_blocks_generic(aes_gcm_ctx_t *c, const uint8_t *data,
+        int num_blocks) {
+    uint8_t x[16];
+    uint64_t zh, zl;
+    int i, n;
+
+    for (i = 0; i < 16; i++)
+        x[i] = c->ghash.v8[i];
+
+    for (n = 0; n < num_blocks; n++, data += 16) {
+        unsigned char lo, hi, rem;
+
+        for (i = 0; i < 16; i++)
+            x[i] ^= data[i];
+
+        lo = x[15] & 0xf;
+        zh = c->hh[lo];
+        zl = c->hl[lo];
+        for (i = 15; i >= 0; i--) {
+            lo = x[i] & 0xf;
+            hi = x[i] >> 4;
+            if (i != 15) {
+                rem = (unsigned char) zl & 0xf;
+                zl = (zh << 60) | (zl >> 4);
+                zh = (zh >> 4) ^ (ghash_last4[rem] << 48);
+                zh ^= c->hh[lo];
+                zl ^= c->hl[lo];
+            }
+            rem = (unsigned char) zl & 0xf;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (ghash_last4[rem] << 48);
+            zh ^= c->hh[hi];
+            zl ^= c->hl[hi];
+        }
+        store_be64(x, zh);
+        store_be64(x + 8, zl);
+    }
+
+    for (i = 0; i < 16; i++)
+        c->ghash.v8[i] = x[i];
+}
+
+/*
+ * GHASH with a carry-less multiply: the operands are byte reflected,
+ * multiplied, and the 256 bit product is shifted by one bit and
+ * reduced modulo x^128 + x^7 + x^2 + x + 1 (Gueron and Kounavis,
+ * "Intel Carry-Less Multiplication Instruction and its Usage for
+ * Computing the GCM Mode", algorithms 2 and 4).  The steps are written
+ * once with the GV_* operations, which map to SSE on x86 and to NEON
+ * on ARM.
+ */
+
+#define GHASH_GFMUL(r, a, b) {                                          \
+    gv_t t2, t3, t4, t5, t6, t7, t8, t9;                                \
+    t3 = GV_CLMUL(a, 0, b, 0);                                          \
+    t4 = GV_CLMUL(a, 0, b, 1);                                          \
+    t5 = GV_CLMUL(a, 1, b, 0);                                          \
+    t6 = GV_CLMUL(a, 1, b, 1);                                          \
+    t4 = GV_XOR(t4, t5);                                                \
+    t5 = GV_SHLB(t4, 8);                                                \
+    t4 = GV_SHRB(t4, 8);                                                \
+    t3 = GV_XOR(t3, t5);                                                \
+    t6 = GV_XOR(t6, t4);                                                \
+    t7 = GV_SHR32(t3, 31);                                              \
+    t8 = GV_SHR32(t6, 31);                                              \
+    t3 = GV_SHL32(t3, 1);                                               \
+    t6 = GV_SHL32(t6, 1);                                               \
+    t9 = GV_SHRB(t7, 12);                                               \
+    t8 = GV_SHLB(t8, 4);                                                \
+    t7 = GV_SHLB(t7, 4);                                                \
+    t3 = GV_OR(t3, t7);                                                 \
+    t6 = GV_OR(t6, t8);                                                 \
+    t6 = GV_OR(t6, t9);                                                 \
+    t7 = GV_SHL32(t3, 31);                                              \
+    t8 = GV_SHL32(t3, 30);                                              \
+    t9 = GV_SHL32(t3, 25);                                              \
+    t7 = GV_XOR(t7, t8);                                                \
+    t7 = GV_XOR(t7, t9);                                                \
+    t8 = GV_SHRB(t7, 4);                                                \
+    t7 = GV_SHLB(t7, 12);                                               \
+    t3 = GV_XOR(t3, t7);                                                \
+    t2 = GV_SHR32(t3, 1);                                               \
+    t4 = GV_SHR32(t3, 2);                                               \
+    t5 = GV_SHR32(t3, 7);                                               \
+    t2 = GV_XOR(t2, t4);                                                \
+    t2 = GV_XOR(t2, t5);                                                \
+    t2 = GV_XOR(t2, t8);                                                \
+    t3 = GV_XOR(t3, t2);                                                \
+    r = GV_XOR(t6, t3);                                                 \
+}
+
+#if defined(AES_GCM_X86)
+
+typedef __m128i gv_t;
+
+#define GV_XOR(a, b) _mm_xor_si128(a, b)
+#define GV_OR(a, b) _mm_or_si128(a, b)
+#define GV_SHL32(a, n) _mm_slli_epi32(a, n)
+#define GV_SHR32(a, n) _mm_srli_epi32(a, n)
+#define GV_SHLB(a, n) _mm_slli_si128(a, n)
+#define GV_SHRB(a, n) _mm_srli_si128(a, n)
+#define GV_CLMUL(a, ha, b, hb) _mm_clmulepi64_si128(a, b, (ha) | ((hb) << 4))
+#define GV_LOAD(p) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p)), \
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15))
+#define GV_STORE(p, a) _mm_storeu_si128((__m128i *) (p), _mm_shuffle_epi8(a, \
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)))
+
+#define AES_GCM_HW_TARGET __attribute__((target("aes,pclmul,ssse3,sse2")))
+
+AES_GCM_HW_TARGET
+static void ghash_blocks_hw(aes_gcm_ctx_t *c, const uint8_t *data,
+        int num_blocks) {
+    gv_t h = GV_LOAD(c->h.v8);
+    gv_t x = GV_LOAD(c->ghash.v8);
+
+    for (; num_blocks > 0; num_blocks--, data += 16) {
+        x = GV_XOR(x, GV_LOAD(data));
+        GHASH_GFMUL(x, x, h);
+    }
+    GV_STORE(c->ghash.v8, x);
+}
+
+AES_GCM_HW_TARGET
+static void aes_gcm_hw_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_key_t *key) {
+    __m128i m[AES_GCM_MAX_BLOCKS];
+    __m128i k;
+    int i, r;
+
+    while (num_blocks > 0) {
+        int n = num_blocks < AES_GCM_MAX_BLOCKS ? num_blocks
+                : AES_GCM_MAX_BLOCKS;
+
+        k = _mm_loadu_si128((const __m128i *) &key->round[0]);
+        for (i = 0; i < n; i++)
+            m[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &blocks[i]),
+                    k);
+        for (r = 1; r < key->num_rounds; r++) {
+            k = _mm_loadu_si128((const __m128i *) &key->round[r]);
+            for (i = 0; i < n; i++)
+                m[i] = _mm_aesenc_si128(m[i], k);
+        }
+        k = _mm_loadu_si128((const __m128i *) &key->round[key->num_rounds]);
+        for (i = 0; i < n; i++)
+            _mm_storeu_si128((__m128i *) &blocks[i],
+                    _mm_aesenclast_si128(m[i], k));
+
+        blocks += n;
+        num_blocks -= n;
+    }
+}
+
+static int aes_gcm_hw_probe(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (ecx & bit_AES) && (ecx & bit_PCLMUL) && (ecx & bit_SSSE3)
+            && (edx & bit_SSE2);
+}
+
+#elif defined(AES_GCM_ARM)
+
+typedef uint8x16_t gv_t;
+
+#define GV_XOR(a, b) veorq_u8(a, b)
+#define GV_OR(a, b) vorrq_u8(a, b)
+#define GV_SHL32(a, n) \
+    vreinterpretq_u8_u32(vshlq_n_u32(vreinterpretq_u32_u8(a), n))
+#define GV_SHR32(a, n) \
+    vreinterpretq_u8_u32(vshrq_n_u32(vreinterpretq_u32_u8(a), n))
+#define GV_SHLB(a, n) vextq_u8(vdupq_n_u8(0), a, 16 - (n))
+#define GV_SHRB(a, n) vextq_u8(a, vdupq_n_u8(0), n)
+#define GV_CLMUL(a, ha, b, hb) vreinterpretq_u8_p128(vmull_p64(        \
+        (poly64_t) vgetq_lane_u64(vreinterpretq_u64_u8(a), ha),         \
+        (poly64_t) vgetq_lane_u64(vreinterpretq_u64_u8(b), hb)))
+
+/* byte reflection of a block, as _mm_shuffle_epi8 does on x86 */
+static inline gv_t gv_reflect(gv_t a) {
+    a = vrev64q_u8(a);
+    return vextq_u8(a, a, 8);
+}
+
+#define GV_LOAD(p) gv_reflect(vld1q_u8(p))
+#define GV_STORE(p, a) vst1q_u8(p, gv_reflect(a))
+
+static void ghash_blocks_hw(aes_gcm_ctx_t *c, const uint8_t *data,
+        int num_blocks) {
+    gv_t h = GV_LOAD(c->h.v8);
+    gv_t x = GV_LOAD(c->ghash.v8);
+
+    for (; num_blocks > 0; num_blocks--, data += 16) {
+        x = GV_XOR(x, GV_LOAD(data));
+        GHASH_GFMUL(x, x, h);
+    }
+    GV_STORE(c->ghash.v8, x);
+}
+
+static void aes_gcm_hw_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_key_t *key) {
+    uint8x16_t m[AES_GCM_MAX_BLOCKS];
+    uint8x16_t k;
+    int i, r;
+
+    while (num_blocks > 0) {
+        int n = num_blocks < AES_GCM_MAX_BLOCKS ? num_blocks
+                : AES_GCM_MAX_BLOCKS;
+
+        for (i = 0; i < n; i++)
+            m[i] = vld1q_u8(blocks[i].v8);
+        /* AESE does AddRoundKey before SubBytes/ShiftRows */
+        for (r = 0; r < key->num_rounds - 1; r++) {
+            k = vld1q_u8(key->round[r].v8);
+            for (i = 0; i < n; i++)
+                m[i] = vaesmcq_u8(vaeseq_u8(m[i], k));
+        }
+        k = vld1q_u8(key->round[key->num_rounds - 1].v8);
+        for (i = 0; i < n; i++)
+            m[i] = vaeseq_u8(m[i], k);
+        k = vld1q_u8(key->round[key->num_rounds].v8);
+        for (i = 0; i < n; i++)
+            vst1q_u8(blocks[i].v8, veorq_u8(m[i], k));
+
+        blocks += n;
+        num_blocks -= n;
+    }
+}
+
+/* see aes_icm_hw_probe() for why the auxiliary vector is read directly */
+static int aes_gcm_hw_probe(void) {
+#if defined(__aarch64__)
+    const unsigned long hwcap_type = 16; /* AT_HWCAP */
+    const unsigned long hwcap_need = (1 << 3) | (1 << 4); /* AES, PMULL */
+#else
+    const unsigned long hwcap_type = 26; /* AT_HWCAP2 */
+    const unsigned long hwcap_need = (1 << 0) | (1 << 1); /* AES, PMULL */
+#endif
+    unsigned long entry[2];
+    int found = 0;
+    FILE *f = fopen("/proc/self/auxv", "rb");
+
+    if (f == NULL)
+        return 0;
+    while (fread(entry, sizeof(entry), 1, f) == 1 && entry[0] != 0) {
+        if (entry[0] == hwcap_type) {
+            found = (entry[1] & hwcap_need) == hwcap_need;
+            break;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+#else
+
+#define ghash_blocks_hw ghash_blocks_generic
+#define aes_gcm_hw_encrypt_blocks aes_key_encrypt_blocks
+
+static int aes_gcm_hw_probe(void) {
+    return 0;
+}
+
+#endif
+
+int aes_gcm_hw_available(void) {
+    static int available = -1;
+
+    if (available < 0) {
+        available = aes_gcm_hw_probe();
+        debug_print(mod_aes_gcm, "hardware aes and ghash: %s",
+                available ? "available" : "not available");
+    }
+    return available;
+}
+
+static inline void aes_gcm_encrypt_blocks(aes_gcm_ctx_t *c, v128_t *blocks,
+        int num_blocks) {
+    if (c->accel)
+        aes_gcm_hw_encrypt_blocks(blocks, num_blocks, &c->key);
+    else
+        aes_key_encrypt_blocks(blocks, num_blocks, &c->key);
+}
+
+static inline void aes_gcm_ghash_blocks(aes_gcm_ctx_t *c, const uint8_t *data,
+        int num_blocks) {
+    if (num_blocks <= 0)
+        return;
+    if (c->accel)
+        ghash_blocks_hw(c, data, num_blocks);
+    else
+        ghash_blocks_generic(c, data, num_blocks);
+}
+
+/* feeds len octets to GHASH, buffering a trailing partial block */
+static void aes_gcm_ghash_update(aes_gcm_ctx_t *c, const uint8_t *data,
+        unsigned int len) {
+    unsigned int n;
+
+    if (c->ghash_bytes > 0) {
+        while (len > 0 && c->ghash_bytes < 16) {
+            c->ghash_buffer.v8[c->ghash_bytes++] = *data++;
+            len--;
+        }
+        if (c->ghash_bytes < 16)
+            return;
+        aes_gcm_ghash_blocks(c, c->ghash_buffer.v8, 1);
+        c->ghash_bytes = 0;
+    }
+
+    n = len / 16;
+    aes_gcm_ghash_blocks(c, data, n);
+    data += 16 * n;
+    len -= 16 * n;
+
+    while (len-- > 0)
+        c->ghash_buffer.v8[c->ghash_bytes++] = *data++;
+}
+
+/* zero-pads and hashes the partial block, if any */
+static void aes_gcm_ghash_flush(aes_gcm_ctx_t *c) {
+    if (c->ghash_bytes == 0)
+        return;
+    while (c->ghash_bytes < 16)
+        c->ghash_buffer.v8[c->ghash_bytes++] = 0;
+    aes_gcm_ghash_blocks(c, c->ghash_buffer.v8, 1);
+    c->ghash_bytes = 0;
+}
+
+static inline void aes_gcm_next_counter(aes_gcm_ctx_t *c, v128_t *block) {
+    *block = c->counter;
+    c->counter.v32[3] = htonl(ntohl(c->counter.v32[3]) + 1);
+}
+
+/* exors len octets of keystream into buf */
+static void aes_gcm_ctr(aes_gcm_ctx_t *c, uint8_t *buf, unsigned int len) {
+    v128_t ks[AES_GCM_MAX_BLOCKS];
+    unsigned int i;
+
+    while (len > 0 && c->bytes_in_buffer > 0) {
+        *buf++ ^= c->keystream_buffer.v8[16 - c->bytes_in_buffer--];
+        len--;
+    }
+
+    while (len >= 16) {
+        unsigned int n = len / 16;
+
+        if (n > AES_GCM_MAX_BLOCKS)
+            n = AES_GCM_MAX_BLOCKS;
+        for (i = 0; i < n; i++)
+            aes_gcm_next_counter(c, &ks[i]);
+        aes_gcm_encrypt_blocks(c, ks, n);
+        for (i = 0; i < 16 * n; i++)
+            buf[i] ^= ((uint8_t *) ks)[i];
+        buf += 16 * n;
+        len -= 16 * n;
+    }
+
+    if (len > 0) {
+        aes_gcm_next_counter(c, &c->keystream_buffer);
+        aes_gcm_encrypt_blocks(c, &c->keystream_buffer, 1);
+        for (i = 0; i < len; i++)
+            buf[i] ^= c->keystream_buffer.v8[i];
+        c->bytes_in_buffer = 16 - len;
+    }
+}
+
+static err_status_t aes_gcm_alloc(cipher_t **c, int key_len) {
+    extern cipher_type_t aes_gcm_128;
+    extern cipher_type_t aes_gcm_256;
+    cipher_type_t *type;
+    uint8_t *pointer;
+    int tmp;
+
+    debug_print(mod_aes_gcm, "allocating cipher with key length %d", key_len);
+
+    if (key_len == 16 + AES_GCM_SALT_LEN)
+        type = &aes_gcm_128;
+    else if (key_len == 32 + AES_GCM_SALT_LEN)
+        type = &aes_gcm_256;
+    else
+        return err_status_bad_param;
+
+    /* allocate memory a cipher of type aes_gcm */
+    tmp = (sizeof(aes_gcm_ctx_t) + sizeof(cipher_t));
+    pointer = (uint8_t*) crypto_alloc(tmp);
+    if (pointer == NULL)
+        return err_status_alloc_fail;
+
+    /* set pointers */
+    *c = (cipher_t *) pointer;
+    (*c)->type = type;
+    (*c)->state = pointer + sizeof(cipher_t);
+
+    /* increment ref_count */
+    type->ref_count++;
+
+    /* set key size        */
+    (*c)->key_len = key_len;
+    ((aes_gcm_ctx_t *) (*c)->state)->key_size = key_len - AES_GCM_SALT_LEN;
+
+    return err_status_ok;
+}
+
+static err_status_t aes_gcm_dealloc(cipher_t *c) {
+    cipher_type_t *type = c->type;
+
+    /* zeroize entire state*/
+    octet_string_set_to_zero((uint8_t *) c, sizeof(aes_gcm_ctx_t)
+            + sizeof(cipher_t));
+
+    /* free memory */
+    crypto_free(c);
+
+    /* decrement ref_count */
+    type->ref_count--;
+
+    return err_status_ok;
+}
+
+/*
+ * aes_gcm_context_init() expands the key and computes the hash
+ * subkey; the length of the AES key was set by aes_gcm_alloc()
+ */
+
+err_status_t aes_gcm_context_init(aes_gcm_ctx_t *c, const uint8_t *key) {
+    err_status_t status;
+    int i;
+
+    status = aes_expand_key(key, c->key_size, &c->key);
+    if (status)
+        return status;
+
+    v128_set_to_zero(&c->salt);
+    for (i = 0; i < AES_GCM_SALT_LEN; i++)
+        c->salt.v8[i] = key[c->key_size + i];
+
+    c->accel = aes_gcm_hw_available();
+
+    v128_set_to_zero(&c->h);
+    aes_gcm_encrypt_blocks(c, &c->h, 1);
+    ghash_init_tables(c);
+
+    debug_print(mod_aes_gcm, "salt: %s", v128_hex_string(&c->salt));
+
+    return err_status_ok;
+}
+
+/*
+ * aes_gcm_set_iv(c, iv) starts a new message; the first 12 octets of
+ * iv are exored with the salt to form the GCM nonce
+ */
+
+err_status_t aes_gcm_set_iv(aes_gcm_ctx_t *c, void *iv) {
+    const v128_t *nonce = (const v128_t *) iv;
+    int i;
+
+    for (i = 0; i < AES_GCM_SALT_LEN; i++)
+        c->j0.v8[i] = nonce->v8[i] ^ c->salt.v8[i];
+    c->j0.v32[3] = htonl(1);
+
+    c->counter = c->j0;
+    c->counter.v32[3] = htonl(2);
+    c->bytes_in_buffer = 0;
+
+    v128_set_to_zero(&c->ghash);
+    c->ghash_bytes = 0;
+    c->aad_done = 0;
+    c->aad_len = 0;
+    c->data_len = 0;
+
+    debug_print(mod_aes_gcm, "set_iv: %s", v128_hex_string(&c->j0));
+
+    return err_status_ok;
+}
+
+/*
+ * aes_gcm_set_aad() may be called several times after set_iv, but not
+ * once data has been encrypted or decrypted
+ */
+
+err_status_t aes_gcm_set_aad(aes_gcm_ctx_t *c, const uint8_t *aad,
+        unsigned int aad_len) {
+    if (c->aad_done)
+        return err_status_bad_param;
+
+    aes_gcm_ghash_update(c, aad, aad_len);
+    c->aad_len += aad_len;
+
+    return err_status_ok;
+}
+
+static inline void aes_gcm_close_aad(aes_gcm_ctx_t *c) {
+    if (!c->aad_done) {
+        aes_gcm_ghash_flush(c);
+        c->aad_done = 1;
+    }
+}
+
+/*
+ * the keystream and GHASH passes are interleaved a few blocks at a
+ * time, so that the data is hashed while it is still in the cache
+ */
+
+err_status_t aes_gcm_encrypt(aes_gcm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len) {
+    unsigned int len = *enc_len;
+
+    aes_gcm_close_aad(c);
+    c->data_len += len;
+
+    while (len > 0) {
+        unsigned int n = len < 16 * AES_GCM_MAX_BLOCKS ? len
+                : 16 * AES_GCM_MAX_BLOCKS;
+
+        aes_gcm_ctr(c, buf, n);
+        aes_gcm_ghash_update(c, buf, n);
+        buf += n;
+        len -= n;
+    }
+
+    return err_status_ok;
+}
+
+/*
+ * aes_gcm_get_tag() finishes GHASH and writes the 16 octet tag; *len
+ * is the room available at tag, and is set to the tag length
+ */
+
+err_status_t aes_gcm_get_tag(aes_gcm_ctx_t *c, uint8_t *tag, int *len) {
+    v128_t lengths;
+    v128_t t;
+    int i;
+
+    if (*len < AES_GCM_TAG_LEN)
+        return err_status_bad_param;
+
+    aes_gcm_close_aad(c);
+    aes_gcm_ghash_flush(c);
+
+    store_be64(lengths.v8, c->aad_len * 8);
+    store_be64(lengths.v8 + 8, c->data_len * 8);
+    aes_gcm_ghash_blocks(c, lengths.v8, 1);
+
+    t = c->j0;
+    aes_gcm_encrypt_blocks(c, &t, 1);
+    for (i = 0; i < AES_GCM_TAG_LEN; i++)
+        tag[i] = t.v8[i] ^ c->ghash.v8[i];
+    *len = AES_GCM_TAG_LEN;
+
+    debug_print(mod_aes_gcm, "tag: %s", octet_string_hex_string(tag,
+            AES_GCM_TAG_LEN));
+
+    return err_status_ok;
+}
+
+/*
+ * aes_gcm_decrypt() authenticates the ciphertext and the tag that
+ * follows it before decrypting anything; on success *enc_len is
+ * reduced by the tag length
+ */
+
+err_status_t aes_gcm_decrypt(aes_gcm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len) {
+    uint8_t tag[AES_GCM_TAG_LEN];
+    int tag_len = AES_GCM_TAG_LEN;
+    unsigned int len;
+    uint8_t diff = 0;
+    int i;
+
+    if (*enc_len < AES_GCM_TAG_LEN)
+        return err_status_bad_param;
+    len = *enc_len - AES_GCM_TAG_LEN;
+
+    aes_gcm_close_aad(c);
+    aes_gcm_ghash_update(c, buf, len);
+    c->data_len += len;
+    aes_gcm_get_tag(c, tag, &tag_len);
+
+    /* compare in constant time */
+    for (i = 0; i < AES_GCM_TAG_LEN; i++)
+        diff |= tag[i] ^ buf[len + i];
+    if (diff != 0)
+        return err_status_auth_fail;
+
+    aes_gcm_ctr(c, buf, len);
+    *enc_len = len;
+
+    return err_status_ok;
+}
+
+/*
+ * test vectors are test cases 2, 4, 14 and 16 of McGrew and Viega,
+ * "The Galois/Counter Mode of Operation (GCM)"; the iv of the test
+ * case is used as the salt, and the packet index is zero
+ */
+
+uint8_t aes_gcm_test_case_0_key[28] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+uint8_t aes_gcm_test_case_idx[16] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+uint8_t aes_gcm_test_case_0_plaintext[16] = { 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+uint8_t aes_gcm_test_case_0_ciphertext[32] = { 0x03, 0x88, 0xda, 0xce, 0x60,
+        0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78,
+        /* tag */
+        0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd, 0xf5, 0x3a, 0x67,
+        0xb2, 0x12, 0x57, 0xbd, 0xdf };
+
+uint8_t aes_gcm_test_case_1_key[28] = { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65,
+        0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+        /* salt */
+        0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8,
+        0x88 };
+
+uint8_t aes_gcm_test_case_1_plaintext[60] = { 0xd9, 0x31, 0x32, 0x25, 0xf8,
+        0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+        0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda, 0x2e, 0x4c, 0x30,
+        0x3d, 0x8a, 0x31, 0x8a, 0x72, 0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68,
+        0x09, 0x53, 0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25, 0xb1,
+        0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57, 0xba, 0x63, 0x7b, 0x39 };
+
+uint8_t aes_gcm_test_case_1_aad[20] = { 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad,
+        0xbe, 0xef, 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xab,
+        0xad, 0xda, 0xd2 };
+
+uint8_t aes_gcm_test_case_1_ciphertext[76] = { 0x42, 0x83, 0x1e, 0xc2, 0x21,
+        0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+        0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0, 0x35, 0xc1, 0x7e,
+        0x23, 0x29, 0xac, 0xa1, 0x2e, 0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66,
+        0x93, 0x1c, 0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05, 0x1b,
+        0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97, 0x3d, 0x58, 0xe0, 0x91,
+        /* tag */
+        0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb, 0x94, 0xfa, 0xe9,
+        0x5a, 0xe7, 0x12, 0x1a, 0x47 };
+
+uint8_t aes_gcm_test_case_2_key[44] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00 };
+
+uint8_t aes_gcm_test_case_2_ciphertext[32] = { 0xce, 0xa7, 0x40, 0x3d, 0x4d,
+        0x60, 0x6b, 0x6e, 0x07, 0x4e, 0xc5, 0xd3, 0xba, 0xf3, 0x9d, 0x18,
+        /* tag */
+        0xd0, 0xd1, 0xc8, 0xa7, 0x99, 0x99, 0x6b, 0xf0, 0x26, 0x5b, 0x98,
+        0xb5, 0xd4, 0x8a, 0xb9, 0x19 };
+
+uint8_t aes_gcm_test_case_3_key[44] = { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65,
+        0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08, 0xfe,
+        0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94,
+        0x67, 0x30, 0x83, 0x08,
+        /* salt */
+        0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8,
+        0x88 };
+
+uint8_t aes_gcm_test_case_3_ciphertext[76] = { 0x52, 0x2d, 0xc1, 0xf0, 0x99,
+        0x56, 0x7d, 0x07, 0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+        0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9, 0x75, 0x98, 0xa2,
+        0xbd, 0x25, 0x55, 0xd1, 0xaa, 0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d,
+        0xbb, 0x3d, 0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38, 0xc5,
+        0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a, 0xbc, 0xc9, 0xf6, 0x62,
+        /* tag */
+        0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68, 0xcd, 0xdf, 0x88,
+        0x53, 0xbb, 0x2d, 0x55, 0x1b };
+
+cipher_test_case_t aes_gcm_test_case_1 = { 28, /* octets in key            */
+aes_gcm_test_case_1_key, /* key                      */
+aes_gcm_test_case_idx, /* packet index             */
+60, /* octets in plaintext      */
+aes_gcm_test_case_1_plaintext, /* plaintext                */
+76, /* octets in ciphertext     */
+aes_gcm_test_case_1_ciphertext, /* ciphertext and tag       */
+NULL, /* pointer to next testcase */
+20, /* octets in AAD            */
+aes_gcm_test_case_1_aad /* AAD                      */
+};
+
+cipher_test_case_t aes_gcm_test_case_0 = { 28, /* octets in key            */
+aes_gcm_test_case_0_key, /* key                      */
+aes_gcm_test_case_idx, /* packet index             */
+16, /* octets in plaintext      */
+aes_gcm_test_case_0_plaintext, /* plaintext                */
+32, /* octets in ciphertext     */
+aes_gcm_test_case_0_ciphertext, /* ciphertext and tag       */
+&aes_gcm_test_case_1, /* pointer to next testcase */
+0, /* octets in AAD            */
+NULL /* AAD                      */
+};
+
+cipher_test_case_t aes_gcm_test_case_3 = { 44, /* octets in key            */
+aes_gcm_test_case_3_key, /* key                      */
+aes_gcm_test_case_idx, /* packet index             */
+60, /* octets in plaintext      */
+aes_gcm_test_case_1_plaintext, /* plaintext                */
+76, /* octets in ciphertext     */
+aes_gcm_test_case_3_ciphertext, /* ciphertext and tag       */
+NULL, /* pointer to next testcase */
+20, /* octets in AAD            */
+aes_gcm_test_case_1_aad /* AAD                      */
+};
+
+cipher_test_case_t aes_gcm_test_case_2 = { 44, /* octets in key            */
+aes_gcm_test_case_2_key, /* key                      */
+aes_gcm_test_case_idx, /* packet index             */
+16, /* octets in plaintext      */
+aes_gcm_test_case_0_plaintext, /* plaintext                */
+32, /* octets in ciphertext     */
+aes_gcm_test_case_2_ciphertext, /* ciphertext and tag       */
+&aes_gcm_test_case_3, /* pointer to next testcase */
+0, /* octets in AAD            */
+NULL /* AAD                      */
+};
+
+char aes_gcm_128_description[] = "aes galois/counter mode, 128 bit key";
+
+char aes_gcm_256_description[] = "aes galois/counter mode, 256 bit key";
+
+cipher_type_t aes_gcm_128 = { (cipher_alloc_func_t) aes_gcm_alloc,
+        (cipher_dealloc_func_t) aes_gcm_dealloc,
+        (cipher_init_func_t) aes_gcm_context_init,
+        (cipher_encrypt_func_t) aes_gcm_encrypt,
+        (cipher_decrypt_func_t) aes_gcm_decrypt,
+        (cipher_set_iv_func_t) aes_gcm_set_iv,
+        (char *) aes_gcm_128_description, (int) 0, /* instance count */
+        (cipher_test_case_t *) &aes_gcm_test_case_0,
+        (debug_module_t *) &mod_aes_gcm,
+        (cipher_set_aad_func_t) aes_gcm_set_aad,
+        (cipher_get_tag_func_t) aes_gcm_get_tag };
+
+cipher_type_t aes_gcm_256 = { (cipher_alloc_func_t) aes_gcm_alloc,
+        (cipher_dealloc_func_t) aes_gcm_dealloc,
+        (cipher_init_func_t) aes_gcm_context_init,
+        (cipher_encrypt_func_t) aes_gcm_encrypt,
+        (cipher_decrypt_func_t) aes_gcm_decrypt,
+        (cipher_set_iv_func_t) aes_gcm_set_iv,
+        (char *) aes_gcm_256_description, (int) 0, /* instance count */
+        (cipher_test_case_t *) &aes_gcm_test_case_2,
+        (debug_module_t *) &mod_aes_gcm,
+        (cipher_set_aad_func_t) aes_gcm_set_aad,
+        (cipher_get_tag_func_t) aes_gcm_get_tag };
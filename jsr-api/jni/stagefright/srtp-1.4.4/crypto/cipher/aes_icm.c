@@ -43,8 +43,6 @@
  *
  */
 
-#define ALIGN_32 0
-
 #include "aes_icm.h"
 #include "alloc.h"
 #define LOG_TAG "Srtp-1.4.4"
@@ -257,6 +255,22 @@ err_status_t aes_icm_set_iv(aes_icm_ctx_t *c, void *iv) {
     return err_status_ok;
 }
 
+/*
+ * aes_icm_clock_counter(...) moves the counter forward by one block
+ */
+
+static inline void aes_icm_clock_counter(aes_icm_ctx_t *c, int forIsmacryp) {
+    if (forIsmacryp) {
+        uint32_t temp;
+        //alex's clock counter forward
+        temp = ntohl(c->counter.v32[3]);
+        c->counter.v32[3] = htonl(++temp);
+    } else {
+        if (!++(c->counter.v8[15]))
+            ++(c->counter.v8[14]);
+    }
+}
+
 /*
  * aes_icm_advance(...) refills the keystream_buffer and
  * advances the block index of the sicm_context forward by one
@@ -264,7 +278,7 @@ err_status_t aes_icm_set_iv(aes_icm_ctx_t *c, void *iv) {
  * this is an internal, hopefully inlined function
  */
 
-inline void aes_icm_advance_ismacryp(aes_icm_ctx_t *c, uint8_t forIsmacryp) {
+static inline void aes_icm_advance_ismacryp(aes_icm_ctx_t *c, uint8_t forIsmacryp) {
     /* fill buffer with new keystream */
     v128_copy(&c->keystream_buffer, &c->counter);
     aes_encrypt(&c->keystream_buffer, c->expanded_key);
@@ -275,22 +289,44 @@ inline void aes_icm_advance_ismacryp(aes_icm_ctx_t *c, uint8_t forIsmacryp) {
             &c->keystream_buffer));
 
     /* clock counter forward */
-
-    if (forIsmacryp) {
-        uint32_t temp;
-        //alex's clock counter forward
-        temp = ntohl(c->counter.v32[3]);
-        c->counter.v32[3] = htonl(++temp);
-    } else {
-        if (!++(c->counter.v8[15]))
-            ++(c->counter.v8[14]);
-    }
+    aes_icm_clock_counter(c, forIsmacryp);
 }
 
-inline void aes_icm_advance(aes_icm_ctx_t *c) {
+static inline void aes_icm_advance(aes_icm_ctx_t *c) {
     aes_icm_advance_ismacryp(c, 0);
 }
 
+/*
+ * aes_icm_xor_keystream(buf, ks, len) adds len octets of keystream into
+ * buf, len being a multiple of 16.  Whole 64 or 32 bit words are used
+ * when buf is aligned for them (the keystream always is).
+ */
+
+static inline void aes_icm_xor_keystream(unsigned char *buf, const v128_t *ks,
+        unsigned int len) {
+    unsigned int i;
+
+    if ((((unsigned long) buf) & 0x07) == 0) {
+        uint64_t *b = (uint64_t *) buf;
+        for (i = 0; i < len / sizeof(v128_t); i++) {
+            *b++ ^= ks[i].v64[0];
+            *b++ ^= ks[i].v64[1];
+        }
+    } else if ((((unsigned long) buf) & 0x03) == 0) {
+        uint32_t *b = (uint32_t *) buf;
+        for (i = 0; i < len / sizeof(v128_t); i++) {
+            *b++ ^= ks[i].v32[0];
+            *b++ ^= ks[i].v32[1];
+            *b++ ^= ks[i].v32[2];
+            *b++ ^= ks[i].v32[3];
+        }
+    } else {
+        const uint8_t *k = ks[0].v8;
+        for (i = 0; i < len; i++)
+            buf[i] ^= k[i];
+    }
+}
+
 /*e
  * icm_encrypt deals with the following cases:
  *
@@ -299,16 +335,22 @@ inline void aes_icm_advance(aes_icm_ctx_t *c) {
  *
  * bytes_to_encr > bytes_in_buffer
  *  - add keystream into data until keystream_buffer is depleted
- *  - loop over blocks, filling keystream_buffer and then
- *    adding keystream into data
+ *  - loop over runs of up to AES_ICM_MAX_BLOCKS blocks: fill them with
+ *    successive counter values, encrypt them with a single call to
+ *    encrypt_blocks, then add the keystream into data
  *  - fill buffer then add in remaining (< 16) bytes of keystream
+ *
+ * encrypt_blocks is aes_encrypt_blocks for the table based cipher, or a
+ * hardware implementation with the same contract
  */
 
-err_status_t aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c, unsigned char *buf,
-        unsigned int *enc_len, int forIsmacryp) {
+err_status_t aes_icm_crypt(aes_icm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len, int forIsmacryp,
+        aes_icm_blocks_func_t encrypt_blocks) {
+    v128_t keystream[AES_ICM_MAX_BLOCKS];
     unsigned int bytes_to_encr = *enc_len;
+    unsigned int num_blocks;
     unsigned int i;
-    uint32_t *b;
 
     /* check that there's enough segment left but not for ismacryp*/
     if (!forIsmacryp && (bytes_to_encr + htons(c->counter.v16[7])) > 0xffff)
@@ -339,59 +381,30 @@ err_status_t aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c, unsigned char *buf,
 
     }
 
-    /* now loop over entire 16-byte blocks of keystream */
-    for (i = 0; i < (bytes_to_encr / sizeof(v128_t)); i++) {
+    /* now loop over entire 16-byte blocks of keystream, several at once */
+    num_blocks = bytes_to_encr / sizeof(v128_t);
+    while (num_blocks > 0) {
+        unsigned int n = num_blocks < AES_ICM_MAX_BLOCKS ? num_blocks
+                : AES_ICM_MAX_BLOCKS;
 
-        /* fill buffer with new keystream */
-        aes_icm_advance_ismacryp(c, forIsmacryp);
-
-        /*
-         * add keystream into the data buffer (this would be a lot faster
-         * if we could assume 32-bit alignment!)
-         */
-
-#if ALIGN_32
-        b = (uint32_t *)buf;
-        *b++ ^= c->keystream_buffer.v32[0];
-        *b++ ^= c->keystream_buffer.v32[1];
-        *b++ ^= c->keystream_buffer.v32[2];
-        *b++ ^= c->keystream_buffer.v32[3];
-        buf = (uint8_t *)b;
-#else
-        if ((((unsigned long) buf) & 0x03) != 0) {
-            *buf++ ^= c->keystream_buffer.v8[0];
-            *buf++ ^= c->keystream_buffer.v8[1];
-            *buf++ ^= c->keystream_buffer.v8[2];
-            *buf++ ^= c->keystream_buffer.v8[3];
-            *buf++ ^= c->keystream_buffer.v8[4];
-            *buf++ ^= c->keystream_buffer.v8[5];
-            *buf++ ^= c->keystream_buffer.v8[6];
-            *buf++ ^= c->keystream_buffer.v8[7];
-            *buf++ ^= c->keystream_buffer.v8[8];
-            *buf++ ^= c->keystream_buffer.v8[9];
-            *buf++ ^= c->keystream_buffer.v8[10];
-            *buf++ ^= c->keystream_buffer.v8[11];
-            *buf++ ^= c->keystream_buffer.v8[12];
-            *buf++ ^= c->keystream_buffer.v8[13];
-            *buf++ ^= c->keystream_buffer.v8[14];
-            *buf++ ^= c->keystream_buffer.v8[15];
-        } else {
-            b = (uint32_t *) buf;
-            *b++ ^= c->keystream_buffer.v32[0];
-            *b++ ^= c->keystream_buffer.v32[1];
-            *b++ ^= c->keystream_buffer.v32[2];
-            *b++ ^= c->keystream_buffer.v32[3];
-            buf = (uint8_t *) b;
+        for (i = 0; i < n; i++) {
+            v128_copy(&keystream[i], &c->counter);
+            aes_icm_clock_counter(c, forIsmacryp);
         }
-#endif /* #if ALIGN_32 */
+        encrypt_blocks(keystream, n, c->expanded_key);
 
+        aes_icm_xor_keystream(buf, keystream, n * sizeof(v128_t));
+        buf += n * sizeof(v128_t);
+        num_blocks -= n;
     }
 
     /* if there is a tail end of the data, process it */
     if ((bytes_to_encr & 0xf) != 0) {
 
         /* fill buffer with new keystream */
-        aes_icm_advance_ismacryp(c, forIsmacryp);
+        v128_copy(&c->keystream_buffer, &c->counter);
+        encrypt_blocks(&c->keystream_buffer, 1, c->expanded_key);
+        aes_icm_clock_counter(c, forIsmacryp);
 
         for (i = 0; i < (bytes_to_encr & 0xf); i++)
             *buf++ ^= c->keystream_buffer.v8[i];
@@ -408,11 +421,89 @@ err_status_t aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c, unsigned char *buf,
     return err_status_ok;
 }
 
+/*
+ * aes_icm_crypt_vec() queues counter blocks taken in turn from each
+ * buffer, so that a run of AES_ICM_MAX_BLOCKS blocks given to
+ * encrypt_blocks may span several short buffers; dst and dst_len
+ * record where the keystream of each queued block goes
+ */
+
+static inline void aes_icm_xor_vec(v128_t *keystream, uint8_t **dst,
+        const unsigned int *dst_len, int n, const aes_icm_ctx_t *c,
+        aes_icm_blocks_func_t encrypt_blocks) {
+    unsigned int i;
+    int j;
+
+    encrypt_blocks(keystream, n, c->expanded_key);
+    for (j = 0; j < n; j++) {
+        if (dst_len[j] == sizeof(v128_t)) {
+            aes_icm_xor_keystream(dst[j], &keystream[j], sizeof(v128_t));
+        } else {
+            for (i = 0; i < dst_len[j]; i++)
+                dst[j][i] ^= keystream[j].v8[i];
+        }
+    }
+}
+
+err_status_t aes_icm_crypt_vec(const aes_icm_ctx_t *c, const v128_t *ivs,
+        uint8_t * const *bufs, const unsigned int *lens, int num_bufs,
+        aes_icm_blocks_func_t encrypt_blocks) {
+    v128_t keystream[AES_ICM_MAX_BLOCKS];
+    uint8_t *dst[AES_ICM_MAX_BLOCKS];
+    unsigned int dst_len[AES_ICM_MAX_BLOCKS];
+    v128_t counter;
+    unsigned int offset;
+    int n, k;
+
+    /* check that there's enough segment left for every buffer */
+    for (k = 0; k < num_bufs; k++) {
+        v128_xor(&counter, &c->offset, &ivs[k]);
+        if ((lens[k] + htons(counter.v16[7])) > 0xffff)
+            return err_status_terminus;
+    }
+
+    n = 0;
+    for (k = 0; k < num_bufs; k++) {
+        v128_xor(&counter, &c->offset, &ivs[k]);
+        for (offset = 0; offset < lens[k]; offset += sizeof(v128_t)) {
+            v128_copy(&keystream[n], &counter);
+            dst[n] = bufs[k] + offset;
+            dst_len[n] = lens[k] - offset;
+            if (dst_len[n] > sizeof(v128_t))
+                dst_len[n] = sizeof(v128_t);
+            n++;
+
+            /* clock counter forward, as aes_icm_clock_counter() does */
+            if (!++(counter.v8[15]))
+                ++(counter.v8[14]);
+
+            if (n == AES_ICM_MAX_BLOCKS) {
+                aes_icm_xor_vec(keystream, dst, dst_len, n, c, encrypt_blocks);
+                n = 0;
+            }
+        }
+    }
+    if (n > 0)
+        aes_icm_xor_vec(keystream, dst, dst_len, n, c, encrypt_blocks);
+
+    return err_status_ok;
+}
+
+err_status_t aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len, int forIsmacryp) {
+    return aes_icm_crypt(c, buf, enc_len, forIsmacryp, aes_encrypt_blocks);
+}
+
 err_status_t aes_icm_encrypt(aes_icm_ctx_t *c, unsigned char *buf,
         unsigned int *enc_len) {
     return aes_icm_encrypt_ismacryp(c, buf, enc_len, 0);
 }
 
+err_status_t aes_icm_encrypt_vec(const aes_icm_ctx_t *c, const v128_t *ivs,
+        uint8_t * const *bufs, const unsigned int *lens, int num_bufs) {
+    return aes_icm_crypt_vec(c, ivs, bufs, lens, num_bufs, aes_encrypt_blocks);
+}
+
 err_status_t aes_icm_output(aes_icm_ctx_t *c, uint8_t *buffer,
         int num_octets_to_output) {
     unsigned int len = num_octets_to_output;
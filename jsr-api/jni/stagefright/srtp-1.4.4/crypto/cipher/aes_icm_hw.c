@@ -0,0 +1,284 @@
+/*
+ * aes_icm_hw.c
+ *
+ * AES Integer Counter Mode using the AES instructions of the CPU
+ * (AES-NI on x86, Cryptography Extensions on ARMv8)
+ *
+ * The counter layout, key schedule and keystream buffering are the
+ * ones of aes_icm.c (see aes_icm_crypt()); only the block encryption
+ * differs.  The cipher
+ * type is only loaded by the crypto kernel when aes_icm_hw_available()
+ * reports that the running CPU implements the instructions.
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "aes_icm.h"
+#include "alloc.h"
+#define LOG_TAG "Srtp-1.4.4"
+
+/*
+ * AES_ICM_HW_X86 and AES_ICM_HW_ARM select the instruction set the
+ * block function is compiled for.  On x86 the function is compiled
+ * with a target attribute so the rest of the library does not need
+ * -maes; on ARM the compiler must be told to enable the crypto
+ * extensions (e.g. -march=armv8-a+crypto), since armeabi and
+ * armeabi-v7a toolchains do not accept them by default.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define AES_ICM_HW_X86 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#elif (defined(__aarch64__) || defined(__arm__)) && defined(__ARM_FEATURE_CRYPTO)
+#define AES_ICM_HW_ARM 1
+#include <arm_neon.h>
+#include <stdio.h>
+#endif
+
+debug_module_t mod_aes_icm_hw = { 0, /* debugging is off by default */
+"aes icm hw" /* printable module name       */
+};
+
+extern cipher_test_case_t aes_icm_test_case_0;
+
+#if defined(AES_ICM_HW_X86)
+
+/*
+ * the blocks are processed AES_ICM_MAX_BLOCKS at a time round by round,
+ * so that the latency of an aesenc is hidden behind the ones of the
+ * other blocks
+ */
+
+__attribute__((target("aes,sse2")))
+static void aes_icm_hw_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_expanded_key_t key) {
+    __m128i m[AES_ICM_MAX_BLOCKS];
+    __m128i k;
+    int i, r;
+
+    while (num_blocks > 0) {
+        int n = num_blocks < AES_ICM_MAX_BLOCKS ? num_blocks
+                : AES_ICM_MAX_BLOCKS;
+
+        k = _mm_loadu_si128((const __m128i *) &key[0]);
+        for (i = 0; i < n; i++)
+            m[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &blocks[i]),
+                    k);
+        for (r = 1; r < 10; r++) {
+            k = _mm_loadu_si128((const __m128i *) &key[r]);
+            for (i = 0; i < n; i++)
+                m[i] = _mm_aesenc_si128(m[i], k);
+        }
+        k = _mm_loadu_si128((const __m128i *) &key[10]);
+        for (i = 0; i < n; i++)
+            _mm_storeu_si128((__m128i *) &blocks[i],
+                    _mm_aesenclast_si128(m[i], k));
+
+        blocks += n;
+        num_blocks -= n;
+    }
+}
+
+static int aes_icm_hw_probe(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (ecx & bit_AES) && (edx & bit_SSE2);
+}
+
+#elif defined(AES_ICM_HW_ARM)
+
+static void aes_icm_hw_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_expanded_key_t key) {
+    uint8x16_t m[AES_ICM_MAX_BLOCKS];
+    uint8x16_t k;
+    int i, r;
+
+    while (num_blocks > 0) {
+        int n = num_blocks < AES_ICM_MAX_BLOCKS ? num_blocks
+                : AES_ICM_MAX_BLOCKS;
+
+        for (i = 0; i < n; i++)
+            m[i] = vld1q_u8(blocks[i].v8);
+        /* AESE does AddRoundKey before SubBytes/ShiftRows */
+        for (r = 0; r < 9; r++) {
+            k = vld1q_u8(key[r].v8);
+            for (i = 0; i < n; i++)
+                m[i] = vaesmcq_u8(vaeseq_u8(m[i], k));
+        }
+        k = vld1q_u8(key[9].v8);
+        for (i = 0; i < n; i++)
+            m[i] = vaeseq_u8(m[i], k);
+        k = vld1q_u8(key[10].v8);
+        for (i = 0; i < n; i++)
+            vst1q_u8(blocks[i].v8, veorq_u8(m[i], k));
+
+        blocks += n;
+        num_blocks -= n;
+    }
+}
+
+/*
+ * getauxval() is missing from older bionic releases, so the hardware
+ * capabilities are read from the auxiliary vector directly.
+ */
+static int aes_icm_hw_probe(void) {
+#if defined(__aarch64__)
+    const unsigned long hwcap_type = 16; /* AT_HWCAP */
+    const unsigned long hwcap_aes = 1 << 3; /* HWCAP_AES */
+#else
+    const unsigned long hwcap_type = 26; /* AT_HWCAP2 */
+    const unsigned long hwcap_aes = 1 << 0; /* HWCAP2_AES */
+#endif
+    unsigned long entry[2];
+    int found = 0;
+    FILE *f = fopen("/proc/self/auxv", "rb");
+
+    if (f == NULL)
+        return 0;
+    while (fread(entry, sizeof(entry), 1, f) == 1 && entry[0] != 0) {
+        if (entry[0] == hwcap_type) {
+            found = (entry[1] & hwcap_aes) != 0;
+            break;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+#else
+
+#define aes_icm_hw_encrypt_blocks aes_encrypt_blocks
+
+static int aes_icm_hw_probe(void) {
+    return 0;
+}
+
+#endif
+
+/*
+ * aes_icm_hw_available() returns 1 if the running CPU implements the
+ * AES instructions this file was compiled for, 0 otherwise
+ */
+
+int aes_icm_hw_available(void) {
+    static int available = -1;
+
+    if (available < 0) {
+        available = aes_icm_hw_probe();
+        debug_print(mod_aes_icm_hw, "hardware aes: %s",
+                available ? "available" : "not available");
+    }
+    return available;
+}
+
+static err_status_t aes_icm_hw_alloc(cipher_t **c, int key_len) {
+    extern cipher_type_t aes_icm_hw;
+    uint8_t *pointer;
+    int tmp;
+
+    debug_print(mod_aes_icm_hw, "allocating cipher with key length %d",
+            key_len);
+
+    if (key_len != 30)
+        return err_status_bad_param;
+
+    /* allocate memory a cipher of type aes_icm_hw */
+    tmp = (sizeof(aes_icm_ctx_t) + sizeof(cipher_t));
+    pointer = (uint8_t*) crypto_alloc(tmp);
+    if (pointer == NULL)
+        return err_status_alloc_fail;
+
+    /* set pointers */
+    *c = (cipher_t *) pointer;
+    (*c)->type = &aes_icm_hw;
+    (*c)->state = pointer + sizeof(cipher_t);
+
+    /* increment ref_count */
+    aes_icm_hw.ref_count++;
+
+    /* set key size        */
+    (*c)->key_len = key_len;
+
+    return err_status_ok;
+}
+
+static err_status_t aes_icm_hw_dealloc(cipher_t *c) {
+    extern cipher_type_t aes_icm_hw;
+
+    /* zeroize entire state*/
+    octet_string_set_to_zero((uint8_t *) c, sizeof(aes_icm_ctx_t)
+            + sizeof(cipher_t));
+
+    /* free memory */
+    crypto_free(c);
+
+    /* decrement ref_count */
+    aes_icm_hw.ref_count--;
+
+    return err_status_ok;
+}
+
+err_status_t aes_icm_hw_encrypt(aes_icm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len) {
+    return aes_icm_crypt(c, buf, enc_len, 0, aes_icm_hw_encrypt_blocks);
+}
+
+err_status_t aes_icm_hw_encrypt_vec(const aes_icm_ctx_t *c, const v128_t *ivs,
+        uint8_t * const *bufs, const unsigned int *lens, int num_bufs) {
+    return aes_icm_crypt_vec(c, ivs, bufs, lens, num_bufs,
+            aes_icm_hw_encrypt_blocks);
+}
+
+char aes_icm_hw_description[] = "aes integer counter mode (hardware)";
+
+/*
+ * the context layout, key setup and iv handling are shared with the
+ * table based aes_icm, and so are its test vectors
+ */
+
+cipher_type_t aes_icm_hw = { (cipher_alloc_func_t) aes_icm_hw_alloc,
+        (cipher_dealloc_func_t) aes_icm_hw_dealloc,
+        (cipher_init_func_t) aes_icm_context_init,
+        (cipher_encrypt_func_t) aes_icm_hw_encrypt,
+        (cipher_decrypt_func_t) aes_icm_hw_encrypt,
+        (cipher_set_iv_func_t) aes_icm_set_iv,
+        (char *) aes_icm_hw_description, (int) 0, /* instance count */
+        (cipher_test_case_t *) &aes_icm_test_case_0,
+        (debug_module_t *) &mod_aes_icm_hw };
@@ -138,6 +138,16 @@ err_status_t cipher_type_self_test(const cipher_type_t *ct) {
             return status;
         }
 
+        /* pass the additional authenticated data to AEAD ciphers */
+        if (ct->set_aad) {
+            status = cipher_set_aad(c, test_case->aad,
+                    test_case->aad_length_octets);
+            if (status) {
+                cipher_dealloc(c);
+                return status;
+            }
+        }
+
         /* encrypt */
         len = test_case->plaintext_length_octets;
         status = cipher_encrypt(c, buffer, &len);
@@ -146,6 +156,18 @@ err_status_t cipher_type_self_test(const cipher_type_t *ct) {
             return status;
         }
 
+        /* the tag of AEAD ciphers follows the ciphertext */
+        if (ct->get_tag) {
+            int tag_len = test_case->ciphertext_length_octets - len;
+
+            status = cipher_get_tag(c, buffer + len, &tag_len);
+            if (status) {
+                cipher_dealloc(c);
+                return status;
+            }
+            len += tag_len;
+        }
+
         debug_print(mod_cipher, "ciphertext:   %s", octet_string_hex_string(
                 buffer, test_case->ciphertext_length_octets));
 
@@ -202,6 +224,15 @@ err_status_t cipher_type_self_test(const cipher_type_t *ct) {
             return status;
         }
 
+        if (ct->set_aad) {
+            status = cipher_set_aad(c, test_case->aad,
+                    test_case->aad_length_octets);
+            if (status) {
+                cipher_dealloc(c);
+                return status;
+            }
+        }
+
         /* decrypt */
         len = test_case->ciphertext_length_octets;
         status = cipher_decrypt(c, buffer, &len);
@@ -235,6 +266,31 @@ err_status_t cipher_type_self_test(const cipher_type_t *ct) {
             return err_status_algo_fail;
         }
 
+        /*
+         * an AEAD cipher must reject the ciphertext once a bit of it
+         * has been flipped
+         */
+        if (ct->get_tag) {
+            for (i = 0; i < test_case->ciphertext_length_octets; i++)
+                buffer[i] = test_case->ciphertext[i];
+            buffer[test_case->ciphertext_length_octets - 1] ^= 0x01;
+            status = cipher_set_iv(c, test_case->idx);
+            if (status == err_status_ok)
+                status = cipher_set_aad(c, test_case->aad,
+                        test_case->aad_length_octets);
+            if (status) {
+                cipher_dealloc(c);
+                return status;
+            }
+            len = test_case->ciphertext_length_octets;
+            if (cipher_decrypt(c, buffer, &len) != err_status_auth_fail) {
+                debug_print(mod_cipher, "test case %d accepted a forged tag",
+                        case_num);
+                cipher_dealloc(c);
+                return err_status_algo_fail;
+            }
+        }
+
         /* deallocate the cipher */
         status = cipher_dealloc(c);
         if (status)
@@ -313,6 +369,16 @@ err_status_t cipher_type_self_test(const cipher_type_t *ct) {
             cipher_dealloc(c);
             return status;
         }
+        if (ct->get_tag) {
+            int tag_len = SELF_TEST_BUF_OCTETS - length;
+
+            status = cipher_get_tag(c, buffer + length, &tag_len);
+            if (status) {
+                cipher_dealloc(c);
+                return status;
+            }
+            length += tag_len;
+        }
         debug_print(mod_cipher, "ciphertext:   %s", octet_string_hex_string(
                 buffer, length));
 
@@ -104,9 +104,26 @@ err_status_t hmac_dealloc(auth_t *a) {
     return err_status_ok;
 }
 
+/*
+ * hmac_resume(ctx, midstate) sets ctx to a state saved right after a
+ * whole 64 octet block was hashed.  The message buffer of such a state
+ * is empty, so only the chaining value and the length are copied.
+ */
+
+static inline void hmac_resume(sha1_ctx_t *ctx, const sha1_ctx_t *midstate) {
+    ctx->H[0] = midstate->H[0];
+    ctx->H[1] = midstate->H[1];
+    ctx->H[2] = midstate->H[2];
+    ctx->H[3] = midstate->H[3];
+    ctx->H[4] = midstate->H[4];
+    ctx->octets_in_buffer = 0;
+    ctx->num_bits_in_msg = midstate->num_bits_in_msg;
+}
+
 err_status_t hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
     int i;
     uint8_t ipad[64];
+    uint8_t opad[64];
 
     /*
      * check key length - note that we don't support keys larger
@@ -121,12 +138,12 @@ err_status_t hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
      */
     for (i = 0; i < key_len; i++) {
         ipad[i] = key[i] ^ 0x36;
-        state->opad[i] = key[i] ^ 0x5c;
+        opad[i] = key[i] ^ 0x5c;
     }
     /* set the rest of ipad, opad to constant values */
     for (; i < 64; i++) {
         ipad[i] = 0x36;
-        ((uint8_t *) state->opad)[i] = 0x5c;
+        opad[i] = 0x5c;
     }
 
     debug_print(mod_hmac, "ipad: %s", octet_string_hex_string(ipad, 64));
@@ -138,12 +155,22 @@ err_status_t hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
     sha1_update(&state->init_ctx, ipad, 64);
     memcpy(&state->ctx, &state->init_ctx, sizeof(sha1_ctx_t));
 
+    /*
+     * hash opad ^ key once here, so that hmac_compute() only has to
+     * resume from that state for the outer hash
+     */
+    sha1_init(&state->opad_ctx);
+    sha1_update(&state->opad_ctx, opad, 64);
+
+    octet_string_set_to_zero(ipad, sizeof(ipad));
+    octet_string_set_to_zero(opad, sizeof(opad));
+
     return err_status_ok;
 }
 
 err_status_t hmac_start(hmac_ctx_t *state) {
 
-    memcpy(&state->ctx, &state->init_ctx, sizeof(sha1_ctx_t));
+    hmac_resume(&state->ctx, &state->init_ctx);
 
     return err_status_ok;
 }
@@ -181,11 +208,8 @@ err_status_t hmac_compute(hmac_ctx_t *state, const void *message,
     debug_print(mod_hmac, "intermediate state: %s", octet_string_hex_string(
             (uint8_t *) H, 20));
 
-    /* re-initialize hash context */
-    sha1_init(&state->ctx);
-
-    /* hash opad ^ key  */
-    sha1_update(&state->ctx, (uint8_t *) state->opad, 64);
+    /* resume from the state after opad ^ key */
+    hmac_resume(&state->ctx, &state->opad_ctx);
 
     /* hash the result of the inner hash */
     sha1_update(&state->ctx, (uint8_t *) H, 20);
@@ -82,36 +82,76 @@ void sha1(const uint8_t *msg, int octets_in_msg, uint32_t hash_value[5]) {
 }
 
 /*
- *  sha1_core(M, H) computes the core compression function, where M is
- *  the next part of the message (in network byte order) and H is the
- *  intermediate state { H0, H1, ...} (in host byte order)
+ * sha1_core_rounds(W, H) runs the 80 rounds of the compression
+ * function over the expanded message W (in host byte order) and adds
+ * the result into the intermediate state H
+ */
+
+void sha1_core_rounds(const uint32_t W[80], uint32_t hash_value[5]) {
+    uint32_t A, B, C, D, E, TEMP;
+    int t;
+
+    A = hash_value[0];
+    B = hash_value[1];
+    C = hash_value[2];
+    D = hash_value[3];
+    E = hash_value[4];
+
+    for (t = 0; t < 20; t++) {
+        TEMP = S5(A) + f0(B,C,D) + E + W[t] + SHA_K0;
+        E = D;
+        D = C;
+        C = S30(B);
+        B = A;
+        A = TEMP;
+    }
+    for (; t < 40; t++) {
+        TEMP = S5(A) + f1(B,C,D) + E + W[t] + SHA_K1;
+        E = D;
+        D = C;
+        C = S30(B);
+        B = A;
+        A = TEMP;
+    }
+    for (; t < 60; t++) {
+        TEMP = S5(A) + f2(B,C,D) + E + W[t] + SHA_K2;
+        E = D;
+        D = C;
+        C = S30(B);
+        B = A;
+        A = TEMP;
+    }
+    for (; t < 80; t++) {
+        TEMP = S5(A) + f3(B,C,D) + E + W[t] + SHA_K3;
+        E = D;
+        D = C;
+        C = S30(B);
+        B = A;
+        A = TEMP;
+    }
+
+    hash_value[0] += A;
+    hash_value[1] += B;
+    hash_value[2] += C;
+    hash_value[3] += D;
+    hash_value[4] += E;
+}
+
+/*
+ *  sha1_core_generic(M, H) computes the core compression function, where
+ *  M is the next part of the message (in network byte order) and H is
+ *  the intermediate state { H0, H1, ...} (in host byte order)
  *
  *  this function does not do any of the padding required in the
  *  complete SHA1 function
- *
- *  this function is used in the SEAL 3.0 key setup routines
- *  (crypto/cipher/seal.c)
  */
 
-void sha1_core(const uint32_t M[16], uint32_t hash_value[5]) {
-    uint32_t H0;
-    uint32_t H1;
-    uint32_t H2;
-    uint32_t H3;
-    uint32_t H4;
+static void sha1_core_generic(const uint32_t M[16], uint32_t hash_value[5]) {
     uint32_t W[80];
-    uint32_t A, B, C, D, E, TEMP;
+    uint32_t TEMP;
     int t;
 
-    /* copy hash_value into H0, H1, H2, H3, H4 */
-    H0 = hash_value[0];
-    H1 = hash_value[1];
-    H2 = hash_value[2];
-    H3 = hash_value[3];
-    H4 = hash_value[4];
-
     /* copy/xor message into array */
-
     W[0] = be32_to_cpu(M[0]);
     W[1] = be32_to_cpu(M[1]);
     W[2] = be32_to_cpu(M[2]);
@@ -167,52 +207,83 @@ void sha1_core(const uint32_t M[16], uint32_t hash_value[5]) {
         W[t] = S1(TEMP);
     }
 
-    A = H0;
-    B = H1;
-    C = H2;
-    D = H3;
-    E = H4;
+    sha1_core_rounds(W, hash_value);
+}
 
-    for (t = 0; t < 20; t++) {
-        TEMP = S5(A) + f0(B,C,D) + E + W[t] + SHA_K0;
-        E = D;
-        D = C;
-        C = S30(B);
-        B = A;
-        A = TEMP;
-    }
-    for (; t < 40; t++) {
-        TEMP = S5(A) + f1(B,C,D) + E + W[t] + SHA_K1;
-        E = D;
-        D = C;
-        C = S30(B);
-        B = A;
-        A = TEMP;
-    }
-    for (; t < 60; t++) {
-        TEMP = S5(A) + f2(B,C,D) + E + W[t] + SHA_K2;
-        E = D;
-        D = C;
-        C = S30(B);
-        B = A;
-        A = TEMP;
+/*
+ * sha1_core_func points to the fastest implementation of the compression
+ * function, chosen by sha1_core_select(); sha1_update() and sha1_final()
+ * call it directly
+ */
+
+static sha1_core_func_t sha1_core_func = sha1_core_generic;
+
+static sha1_core_type_t sha1_core_current = sha1_core_type_generic;
+
+/*
+ * sha1_core(M, H) computes the core compression function with the
+ * implementation selected by sha1_core_select() or sha1_core_use()
+ *
+ *  this function is used in the SEAL 3.0 key setup routines
+ *  (crypto/cipher/seal.c)
+ */
+
+void sha1_core(const uint32_t M[16], uint32_t hash_value[5]) {
+    sha1_core_func(M, hash_value);
+}
+
+int sha1_core_available(sha1_core_type_t type) {
+    switch (type) {
+    case sha1_core_type_generic:
+        return 1;
+    case sha1_core_type_simd:
+        return sha1_core_simd_available();
+    case sha1_core_type_hw:
+        return sha1_core_hw_available();
     }
-    for (; t < 80; t++) {
-        TEMP = S5(A) + f3(B,C,D) + E + W[t] + SHA_K3;
-        E = D;
-        D = C;
-        C = S30(B);
-        B = A;
-        A = TEMP;
+    return 0;
+}
+
+err_status_t sha1_core_use(sha1_core_type_t type) {
+    if (!sha1_core_available(type))
+        return err_status_bad_param;
+
+    switch (type) {
+    case sha1_core_type_generic:
+        sha1_core_func = sha1_core_generic;
+        break;
+    case sha1_core_type_simd:
+        sha1_core_func = sha1_core_simd;
+        break;
+    case sha1_core_type_hw:
+        sha1_core_func = sha1_core_hw;
+        break;
     }
+    sha1_core_current = type;
 
-    hash_value[0] = H0 + A;
-    hash_value[1] = H1 + B;
-    hash_value[2] = H2 + C;
-    hash_value[3] = H3 + D;
-    hash_value[4] = H4 + E;
+    debug_print(mod_sha1, "using %s sha1_core()", sha1_core_name(type));
 
-    return;
+    return err_status_ok;
+}
+
+sha1_core_type_t sha1_core_select(void) {
+    if (sha1_core_use(sha1_core_type_hw) != err_status_ok &&
+        sha1_core_use(sha1_core_type_simd) != err_status_ok)
+        sha1_core_use(sha1_core_type_generic);
+
+    return sha1_core_current;
+}
+
+const char *sha1_core_name(sha1_core_type_t type) {
+    switch (type) {
+    case sha1_core_type_generic:
+        return "generic";
+    case sha1_core_type_simd:
+        return "simd message schedule";
+    case sha1_core_type_hw:
+        return "hardware";
+    }
+    return "unknown";
 }
 
 void sha1_init(sha1_ctx_t *ctx) {
@@ -257,7 +328,7 @@ void sha1_update(sha1_ctx_t *ctx, const uint8_t *msg, int octets_in_msg) {
 
             debug_print(mod_sha1, "(update) running sha1_core()", NULL);
 
-            sha1_core(ctx->M, ctx->H);
+            sha1_core_func(ctx->M, ctx->H);
 
         } else {
 
@@ -280,175 +351,32 @@ void sha1_update(sha1_ctx_t *ctx, const uint8_t *msg, int octets_in_msg) {
  */
 
 void sha1_final(sha1_ctx_t *ctx, uint32_t *output) {
-    uint32_t A, B, C, D, E, TEMP;
-    uint32_t W[80];
-    int i, t;
+    uint8_t *buf = (uint8_t *) ctx->M;
+    int i = ctx->octets_in_buffer;
 
     /*
-     * process the remaining octets_in_buffer, padding and terminating as
-     * necessary
+     * pad the remaining octets_in_buffer in place: a one bit, zeros,
+     * then the bit-length of the message in the last word.  If there is
+     * no room left for the length, the block is processed and a second
+     * one holding only the length follows.
      */
-    {
-        int tail = ctx->octets_in_buffer % 4;
-
-        /* copy/xor message into array */
-        for (i = 0; i < (ctx->octets_in_buffer + 3) / 4; i++)
-            W[i] = be32_to_cpu(ctx->M[i]);
-
-        /* set the high bit of the octet immediately following the message */
-        switch (tail) {
-        case (3):
-            W[i - 1] = (be32_to_cpu(ctx->M[i - 1]) & 0xffffff00) | 0x80;
-            W[i] = 0x0;
-            break;
-        case (2):
-            W[i - 1] = (be32_to_cpu(ctx->M[i - 1]) & 0xffff0000) | 0x8000;
-            W[i] = 0x0;
-            break;
-        case (1):
-            W[i - 1] = (be32_to_cpu(ctx->M[i - 1]) & 0xff000000) | 0x800000;
-            W[i] = 0x0;
-            break;
-        case (0):
-            W[i] = 0x80000000;
-            break;
-        }
-
-        /* zeroize remaining words */
-        for (i++; i < 15; i++)
-            W[i] = 0x0;
-
-        /*
-         * if there is room at the end of the word array, then set the
-         * last word to the bit-length of the message; otherwise, set that
-         * word to zero and then we need to do one more run of the
-         * compression algo.
-         */
-        if (ctx->octets_in_buffer < 56)
-            W[15] = ctx->num_bits_in_msg;
-        else if (ctx->octets_in_buffer < 60)
-            W[15] = 0x0;
-
-        /* process the word array */
-        for (t = 16; t < 80; t++) {
-            TEMP = W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16];
-            W[t] = S1(TEMP);
-        }
-
-        A = ctx->H[0];
-        B = ctx->H[1];
-        C = ctx->H[2];
-        D = ctx->H[3];
-        E = ctx->H[4];
-
-        for (t = 0; t < 20; t++) {
-            TEMP = S5(A) + f0(B,C,D) + E + W[t] + SHA_K0;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-        for (; t < 40; t++) {
-            TEMP = S5(A) + f1(B,C,D) + E + W[t] + SHA_K1;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-        for (; t < 60; t++) {
-            TEMP = S5(A) + f2(B,C,D) + E + W[t] + SHA_K2;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-        for (; t < 80; t++) {
-            TEMP = S5(A) + f3(B,C,D) + E + W[t] + SHA_K3;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
+    buf[i++] = 0x80;
+    if (i > 56) {
+        for (; i < 64; i++)
+            buf[i] = 0x0;
 
-        ctx->H[0] += A;
-        ctx->H[1] += B;
-        ctx->H[2] += C;
-        ctx->H[3] += D;
-        ctx->H[4] += E;
+        debug_print(mod_sha1, "(final) running sha1_core() again", NULL);
 
+        sha1_core_func(ctx->M, ctx->H);
+        i = 0;
     }
+    for (; i < 60; i++)
+        buf[i] = 0x0;
+    ctx->M[15] = be32_to_cpu(ctx->num_bits_in_msg);
 
     debug_print(mod_sha1, "(final) running sha1_core()", NULL);
 
-    if (ctx->octets_in_buffer >= 56) {
-
-        debug_print(mod_sha1, "(final) running sha1_core() again", NULL);
-
-        /* we need to do one final run of the compression algo */
-
-        /*
-         * set initial part of word array to zeros, and set the
-         * final part to the number of bits in the message
-         */
-        for (i = 0; i < 15; i++)
-            W[i] = 0x0;
-        W[15] = ctx->num_bits_in_msg;
-
-        /* process the word array */
-        for (t = 16; t < 80; t++) {
-            TEMP = W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16];
-            W[t] = S1(TEMP);
-        }
-
-        A = ctx->H[0];
-        B = ctx->H[1];
-        C = ctx->H[2];
-        D = ctx->H[3];
-        E = ctx->H[4];
-
-        for (t = 0; t < 20; t++) {
-            TEMP = S5(A) + f0(B,C,D) + E + W[t] + SHA_K0;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-        for (; t < 40; t++) {
-            TEMP = S5(A) + f1(B,C,D) + E + W[t] + SHA_K1;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-        for (; t < 60; t++) {
-            TEMP = S5(A) + f2(B,C,D) + E + W[t] + SHA_K2;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-        for (; t < 80; t++) {
-            TEMP = S5(A) + f3(B,C,D) + E + W[t] + SHA_K3;
-            E = D;
-            D = C;
-            C = S30(B);
-            B = A;
-            A = TEMP;
-        }
-
-        ctx->H[0] += A;
-        ctx->H[1] += B;
-        ctx->H[2] += C;
-        ctx->H[3] += D;
-        ctx->H[4] += E;
-    }
+    sha1_core_func(ctx->M, ctx->H);
 
     /* copy result into output buffer */
     output[0] = be32_to_cpu(ctx->H[0]);
@@ -462,4 +390,3 @@ void sha1_final(sha1_ctx_t *ctx, uint32_t *output) {
 
     return;
 }
-
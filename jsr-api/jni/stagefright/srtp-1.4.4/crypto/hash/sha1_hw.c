@@ -0,0 +1,371 @@
+/*
+ * sha1_hw.c
+ *
+ * accelerated implementations of the SHA-1 compression function:
+ *
+ *   sha1_core_simd  computes the message schedule with SSSE3 (x86) or
+ *                   NEON (ARM) and runs the rounds with the portable
+ *                   sha1_core_rounds()
+ *   sha1_core_hw    uses the SHA extensions (x86) or the SHA1
+ *                   instructions of the ARMv8 Cryptography Extensions
+ *
+ * Both are only used when the matching *_available() function reports
+ * that the running CPU implements the instructions; sha1_core_select()
+ * in sha1.c makes that choice.
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sha1.h"
+#define LOG_TAG "Srtp-1.4.4"
+
+/*
+ * as in aes_icm_hw.c, the x86 functions are compiled with target
+ * attributes, while the ARM ones need the compiler to be told about
+ * NEON (armeabi-v7a) or the crypto extensions (-march=armv8-a+crypto)
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SHA1_SIMD_X86 1
+#define SHA1_HW_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON__))
+#define SHA1_SIMD_ARM 1
+#if defined(__ARM_FEATURE_CRYPTO)
+#define SHA1_HW_ARM 1
+#endif
+#include <arm_neon.h>
+#include <stdio.h>
+#endif
+
+#if defined(SHA1_SIMD_X86)
+
+/*
+ * the message schedule is computed four words at a time.  W[t+3]
+ * depends on W[t], which is computed in the same vector: it is first
+ * computed with W[t] = 0, then rol1(W[t]) is xored into it.
+ */
+
+__attribute__((target("ssse3")))
+static void sha1_schedule(const uint32_t M[16], uint32_t W[80]) {
+    const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5,
+            6, 7, 0, 1, 2, 3);
+    __m128i w[20];
+    __m128i x, r, fix;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (M + 4 * i)),
+                bswap);
+
+    for (i = 4; i < 20; i++) {
+        x = _mm_srli_si128(w[i - 1], 4); /* W[t-3], 0 for the last lane */
+        x = _mm_xor_si128(x, w[i - 2]); /* W[t-8]  */
+        x = _mm_xor_si128(x, _mm_alignr_epi8(w[i - 3], w[i - 4], 8)); /* W[t-14] */
+        x = _mm_xor_si128(x, w[i - 4]); /* W[t-16] */
+        r = _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));
+        fix = _mm_slli_si128(r, 12);
+        fix = _mm_or_si128(_mm_slli_epi32(fix, 1), _mm_srli_epi32(fix, 31));
+        w[i] = _mm_xor_si128(r, fix);
+    }
+
+    for (i = 0; i < 20; i++)
+        _mm_storeu_si128((__m128i *) (W + 4 * i), w[i]);
+}
+
+static int sha1_cpu_has(int want_sha) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    if (!(ecx & bit_SSSE3))
+        return 0;
+    if (!want_sha)
+        return 1;
+    if (!(ecx & bit_SSE4_1) || __get_cpuid_max(0, NULL) < 7)
+        return 0;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1 << 29)) != 0; /* SHA */
+}
+
+#elif defined(SHA1_SIMD_ARM)
+
+static void sha1_schedule(const uint32_t M[16], uint32_t W[80]) {
+    const uint32x4_t zero = vdupq_n_u32(0);
+    uint32x4_t w[20];
+    uint32x4_t x, r, fix;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(
+                (const uint8_t *) (M + 4 * i))));
+
+    for (i = 4; i < 20; i++) {
+        x = vextq_u32(w[i - 1], zero, 1); /* W[t-3], 0 for the last lane */
+        x = veorq_u32(x, w[i - 2]); /* W[t-8]  */
+        x = veorq_u32(x, vextq_u32(w[i - 4], w[i - 3], 2)); /* W[t-14] */
+        x = veorq_u32(x, w[i - 4]); /* W[t-16] */
+        r = vorrq_u32(vshlq_n_u32(x, 1), vshrq_n_u32(x, 31));
+        fix = vextq_u32(zero, r, 1);
+        fix = vorrq_u32(vshlq_n_u32(fix, 1), vshrq_n_u32(fix, 31));
+        w[i] = veorq_u32(r, fix);
+    }
+
+    for (i = 0; i < 20; i++)
+        vst1q_u32(W + 4 * i, w[i]);
+}
+
+/*
+ * getauxval() is missing from older bionic releases, so the hardware
+ * capabilities are read from the auxiliary vector directly
+ */
+static unsigned long sha1_read_hwcap(unsigned long type) {
+    unsigned long entry[2];
+    unsigned long value = 0;
+    FILE *f = fopen("/proc/self/auxv", "rb");
+
+    if (f == NULL)
+        return 0;
+    while (fread(entry, sizeof(entry), 1, f) == 1 && entry[0] != 0) {
+        if (entry[0] == type) {
+            value = entry[1];
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+static int sha1_cpu_has(int want_sha) {
+#if defined(__aarch64__)
+    /* NEON is part of the base architecture */
+    return !want_sha || (sha1_read_hwcap(16) & (1 << 5)); /* HWCAP_SHA1 */
+#else
+    if (!(sha1_read_hwcap(16) & (1 << 12))) /* HWCAP_NEON */
+        return 0;
+    return !want_sha || (sha1_read_hwcap(26) & (1 << 2)); /* HWCAP2_SHA1 */
+#endif
+}
+
+#endif
+
+#if defined(SHA1_SIMD_X86) || defined(SHA1_SIMD_ARM)
+
+void sha1_core_simd(const uint32_t M[16], uint32_t hash_value[5]) {
+    uint32_t W[80];
+
+    sha1_schedule(M, W);
+    sha1_core_rounds(W, hash_value);
+}
+
+int sha1_core_simd_available(void) {
+    static int available = -1;
+
+    if (available < 0)
+        available = sha1_cpu_has(0);
+    return available;
+}
+
+#else
+
+void sha1_core_simd(const uint32_t M[16], uint32_t hash_value[5]) {
+    sha1_core(M, hash_value);
+}
+
+int sha1_core_simd_available(void) {
+    return 0;
+}
+
+#endif
+
+#if defined(SHA1_HW_X86)
+
+/*
+ * SHA-NI: sha1rnds4 runs four rounds, sha1nexte computes E for the next
+ * four from the current A, and sha1msg1/sha1msg2 compute the message
+ * schedule four words at a time.  Each step below handles four rounds;
+ * the schedule of the message words used four steps later is
+ * interleaved with them.
+ */
+
+#define SHA1_NI_STEP(e_cur, e_next, m0, m1, m2, m3, func) \
+    e_cur = _mm_sha1nexte_epu32(e_cur, m0); \
+    e_next = abcd; \
+    m1 = _mm_sha1msg2_epu32(m1, m0); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_cur, func); \
+    m3 = _mm_sha1msg1_epu32(m3, m0); \
+    m2 = _mm_xor_si128(m2, m0)
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha1_core_hw(const uint32_t M[16], uint32_t hash_value[5]) {
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+            0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e0, e0_save, e1;
+    __m128i msg0, msg1, msg2, msg3;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) hash_value),
+            0x1b);
+    e0 = _mm_set_epi32(hash_value[4], 0, 0, 0);
+    abcd_save = abcd;
+    e0_save = e0;
+
+    /* rounds 0-3 */
+    msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (M + 0)), bswap);
+    e0 = _mm_add_epi32(e0, msg0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    /* rounds 4-7 */
+    msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (M + 4)), bswap);
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+    /* rounds 8-11 */
+    msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (M + 8)), bswap);
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    /* rounds 12-79 */
+    msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (M + 12)), bswap);
+    SHA1_NI_STEP(e1, e0, msg3, msg0, msg1, msg2, 0);
+    SHA1_NI_STEP(e0, e1, msg0, msg1, msg2, msg3, 0);
+    SHA1_NI_STEP(e1, e0, msg1, msg2, msg3, msg0, 1);
+    SHA1_NI_STEP(e0, e1, msg2, msg3, msg0, msg1, 1);
+    SHA1_NI_STEP(e1, e0, msg3, msg0, msg1, msg2, 1);
+    SHA1_NI_STEP(e0, e1, msg0, msg1, msg2, msg3, 1);
+    SHA1_NI_STEP(e1, e0, msg1, msg2, msg3, msg0, 1);
+    SHA1_NI_STEP(e0, e1, msg2, msg3, msg0, msg1, 2);
+    SHA1_NI_STEP(e1, e0, msg3, msg0, msg1, msg2, 2);
+    SHA1_NI_STEP(e0, e1, msg0, msg1, msg2, msg3, 2);
+    SHA1_NI_STEP(e1, e0, msg1, msg2, msg3, msg0, 2);
+    SHA1_NI_STEP(e0, e1, msg2, msg3, msg0, msg1, 2);
+    SHA1_NI_STEP(e1, e0, msg3, msg0, msg1, msg2, 3);
+    SHA1_NI_STEP(e0, e1, msg0, msg1, msg2, msg3, 3);
+    SHA1_NI_STEP(e1, e0, msg1, msg2, msg3, msg0, 3);
+    SHA1_NI_STEP(e0, e1, msg2, msg3, msg0, msg1, 3);
+    SHA1_NI_STEP(e1, e0, msg3, msg0, msg1, msg2, 3);
+
+    /* add the result into the state */
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+
+    _mm_storeu_si128((__m128i *) hash_value, _mm_shuffle_epi32(abcd, 0x1b));
+    hash_value[4] = _mm_extract_epi32(e0, 3);
+}
+
+int sha1_core_hw_available(void) {
+    static int available = -1;
+
+    if (available < 0)
+        available = sha1_cpu_has(1);
+    return available;
+}
+
+#elif defined(SHA1_HW_ARM)
+
+/*
+ * the message schedule comes from sha1_schedule(); each group of four
+ * rounds is then a single SHA1C/SHA1P/SHA1M instruction, SHA1H giving
+ * E for the next group
+ */
+
+void sha1_core_hw(const uint32_t M[16], uint32_t hash_value[5]) {
+    uint32_t W[80];
+    uint32x4_t abcd, abcd_save, wk;
+    uint32_t e, e_next;
+    int g;
+
+    sha1_schedule(M, W);
+
+    abcd = vld1q_u32(hash_value);
+    abcd_save = abcd;
+    e = hash_value[4];
+
+    for (g = 0; g < 5; g++) {
+        wk = vaddq_u32(vld1q_u32(W + 4 * g), vdupq_n_u32(0x5A827999));
+        e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e, wk);
+        e = e_next;
+    }
+    for (; g < 10; g++) {
+        wk = vaddq_u32(vld1q_u32(W + 4 * g), vdupq_n_u32(0x6ED9EBA1));
+        e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e, wk);
+        e = e_next;
+    }
+    for (; g < 15; g++) {
+        wk = vaddq_u32(vld1q_u32(W + 4 * g), vdupq_n_u32(0x8F1BBCDC));
+        e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e, wk);
+        e = e_next;
+    }
+    for (; g < 20; g++) {
+        wk = vaddq_u32(vld1q_u32(W + 4 * g), vdupq_n_u32(0xCA62C1D6));
+        e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e, wk);
+        e = e_next;
+    }
+
+    vst1q_u32(hash_value, vaddq_u32(abcd, abcd_save));
+    hash_value[4] += e;
+}
+
+int sha1_core_hw_available(void) {
+    static int available = -1;
+
+    if (available < 0)
+        available = sha1_cpu_has(1);
+    return available;
+}
+
+#else
+
+void sha1_core_hw(const uint32_t M[16], uint32_t hash_value[5]) {
+    sha1_core(M, hash_value);
+}
+
+int sha1_core_hw_available(void) {
+    return 0;
+}
+
+#endif
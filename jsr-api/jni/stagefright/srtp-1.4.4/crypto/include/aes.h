@@ -50,6 +50,7 @@
 
 #include "datatypes.h"
 #include "gf2_8.h"
+#include "err.h"
 
 /* aes internals */
 
@@ -63,8 +64,28 @@ void aes_expand_decryption_key(const v128_t *key,
 
 void aes_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key);
 
+void aes_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_expanded_key_t exp_key);
+
 void aes_decrypt(v128_t *plaintext, const aes_expanded_key_t exp_key);
 
+/*
+ * aes_key_t holds the encryption round keys of AES-128 (10 rounds) or
+ * AES-256 (14 rounds); it is used where both key sizes are needed,
+ * i.e. by AES-GCM and by the SRTP key derivation
+ */
+
+typedef struct {
+    v128_t round[15];
+    int num_rounds;
+} aes_key_t;
+
+err_status_t aes_expand_key(const uint8_t *key, int key_len,
+        aes_key_t *exp_key);
+
+void aes_key_encrypt_blocks(v128_t *blocks, int num_blocks,
+        const aes_key_t *exp_key);
+
 #if 0
 /*
  * internal functions
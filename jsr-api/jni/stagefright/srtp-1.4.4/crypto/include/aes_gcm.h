@@ -0,0 +1,110 @@
+/*
+ * aes_gcm.h
+ *
+ * Header for AES Galois/Counter Mode.
+ *
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AES_GCM_H
+#define AES_GCM_H
+
+#include "aes.h"
+#include "cipher.h"
+
+/*
+ * the key of an aes_gcm cipher is the AES key (16 or 32 octets)
+ * followed by a 12 octet salt, as for the AEAD_AES_128_GCM and
+ * AEAD_AES_256_GCM SRTP transforms of RFC 7714; the iv passed to
+ * set_iv is 12 octets long and is exored with the salt
+ */
+
+#define AES_GCM_SALT_LEN   12
+#define AES_GCM_TAG_LEN    16
+#define AES_GCM_MAX_BLOCKS 8
+
+typedef struct {
+    aes_key_t key; /* the AES round keys               */
+    v128_t h; /* the hash subkey E(K, 0^128)      */
+    uint64_t hl[16]; /* GHASH tables of the generic     */
+    uint64_t hh[16]; /* implementation (multiples of h) */
+    v128_t salt; /* exored into the iv               */
+    v128_t j0; /* pre-counter block, for the tag   */
+    v128_t counter; /* next counter block               */
+    v128_t keystream_buffer; /* buffers bytes of keystream       */
+    v128_t ghash; /* GHASH accumulator                */
+    v128_t ghash_buffer; /* partial block of GHASH input     */
+    int bytes_in_buffer; /* unused bytes in keystream_buffer */
+    int ghash_bytes; /* bytes in ghash_buffer            */
+    int aad_done; /* the AAD has been padded          */
+    uint64_t aad_len; /* octets of AAD since set_iv       */
+    uint64_t data_len; /* octets of data since set_iv      */
+    int key_size; /* octets in the AES key            */
+    int accel; /* use the CPU AES and GHASH code   */
+} aes_gcm_ctx_t;
+
+err_status_t aes_gcm_context_init(aes_gcm_ctx_t *c, const uint8_t *key);
+
+err_status_t aes_gcm_set_iv(aes_gcm_ctx_t *c, void *iv);
+
+err_status_t aes_gcm_set_aad(aes_gcm_ctx_t *c, const uint8_t *aad,
+        unsigned int aad_len);
+
+err_status_t aes_gcm_encrypt(aes_gcm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len);
+
+err_status_t aes_gcm_decrypt(aes_gcm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len);
+
+err_status_t aes_gcm_get_tag(aes_gcm_ctx_t *c, uint8_t *tag, int *len);
+
+/*
+ * aes_gcm_hw_available() returns 1 if the running CPU has both the
+ * AES and the carry-less multiply (PCLMULQDQ or PMULL) instructions,
+ * in which case the aes_gcm ciphers use them
+ */
+
+int aes_gcm_hw_available(void);
+
+extern cipher_type_t aes_gcm_128;
+
+extern cipher_type_t aes_gcm_256;
+
+#define cipher_type_is_aes_gcm(ct) ((ct) == &aes_gcm_128 || (ct) == &aes_gcm_256)
+
+#endif /* AES_GCM_H */
@@ -22,6 +22,17 @@ typedef struct {
     int bytes_in_buffer; /* number of unused bytes in buffer */
 } aes_icm_ctx_t;
 
+/*
+ * an aes_icm_blocks_func_t encrypts num_blocks independent blocks in
+ * place with the expanded key; aes_icm_crypt() hands it up to
+ * AES_ICM_MAX_BLOCKS counter blocks at a time
+ */
+
+#define AES_ICM_MAX_BLOCKS 8
+
+typedef void (*aes_icm_blocks_func_t)(v128_t *blocks, int num_blocks,
+        const aes_expanded_key_t exp_key);
+
 err_status_t aes_icm_context_init(aes_icm_ctx_t *c, const unsigned char *key);
 
 err_status_t aes_icm_set_iv(aes_icm_ctx_t *c, void *iv);
@@ -39,5 +50,49 @@ err_status_t aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c, unsigned char *buf,
 
 err_status_t aes_icm_alloc_ismacryp(cipher_t **c, int key_len, int forIsmacryp);
 
+err_status_t aes_icm_crypt(aes_icm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len, int forIsmacryp,
+        aes_icm_blocks_func_t encrypt_blocks);
+
+/*
+ * aes_icm_crypt_vec(c, ivs, bufs, lens, num_bufs, encrypt_blocks)
+ * encrypts (or decrypts) each of the num_bufs buffers bufs[k], of
+ * lens[k] octets, from the start of the keystream selected by ivs[k],
+ * with the key of c.  The counter blocks of all of the buffers are
+ * handed to encrypt_blocks together, so that short packets keep it as
+ * busy as long ones.  c itself is not changed.
+ *
+ * aes_icm_encrypt_vec() and aes_icm_hw_encrypt_vec() use the block
+ * function of the aes_icm and aes_icm_hw cipher types, respectively
+ */
+
+err_status_t aes_icm_crypt_vec(const aes_icm_ctx_t *c, const v128_t *ivs,
+        uint8_t * const *bufs, const unsigned int *lens, int num_bufs,
+        aes_icm_blocks_func_t encrypt_blocks);
+
+err_status_t aes_icm_encrypt_vec(const aes_icm_ctx_t *c, const v128_t *ivs,
+        uint8_t * const *bufs, const unsigned int *lens, int num_bufs);
+
+err_status_t aes_icm_hw_encrypt_vec(const aes_icm_ctx_t *c, const v128_t *ivs,
+        uint8_t * const *bufs, const unsigned int *lens, int num_bufs);
+
+/*
+ * aes_icm_hw is the same cipher computed with the AES instructions of
+ * the CPU, if aes_icm_hw_available() returns 1.  Both types share
+ * aes_icm_ctx_t, so code that needs to know whether a cipher is an
+ * integer counter mode one must use cipher_type_is_aes_icm().
+ */
+
+extern cipher_type_t aes_icm;
+
+extern cipher_type_t aes_icm_hw;
+
+err_status_t aes_icm_hw_encrypt(aes_icm_ctx_t *c, unsigned char *buf,
+        unsigned int *enc_len);
+
+int aes_icm_hw_available(void);
+
+#define cipher_type_is_aes_icm(ct) ((ct) == &aes_icm || (ct) == &aes_icm_hw)
+
 #endif /* AES_ICM_H */
 
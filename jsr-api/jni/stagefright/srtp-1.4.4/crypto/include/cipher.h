@@ -112,6 +112,25 @@ typedef err_status_t (*cipher_decrypt_func_t)(void *state, uint8_t *buffer,
 
 typedef err_status_t (*cipher_set_iv_func_t)(cipher_pointer_t cp, void *iv);
 
+/*
+ * a cipher_set_aad_func_t passes the additional authenticated data to
+ * an AEAD cipher; it is called after set_iv and before encrypt/decrypt
+ */
+
+typedef err_status_t (*cipher_set_aad_func_t)(void *state, const uint8_t *aad,
+        unsigned int aad_len);
+
+/*
+ * a cipher_get_tag_func_t writes the authentication tag of the data
+ * encrypted since the last set_iv; *len is the length of the tag.
+ * The decrypt function of an AEAD cipher expects the ciphertext to be
+ * followed by the tag, and fails with err_status_auth_fail if the tag
+ * does not match.
+ */
+
+typedef err_status_t (*cipher_get_tag_func_t)(void *state, uint8_t *tag,
+        int *len);
+
 /*
  * cipher_test_case_t is a (list of) key, salt, xtd_seq_num_t,
  * plaintext, and ciphertext values that are known to be correct for a
@@ -127,8 +146,10 @@ typedef struct cipher_test_case_t {
     int plaintext_length_octets; /* octets in plaintext      */
     uint8_t *plaintext; /* plaintext                */
     int ciphertext_length_octets; /* octets in plaintext      */
-    uint8_t *ciphertext; /* ciphertext               */
+    uint8_t *ciphertext; /* ciphertext (and tag)     */
     struct cipher_test_case_t *next_test_case; /* pointer to next testcase */
+    int aad_length_octets; /* octets in AAD (AEAD only) */
+    uint8_t *aad; /* additional data          */
 } cipher_test_case_t;
 
 /* cipher_type_t defines the 'metadata' for a particular cipher type */
@@ -144,6 +165,8 @@ typedef struct cipher_type_t {
     int ref_count;
     cipher_test_case_t *test_data;
     debug_module_t *debug;
+    cipher_set_aad_func_t set_aad; /* AEAD ciphers only */
+    cipher_get_tag_func_t get_tag; /* AEAD ciphers only */
 } cipher_type_t;
 
 /*
@@ -178,6 +201,16 @@ typedef struct cipher_t {
   ((c) ? (((c)->type)->set_iv(((cipher_pointer_t)(c)->state), (n))) :   \
                                 err_status_no_such_op)
 
+#define cipher_is_aead(c) ((c)->type->get_tag != NULL)
+
+#define cipher_set_aad(c, aad, len)                            \
+  (((c)->type->set_aad) ?                                      \
+   ((c)->type->set_aad(((c)->state), (aad), (len))) : err_status_no_such_op)
+
+#define cipher_get_tag(c, tag, len)                            \
+  (((c)->type->get_tag) ?                                      \
+   ((c)->type->get_tag(((c)->state), (tag), (len))) : err_status_no_such_op)
+
 err_status_t cipher_output(cipher_t *c, uint8_t *buffer,
         int num_octets_to_output);
 
@@ -74,6 +74,7 @@ typedef enum {
 typedef struct kernel_cipher_type {
     cipher_type_id_t id;
     cipher_type_t *cipher_type;
+    int self_tested; /* the known-answer tests have passed */
     struct kernel_cipher_type *next;
 } kernel_cipher_type_t;
 
@@ -84,6 +85,7 @@ typedef struct kernel_cipher_type {
 typedef struct kernel_auth_type {
     auth_type_id_t id;
     auth_type_t *auth_type;
+    int self_tested; /* the known-answer tests have passed */
     struct kernel_auth_type *next;
 } kernel_auth_type_t;
 
@@ -110,10 +112,70 @@ typedef struct {
     kernel_debug_module_t *debug_module_list; /* list of all debug modules   */
 } crypto_kernel_t;
 
+/*
+ * crypto_kernel_init_mode_t selects how much self-testing
+ * crypto_kernel_init() does before it returns:
+ *
+ *    full     - the FIPS-140 statistical tests of rand_source and
+ *               ctr_prng, and the known-answer tests of every cipher
+ *               and auth type (the default)
+ *
+ *    deferred - the known-answer tests of a type run just before the
+ *               first cipher or auth function of that type is
+ *               allocated, and the statistical tests run on a
+ *               background thread (where threads are available); if
+ *               they fail, the kernel returns to the insecure state,
+ *               so that no further ciphers or auth functions can be
+ *               allocated
+ */
+
+typedef enum {
+    crypto_kernel_init_full, crypto_kernel_init_deferred
+} crypto_kernel_init_mode_t;
+
+/*
+ * crypto_kernel_init_stats_t reports the time, in microseconds, that
+ * the phases of the last crypto_kernel_init() took, and the outcome
+ * of the statistical tests of the random number generators
+ */
+
+typedef struct {
+    crypto_kernel_init_mode_t mode; /* mode of the initialization      */
+    unsigned long total_usec; /* crypto_kernel_init() as a whole */
+    unsigned long rng_init_usec; /* rand_source and ctr_prng set-up */
+    unsigned long rng_test_usec; /* statistical tests of both RNGs  */
+    unsigned long cipher_usec; /* loading the cipher types        */
+    unsigned long auth_usec; /* loading the auth types          */
+    int rng_test_done; /* the statistical tests finished  */
+    err_status_t rng_test_status; /* and their result                */
+} crypto_kernel_init_stats_t;
+
 /*
  * crypto_kernel_t external api
  */
 
+/*
+ * crypto_kernel_set_init_mode(mode) sets the mode of the following
+ * calls to crypto_kernel_init()
+ */
+
+void crypto_kernel_set_init_mode(crypto_kernel_init_mode_t mode);
+
+/*
+ * crypto_kernel_get_init_stats(stats) copies the statistics of the
+ * last crypto_kernel_init() into *stats
+ */
+
+void crypto_kernel_get_init_stats(crypto_kernel_init_stats_t *stats);
+
+/*
+ * crypto_kernel_wait_rng_test() waits until the statistical tests of
+ * the random number generators have finished, and returns their
+ * result
+ */
+
+err_status_t crypto_kernel_wait_rng_test(void);
+
 /*
  * The function crypto_kernel_init() initialized the crypto kernel and
  * runs the self-test operations on the random number generators and
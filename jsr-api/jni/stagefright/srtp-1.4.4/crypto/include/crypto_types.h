@@ -120,6 +120,23 @@
  */
 #define AES_128_CBC        3
 
+/**
+ * @brief AES-128 Galois/Counter Mode (AES GCM)
+ *
+ * AES-128 GCM is the AEAD cipher of the AEAD_AES_128_GCM transform of
+ * SRTP (RFC 7714).  It uses a 16-octet key and a 12-octet salt, and
+ * appends a 16-octet authentication tag to the ciphertext.
+ */
+#define AES_128_GCM        6
+
+/**
+ * @brief AES-256 Galois/Counter Mode (AES GCM)
+ *
+ * AES-256 GCM is the AEAD cipher of the AEAD_AES_256_GCM transform of
+ * SRTP (RFC 7714).  It uses a 32-octet key and a 12-octet salt.
+ */
+#define AES_256_GCM        7
+
 /**
  * @brief Strongest available cipher.
  *
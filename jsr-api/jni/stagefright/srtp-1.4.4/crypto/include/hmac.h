@@ -50,9 +50,9 @@
 #include "sha1.h"
 
 typedef struct {
-    uint8_t opad[64];
     sha1_ctx_t ctx;
-    sha1_ctx_t init_ctx;
+    sha1_ctx_t init_ctx; /* state after hashing ipad ^ key  */
+    sha1_ctx_t opad_ctx; /* state after hashing opad ^ key  */
 } hmac_ctx_t;
 
 err_status_t hmac_alloc(auth_t **a, int key_len, int out_len);
@@ -67,6 +67,10 @@ err_status_t rand_source_init(void);
  *     - [other]          a problem occured, and no assumptions should
  *                        be made about the contents of the destination
  *                        buffer.
+ *
+ * rand_source_get_octet_string() may be called from any thread, and
+ * before rand_source_init(); each thread draws from its own buffered
+ * generator, which is seeded from the kernel on first use.
  */
 
 err_status_t rand_source_get_octet_string(void *dest, uint32_t length);
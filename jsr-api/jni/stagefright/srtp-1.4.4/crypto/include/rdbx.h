@@ -41,21 +41,59 @@ typedef uint64_t xtd_seq_num_t;
 /*
  * An rdbx_t is a replay database with extended range; it uses an
  * xtd_seq_num_t and a bitmask of recently received indices.
+ *
+ * The bitmask covers the window_size indices up to and including
+ * index.  It is kept in a ring of 32-bit words, in which the bit for
+ * the index i is bit (i % 32) of word (i / 32) % (ring_mask + 1), so
+ * that moving the window forward only clears the words that it
+ * enters, rather than shifting the whole bitmask.
  */
 
 typedef struct {
-    xtd_seq_num_t index;
-    v128_t bitmask;
+    xtd_seq_num_t index; /* highest index received             */
+    uint32_t *bitmask; /* ring of (ring_mask + 1) words      */
+    unsigned int ring_mask; /* number of words in the ring, - 1   */
+    unsigned int window_size; /* number of indices in the window    */
 } rdbx_t;
 
 /*
- * rdbx_init(rdbx_ptr)
+ * the replay window size must be at least 64 (RFC 3711 section 3.3.2)
+ * and less than seq_num_median, since a received index can only be
+ * estimated that far behind the highest one
+ */
+
+#define rdbx_default_window_size 128
+#define rdbx_min_window_size     64
+#define rdbx_max_window_size     (seq_num_median - 1)
+
+/*
+ * rdbx_init(rdbx_ptr, ws)
+ *
+ * initializes the rdbx pointed to by its argument with a replay
+ * window of ws indices, setting the rollover counter and sequence
+ * number to zero
+ *
+ * returns err_status_bad_param if ws is out of range, and
+ * err_status_alloc_fail if the bitmask cannot be allocated
+ */
+
+err_status_t rdbx_init(rdbx_t *rdbx, unsigned long ws);
+
+/*
+ * rdbx_dealloc(rdbx_ptr)
+ *
+ * frees the bitmask of the rdbx pointed to by its argument
+ */
+
+err_status_t rdbx_dealloc(rdbx_t *rdbx);
+
+/*
+ * rdbx_get_window_size(rdbx_ptr)
  *
- * initializes the rdbx pointed to by its argument, setting the
- * rollover counter and sequence number to zero
+ * returns the size of the replay window of the rdbx, in indices
  */
 
-err_status_t rdbx_init(rdbx_t *rdbx);
+unsigned long rdbx_get_window_size(const rdbx_t *rdbx);
 
 /*
  * rdbx_estimate_index(rdbx, guess, s)
@@ -73,7 +111,7 @@ int rdbx_estimate_index(const rdbx_t *rdbx, xtd_seq_num_t *guess,
  * rdbx_check(rdbx, delta);
  *
  * rdbx_check(&r, delta) checks to see if the xtd_seq_num_t
- * which is at rdbx->window_start + delta is in the rdb
+ * which is at rdbx->index + delta is in the rdb
  *
  */
 
@@ -82,7 +120,7 @@ err_status_t rdbx_check(const rdbx_t *rdbx, int difference);
 /*
  * replay_add_index(rdbx, delta)
  *
- * adds the xtd_seq_num_t at rdbx->window_start + delta to replay_db
+ * adds the xtd_seq_num_t at rdbx->index + delta to replay_db
  * (and does *not* check if that xtd_seq_num_t appears in db)
  *
  * this function should be called *only* after replay_check has
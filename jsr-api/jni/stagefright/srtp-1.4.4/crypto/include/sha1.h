@@ -100,4 +100,47 @@ void sha1_final(sha1_ctx_t *ctx, uint32_t output[5]);
 
 void sha1_core(const uint32_t M[16], uint32_t hash_value[5]);
 
+/*
+ * several implementations of sha1_core are available, depending on
+ * the CPU:
+ *
+ *   sha1_core_type_generic  portable C
+ *   sha1_core_type_simd     SSSE3 or NEON message schedule, C rounds
+ *   sha1_core_type_hw       x86 SHA extensions or ARMv8 SHA1 instructions
+ *
+ * sha1_core_select() picks the fastest one the CPU supports; it is
+ * called by crypto_kernel_init().  sha1_core_use(type) forces one, and
+ * returns err_status_bad_param if it is not available.
+ */
+
+typedef enum {
+    sha1_core_type_generic = 0,
+    sha1_core_type_simd = 1,
+    sha1_core_type_hw = 2
+} sha1_core_type_t;
+
+typedef void (*sha1_core_func_t)(const uint32_t M[16], uint32_t hash_value[5]);
+
+sha1_core_type_t sha1_core_select(void);
+
+err_status_t sha1_core_use(sha1_core_type_t type);
+
+int sha1_core_available(sha1_core_type_t type);
+
+const char *sha1_core_name(sha1_core_type_t type);
+
+/*
+ * internal to the sha1 implementations (crypto/hash/sha1_hw.c)
+ */
+
+void sha1_core_rounds(const uint32_t W[80], uint32_t hash_value[5]);
+
+void sha1_core_simd(const uint32_t M[16], uint32_t hash_value[5]);
+
+void sha1_core_hw(const uint32_t M[16], uint32_t hash_value[5]);
+
+int sha1_core_simd_available(void);
+
+int sha1_core_hw_available(void);
+
 #endif /* SHA1_H */
@@ -45,6 +45,14 @@
 #include "alloc.h"
 
 #include "crypto_kernel.h"
+#include "sha1.h"
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef HAVE_CLOCK_GETTIME
+# include <time.h>
+#endif
 #define LOG_TAG "Srtp-1.4.4"
 
 /* the debug module for the crypto_kernel */
@@ -68,7 +76,12 @@ extern debug_module_t mod_alloc;
 
 extern cipher_type_t null_cipher;
 extern cipher_type_t aes_icm;
+extern cipher_type_t aes_icm_hw;
 extern cipher_type_t aes_cbc;
+extern cipher_type_t aes_gcm_128;
+extern cipher_type_t aes_gcm_256;
+
+extern int aes_icm_hw_available(void);
 
 /*
  * auth func types that can be included in the kernel
@@ -87,6 +100,129 @@ NULL /* no debug modules yet        */
 
 #define MAX_RNG_TRIALS 25
 
+/*
+ * the init mode and statistics are kept outside of crypto_kernel,
+ * which crypto_kernel_init(1) clears
+ */
+
+static crypto_kernel_init_mode_t crypto_kernel_init_mode =
+        crypto_kernel_init_full;
+
+static crypto_kernel_init_stats_t crypto_kernel_init_stats;
+
+/*
+ * crypto_kernel_lock serializes the background RNG tests with the
+ * users of ctr_prng and of the kernel state, and the deferred
+ * known-answer tests with each other
+ *
+ * crypto_kernel_rng_thread_mutex guards the thread handle and its
+ * running flag, and is held across the join so that concurrent waiters
+ * neither join the thread twice nor return before its result is in;
+ * the thread itself never takes it
+ */
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t crypto_kernel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t crypto_kernel_rng_thread_mutex =
+        PTHREAD_MUTEX_INITIALIZER;
+static pthread_t crypto_kernel_rng_thread;
+static int crypto_kernel_rng_thread_running = 0;
+# define crypto_kernel_lock()   pthread_mutex_lock(&crypto_kernel_mutex)
+# define crypto_kernel_unlock() pthread_mutex_unlock(&crypto_kernel_mutex)
+#else
+# define crypto_kernel_lock()
+# define crypto_kernel_unlock()
+#endif
+
+/* returns a monotonic time in microseconds */
+static unsigned long long crypto_kernel_usec(void) {
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (unsigned long long) clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+static err_status_t crypto_kernel_locked_prng(void *dest, uint32_t len) {
+    err_status_t status;
+
+    crypto_kernel_lock();
+    status = ctr_prng_get_octet_string(dest, len);
+    crypto_kernel_unlock();
+    return status;
+}
+
+/*
+ * crypto_kernel_rng_test() runs the FIPS-140 statistical tests on
+ * rand_source and ctr_prng, and records the result; a failure takes
+ * the kernel back to the insecure state
+ */
+
+static err_status_t crypto_kernel_rng_test(void) {
+    unsigned long long start = crypto_kernel_usec();
+    err_status_t status;
+
+    status = stat_test_rand_source_with_repetition(
+            rand_source_get_octet_string, MAX_RNG_TRIALS);
+    if (status == err_status_ok)
+        status = stat_test_rand_source_with_repetition(
+                crypto_kernel_locked_prng, MAX_RNG_TRIALS);
+
+    crypto_kernel_lock();
+    crypto_kernel_init_stats.rng_test_usec = (unsigned long) (crypto_kernel_usec()
+            - start);
+    crypto_kernel_init_stats.rng_test_status = status;
+    crypto_kernel_init_stats.rng_test_done = 1;
+    if (status)
+        crypto_kernel.state = crypto_kernel_state_insecure;
+    crypto_kernel_unlock();
+
+    debug_print(mod_crypto_kernel, "rng statistical tests took %lu usec",
+            crypto_kernel_init_stats.rng_test_usec);
+
+    return status;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void *crypto_kernel_rng_test_thread(void *arg) {
+    crypto_kernel_rng_test();
+    return NULL;
+}
+#endif
+
+void crypto_kernel_set_init_mode(crypto_kernel_init_mode_t mode) {
+    crypto_kernel_init_mode = mode;
+}
+
+void crypto_kernel_get_init_stats(crypto_kernel_init_stats_t *stats) {
+    crypto_kernel_lock();
+    *stats = crypto_kernel_init_stats;
+    crypto_kernel_unlock();
+}
+
+err_status_t crypto_kernel_wait_rng_test(void) {
+    err_status_t status;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&crypto_kernel_rng_thread_mutex);
+    if (crypto_kernel_rng_thread_running) {
+        pthread_join(crypto_kernel_rng_thread, NULL);
+        crypto_kernel_rng_thread_running = 0;
+    }
+    pthread_mutex_unlock(&crypto_kernel_rng_thread_mutex);
+#endif
+    crypto_kernel_lock();
+    if (!crypto_kernel_init_stats.rng_test_done)
+        status = err_status_init_fail;
+    else
+        status = crypto_kernel_init_stats.rng_test_status;
+    crypto_kernel_unlock();
+    return status;
+}
+
 // The only reason to have this forceInit argument, is to make sure
 // we properly initialize ourselves to run dtls_srtp_driver test.
 // In past, dtls_srtp_driver was running as a separate process
@@ -95,8 +231,11 @@ NULL /* no debug modules yet        */
 // we reset the state (if necessary) in between test runs.
 err_status_t crypto_kernel_init(int forceInit) {
     err_status_t status;
+    unsigned long long start, phase;
+    int defer = crypto_kernel_init_mode == crypto_kernel_init_deferred;
 
     if (forceInit) {
+        crypto_kernel_wait_rng_test();
         memset(&crypto_kernel, 0, sizeof(crypto_kernel));
     }
 
@@ -110,6 +249,12 @@ err_status_t crypto_kernel_init(int forceInit) {
         return crypto_kernel_status();
     }
 
+    /* don't start while the tests of an earlier init are still running */
+    crypto_kernel_wait_rng_test();
+    memset(&crypto_kernel_init_stats, 0, sizeof(crypto_kernel_init_stats));
+    crypto_kernel_init_stats.mode = crypto_kernel_init_mode;
+    start = crypto_kernel_usec();
+
     /* load debug modules */
     status = crypto_kernel_load_debug_module(&mod_crypto_kernel);
     if (status)
@@ -128,49 +273,94 @@ err_status_t crypto_kernel_init(int forceInit) {
         return status;
 
     /* initialize random number generator */
+    phase = crypto_kernel_usec();
     status = rand_source_init();
     if (status)
         return status;
 
-    /* run FIPS-140 statistical tests on rand_source */
-    status = stat_test_rand_source_with_repetition(
-            rand_source_get_octet_string, MAX_RNG_TRIALS);
-    if (status)
-        return status;
-
     /* initialize pseudorandom number generator */
     status = ctr_prng_init(rand_source_get_octet_string);
     if (status)
         return status;
+    crypto_kernel_init_stats.rng_init_usec = (unsigned long) (crypto_kernel_usec()
+            - phase);
 
-    /* run FIPS-140 statistical tests on ctr_prng */
-    status = stat_test_rand_source_with_repetition(ctr_prng_get_octet_string,
-            MAX_RNG_TRIALS);
-    if (status)
-        return status;
+    /*
+     * run FIPS-140 statistical tests on rand_source and ctr_prng, unless
+     * they are to run in the background once the kernel is up
+     */
+#ifdef HAVE_PTHREAD_H
+    if (!defer) {
+#endif
+        status = crypto_kernel_rng_test();
+        if (status)
+            return status;
+#ifdef HAVE_PTHREAD_H
+    }
+#endif
 
     /* load cipher types */
+    phase = crypto_kernel_usec();
     status = crypto_kernel_load_cipher_type(&null_cipher, NULL_CIPHER);
     if (status)
         return status;
-    status = crypto_kernel_load_cipher_type(&aes_icm, AES_128_ICM);
+    /* use the AES instructions of the CPU when it has them */
+    status = crypto_kernel_load_cipher_type(
+            aes_icm_hw_available() ? &aes_icm_hw : &aes_icm, AES_128_ICM);
     if (status)
         return status;
     status = crypto_kernel_load_cipher_type(&aes_cbc, AES_128_CBC);
     if (status)
         return status;
+    status = crypto_kernel_load_cipher_type(&aes_gcm_128, AES_128_GCM);
+    if (status)
+        return status;
+    status = crypto_kernel_load_cipher_type(&aes_gcm_256, AES_256_GCM);
+    if (status)
+        return status;
+    crypto_kernel_init_stats.cipher_usec = (unsigned long) (crypto_kernel_usec()
+            - phase);
+
+    /* pick the sha1_core the hmac self-test below will check */
+    sha1_core_select();
 
     /* load auth func types */
+    phase = crypto_kernel_usec();
     status = crypto_kernel_load_auth_type(&null_auth, NULL_AUTH);
     if (status)
         return status;
     status = crypto_kernel_load_auth_type(&hmac, HMAC_SHA1);
     if (status)
         return status;
+    crypto_kernel_init_stats.auth_usec = (unsigned long) (crypto_kernel_usec()
+            - phase);
 
     /* change state to secure */
     crypto_kernel.state = crypto_kernel_state_secure;
 
+#ifdef HAVE_PTHREAD_H
+    if (defer) {
+        int started;
+
+        pthread_mutex_lock(&crypto_kernel_rng_thread_mutex);
+        started = pthread_create(&crypto_kernel_rng_thread, NULL,
+                crypto_kernel_rng_test_thread, NULL) == 0;
+        crypto_kernel_rng_thread_running = started;
+        pthread_mutex_unlock(&crypto_kernel_rng_thread_mutex);
+        if (!started) {
+            /* no thread, so test the generators here after all */
+            status = crypto_kernel_rng_test();
+            if (status)
+                return status;
+        }
+    }
+#endif
+
+    crypto_kernel_init_stats.total_usec = (unsigned long) (crypto_kernel_usec()
+            - start);
+    debug_print(mod_crypto_kernel, "init took %lu usec",
+            crypto_kernel_init_stats.total_usec);
+
     return err_status_ok;
 }
 
@@ -284,6 +474,9 @@ err_status_t crypto_kernel_shutdown() {
         crypto_free(kdm);
     }
 
+    /* the background RNG tests may still be reading rand_source */
+    crypto_kernel_wait_rng_test();
+
     /* de-initialize random number generator */
     status = rand_source_deinit();
     if (status)
@@ -304,10 +497,12 @@ err_status_t crypto_kernel_load_cipher_type(cipher_type_t *new_ct,
     if (new_ct == NULL)
         return err_status_bad_param;
 
-    /* check cipher type by running self-test */
-    status = cipher_type_self_test(new_ct);
-    if (status) {
-        return status;
+    /* check cipher type by running self-test, unless it is deferred */
+    if (crypto_kernel_init_mode != crypto_kernel_init_deferred) {
+        status = cipher_type_self_test(new_ct);
+        if (status) {
+            return status;
+        }
     }
 
     /* walk down list, checking if this type is in the list already  */
@@ -328,6 +523,8 @@ err_status_t crypto_kernel_load_cipher_type(cipher_type_t *new_ct,
     /* set fields */
     new_ctype->cipher_type = new_ct;
     new_ctype->id = id;
+    new_ctype->self_tested = crypto_kernel_init_mode
+            != crypto_kernel_init_deferred;
     new_ctype->next = crypto_kernel.cipher_type_list;
 
     /* set head of list to new cipher type */
@@ -350,10 +547,12 @@ err_status_t crypto_kernel_load_auth_type(auth_type_t *new_at,
     if (new_at == NULL)
         return err_status_bad_param;
 
-    /* check auth type by running self-test */
-    status = auth_type_self_test(new_at);
-    if (status) {
-        return status;
+    /* check auth type by running self-test, unless it is deferred */
+    if (crypto_kernel_init_mode != crypto_kernel_init_deferred) {
+        status = auth_type_self_test(new_at);
+        if (status) {
+            return status;
+        }
     }
 
     /* walk down list, checking if this type is in the list already  */
@@ -373,6 +572,8 @@ err_status_t crypto_kernel_load_auth_type(auth_type_t *new_at,
     /* set fields */
     new_atype->auth_type = new_at;
     new_atype->id = id;
+    new_atype->self_tested = crypto_kernel_init_mode
+            != crypto_kernel_init_deferred;
     new_atype->next = crypto_kernel.auth_type_list;
 
     /* set head of list to new auth type */
@@ -405,20 +606,35 @@ crypto_kernel_get_cipher_type(cipher_type_id_t id) {
 
 err_status_t crypto_kernel_alloc_cipher(cipher_type_id_t id,
         cipher_pointer_t *cp, int key_len) {
-    cipher_type_t *ct;
+    kernel_cipher_type_t *ctype;
+    err_status_t status = err_status_ok;
 
     /*
      * if the crypto_kernel is not yet initialized, we refuse to allocate
      * any ciphers - this is a bit extra-paranoid
      */
+    crypto_kernel_lock();
     if (crypto_kernel.state != crypto_kernel_state_secure)
-        return err_status_init_fail;
+        status = err_status_init_fail;
+
+    /* walk down list, looking for id  */
+    ctype = crypto_kernel.cipher_type_list;
+    while (ctype != NULL && id != ctype->id)
+        ctype = ctype->next;
+    if (status == err_status_ok && ctype == NULL)
+        status = err_status_fail;
 
-    ct = crypto_kernel_get_cipher_type(id);
-    if (!ct)
-        return err_status_fail;
+    /* run the deferred self-test before the first use of the type */
+    if (status == err_status_ok && !ctype->self_tested) {
+        status = cipher_type_self_test(ctype->cipher_type);
+        if (status == err_status_ok)
+            ctype->self_tested = 1;
+    }
+    crypto_kernel_unlock();
+    if (status)
+        return status;
 
-    return ((ct)->alloc(cp, key_len));
+    return ((ctype->cipher_type)->alloc(cp, key_len));
 }
 
 auth_type_t *
@@ -439,20 +655,35 @@ crypto_kernel_get_auth_type(auth_type_id_t id) {
 
 err_status_t crypto_kernel_alloc_auth(auth_type_id_t id, auth_pointer_t *ap,
         int key_len, int tag_len) {
-    auth_type_t *at;
+    kernel_auth_type_t *atype;
+    err_status_t status = err_status_ok;
 
     /*
      * if the crypto_kernel is not yet initialized, we refuse to allocate
      * any auth functions - this is a bit extra-paranoid
      */
+    crypto_kernel_lock();
     if (crypto_kernel.state != crypto_kernel_state_secure)
-        return err_status_init_fail;
+        status = err_status_init_fail;
 
-    at = crypto_kernel_get_auth_type(id);
-    if (!at)
-        return err_status_fail;
+    /* walk down list, looking for id  */
+    atype = crypto_kernel.auth_type_list;
+    while (atype != NULL && id != atype->id)
+        atype = atype->next;
+    if (status == err_status_ok && atype == NULL)
+        status = err_status_fail;
 
-    return ((at)->alloc(ap, key_len, tag_len));
+    /* run the deferred self-test before the first use of the type */
+    if (status == err_status_ok && !atype->self_tested) {
+        status = auth_type_self_test(atype->auth_type);
+        if (status == err_status_ok)
+            atype->self_tested = 1;
+    }
+    crypto_kernel_unlock();
+    if (status)
+        return status;
+
+    return ((atype->auth_type)->alloc(ap, key_len, tag_len));
 }
 
 err_status_t crypto_kernel_load_debug_module(debug_module_t *new_dm) {
@@ -503,8 +734,14 @@ err_status_t crypto_kernel_set_debug_module(char *name, int on) {
 }
 
 err_status_t crypto_get_random(unsigned char *buffer, unsigned int length) {
+    err_status_t status;
+
+    crypto_kernel_lock();
     if (crypto_kernel.state == crypto_kernel_state_secure)
-        return ctr_prng_get_octet_string(buffer, length);
+        status = ctr_prng_get_octet_string(buffer, length);
     else
-        return err_status_fail;
+        status = err_status_fail;
+    crypto_kernel_unlock();
+
+    return status;
 }
@@ -44,8 +44,7 @@
  */
 
 #include "rdbx.h"
-
-#define rdbx_high_bit_in_bitmask 127
+#include "alloc.h"   /* for crypto_alloc() */
 
 /*
  * from draft-ietf-avt-srtp-00.txt:
@@ -80,8 +79,15 @@
  *
  * A rdbx_t consists of a xtd_seq_num_t and a bitmask.  The index is highest
  * sequence number that has been received, and the bitmask indicates
- * which of the recent indicies have been received as well.  The
- * highest bit in the bitmask corresponds to the index in the bitmask.
+ * which of the recent indicies have been received as well.
+ *
+ * The bitmask is a ring of 32-bit words that is addressed by the low
+ * bits of the index, so the bit of an index stays where it is while
+ * the window moves.  The ring holds at least as many words as the
+ * window can span, so no two indices in the window share a bit.  When
+ * the window moves forward, the words that it enters are cleared; a
+ * slide thus costs one word store per 32 indices, whatever the window
+ * size, instead of a shift of the whole bitmask.
  */
 
 void index_init(xtd_seq_num_t *pi) {
@@ -137,8 +143,9 @@ int index_guess(const xtd_seq_num_t *local, xtd_seq_num_t *guess,
 
     if (local_seq < seq_num_median) {
         if (s - local_seq > seq_num_median) {
+            /* s is from before the last rollover, so it is behind */
             guess_roc = local_roc - 1;
-            difference = seq_num_max - s + local_seq;
+            difference = s - local_seq - seq_num_max;
         } else {
             guess_roc = local_roc;
             difference = s - local_seq;
@@ -171,40 +178,92 @@ int index_guess(const xtd_seq_num_t *local, xtd_seq_num_t *guess,
  */
 
 /*
- *  rdbx_init(&r) initalizes the rdbx_t pointed to by r
+ * rdbx_index_low32(&pi) returns the low 32 bits of the packet index
+ * pi, which are all that is needed to locate its bit in the bitmask
  */
 
-err_status_t rdbx_init(rdbx_t *rdbx) {
-    v128_set_to_zero(&rdbx->bitmask);
+static inline uint32_t rdbx_index_low32(const xtd_seq_num_t *pi) {
+#ifdef NO_64BIT_MATH
+    return low32(*pi);
+#else
+    return (uint32_t) * pi;
+#endif
+}
+
+/*
+ *  rdbx_init(&r, ws) initalizes the rdbx_t pointed to by r, with a
+ *  replay window of ws indices
+ */
+
+err_status_t rdbx_init(rdbx_t *rdbx, unsigned long ws) {
+    unsigned int num_words;
+
+    if (ws < rdbx_min_window_size || ws > rdbx_max_window_size)
+        return err_status_bad_param;
+
+    /*
+     * the window spans at most ws / 32 + 2 words; round that up to a
+     * power of two, so that the ring can be indexed with a mask
+     */
+    num_words = 1;
+    while (num_words < ws / 32 + 2)
+        num_words <<= 1;
+
+    rdbx->bitmask = (uint32_t *) crypto_alloc(num_words * sizeof(uint32_t));
+    if (rdbx->bitmask == NULL)
+        return err_status_alloc_fail;
+    octet_string_set_to_zero((uint8_t *) rdbx->bitmask,
+            num_words * sizeof(uint32_t));
+    rdbx->ring_mask = num_words - 1;
+    rdbx->window_size = ws;
     index_init(&rdbx->index);
 
     return err_status_ok;
 }
 
+/*
+ *  rdbx_dealloc(&r) frees the bitmask of the rdbx_t pointed to by r
+ */
+
+err_status_t rdbx_dealloc(rdbx_t *rdbx) {
+    if (rdbx->bitmask != NULL)
+        crypto_free(rdbx->bitmask);
+    rdbx->bitmask = NULL;
+
+    return err_status_ok;
+}
+
+unsigned long rdbx_get_window_size(const rdbx_t *rdbx) {
+    return rdbx->window_size;
+}
+
 /*
  * rdbx_check(&r, delta) checks to see if the xtd_seq_num_t
  * which is at rdbx->index + delta is in the rdb
  */
 
 err_status_t rdbx_check(const rdbx_t *rdbx, int delta) {
+    uint32_t i;
 
     if (delta > 0) { /* if delta is positive, it's good */
         return err_status_ok;
-    } else if (rdbx_high_bit_in_bitmask + delta < 0) {
+    } else if ((int) rdbx->window_size + delta <= 0) {
         /* if delta is lower than the bitmask, it's bad */
         return err_status_replay_old;
-    } else if (v128_get_bit(&rdbx->bitmask, rdbx_high_bit_in_bitmask + delta)
-            == 1) {
-        /* delta is within the window, so check the bitmask */
-        return err_status_replay_fail;
     }
+
+    /* delta is within the window, so check the bitmask */
+    i = rdbx_index_low32(&rdbx->index) + delta;
+    if (rdbx->bitmask[(i >> 5) & rdbx->ring_mask] & (1U << (i & 31)))
+        return err_status_replay_fail;
+
     /* otherwise, the index is okay */
 
     return err_status_ok;
 }
 
 /*
- * rdbx_add_index adds the xtd_seq_num_t at rdbx->window_start + d to
+ * rdbx_add_index adds the xtd_seq_num_t at rdbx->index + d to
  * replay_db (and does *not* check if that xtd_seq_num_t appears in db)
  *
  * this function should be called only after replay_check has
@@ -213,18 +272,31 @@ err_status_t rdbx_check(const rdbx_t *rdbx, int delta) {
  */
 
 err_status_t rdbx_add_index(rdbx_t *rdbx, int delta) {
+    uint32_t i, word, last_word;
+
+    i = rdbx_index_low32(&rdbx->index);
 
     if (delta > 0) {
+        /* clear the words that the window moves into */
+        word = i >> 5;
+        last_word = (i + delta) >> 5;
+        if (last_word - word > rdbx->ring_mask) {
+            octet_string_set_to_zero((uint8_t *) rdbx->bitmask,
+                    (rdbx->ring_mask + 1) * sizeof(uint32_t));
+        } else {
+            while (word != last_word) {
+                word++;
+                rdbx->bitmask[word & rdbx->ring_mask] = 0;
+            }
+        }
+
         /* shift forward by delta */
         index_advance(&rdbx->index, delta);
-        v128_left_shift(&rdbx->bitmask, delta);
-        v128_set_bit(&rdbx->bitmask, 127);
-    } else {
-        /* delta is in window, so flip bit in bitmask */
-        v128_set_bit(&rdbx->bitmask, -delta);
     }
 
-    /* note that we need not consider the case that delta == 0 */
+    /* set the bit of the index in the bitmask */
+    i += delta;
+    rdbx->bitmask[(i >> 5) & rdbx->ring_mask] |= 1U << (i & 31);
 
     return err_status_ok;
 }
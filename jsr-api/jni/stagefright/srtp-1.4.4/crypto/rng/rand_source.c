@@ -1,7 +1,8 @@
 /*
  * rand_source.c
  *
- * implements a random source based on /dev/random
+ * implements a random source: a buffered, per-thread AES-256 counter
+ * mode generator seeded from getrandom() or /dev/urandom
  *
  * David A. McGrew
  * Cisco Systems, Inc.
@@ -47,65 +48,98 @@
 #ifdef DEV_URANDOM
 # include <fcntl.h>          /* for open()  */
 # include <unistd.h>         /* for close() */
+# include <errno.h>
+# include <sys/syscall.h>    /* for SYS_getrandom */
 #elif (_MSC_VER >= 1400)
 #define _CRT_RAND_S
 # include <stdlib.h>
 # include <stdio.h>
 #else
 # include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
 #endif
 
 #include "rand_source.h"
+#include "aes.h"
+#include "alloc.h"
+
+/*
+ * The octets handed out by rand_source_get_octet_string() come from a
+ * generator per thread, so that callers don't contend for a lock nor
+ * make a system call per request.  Each generator holds an AES-256
+ * key and a buffer of keystream.  When the buffer runs out, the
+ * generator encrypts RAND_SOURCE_BLOCKS + 2 counter blocks; the first
+ * two become the next key and the rest refill the buffer, so that the
+ * octets already handed out can't be recomputed from the state.  The
+ * generator is seeded from the kernel when it is created, and the
+ * kernel seed is mixed into its key again every RAND_SOURCE_RESEED
+ * refills.  A child process inherits the generator of the thread that
+ * forked, which is then seeded again before the child uses it, so that
+ * the parent and the child don't hand out the same octets.
+ */
+
+#define RAND_SOURCE_BLOCKS 32
+#define RAND_SOURCE_RESEED 1024
+
+typedef struct {
+    aes_key_t key; /* the current key, expanded         */
+    uint8_t buffer[RAND_SOURCE_BLOCKS * 16]; /* keystream not yet handed out */
+    int bytes_in_buffer; /* unused octets at end of buffer    */
+    int refills; /* refills until the next reseed     */
+    unsigned int forks; /* rand_source_forks when seeded     */
+} rand_source_state_t;
 
 /*
  * global dev_rand_fdes is file descriptor for /dev/random
  *
- * This variable is also used to indicate that the random source has
- * been initialized.  When this variable is set to the value of the
- * #define RAND_SOURCE_NOT_READY, it indicates that the random source
- * is not ready to be used.  The value of the #define
- * RAND_SOURCE_READY is for use whenever that variable is used as an
- * indicator of the state of the random source, but not as a file
- * descriptor.
+ * It is only opened when the kernel has no getrandom() system call.
+ * rand_source_ready tells whether the random source has been
+ * initialized with rand_source_init(); rand_source_get_octet_string()
+ * works without it, for the users of the random source outside of
+ * the crypto kernel.
  */
 
 #define RAND_SOURCE_NOT_READY (-1)
-#define RAND_SOURCE_READY     (17)
 
 static int dev_random_fdes = RAND_SOURCE_NOT_READY;
+static int rand_source_ready = 0;
 
-err_status_t rand_source_init(void) {
-    if (dev_random_fdes >= 0) {
-        /* already open */
-        return err_status_ok;
-    }
-#ifdef DEV_URANDOM
-    /* open random source for reading */
-    dev_random_fdes = open(DEV_URANDOM, O_RDONLY);
-    if (dev_random_fdes < 0)
-    return err_status_init_fail;
-#elif (_MSC_VER >= 1400)
-    dev_random_fdes = RAND_SOURCE_READY;
+#ifdef HAVE_PTHREAD_H
+static pthread_once_t rand_source_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rand_source_key;
+
+/* counts the fork() calls, in the children */
+static volatile unsigned int rand_source_forks = 0;
 #else
-    /* no random source available; let the user know */
-    fprintf(stderr, "WARNING: no real random source present!\n");
-    dev_random_fdes = RAND_SOURCE_READY;
+static rand_source_state_t *rand_source_state = NULL;
 #endif
-    return err_status_ok;
-}
 
-err_status_t rand_source_get_octet_string(void *dest, uint32_t len) {
+/*
+ * rand_source_get_seed() reads len octets of entropy from the kernel
+ */
 
-    /*
-     * read len octets from /dev/random to dest, and
-     * check return value to make sure enough octets were
-     * written
-     */
+static err_status_t rand_source_get_seed(uint8_t *dest, uint32_t len) {
 #ifdef DEV_URANDOM
-    if (read(dev_random_fdes, dest, len) != len)
-    return err_status_fail;
+    while (len) {
+        ssize_t n = -1;
+
+#ifdef SYS_getrandom
+        if (dev_random_fdes < 0)
+            n = syscall(SYS_getrandom, dest, len, 0);
+        else
+#endif
+            n = read(dev_random_fdes, dest, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return err_status_fail;
+        dest += n;
+        len -= n;
+    }
 #elif (_MSC_VER >= 1400)
-    unsigned int *dst = dest;
     while (len)
     {
         unsigned int val = 0;
@@ -115,33 +149,224 @@ err_status_t rand_source_get_octet_string(void *dest, uint32_t len) {
             return err_status_fail;
         }
 
-        *dst++ = val;
+        *dest++ = val & 0xff;
         len--;
     }
 #else
     /* Generic C-library (rand()) version */
     /* This is a random source of last resort */
-    uint8_t *dst = (uint8_t *) dest;
     while (len) {
         int val = rand();
         /* rand() returns 0-32767 (ugh) */
         /* Is this a good enough way to get random bytes?
          It is if it passes FIPS-140... */
-        *dst++ = val & 0xff;
+        *dest++ = val & 0xff;
         len--;
     }
 #endif
     return err_status_ok;
 }
 
+/*
+ * rand_source_refill() replaces the key of state and fills its buffer,
+ * mixing a fresh kernel seed into the key when one is due
+ */
+
+static err_status_t rand_source_refill(rand_source_state_t *state) {
+    v128_t blocks[RAND_SOURCE_BLOCKS + 2];
+    uint8_t seed[32];
+    err_status_t status = err_status_ok;
+    int i;
+
+    for (i = 0; i < RAND_SOURCE_BLOCKS + 2; i++) {
+        v128_set_to_zero(&blocks[i]);
+        blocks[i].v32[3] = i;
+    }
+    aes_key_encrypt_blocks(blocks, RAND_SOURCE_BLOCKS + 2, &state->key);
+
+    if (--state->refills <= 0) {
+        status = rand_source_get_seed(seed, sizeof(seed));
+        if (status == err_status_ok) {
+            for (i = 0; i < 16; i++) {
+                blocks[0].v8[i] ^= seed[i];
+                blocks[1].v8[i] ^= seed[16 + i];
+            }
+            state->refills = RAND_SOURCE_RESEED;
+        }
+        octet_string_set_to_zero(seed, sizeof(seed));
+    }
+
+    if (status == err_status_ok)
+        status = aes_expand_key(blocks[0].v8, 32, &state->key);
+    if (status == err_status_ok) {
+        memcpy(state->buffer, &blocks[2], sizeof(state->buffer));
+        state->bytes_in_buffer = sizeof(state->buffer);
+    }
+    octet_string_set_to_zero((uint8_t *) blocks, sizeof(blocks));
+
+    return status;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void rand_source_free_state(void *arg) {
+    rand_source_state_t *state = (rand_source_state_t *) arg;
+
+    octet_string_set_to_zero((uint8_t *) state, sizeof(*state));
+    crypto_free(state);
+}
+#endif
+
+/*
+ * rand_source_seed() gives state a new key from the kernel and empties
+ * its buffer
+ */
+
+static err_status_t rand_source_seed(rand_source_state_t *state) {
+    uint8_t seed[32];
+    err_status_t status;
+
+    status = rand_source_get_seed(seed, sizeof(seed));
+    if (status == err_status_ok)
+        status = aes_expand_key(seed, sizeof(seed), &state->key);
+    octet_string_set_to_zero(seed, sizeof(seed));
+    octet_string_set_to_zero(state->buffer, sizeof(state->buffer));
+    state->bytes_in_buffer = 0;
+    state->refills = RAND_SOURCE_RESEED;
+#ifdef HAVE_PTHREAD_H
+    state->forks = rand_source_forks;
+#endif
+
+    return status;
+}
+
+static rand_source_state_t *rand_source_new_state(void) {
+    rand_source_state_t *state;
+
+    state = (rand_source_state_t *) crypto_alloc(sizeof(*state));
+    if (state == NULL)
+        return NULL;
+
+    if (rand_source_seed(state)) {
+        crypto_free(state);
+        return NULL;
+    }
+
+    return state;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void rand_source_atfork_child(void) {
+    rand_source_forks++;
+}
+
+static void rand_source_setup(void) {
+    pthread_key_create(&rand_source_key, rand_source_free_state);
+    /* the child reseeds lazily: it can't allocate nor lock in the handler */
+    pthread_atfork(NULL, NULL, rand_source_atfork_child);
+
+#if defined(DEV_URANDOM) && defined(SYS_getrandom)
+    /* use /dev/urandom only if the kernel predates getrandom() */
+    if (syscall(SYS_getrandom, NULL, 0, 0) < 0 && errno == ENOSYS)
+        dev_random_fdes = open(DEV_URANDOM, O_RDONLY);
+#elif defined(DEV_URANDOM)
+    dev_random_fdes = open(DEV_URANDOM, O_RDONLY);
+#endif
+}
+#endif
+
+static rand_source_state_t *rand_source_get_state(void) {
+    rand_source_state_t *state;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_once(&rand_source_once, rand_source_setup);
+    state = (rand_source_state_t *) pthread_getspecific(rand_source_key);
+    if (state == NULL) {
+        state = rand_source_new_state();
+        if (state != NULL && pthread_setspecific(rand_source_key, state)) {
+            rand_source_free_state(state);
+            state = NULL;
+        }
+    } else if (state->forks != rand_source_forks) {
+        /* inherited from the parent process */
+        if (rand_source_seed(state))
+            return NULL;
+    }
+#else
+#ifdef DEV_URANDOM
+    if (dev_random_fdes < 0 && rand_source_state == NULL)
+        dev_random_fdes = open(DEV_URANDOM, O_RDONLY);
+#endif
+    if (rand_source_state == NULL)
+        rand_source_state = rand_source_new_state();
+    state = rand_source_state;
+#endif
+
+    return state;
+}
+
+err_status_t rand_source_init(void) {
+    if (rand_source_ready) {
+        /* already initialized */
+        return err_status_ok;
+    }
+
+    /* check that the calling thread can get a seeded generator */
+    if (rand_source_get_state() == NULL)
+        return err_status_init_fail;
+
+#if !defined(DEV_URANDOM) && !(_MSC_VER >= 1400)
+    /* no random source available; let the user know */
+    fprintf(stderr, "WARNING: no real random source present!\n");
+#endif
+    rand_source_ready = 1;
+    return err_status_ok;
+}
+
+err_status_t rand_source_get_octet_string(void *dest, uint32_t len) {
+    rand_source_state_t *state = rand_source_get_state();
+    uint8_t *dst = (uint8_t *) dest;
+    err_status_t status;
+
+    if (state == NULL)
+        return err_status_fail;
+
+    /*
+     * copy len octets of keystream to dest, refilling the buffer as
+     * needed, and wipe the octets handed out
+     */
+    while (len) {
+        uint32_t n;
+        uint8_t *src;
+
+        if (state->bytes_in_buffer == 0) {
+            status = rand_source_refill(state);
+            if (status)
+                return status;
+        }
+        n = state->bytes_in_buffer;
+        if (n > len)
+            n = len;
+        src = state->buffer + sizeof(state->buffer) - state->bytes_in_buffer;
+        memcpy(dst, src, n);
+        octet_string_set_to_zero(src, n);
+        state->bytes_in_buffer -= n;
+        dst += n;
+        len -= n;
+    }
+
+    return err_status_ok;
+}
+
 err_status_t rand_source_deinit(void) {
-    if (dev_random_fdes < 0)
+    if (!rand_source_ready)
         return err_status_dealloc_fail; /* well, we haven't really failed, *
          * but there is something wrong    */
-#ifdef DEV_URANDOM
-    close(dev_random_fdes);
-#endif
-    dev_random_fdes = RAND_SOURCE_NOT_READY;
+
+    /*
+     * the per-thread generators, and /dev/urandom if it is in use,
+     * stay available to the other users of the random source
+     */
+    rand_source_ready = 0;
 
     return err_status_ok;
 }
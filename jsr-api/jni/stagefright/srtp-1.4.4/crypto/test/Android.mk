@@ -19,3 +19,19 @@ LOCAL_C_INCLUDES        := $(LOCAL_PATH)/../../include $(LOCAL_PATH)/../include
 LOCAL_SHARED_LIBRARIES  := liblog libSrtp
 
 include $(BUILD_STATIC_LIBRARY)
+
+# Build the crypto_bench benchmark
+# ============================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+
+LOCAL_MODULE            := crypto_bench
+LOCAL_SRC_FILES         := \
+    crypto_bench.c \
+    ../../test/getopt_s.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/../../include $(LOCAL_PATH)/../include
+
+LOCAL_SHARED_LIBRARIES  := liblog libSrtp
+
+include $(BUILD_EXECUTABLE)
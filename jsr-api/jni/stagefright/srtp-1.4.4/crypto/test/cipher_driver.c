@@ -49,6 +49,7 @@
 #include <unistd.h>          /* for getopt() */
 #include "cipher.h"
 #include "aes_icm.h"
+#include "aes_gcm.h"
 #include "null_cipher.h"
 
 #define PRINT_DEBUG 0
@@ -95,6 +96,7 @@ err_status_t cipher_array_alloc_init(cipher_t ***cipher_array, int num_ciphers,
 
 extern cipher_type_t null_cipher;
 extern cipher_type_t aes_icm;
+extern cipher_type_t aes_icm_hw;
 extern cipher_type_t aes_cbc;
 
 // int main(int argc, char *argv[]) {
@@ -104,6 +106,12 @@ int cipher_driver(unsigned do_timing_test, unsigned do_validation, unsigned do_a
     unsigned char test_key[20] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
             0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11,
             0x12, 0x13 };
+    unsigned char gcm_test_key[44] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+            0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+            0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b,
+            0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,
+            0x27, 0x28, 0x29, 0x2a, 0x2b };
+    int i;
 
     printf("cipher test driver\n"
         "David A. McGrew\n"
@@ -128,7 +136,11 @@ int cipher_driver(unsigned do_timing_test, unsigned do_validation, unsigned do_a
     if (do_validation) {
         cipher_driver_self_test(&null_cipher);
         cipher_driver_self_test(&aes_icm);
+        if (aes_icm_hw_available())
+            cipher_driver_self_test(&aes_icm_hw);
         cipher_driver_self_test(&aes_cbc);
+        cipher_driver_self_test(&aes_gcm_128);
+        cipher_driver_self_test(&aes_gcm_256);
     }
 
     /* do timing and/or buffer_test on null_cipher */
@@ -168,6 +180,53 @@ int cipher_driver(unsigned do_timing_test, unsigned do_validation, unsigned do_a
     status = cipher_dealloc(c);
     check_status(status);
 
+    /* same tests on the hardware aes_icm, when the cpu supports it */
+    if (aes_icm_hw_available()) {
+        status = cipher_type_alloc(&aes_icm_hw, &c, 30);
+        if (status) {
+            fprintf(stderr, "error: can't allocate cipher\n");
+            return(status);
+        }
+
+        status = cipher_init(c, test_key, direction_encrypt);
+        check_status(status);
+
+        if (do_timing_test)
+            cipher_driver_test_throughput(c);
+
+        if (do_validation) {
+            status = cipher_driver_test_buffering(c);
+            check_status(status);
+        }
+
+        status = cipher_dealloc(c);
+        check_status(status);
+    }
+
+    /* and on aes_gcm, with both key lengths */
+    for (i = 0; i < 2; i++) {
+        status = cipher_type_alloc(i ? &aes_gcm_256 : &aes_gcm_128, &c,
+                i ? 44 : 28);
+        if (status) {
+            fprintf(stderr, "error: can't allocate cipher\n");
+            return(status);
+        }
+
+        status = cipher_init(c, gcm_test_key, direction_encrypt);
+        check_status(status);
+
+        if (do_timing_test)
+            cipher_driver_test_throughput(c);
+
+        if (do_validation) {
+            status = cipher_driver_test_buffering(c);
+            check_status(status);
+        }
+
+        status = cipher_dealloc(c);
+        check_status(status);
+    }
+
     return 0;
 }
 
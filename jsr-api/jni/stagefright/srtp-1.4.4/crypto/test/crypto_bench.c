@@ -0,0 +1,505 @@
+/*
+ * crypto_bench.c
+ *
+ * a cycle count benchmark of the cipher and auth backends
+ *
+ */
+
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * crypto_bench times every backend of each primitive, over a range of
+ * message lengths, and writes the cycles and nanoseconds per octet of
+ * each as JSON, followed by the fastest backend of each primitive at
+ * each length.  The backends are all the cipher and auth types that
+ * the crypto kernel can load, plus the alternatives it picks between:
+ * aes_icm and aes_icm_hw, the generic and CPU-accelerated code paths
+ * of aes_gcm, and each sha1_core under hmac.
+ *
+ * Each backend is warmed up, then timed in a number of samples of
+ * several calls each; the median sample is reported, along with the
+ * fastest.  A call is what SRTP does per packet: set_iv and encrypt
+ * (plus set_aad and get_tag for an AEAD cipher), or start and compute
+ * for an auth function.  Cycles are counted by perf_event_open() where
+ * the kernel allows it, and read from the TSC otherwise on x86, as in
+ * srtp_bench; with -c the benchmark is pinned to one CPU, which makes
+ * both more stable.
+ *
+ * usage: crypto_bench [ -c cpu ] [ -s length ] [ -n samples ]
+ */
+
+#ifdef __linux__
+# define _GNU_SOURCE         /* for sched_setaffinity() */
+# include <sched.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+#include <stdio.h>           /* for printf() */
+#include <stdlib.h>          /* for qsort() */
+#include <string.h>          /* for memset() */
+#include <time.h>            /* for clock_gettime() */
+#include <unistd.h>          /* for close() */
+#if defined(__i386__) || defined(__x86_64__)
+# include <x86intrin.h>      /* for __rdtsc() */
+#endif
+#include "getopt_s.h"
+#include "crypto_kernel.h"
+#include "aes_icm.h"
+#include "aes_gcm.h"
+#include "sha1.h"
+
+extern cipher_type_t null_cipher;
+extern cipher_type_t aes_icm;
+extern cipher_type_t aes_icm_hw;
+extern cipher_type_t aes_cbc;
+extern cipher_type_t aes_gcm_128;
+extern cipher_type_t aes_gcm_256;
+extern auth_type_t null_auth;
+extern auth_type_t hmac;
+
+extern crypto_kernel_t crypto_kernel;
+
+#define BENCH_MAX_LEN      4096
+#define BENCH_AAD_LEN        12 /* an RTP header                */
+#define BENCH_TAG_LEN        10 /* HMAC-SHA1-80                 */
+#define BENCH_WARMUP_OCTETS  (1 << 20)
+#define BENCH_SAMPLE_OCTETS  (1 << 16)
+#define BENCH_MAX_SAMPLES   101
+#define BENCH_DEFAULT_SAMPLES 21
+
+static const int bench_lengths[] = {
+    16, 32, 64, 128, 160, 256, 512, 1024, 2048, 4096
+};
+
+#define BENCH_NUM_LENGTHS \
+    ((int) (sizeof(bench_lengths) / sizeof(bench_lengths[0])))
+
+static int bench_icm_hw_available(void) {
+    return aes_icm_hw_available();
+}
+
+static int bench_gcm_hw_available(void) {
+    return aes_gcm_hw_available();
+}
+
+static int bench_sha1_simd_available(void) {
+    return sha1_core_available(sha1_core_type_simd);
+}
+
+static int bench_sha1_hw_available(void) {
+    return sha1_core_available(sha1_core_type_hw);
+}
+
+/*
+ * a bench_backend_t is one implementation of a primitive; available
+ * is NULL for the backends that every CPU can run
+ */
+
+typedef struct {
+    const char *primitive;
+    const char *backend;
+    cipher_type_t *cipher; /* NULL for an auth backend     */
+    auth_type_t *auth;
+    int key_len;
+    int gcm_generic; /* turn off the aes_gcm accel   */
+    sha1_core_type_t sha1_core;
+    int (*available)(void);
+} bench_backend_t;
+
+static const bench_backend_t bench_backends[] = {
+    { "null_cipher", "c", &null_cipher, NULL, 0, 0, 0, NULL },
+    { "aes_128_icm", "table", &aes_icm, NULL, 30, 0, 0, NULL },
+    { "aes_128_icm", "hw", &aes_icm_hw, NULL, 30, 0, 0,
+      bench_icm_hw_available },
+    { "aes_128_cbc", "table", &aes_cbc, NULL, 16, 0, 0, NULL },
+    { "aes_128_gcm", "generic", &aes_gcm_128, NULL, 28, 1, 0, NULL },
+    { "aes_128_gcm", "hw", &aes_gcm_128, NULL, 28, 0, 0,
+      bench_gcm_hw_available },
+    { "aes_256_gcm", "generic", &aes_gcm_256, NULL, 44, 1, 0, NULL },
+    { "aes_256_gcm", "hw", &aes_gcm_256, NULL, 44, 0, 0,
+      bench_gcm_hw_available },
+    { "null_auth", "c", NULL, &null_auth, 0, 0, 0, NULL },
+    { "hmac_sha1", "generic", NULL, &hmac, 20, 0, sha1_core_type_generic,
+      NULL },
+    { "hmac_sha1", "simd", NULL, &hmac, 20, 0, sha1_core_type_simd,
+      bench_sha1_simd_available },
+    { "hmac_sha1", "hw", NULL, &hmac, 20, 0, sha1_core_type_hw,
+      bench_sha1_hw_available },
+};
+
+#define BENCH_NUM_BACKENDS \
+    ((int) (sizeof(bench_backends) / sizeof(bench_backends[0])))
+
+/*
+ * the source of cycle counts: perf_event_open(), the TSC, or none,
+ * picked in that order as in srtp_bench
+ */
+
+typedef enum {
+    bench_cycles_none = 0,
+    bench_cycles_perf = 1,
+    bench_cycles_tsc = 2
+} bench_cycles_t;
+
+static bench_cycles_t bench_cycles = bench_cycles_none;
+static int bench_perf_fd = -1;
+
+static const char *bench_cycles_name[] = { "none", "perf", "tsc" };
+
+static void bench_cycles_select(void) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    bench_perf_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (bench_perf_fd >= 0) {
+        bench_cycles = bench_cycles_perf;
+        return;
+    }
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+    bench_cycles = bench_cycles_tsc;
+#endif
+}
+
+static unsigned long long bench_cycles_read(void) {
+    unsigned long long count = 0;
+
+#ifdef __linux__
+    if (bench_perf_fd >= 0
+            && read(bench_perf_fd, &count, sizeof(count)) == sizeof(count))
+        return count;
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+    if (bench_cycles == bench_cycles_tsc)
+        return __rdtsc();
+#endif
+    return count;
+}
+
+static unsigned long long bench_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * a bench_sample_t is the cost of one call, averaged over the calls
+ * of a sample
+ */
+
+typedef struct {
+    double cycles;
+    double ns;
+} bench_sample_t;
+
+static int bench_compare_sample(const void *a, const void *b) {
+    double x = ((const bench_sample_t *) a)->ns;
+    double y = ((const bench_sample_t *) b)->ns;
+
+    return (x > y) - (x < y);
+}
+
+static uint8_t bench_key[64];
+static uint8_t bench_buffer[BENCH_MAX_LEN + 64];
+
+/*
+ * bench_call() is one call of the backend on len octets
+ */
+
+static err_status_t bench_call(cipher_t *c, auth_t *a, int len) {
+    uint8_t tag[32];
+    v128_t iv;
+    unsigned int enc_len = len;
+    int tag_len = sizeof(tag);
+    err_status_t status;
+
+    if (a != NULL) {
+        status = auth_start(a);
+        if (status == err_status_ok)
+            status = auth_compute(a, bench_buffer, len, tag);
+        return status;
+    }
+
+    v128_set_to_zero(&iv);
+    iv.v32[3] = len;
+    status = cipher_set_iv(c, &iv);
+    if (status == err_status_ok && cipher_is_aead(c))
+        status = cipher_set_aad(c, bench_buffer + BENCH_MAX_LEN, BENCH_AAD_LEN);
+    if (status == err_status_ok)
+        status = cipher_encrypt(c, bench_buffer, &enc_len);
+    if (status == err_status_ok && cipher_is_aead(c))
+        status = cipher_get_tag(c, tag, &tag_len);
+    return status;
+}
+
+/*
+ * bench_backend() times b at each length, writes its JSON records,
+ * and stores the median nanoseconds per octet in ns_per_octet
+ */
+
+static err_status_t bench_backend(const bench_backend_t *b, int only_len,
+        int num_samples, int *first, double *ns_per_octet) {
+    bench_sample_t sample[BENCH_MAX_SAMPLES];
+    cipher_t *c = NULL;
+    auth_t *a = NULL;
+    err_status_t status;
+    int i, j, l;
+
+    if (b->cipher) {
+        status = cipher_type_alloc(b->cipher, &c, b->key_len);
+        if (status == err_status_ok)
+            status = cipher_init(c, bench_key, direction_encrypt);
+        if (status == err_status_ok && b->gcm_generic)
+            ((aes_gcm_ctx_t *) c->state)->accel = 0;
+    } else {
+        status = sha1_core_use(b->sha1_core);
+        if (status == err_status_ok)
+            status = auth_type_alloc(b->auth, &a, b->key_len, BENCH_TAG_LEN);
+        if (status == err_status_ok)
+            status = auth_init(a, bench_key);
+    }
+
+    for (l = 0; status == err_status_ok && l < BENCH_NUM_LENGTHS; l++) {
+        int len = only_len ? only_len : bench_lengths[l];
+        int calls = BENCH_SAMPLE_OCTETS / len;
+        bench_sample_t *median;
+
+        if (only_len && l > 0)
+            break;
+        if (calls < 8)
+            calls = 8;
+
+        /* warm up the caches, the branch predictors and the clock */
+        for (i = 0; status == err_status_ok
+                && i < BENCH_WARMUP_OCTETS / len; i++)
+            status = bench_call(c, a, len);
+
+        for (j = 0; status == err_status_ok && j < num_samples; j++) {
+            unsigned long long ns = bench_now_ns();
+            unsigned long long cycles = bench_cycles_read();
+
+            for (i = 0; status == err_status_ok && i < calls; i++)
+                status = bench_call(c, a, len);
+            sample[j].cycles = (double) (bench_cycles_read() - cycles) / calls;
+            sample[j].ns = (double) (bench_now_ns() - ns) / calls;
+        }
+        if (status)
+            break;
+
+        qsort(sample, num_samples, sizeof(sample[0]), bench_compare_sample);
+        median = &sample[num_samples / 2];
+        ns_per_octet[l] = median->ns / len;
+
+        printf("%s    {\"primitive\": \"%s\", \"backend\": \"%s\", "
+               "\"length\": %d, ", *first ? "" : ",\n", b->primitive,
+               b->backend, len);
+        if (bench_cycles == bench_cycles_none)
+            printf("\"cycles_per_octet\": null, \"cycles_per_call\": null, "
+                   "\"min_cycles_per_call\": null, ");
+        else
+            printf("\"cycles_per_octet\": %.2f, \"cycles_per_call\": %.1f, "
+                   "\"min_cycles_per_call\": %.1f, ", median->cycles / len,
+                   median->cycles, sample[0].cycles);
+        printf("\"ns_per_octet\": %.3f, \"ns_per_call\": %.1f}",
+                median->ns / len, median->ns);
+        *first = 0;
+    }
+
+    if (c)
+        cipher_dealloc(c);
+    if (a)
+        auth_dealloc(a);
+    return status;
+}
+
+static void usage(char *prog_name) {
+    printf("usage: %s [ -c cpu ] [ -s length ] [ -n samples ]\n"
+           "  -c pin the benchmark to the given CPU\n"
+           "  -s time only the given message length\n"
+           "  -n samples per length (default %d)\n", prog_name,
+           BENCH_DEFAULT_SAMPLES);
+    exit(255);
+}
+
+int main(int argc, char *argv[]) {
+    static double ns_per_octet[BENCH_NUM_BACKENDS][BENCH_NUM_LENGTHS];
+    int ran[BENCH_NUM_BACKENDS];
+    kernel_cipher_type_t *ctype;
+    kernel_auth_type_t *atype;
+    int cpu = -1, only_len = 0, num_samples = BENCH_DEFAULT_SAMPLES;
+    int first = 1;
+    int b, l, i;
+    err_status_t status;
+
+    while (1) {
+        int c = getopt_s(argc, argv, "c:s:n:");
+        if (c == -1)
+            break;
+        switch (c) {
+        case 'c':
+            cpu = atoi(optarg_s);
+            break;
+        case 's':
+            only_len = atoi(optarg_s);
+            break;
+        case 'n':
+            num_samples = atoi(optarg_s);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (only_len < 0 || only_len > BENCH_MAX_LEN || num_samples <= 0
+            || num_samples > BENCH_MAX_SAMPLES)
+        usage(argv[0]);
+
+    if (cpu >= 0) {
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set)) {
+            fprintf(stderr, "error: can't pin to cpu %d\n", cpu);
+            exit(1);
+        }
+#else
+        fprintf(stderr, "warning: pinning is not supported here\n");
+        cpu = -1;
+#endif
+    }
+
+    status = crypto_kernel_init(0);
+    if (status) {
+        fprintf(stderr, "error: crypto_kernel init failed\n");
+        exit(1);
+    }
+    bench_cycles_select();
+
+    /* every type the kernel loaded must have a backend here */
+    for (ctype = crypto_kernel.cipher_type_list; ctype; ctype = ctype->next) {
+        for (b = 0; b < BENCH_NUM_BACKENDS; b++)
+            if (bench_backends[b].cipher == ctype->cipher_type)
+                break;
+        if (b == BENCH_NUM_BACKENDS)
+            fprintf(stderr, "warning: no backend for cipher %s\n",
+                    ctype->cipher_type->description);
+    }
+    for (atype = crypto_kernel.auth_type_list; atype; atype = atype->next) {
+        for (b = 0; b < BENCH_NUM_BACKENDS; b++)
+            if (bench_backends[b].auth == atype->auth_type)
+                break;
+        if (b == BENCH_NUM_BACKENDS)
+            fprintf(stderr, "warning: no backend for auth %s\n",
+                    atype->auth_type->description);
+    }
+
+    for (i = 0; i < (int) sizeof(bench_key); i++)
+        bench_key[i] = (uint8_t) (i * 37 + 11);
+    memset(bench_buffer, 0xab, sizeof(bench_buffer));
+
+    printf("{\n  \"benchmark\": \"crypto_bench\",\n  \"cycle_source\": "
+           "\"%s\",\n  \"cpu\": %d,\n  \"results\": [\n",
+           bench_cycles_name[bench_cycles], cpu);
+
+    for (b = 0; b < BENCH_NUM_BACKENDS; b++) {
+        const bench_backend_t *backend = &bench_backends[b];
+
+        ran[b] = backend->available == NULL || backend->available();
+        if (!ran[b])
+            continue;
+        status = bench_backend(backend, only_len, num_samples, &first,
+                ns_per_octet[b]);
+        if (status) {
+            fprintf(stderr, "error: %s/%s failed with error code %d\n",
+                    backend->primitive, backend->backend, status);
+            exit(1);
+        }
+    }
+
+    /* the fastest backend of each primitive, at each length */
+    printf("\n  ],\n  \"fastest\": [\n");
+    first = 1;
+    for (b = 0; b < BENCH_NUM_BACKENDS; b++) {
+        for (i = 0; i < b; i++)
+            if (!strcmp(bench_backends[i].primitive,
+                    bench_backends[b].primitive))
+                break;
+        if (i < b)
+            continue; /* primitive already done */
+
+        for (l = 0; l < (only_len ? 1 : BENCH_NUM_LENGTHS); l++) {
+            int best = -1;
+
+            for (i = b; i < BENCH_NUM_BACKENDS; i++)
+                if (ran[i] && !strcmp(bench_backends[i].primitive,
+                        bench_backends[b].primitive) && (best < 0
+                        || ns_per_octet[i][l] < ns_per_octet[best][l]))
+                    best = i;
+            if (best < 0)
+                continue;
+            printf("%s    {\"primitive\": \"%s\", \"length\": %d, "
+                   "\"backend\": \"%s\"}", first ? "" : ",\n",
+                   bench_backends[b].primitive,
+                   only_len ? only_len : bench_lengths[l],
+                   bench_backends[best].backend);
+            first = 0;
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    /* put back the sha1_core the kernel picked */
+    sha1_core_select();
+    if (bench_perf_fd >= 0)
+        close(bench_perf_fd);
+
+    status = crypto_kernel_shutdown();
+    if (status) {
+        fprintf(stderr, "error: crypto_kernel shutdown failed\n");
+        exit(1);
+    }
+
+    return 0;
+}
@@ -46,6 +46,8 @@
 #include <unistd.h>          /* for getopt() */
 #include "crypto_kernel.h"
 
+err_status_t crypto_kernel_deferred_test(void);
+
 // int main(int argc, char *argv[]) {
 int kernel_driver(unsigned do_validation, unsigned do_debug) {
     extern char *optarg;
@@ -75,6 +77,14 @@ int kernel_driver(unsigned do_validation, unsigned do_debug) {
             return(1);
         }
         printf("crypto_kernel passed self-tests\n");
+
+        printf("checking deferred crypto_kernel init...\n");
+        status = crypto_kernel_deferred_test();
+        if (status) {
+            printf("failed\n");
+            return(1);
+        }
+        printf("passed\n");
     }
 
     status = crypto_kernel_shutdown();
@@ -98,3 +108,41 @@ err_status_t crypto_kernel_cipher_test(void) {
 
     return err_status_ok;
 }
+
+/*
+ * crypto_kernel_deferred_test() re-initializes the crypto_kernel in
+ * the deferred mode, and checks that the RNG tests complete and that
+ * the first allocation of a cipher runs its self-test
+ */
+
+err_status_t crypto_kernel_deferred_test(void) {
+    crypto_kernel_init_stats_t stats;
+    cipher_t *c = NULL;
+    err_status_t status;
+
+    status = crypto_kernel_shutdown();
+    if (status)
+        return status;
+
+    crypto_kernel_set_init_mode(crypto_kernel_init_deferred);
+    status = crypto_kernel_init(1);
+    if (status == err_status_ok)
+        status = crypto_kernel_wait_rng_test();
+    if (status == err_status_ok)
+        status = crypto_kernel_alloc_cipher(AES_128_ICM, &c, 30);
+    if (status == err_status_ok)
+        status = cipher_dealloc(c);
+    crypto_kernel_set_init_mode(crypto_kernel_init_full);
+    if (status)
+        return status;
+
+    crypto_kernel_get_init_stats(&stats);
+    printf("init took %lu usec (rng %lu, ciphers %lu, auth %lu), "
+           "rng tests %lu usec in the background\n",
+           stats.total_usec, stats.rng_init_usec, stats.cipher_usec,
+           stats.auth_usec, stats.rng_test_usec);
+    if (stats.mode != crypto_kernel_init_deferred || !stats.rng_test_done)
+        return err_status_algo_fail;
+
+    return crypto_kernel_status();
+}
@@ -366,10 +366,13 @@ err_status_t sha1_validate(void) {
     hash_test_case_t *test_case;
     err_status_t err;
 
-    err = sha1_add_test_cases();
-    if (err) {
-        printf("error adding SHA1 test cases (error code %d)\n", err);
-        return err;
+    /* the test cases are shared by all the sha1_core implementations */
+    if (sha1_test_case_list == NULL) {
+        err = sha1_add_test_cases();
+        if (err) {
+            printf("error adding SHA1 test cases (error code %d)\n", err);
+            return err;
+        }
     }
 
     if (sha1_test_case_list == NULL)
@@ -391,15 +394,25 @@ err_status_t sha1_validate(void) {
 // int main(void) {
 int sha1_driver(void) {
     err_status_t err;
+    sha1_core_type_t type;
 
     printf("sha1 test driver\n");
 
-    err = sha1_validate();
-    if (err) {
-        printf("SHA1 did not pass validation testing\n");
-        return 1;
+    /* validate every sha1_core implementation this cpu can run */
+    for (type = sha1_core_type_generic; type <= sha1_core_type_hw; type++) {
+        if (sha1_core_use(type) != err_status_ok)
+            continue;
+
+        err = sha1_validate();
+        if (err) {
+            printf("SHA1 (%s) did not pass validation testing\n",
+                    sha1_core_name(type));
+            sha1_core_select();
+            return 1;
+        }
+        printf("SHA1 (%s) passed validation tests\n", sha1_core_name(type));
     }
-    printf("SHA1 passed validation tests\n");
+    sha1_core_select();
 
     return 0;
 
@@ -79,7 +79,7 @@ extern "C" {
  * SRTP_MAX_TAG_LEN is the maximum tag length supported by libSRTP
  */
 
-#define SRTP_MAX_TAG_LEN 12
+#define SRTP_MAX_TAG_LEN 16
 
 /**
  * SRTP_MAX_TRAILER_LEN is the maximum length of the SRTP trailer
@@ -179,7 +179,8 @@ typedef struct {
  * policy for an entire SRTP session.  Each element contains the SRTP
  * and SRTCP crypto policies for that stream, a pointer to the SRTP
  * master key for that stream, the SSRC describing that stream, or a
- * flag indicating a `wildcard' SSRC value, and a `next' field that
+ * flag indicating a `wildcard' SSRC value, the size of the replay
+ * window of the receiver of that stream, and a `next' field that
  * holds a pointer to the next element in the list of policy elements,
  * or NULL if it is the last element.
  *
@@ -208,6 +209,10 @@ typedef struct srtp_policy_t {
     crypto_policy_t rtcp; /**< SRTCP crypto policy.                 */
     unsigned char *key; /**< Pointer to the SRTP master key for
      *    this stream.                        */
+    unsigned long window_size; /**< The size of the SRTP replay window,
+     *   in packets: at least 64 and at most
+     *   32767, or 0 for the default of 128.
+     */
     struct srtp_policy_t *next; /**< Pointer to next stream policy.       */
 } srtp_policy_t;
 
@@ -340,6 +345,77 @@ err_status_t srtp_protect(srtp_t ctx, void *rtp_hdr, int *len_ptr);
 
 err_status_t srtp_unprotect(srtp_t ctx, void *srtp_hdr, int *len_ptr);
 
+/**
+ * @brief srtp_protect_vec() applies srtp_protect() to an array of
+ * packets.
+ *
+ * The function call srtp_protect_vec(ctx, rtp_hdr, len, status, num)
+ * protects the num RTP packets rtp_hdr[0] to rtp_hdr[num-1], of
+ * len[0] to len[num-1] octets, as num calls to srtp_protect() in that
+ * order would, and leaves the result for packet i in status[i] and its
+ * new length in len[i].  The packets of streams that use AES counter
+ * mode are encrypted together, so that the keystream of several short
+ * packets is computed as efficiently as that of one long packet; a
+ * run of packets of the same SSRC also finds its stream without
+ * searching the stream list.
+ *
+ * This suits a transport that sends a burst of packets at once, e.g.
+ * with sendmmsg().
+ *
+ * @param ctx is the SRTP context to use in processing the packets.
+ *
+ * @param rtp_hdr is an array of pointers to the RTP packets, each of
+ * which must have room for the authentication tag, as for
+ * srtp_protect().
+ *
+ * @param len is an array of the lengths of the packets in octets.
+ *
+ * @param status is an array that receives the status of each packet.
+ *
+ * @param num is the number of packets.
+ *
+ * @return
+ *    - err_status_ok  if every packet was protected.
+ *    - [other]        the status of the first packet that was not.
+ */
+
+err_status_t srtp_protect_vec(srtp_t ctx, void *rtp_hdr[], int len[],
+        err_status_t status[], int num);
+
+/**
+ * @brief srtp_unprotect_vec() applies srtp_unprotect() to an array of
+ * packets.
+ *
+ * The function call srtp_unprotect_vec(ctx, srtp_hdr, len, status,
+ * num) verifies and decrypts the num SRTP packets srtp_hdr[0] to
+ * srtp_hdr[num-1], of len[0] to len[num-1] octets, as num calls to
+ * srtp_unprotect() in that order would, and leaves the result for
+ * packet i in status[i] and its new length in len[i].  The packets
+ * are authenticated and checked against the replay database one by
+ * one; those that are accepted and use AES counter mode are then
+ * decrypted together.
+ *
+ * This suits a transport that receives a burst of packets at once,
+ * e.g. with recvmmsg().
+ *
+ * @param ctx is the SRTP context to use in processing the packets.
+ *
+ * @param srtp_hdr is an array of pointers to the SRTP packets.
+ *
+ * @param len is an array of the lengths of the packets in octets.
+ *
+ * @param status is an array that receives the status of each packet.
+ *
+ * @param num is the number of packets.
+ *
+ * @return
+ *    - err_status_ok  if every packet was valid.
+ *    - [other]        the status of the first packet that was not.
+ */
+
+err_status_t srtp_unprotect_vec(srtp_t ctx, void *srtp_hdr[], int len[],
+        err_status_t status[], int num);
+
 /**
  * @brief srtp_create() allocates and initializes an SRTP session.
 
@@ -364,6 +440,48 @@ err_status_t srtp_unprotect(srtp_t ctx, void *srtp_hdr, int *len_ptr);
 
 err_status_t srtp_create(srtp_t *session, const srtp_policy_t *policy);
 
+/**
+ * @brief srtp_create_pair() allocates and initializes a pair of SRTP
+ * sessions, one for each direction of a media session.
+ *
+ * An srtp_t must not be used by two threads at the same time, since
+ * srtp_protect() and srtp_unprotect() both update the streams of the
+ * session and may add streams to it.  Distinct sessions share no
+ * state that these functions change, however, so a sending and a
+ * receiving thread can each use one of the sessions of a pair without
+ * any locking.
+ *
+ * The function call srtp_create_pair(sender, receiver, policy) creates
+ * the sessions *sender and *receiver as srtp_create() would, except
+ * that every stream of *sender, including those added to it later, is
+ * one that is used with srtp_protect() and srtp_protect_rtcp(), and
+ * every stream of *receiver one that is used with srtp_unprotect() and
+ * srtp_unprotect_rtcp().  Using a stream the other way is reported as
+ * an SSRC collision.  The RTP and RTCP halves of a stream are
+ * independent, and the RTP and RTCP functions keep separate caches of
+ * their last stream lookup, so the RTCP reports of a receiving thread
+ * can be protected with *sender while another thread protects RTP
+ * packets with it, provided that every stream used was created from
+ * an SSRC specific policy rather than from a template: a stream
+ * cloned from a template is added to the session by whichever thread
+ * first sees its SSRC.
+ *
+ * @param sender is set to the session for outgoing packets.
+ *
+ * @param receiver is set to the session for incoming packets.
+ *
+ * @param policy is the srtp_policy_t list applied to both sessions,
+ * as for srtp_create().
+ *
+ * @return
+ *    - err_status_ok           if creation succeded.
+ *    - err_status_alloc_fail   if allocation failed.
+ *    - err_status_init_fail    if initialization failed.
+ */
+
+err_status_t srtp_create_pair(srtp_t *sender, srtp_t *receiver,
+        const srtp_policy_t *policy);
+
 /**
  * @brief srtp_add_stream() allocates and initializes an SRTP stream
  * within a given SRTP session.
@@ -551,6 +669,48 @@ void crypto_policy_set_aes_cm_128_null_auth(crypto_policy_t *p);
 
 void crypto_policy_set_null_cipher_hmac_sha1_80(crypto_policy_t *p);
 
+/**
+ * @brief crypto_policy_set_aes_gcm_128_16_auth() sets a crypto
+ * policy structure to the AEAD_AES_128_GCM transform
+ *
+ * @param p is a pointer to the policy structure to be set
+ *
+ * The function call crypto_policy_set_aes_gcm_128_16_auth(&p) sets
+ * the crypto_policy_t at location p to use AES-128 Galois/Counter Mode
+ * with a 16 octet tag, which provides both encryption and message
+ * authentication (RFC 7714).  The master key is 16 octets long and the
+ * master salt 12 octets, i.e. the key passed in the srtp_policy_t is
+ * 28 octets long.
+ *
+ * This function is a convenience that helps to avoid dealing directly
+ * with the policy data structure.  You are encouraged to initialize
+ * policy elements with this function call.  Doing so may allow your
+ * code to be forward compatible with later versions of libSRTP that
+ * include more elements in the crypto_policy_t datatype.
+ *
+ * @return void.
+ *
+ */
+
+void crypto_policy_set_aes_gcm_128_16_auth(crypto_policy_t *p);
+
+/**
+ * @brief crypto_policy_set_aes_gcm_256_16_auth() sets a crypto
+ * policy structure to the AEAD_AES_256_GCM transform
+ *
+ * @param p is a pointer to the policy structure to be set
+ *
+ * The function call crypto_policy_set_aes_gcm_256_16_auth(&p) is
+ * crypto_policy_set_aes_gcm_128_16_auth() with AES-256; the key passed
+ * in the srtp_policy_t is 44 octets long (a 32 octet master key and a
+ * 12 octet master salt).
+ *
+ * @return void.
+ *
+ */
+
+void crypto_policy_set_aes_gcm_256_16_auth(crypto_policy_t *p);
+
 /**
  * @brief srtp_dealloc() deallocates storage for an SRTP session
  * context.
@@ -180,6 +180,18 @@ typedef enum direction_t {
     dir_unknown = 0, dir_srtp_sender = 1, dir_srtp_receiver = 2
 } direction_t;
 
+/*
+ * an srtp_fast_path_t selects the direct AES counter mode and
+ * HMAC-SHA1 code that srtp_protect() (in one fused pass) and
+ * srtp_unprotect() use for the RTP packets of a stream that is
+ * protected with them, the profile used by nearly all SRTP traffic;
+ * srtp_fast_none selects the generic code
+ */
+
+typedef enum srtp_fast_path_t {
+    srtp_fast_none = 0, srtp_fast_aes_icm = 1, srtp_fast_aes_icm_hw = 2
+} srtp_fast_path_t;
+
 /*
  * an srtp_stream_t has its own SSRC, encryption key, authentication
  * key, sequence number, and replay database
@@ -194,6 +206,7 @@ typedef struct srtp_stream_ctx_t {
     auth_t *rtp_auth;
     rdbx_t rtp_rdbx;
     sec_serv_t rtp_services;
+    srtp_fast_path_t rtp_fast_path;
     cipher_t *rtcp_cipher;
     auth_t *rtcp_auth;
     rdb_t rtcp_rdb;
@@ -210,6 +223,12 @@ typedef struct srtp_stream_ctx_t {
 typedef struct srtp_ctx_t {
     srtp_stream_ctx_t *stream_list; /* linked list of streams            */
     srtp_stream_ctx_t *stream_template; /* act as template for other streams */
+    srtp_stream_ctx_t **stream_index; /* ssrc hash table over stream_list */
+    unsigned int index_size; /* slots in stream_index (power of 2) */
+    unsigned int index_count; /* streams in stream_index           */
+    srtp_stream_ctx_t *stream_last; /* result of the last RTP lookup     */
+    srtp_stream_ctx_t *stream_last_rtcp; /* and of the last RTCP lookup  */
+    direction_t direction; /* of all streams, if not dir_unknown    */
 } srtp_ctx_t;
 
 /*
@@ -43,7 +43,9 @@
  */
 
 #include "srtp_priv.h"
-#include "aes_icm.h"         /* aes_icm is used in the KDF  */
+#include "aes_icm.h"         /* aes is used in the KDF      */
+#include "aes_gcm.h"         /* for the AEAD transforms     */
+#include "hmac.h"            /* for the fused fast path     */
 #include "alloc.h"           /* for crypto_alloc()          */
 
 #ifndef SRTP_KERNEL
@@ -57,6 +59,7 @@
 
 extern cipher_type_t aes_icm;
 extern auth_type_t tmmhv2;
+extern auth_type_t hmac;
 
 /* the debug module for srtp */
 
@@ -211,6 +214,9 @@ err_status_t srtp_stream_dealloc(srtp_t session, srtp_stream_ctx_t *stream) {
             return status;
     }
 
+    /* deallocate replay database */
+    rdbx_dealloc(&stream->rtp_rdbx);
+
     /* deallocate srtp stream context */
     crypto_free(stream);
 
@@ -225,6 +231,26 @@ err_status_t srtp_stream_dealloc(srtp_t session, srtp_stream_ctx_t *stream) {
  * the SSRC
  */
 
+/*
+ * srtp_select_fast_path(stream) returns the fused path that suits the
+ * RTP transform of stream: one of the aes_icm ciphers without a
+ * keystream prefix, HMAC-SHA1, and both confidentiality and
+ * authentication
+ */
+
+static srtp_fast_path_t srtp_select_fast_path(const srtp_stream_ctx_t *stream) {
+
+    if (stream->rtp_services != sec_serv_conf_and_auth
+            || stream->rtp_auth->type != &hmac
+            || stream->rtp_auth->prefix_len != 0)
+        return srtp_fast_none;
+    if (stream->rtp_cipher->type == &aes_icm_hw)
+        return srtp_fast_aes_icm_hw;
+    if (stream->rtp_cipher->type == &aes_icm)
+        return srtp_fast_aes_icm;
+    return srtp_fast_none;
+}
+
 err_status_t srtp_stream_clone(const srtp_stream_ctx_t *stream_template,
         uint32_t ssrc, srtp_stream_ctx_t **str_ptr) {
     err_status_t status;
@@ -250,7 +276,12 @@ err_status_t srtp_stream_clone(const srtp_stream_ctx_t *stream_template,
         return status;
 
     /* initialize replay databases */
-    rdbx_init(&str->rtp_rdbx);
+    status = rdbx_init(&str->rtp_rdbx,
+            rdbx_get_window_size(&stream_template->rtp_rdbx));
+    if (status) {
+        crypto_free(str);
+        return status;
+    }
     rdb_init(&str->rtcp_rdb);
 
     /* set ssrc to that provided */
@@ -260,6 +291,7 @@ err_status_t srtp_stream_clone(const srtp_stream_ctx_t *stream_template,
     str->direction = stream_template->direction;
     str->rtp_services = stream_template->rtp_services;
     str->rtcp_services = stream_template->rtcp_services;
+    str->rtp_fast_path = stream_template->rtp_fast_path;
 
     /* defensive coding */
     str->next = NULL;
@@ -267,6 +299,143 @@ err_status_t srtp_stream_clone(const srtp_stream_ctx_t *stream_template,
     return err_status_ok;
 }
 
+/*
+ * the stream index is an open addressing hash table, with linear
+ * probing, that maps an ssrc to its stream in the stream_list.  It
+ * holds at most one stream per ssrc (the one nearest to the head of
+ * the list, which is the one that the list walk would find), has a
+ * power of two size and is kept at most half full.  If it cannot be
+ * grown it is dropped, and srtp_get_stream() walks the list instead.
+ *
+ * stream_last caches the result of the last lookup, which is all
+ * that is needed when a session carries a single stream.  The RTCP
+ * functions have their own cache, stream_last_rtcp, so that RTP and
+ * RTCP packets can be processed by two threads without either of
+ * them writing memory that the other one uses
+ */
+
+#define SRTP_INDEX_MIN_SIZE 16
+
+static inline unsigned int srtp_index_hash(uint32_t ssrc, unsigned int size) {
+
+    /* ssrcs may be sequential, so mix all of the bits into the low ones */
+    ssrc ^= ssrc >> 16;
+    ssrc *= 0x85ebca6b;
+    ssrc ^= ssrc >> 13;
+
+    return ssrc & (size - 1);
+}
+
+static void srtp_index_insert(srtp_ctx_t *ctx, srtp_stream_ctx_t *stream,
+        int replace) {
+    unsigned int i;
+
+    i = srtp_index_hash(stream->ssrc, ctx->index_size);
+    while (ctx->stream_index[i] != NULL) {
+        if (ctx->stream_index[i]->ssrc == stream->ssrc) {
+            if (replace)
+                ctx->stream_index[i] = stream;
+            return;
+        }
+        i = (i + 1) & (ctx->index_size - 1);
+    }
+    ctx->stream_index[i] = stream;
+    ctx->index_count++;
+}
+
+static void srtp_index_clear(srtp_ctx_t *ctx) {
+    if (ctx->stream_index != NULL)
+        crypto_free(ctx->stream_index);
+    ctx->stream_index = NULL;
+    ctx->index_size = 0;
+    ctx->index_count = 0;
+}
+
+/*
+ * srtp_index_rebuild(ctx) replaces the stream index with one at least
+ * twice as large as the stream_list, and fills it from the list
+ */
+
+static void srtp_index_rebuild(srtp_ctx_t *ctx) {
+    srtp_stream_ctx_t *stream;
+    unsigned int size = SRTP_INDEX_MIN_SIZE;
+    unsigned int num_streams = 0;
+
+    for (stream = ctx->stream_list; stream != NULL; stream = stream->next)
+        num_streams++;
+    while (size < 2 * num_streams)
+        size *= 2;
+
+    srtp_index_clear(ctx);
+    ctx->stream_index = (srtp_stream_ctx_t **) crypto_alloc(
+            size * sizeof(srtp_stream_ctx_t *));
+    if (ctx->stream_index == NULL)
+        return;
+    memset(ctx->stream_index, 0, size * sizeof(srtp_stream_ctx_t *));
+    ctx->index_size = size;
+
+    /* the first stream found for an ssrc is the one to keep */
+    for (stream = ctx->stream_list; stream != NULL; stream = stream->next)
+        srtp_index_insert(ctx, stream, 0);
+}
+
+/*
+ * srtp_insert_stream(ctx, stream) adds stream to the head of the
+ * stream_list of ctx, and to its stream index
+ */
+
+static void srtp_insert_stream(srtp_ctx_t *ctx, srtp_stream_ctx_t *stream) {
+
+    stream->next = ctx->stream_list;
+    ctx->stream_list = stream;
+
+    if (2 * (ctx->index_count + 1) > ctx->index_size)
+        srtp_index_rebuild(ctx);
+    else
+        srtp_index_insert(ctx, stream, 1);
+
+    ctx->stream_last = stream;
+}
+
+/*
+ * srtp_index_remove(ctx, stream) removes stream from the stream index
+ * of ctx, if it is there, closing the gap in its probe sequence
+ */
+
+static void srtp_index_remove(srtp_ctx_t *ctx, srtp_stream_ctx_t *stream) {
+    srtp_stream_ctx_t **tab = ctx->stream_index;
+    unsigned int mask = ctx->index_size - 1;
+    unsigned int i, j, k;
+
+    if (ctx->stream_last == stream)
+        ctx->stream_last = NULL;
+    if (ctx->stream_last_rtcp == stream)
+        ctx->stream_last_rtcp = NULL;
+    if (tab == NULL)
+        return;
+
+    i = srtp_index_hash(stream->ssrc, ctx->index_size);
+    while (tab[i] != stream) {
+        if (tab[i] == NULL)
+            return;
+        i = (i + 1) & mask;
+    }
+
+    /*
+     * move back each following entry of the cluster that would no
+     * longer be reachable from its home slot k once slot i is empty
+     */
+    for (j = (i + 1) & mask; tab[j] != NULL; j = (j + 1) & mask) {
+        k = srtp_index_hash(tab[j]->ssrc, ctx->index_size);
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        tab[i] = tab[j];
+        i = j;
+    }
+    tab[i] = NULL;
+    ctx->index_count--;
+}
+
 /*
  * key derivation functions, internal to libSRTP
  *
@@ -293,33 +462,55 @@ typedef enum {
 
 /*
  * srtp_kdf_t represents a key derivation function.  The SRTP
- * default KDF is the only one implemented at present.
+ * default KDF is the only one implemented at present; it is AES
+ * counter mode keyed with the master key, with an AES-256 master key
+ * for the AEAD_AES_256_GCM transform (RFC 7714 section 11).
  */
 
 typedef struct {
-    aes_icm_ctx_t c; /* cipher used for key derivation  */
+    aes_key_t key; /* master key                        */
+    v128_t salt; /* master salt, zero padded          */
 } srtp_kdf_t;
 
-err_status_t srtp_kdf_init(srtp_kdf_t *kdf, const uint8_t key[30]) {
+/*
+ * srtp_kdf_init(&kdf, k, kl, sl) initializes kdf with the master key
+ * of kl octets at k, followed by a master salt of sl octets (14, or
+ * 12 for the AEAD transforms)
+ */
 
-    aes_icm_context_init(&kdf->c, key);
+err_status_t srtp_kdf_init(srtp_kdf_t *kdf, const uint8_t *key, int key_len,
+        int salt_len) {
+    int i;
 
-    return err_status_ok;
+    v128_set_to_zero(&kdf->salt);
+    for (i = 0; i < salt_len && i < 14; i++)
+        kdf->salt.v8[i] = key[key_len + i];
+
+    return aes_expand_key(key, key_len, &kdf->key);
 }
 
 err_status_t srtp_kdf_generate(srtp_kdf_t *kdf, srtp_prf_label label,
         uint8_t *key, int length) {
+    v128_t block;
+    int i, n;
 
-    v128_t nonce;
-
-    /* set eigth octet of nonce to <label>, set the rest of it to zero */
-    v128_set_to_zero(&nonce);
-    nonce.v8[7] = label;
-
-    aes_icm_set_iv(&kdf->c, &nonce);
-
-    /* generate keystream output */
-    aes_icm_output(&kdf->c, key, length);
+    /*
+     * the eighth octet of the salt is exored with <label>, and the
+     * last two octets count the keystream blocks
+     */
+    for (i = 0; length > 0; i++) {
+        block = kdf->salt;
+        block.v8[7] ^= label;
+        block.v8[14] = (uint8_t) (i >> 8);
+        block.v8[15] = (uint8_t) i;
+        aes_key_encrypt_blocks(&block, 1, &kdf->key);
+
+        n = length < 16 ? length : 16;
+        memcpy(key, block.v8, n);
+        key += n;
+        length -= n;
+    }
+    octet_string_set_to_zero(block.v8, sizeof(block));
 
     return err_status_ok;
 }
@@ -343,22 +534,36 @@ err_status_t srtp_stream_init_keys(srtp_stream_ctx_t *srtp, const void *key) {
     srtp_kdf_t kdf;
     uint8_t tmp_key[MAX_SRTP_KEY_LEN];
 
-    /* initialize KDF state     */
-    srtp_kdf_init(&kdf, (const uint8_t *) key);
+    /*
+     * initialize KDF state; the master key of an AEAD stream is as
+     * long as its cipher key, and its master salt is 12 octets
+     */
+    if (cipher_is_aead(srtp->rtp_cipher))
+        stat = srtp_kdf_init(&kdf, (const uint8_t *) key,
+                cipher_get_key_length(srtp->rtp_cipher) - AES_GCM_SALT_LEN,
+                AES_GCM_SALT_LEN);
+    else
+        stat = srtp_kdf_init(&kdf, (const uint8_t *) key, 16, 14);
+    if (stat)
+        return err_status_init_fail;
 
     /* generate encryption key  */
     srtp_kdf_generate(&kdf, label_rtp_encryption, tmp_key,
             cipher_get_key_length(srtp->rtp_cipher));
     /*
-     * if the cipher in the srtp context is aes_icm, then we need
-     * to generate the salt value
+     * if the cipher in the srtp context is aes_icm or aes_gcm, then
+     * we need to generate the salt value
      */
-    if (srtp->rtp_cipher->type == &aes_icm) {
+    if (cipher_type_is_aes_icm(srtp->rtp_cipher->type)
+            || cipher_type_is_aes_gcm(srtp->rtp_cipher->type)) {
         /* FIX!!! this is really the cipher key length; rest is salt */
-        int base_key_len = 16;
+        int base_key_len = cipher_type_is_aes_gcm(srtp->rtp_cipher->type)
+                ? cipher_get_key_length(srtp->rtp_cipher) - AES_GCM_SALT_LEN
+                : 16;
         int salt_len = cipher_get_key_length(srtp->rtp_cipher) - base_key_len;
 
-        debug_print(mod_srtp, "found aes_icm, generating salt", NULL);
+        debug_print(mod_srtp, "found aes_icm or aes_gcm, generating salt",
+                NULL);
 
         /* generate encryption salt, put after encryption key */
         srtp_kdf_generate(&kdf, label_rtp_salt, tmp_key + base_key_len,
@@ -397,15 +602,19 @@ err_status_t srtp_stream_init_keys(srtp_stream_ctx_t *srtp, const void *key) {
     srtp_kdf_generate(&kdf, label_rtcp_encryption, tmp_key,
             cipher_get_key_length(srtp->rtcp_cipher));
     /*
-     * if the cipher in the srtp context is aes_icm, then we need
-     * to generate the salt value
+     * if the cipher in the srtp context is aes_icm or aes_gcm, then
+     * we need to generate the salt value
      */
-    if (srtp->rtcp_cipher->type == &aes_icm) {
+    if (cipher_type_is_aes_icm(srtp->rtcp_cipher->type)
+            || cipher_type_is_aes_gcm(srtp->rtcp_cipher->type)) {
         /* FIX!!! this is really the cipher key length; rest is salt */
-        int base_key_len = 16;
+        int base_key_len = cipher_type_is_aes_gcm(srtp->rtcp_cipher->type)
+                ? cipher_get_key_length(srtp->rtcp_cipher) - AES_GCM_SALT_LEN
+                : 16;
         int salt_len = cipher_get_key_length(srtp->rtcp_cipher) - base_key_len;
 
-        debug_print(mod_srtp, "found aes_icm, generating rtcp salt", NULL);
+        debug_print(mod_srtp,
+                "found aes_icm or aes_gcm, generating rtcp salt", NULL);
 
         /* generate encryption salt, put after encryption key */
         srtp_kdf_generate(&kdf, label_rtcp_salt, tmp_key + base_key_len,
@@ -448,8 +657,11 @@ err_status_t srtp_stream_init(srtp_stream_ctx_t *srtp, const srtp_policy_t *p) {
 
     debug_print(mod_srtp, "initializing stream (SSRC: 0x%08x)", p->ssrc.value);
 
-    /* initialize replay database */
-    rdbx_init(&srtp->rtp_rdbx);
+    /* initialize replay database, with the default window if none is set */
+    err = rdbx_init(&srtp->rtp_rdbx, p->window_size ? p->window_size
+            : rdbx_default_window_size);
+    if (err)
+        return err;
 
     /* initialize key limit to maximum value */
 #ifdef NO_64BIT_MATH
@@ -483,8 +695,12 @@ err_status_t srtp_stream_init(srtp_stream_ctx_t *srtp, const srtp_policy_t *p) {
 
     /* initialize keys */
     err = srtp_stream_init_keys(srtp, p->key);
-    if (err)
+    if (err) {
+        rdbx_dealloc(&srtp->rtp_rdbx);
         return err;
+    }
+
+    srtp->rtp_fast_path = srtp_select_fast_path(srtp);
 
     return err_status_ok;
 }
@@ -536,12 +752,484 @@ err_status_t srtp_install_event_handler(srtp_event_handler_func_t func) {
      * been previously installed
      */
 
-    /* set global event handling function */
-    srtp_event_handler = func;
+    /* set global event handling function */
+    srtp_event_handler = func;
+    return err_status_ok;
+}
+
+/*
+ * the AEAD transforms of RFC 7714 (AES-GCM) authenticate the part of
+ * the packet that is not encrypted as additional data, and append the
+ * tag of the cipher to the ciphertext; no authentication function is
+ * run.  The 12 octet IV is
+ *
+ *   00 00 || SSRC || ROC || SEQ        (SRTP)
+ *   00 00 || SSRC || 00 00 || 0 || SRTCP index (SRTCP)
+ *
+ * and the cipher exors it with the session salt.
+ */
+
+static void srtp_calc_aead_iv(v128_t *iv, uint32_t ssrc, uint32_t high,
+        uint32_t low) {
+    iv->v32[0] = 0;
+    iv->v32[1] = 0;
+    iv->v32[2] = 0;
+    iv->v32[3] = 0;
+    memcpy(iv->v8 + 2, &ssrc, 4); /* still in network order */
+    iv->v8[6] = (uint8_t) (high >> 24);
+    iv->v8[7] = (uint8_t) (high >> 16);
+    iv->v8[8] = (uint8_t) (high >> 8);
+    iv->v8[9] = (uint8_t) high;
+    iv->v8[10] = (uint8_t) (low >> 8);
+    iv->v8[11] = (uint8_t) low;
+}
+
+/* returns the offset of the payload of an RTP packet, or -1 */
+static int srtp_get_payload_offset(const srtp_hdr_t *hdr, int pkt_octet_len) {
+    int offset = octets_in_rtp_header + 4 * hdr->cc;
+
+    if (hdr->x == 1) {
+        const srtp_hdr_xtnd_t *xtn_hdr;
+
+        if (offset + 4 > pkt_octet_len)
+            return -1;
+        xtn_hdr = (const srtp_hdr_xtnd_t *) ((const uint8_t *) hdr + offset);
+        offset += 4 * (ntohs(xtn_hdr->length) + 1);
+    }
+    return offset > pkt_octet_len ? -1 : offset;
+}
+
+static err_status_t srtp_protect_aead(srtp_ctx_t *ctx,
+        srtp_stream_ctx_t *stream, srtp_hdr_t *hdr, int *pkt_octet_len) {
+    xtd_seq_num_t est; /* estimated xtd_seq_num_t of *hdr        */
+    int delta; /* delta of local pkt idx and that in hdr */
+    unsigned int aad_len; /* octets authenticated only             */
+    unsigned int enc_octet_len; /* octets encrypted                   */
+    uint8_t *enc_start;
+    int tag_len = SRTP_MAX_TAG_LEN;
+    v128_t iv;
+    err_status_t status;
+
+    /* without confidentiality, all of the packet is additional data */
+    if (stream->rtp_services & sec_serv_conf) {
+        int offset = srtp_get_payload_offset(hdr, *pkt_octet_len);
+        if (offset < 0)
+            return err_status_bad_param;
+        aad_len = offset;
+    } else {
+        aad_len = *pkt_octet_len;
+    }
+    enc_start = (uint8_t *) hdr + aad_len;
+    enc_octet_len = *pkt_octet_len - aad_len;
+
+    delta = rdbx_estimate_index(&stream->rtp_rdbx, &est, ntohs(hdr->seq));
+    status = rdbx_check(&stream->rtp_rdbx, delta);
+    if (status)
+        return status; /* we've been asked to reuse an index */
+    rdbx_add_index(&stream->rtp_rdbx, delta);
+
+#ifdef NO_64BIT_MATH
+    srtp_calc_aead_iv(&iv, hdr->ssrc, (high32(est) << 16) | (low32(est) >> 16),
+            low32(est));
+#else
+    srtp_calc_aead_iv(&iv, hdr->ssrc, (uint32_t) (est >> 16), (uint32_t) est);
+#endif
+    status = cipher_set_iv(stream->rtp_cipher, &iv);
+    if (status == err_status_ok)
+        status = cipher_set_aad(stream->rtp_cipher, (uint8_t *) hdr, aad_len);
+    if (status == err_status_ok)
+        status = cipher_encrypt(stream->rtp_cipher, enc_start, &enc_octet_len);
+    if (status == err_status_ok)
+        status = cipher_get_tag(stream->rtp_cipher, enc_start + enc_octet_len,
+                &tag_len);
+    if (status)
+        return err_status_cipher_fail;
+
+    debug_print(mod_srtp, "srtp aead tag:    %s", octet_string_hex_string(
+            enc_start + enc_octet_len, tag_len));
+
+    /* increase the packet length by the length of the tag */
+    *pkt_octet_len += tag_len;
+
+    return err_status_ok;
+}
+
+static err_status_t srtp_unprotect_aead(srtp_ctx_t *ctx,
+        srtp_stream_ctx_t *stream, int delta, xtd_seq_num_t est,
+        srtp_hdr_t *hdr, int *pkt_octet_len) {
+    unsigned int aad_len; /* octets authenticated only             */
+    unsigned int enc_octet_len; /* octets of ciphertext and tag       */
+    int tag_len = auth_get_tag_length(stream->rtp_auth);
+    v128_t iv;
+    err_status_t status;
+
+    if (*pkt_octet_len < octets_in_rtp_header + tag_len)
+        return err_status_bad_param;
+    if (stream->rtp_services & sec_serv_conf) {
+        int offset = srtp_get_payload_offset(hdr, *pkt_octet_len - tag_len);
+        if (offset < 0)
+            return err_status_bad_param;
+        aad_len = offset;
+    } else {
+        aad_len = *pkt_octet_len - tag_len;
+    }
+    enc_octet_len = *pkt_octet_len - aad_len;
+
+#ifdef NO_64BIT_MATH
+    srtp_calc_aead_iv(&iv, hdr->ssrc, (high32(est) << 16) | (low32(est) >> 16),
+            low32(est));
+#else
+    srtp_calc_aead_iv(&iv, hdr->ssrc, (uint32_t) (est >> 16), (uint32_t) est);
+#endif
+    status = cipher_set_iv(stream->rtp_cipher, &iv);
+    if (status == err_status_ok)
+        status = cipher_set_aad(stream->rtp_cipher, (uint8_t *) hdr, aad_len);
+    if (status)
+        return err_status_cipher_fail;
+
+    /* the cipher checks the tag before decrypting anything */
+    status = cipher_decrypt(stream->rtp_cipher, (uint8_t *) hdr + aad_len,
+            &enc_octet_len);
+    if (status == err_status_auth_fail)
+        return err_status_auth_fail;
+    if (status)
+        return err_status_cipher_fail;
+
+    /*
+     * update the key usage limit, and check it to make sure that we
+     * didn't just hit either the soft limit or the hard limit, and call
+     * the event handler if we hit either.
+     */
+    switch (key_limit_update(stream->limit)) {
+    case key_event_normal:
+        break;
+    case key_event_soft_limit:
+        srtp_handle_event(ctx, stream, event_key_soft_limit);
+        break;
+    case key_event_hard_limit:
+        srtp_handle_event(ctx, stream, event_key_hard_limit);
+        return err_status_key_expired;
+    default:
+        break;
+    }
+
+    /* see srtp_unprotect() for these checks */
+    if (stream->direction != dir_srtp_receiver) {
+        if (stream->direction == dir_unknown) {
+            stream->direction = dir_srtp_receiver;
+        } else {
+            srtp_handle_event(ctx, stream, event_ssrc_collision);
+        }
+    }
+    if (stream == ctx->stream_template) {
+        srtp_stream_ctx_t *new_stream;
+
+        status = srtp_stream_clone(ctx->stream_template, hdr->ssrc,
+                &new_stream);
+        if (status)
+            return status;
+
+        /* add new stream to the head of the stream_list */
+        srtp_insert_stream(ctx, new_stream);
+
+        /* set stream (the pointer used in this function) */
+        stream = new_stream;
+    }
+
+    rdbx_add_index(&stream->rtp_rdbx, delta);
+
+    /* decrease the packet length by the length of the tag */
+    *pkt_octet_len -= tag_len;
+
+    return err_status_ok;
+}
+
+/*
+ * the fused path for AES counter mode with HMAC-SHA1 (see
+ * srtp_select_fast_path()) makes a single pass over the payload when
+ * sending, SRTP_FAST_CHUNK_LEN octets at a time: each chunk is
+ * encrypted and then, while it is still in the cache, fed to the MAC.
+ * On receiving the packet is authenticated before anything is
+ * decrypted, so that a forged packet costs no decryption, and the
+ * payload is then decrypted in a second pass.  The aes_icm and hmac
+ * functions are called directly rather than through the cipher_t and
+ * auth_t function pointers.  The chunk length is a multiple of both
+ * the AES_ICM_MAX_BLOCKS blocks that aes_icm encrypts at a time and
+ * the SHA-1 block.
+ */
+
+#define SRTP_FAST_CHUNK_LEN 512
+
+static void srtp_calc_icm_iv(v128_t *iv, uint32_t ssrc, xtd_seq_num_t est) {
+    iv->v32[0] = 0;
+    iv->v32[1] = ssrc; /* still in network order */
+#ifdef NO_64BIT_MATH
+    iv->v64[1] = be64_to_cpu(make64((high32(est) << 16) | (low32(est) >> 16),
+                    low32(est) << 16));
+#else
+    iv->v64[1] = be64_to_cpu(est << 16);
+#endif
+}
+
+static inline err_status_t srtp_fast_crypt(srtp_fast_path_t fast_path,
+        aes_icm_ctx_t *cipher, uint8_t *buf, unsigned int len) {
+    if (fast_path == srtp_fast_aes_icm_hw)
+        return aes_icm_hw_encrypt(cipher, buf, &len);
+    return aes_icm_encrypt(cipher, buf, &len);
+}
+
+/*
+ * srtp_fast_mac_final(stream, mac, est, tag) runs the MAC over the ROC
+ * of est, as srtp_protect() does, and writes the tag
+ */
+
+static err_status_t srtp_fast_mac_final(const srtp_stream_ctx_t *stream,
+        hmac_ctx_t *mac, xtd_seq_num_t est, uint8_t *tag) {
+    err_status_t status;
+
+#ifdef NO_64BIT_MATH
+    est = be64_to_cpu(make64((high32(est) << 16) |
+                    (low32(est) >> 16),
+                    low32(est) << 16));
+#else
+    est = be64_to_cpu(est << 16);
+#endif
+    status = hmac_compute(mac, &est, 4, stream->rtp_auth->out_len, tag);
+    if (status)
+        return err_status_auth_fail;
+
+    return err_status_ok;
+}
+
+/*
+ * srtp_fast_encrypt_and_mac(stream, hdr, offset, enc_octet_len, est,
+ * tag) encrypts the enc_octet_len octets that follow the first offset
+ * octets of hdr, and writes the HMAC of the ciphertext packet and ROC
+ * into tag
+ */
+
+static err_status_t srtp_fast_encrypt_and_mac(const srtp_stream_ctx_t *stream,
+        srtp_hdr_t *hdr, int offset, unsigned int enc_octet_len,
+        xtd_seq_num_t est, uint8_t *tag) {
+    aes_icm_ctx_t *cipher = (aes_icm_ctx_t *) stream->rtp_cipher->state;
+    hmac_ctx_t *mac = (hmac_ctx_t *) stream->rtp_auth->state;
+    uint8_t *buf = (uint8_t *) hdr + offset;
+    unsigned int chunk;
+    v128_t iv;
+    err_status_t status;
+
+    srtp_calc_icm_iv(&iv, hdr->ssrc, est);
+    status = aes_icm_set_iv(cipher, &iv);
+    if (status)
+        return err_status_cipher_fail;
+
+    hmac_start(mac);
+    hmac_update(mac, (uint8_t *) hdr, offset);
+    while (enc_octet_len > 0) {
+        chunk = enc_octet_len < SRTP_FAST_CHUNK_LEN ? enc_octet_len
+                : SRTP_FAST_CHUNK_LEN;
+        status = srtp_fast_crypt(stream->rtp_fast_path, cipher, buf, chunk);
+        if (status)
+            return err_status_cipher_fail;
+        hmac_update(mac, buf, chunk);
+        buf += chunk;
+        enc_octet_len -= chunk;
+    }
+
+    return srtp_fast_mac_final(stream, mac, est, tag);
+}
+
+static err_status_t srtp_protect_aes_cm_hmac(srtp_stream_ctx_t *stream,
+        srtp_hdr_t *hdr, int *pkt_octet_len) {
+    xtd_seq_num_t est; /* estimated xtd_seq_num_t of *hdr        */
+    int delta; /* delta of local pkt idx and that in hdr */
+    int offset; /* octets before the encrypted portion    */
+    err_status_t status;
+
+    offset = srtp_get_payload_offset(hdr, *pkt_octet_len);
+    if (offset < 0)
+        return err_status_bad_param;
+
+    delta = rdbx_estimate_index(&stream->rtp_rdbx, &est, ntohs(hdr->seq));
+    status = rdbx_check(&stream->rtp_rdbx, delta);
+    if (status)
+        return status; /* we've been asked to reuse an index */
+    rdbx_add_index(&stream->rtp_rdbx, delta);
+
+    status = srtp_fast_encrypt_and_mac(stream, hdr, offset,
+            *pkt_octet_len - offset, est, (uint8_t *) hdr + *pkt_octet_len);
+    if (status)
+        return status;
+
+    /* increase the packet length by the length of the auth tag */
+    *pkt_octet_len += stream->rtp_auth->out_len;
+
+    return err_status_ok;
+}
+
+static err_status_t srtp_unprotect_aes_cm_hmac(srtp_ctx_t *ctx,
+        srtp_stream_ctx_t *stream, int delta, xtd_seq_num_t est,
+        srtp_hdr_t *hdr, int *pkt_octet_len) {
+    int tag_len = stream->rtp_auth->out_len;
+    aes_icm_ctx_t *cipher = (aes_icm_ctx_t *) stream->rtp_cipher->state;
+    hmac_ctx_t *mac = (hmac_ctx_t *) stream->rtp_auth->state;
+    uint8_t tmp_tag[SRTP_MAX_TAG_LEN];
+    unsigned int enc_octet_len;
+    int offset;
+    v128_t iv;
+    err_status_t status;
+
+    if (*pkt_octet_len < octets_in_rtp_header + tag_len)
+        return err_status_bad_param;
+    offset = srtp_get_payload_offset(hdr, *pkt_octet_len - tag_len);
+    if (offset < 0)
+        return err_status_bad_param;
+    enc_octet_len = *pkt_octet_len - tag_len - offset;
+
+    /* authenticate the packet as it was received, then decrypt it */
+    hmac_start(mac);
+    hmac_update(mac, (uint8_t *) hdr, *pkt_octet_len - tag_len);
+    status = srtp_fast_mac_final(stream, mac, est, tmp_tag);
+    if (status)
+        return status;
+    if (octet_string_is_eq(tmp_tag, (uint8_t *) hdr + *pkt_octet_len
+            - tag_len, tag_len))
+        return err_status_auth_fail;
+
+    switch (key_limit_update(stream->limit)) {
+    case key_event_normal:
+        break;
+    case key_event_soft_limit:
+        srtp_handle_event(ctx, stream, event_key_soft_limit);
+        break;
+    case key_event_hard_limit:
+        srtp_handle_event(ctx, stream, event_key_hard_limit);
+        return err_status_key_expired;
+    default:
+        break;
+    }
+
+    srtp_calc_icm_iv(&iv, hdr->ssrc, est);
+    status = aes_icm_set_iv(cipher, &iv);
+    if (status)
+        return err_status_cipher_fail;
+    status = srtp_fast_crypt(stream->rtp_fast_path, cipher,
+            (uint8_t *) hdr + offset, enc_octet_len);
+    if (status)
+        return err_status_cipher_fail;
+
+    /* see srtp_unprotect() for these checks */
+    if (stream->direction != dir_srtp_receiver) {
+        if (stream->direction == dir_unknown) {
+            stream->direction = dir_srtp_receiver;
+        } else {
+            srtp_handle_event(ctx, stream, event_ssrc_collision);
+        }
+    }
+    if (stream == ctx->stream_template) {
+        srtp_stream_ctx_t *new_stream;
+
+        status = srtp_stream_clone(ctx->stream_template, hdr->ssrc,
+                &new_stream);
+        if (status)
+            return status;
+
+        /* add new stream to the head of the stream_list */
+        srtp_insert_stream(ctx, new_stream);
+
+        /* set stream (the pointer used in this function) */
+        stream = new_stream;
+    }
+
+    rdbx_add_index(&stream->rtp_rdbx, delta);
+
+    /* decrease the packet length by the length of the auth tag */
+    *pkt_octet_len -= tag_len;
+
+    return err_status_ok;
+}
+
+/*
+ * an srtp_crypt_job_t describes the aes_icm encryption (or decryption)
+ * of one packet that srtp_protect_vec() or srtp_unprotect_vec() run
+ * together with those of the other packets of the batch, and for
+ * srtp_protect_vec() the authentication that has to follow it
+ */
+
+#define SRTP_VEC_MAX_PKTS 32
+
+typedef struct {
+    cipher_t *cipher; /* aes_icm cipher, NULL if nothing to do  */
+    v128_t iv; /* iv of the packet                      */
+    uint8_t *enc_start; /* start of encrypted portion            */
+    unsigned int enc_octet_len; /* octets in encrypted portion           */
+    auth_t *auth; /* the remaining fields are for          */
+    uint32_t *auth_start; /* srtp_protect_auth()                   */
+    uint8_t *auth_tag;
+    xtd_seq_num_t est;
+    int pkt; /* index of the packet in the batch      */
+    int queued; /* the encryption has been queued        */
+} srtp_crypt_job_t;
+
+/*
+ * srtp_protect_auth(auth, auth_start, auth_tag, est, pkt_octet_len)
+ * computes the authentication tag of an encrypted packet, if
+ * auth_start is set, and adds its length to *pkt_octet_len; est is
+ * the shifted packet index, in network byte order
+ */
+
+static err_status_t srtp_protect_auth(auth_t *auth, uint32_t *auth_start,
+        uint8_t *auth_tag, xtd_seq_num_t est, int *pkt_octet_len) {
+    err_status_t status;
+    int tag_len;
+
+    /* get tag length from stream */
+    tag_len = auth_get_tag_length(auth);
+
+    /*
+     *  if we're authenticating, run authentication function and put result
+     *  into the auth_tag
+     */
+    if (auth_start) {
+
+        /* initialize auth func context */
+        status = auth_start(auth);
+        if (status)
+            return status;
+
+        /* run auth func over packet */
+        status = auth_update(auth, (uint8_t *) auth_start, *pkt_octet_len);
+        if (status)
+            return status;
+
+        /* run auth func over ROC, put result into auth_tag */
+        debug_print(mod_srtp, "estimated packet index: %016llx", est);
+        status = auth_compute(auth, (uint8_t *) &est, 4, auth_tag);
+        debug_print(mod_srtp, "srtp auth tag:    %s", octet_string_hex_string(
+                auth_tag, tag_len));
+        if (status)
+            return err_status_auth_fail;
+
+    }
+
+    if (auth_tag) {
+
+        /* increase the packet length by the length of the auth tag */
+        *pkt_octet_len += tag_len;
+    }
+
     return err_status_ok;
 }
 
-err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
+/*
+ * srtp_protect_packet(ctx, hdr, len, job) is srtp_protect(), except
+ * that if job is not NULL and the packet is to be encrypted with an
+ * aes_icm cipher, the encryption and the authentication are left to
+ * the caller and described in *job
+ */
+
+static err_status_t srtp_protect_packet(srtp_ctx_t *ctx, void *rtp_hdr,
+        int *pkt_octet_len, srtp_crypt_job_t *job) {
     srtp_hdr_t *hdr = (srtp_hdr_t *) rtp_hdr;
     uint32_t *enc_start; /* pointer to start of encrypted portion  */
     uint32_t *auth_start; /* pointer to start of auth. portion      */
@@ -549,8 +1237,8 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
     xtd_seq_num_t est; /* estimated xtd_seq_num_t of *hdr        */
     int delta; /* delta of local pkt idx and that in hdr */
     uint8_t *auth_tag = NULL; /* location of auth_tag within packet     */
+    v128_t iv;
     err_status_t status;
-    int tag_len;
     srtp_stream_ctx_t *stream;
     int prefix_len;
 
@@ -581,8 +1269,7 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
                 return status;
 
             /* add new stream to the head of the stream_list */
-            new_stream->next = ctx->stream_list;
-            ctx->stream_list = new_stream;
+            srtp_insert_stream(ctx, new_stream);
 
             /* set direction to outbound */
             new_stream->direction = dir_srtp_sender;
@@ -627,8 +1314,13 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
         break;
     }
 
-    /* get tag length from stream */
-    tag_len = auth_get_tag_length(stream->rtp_auth);
+    /* AEAD transforms encrypt and authenticate in one pass */
+    if (cipher_is_aead(stream->rtp_cipher))
+        return srtp_protect_aead(ctx, stream, hdr, pkt_octet_len);
+
+    /* so does the fused path, which a batch caller does not use */
+    if (stream->rtp_fast_path != srtp_fast_none && job == NULL)
+        return srtp_protect_aes_cm_hmac(stream, hdr, pkt_octet_len);
 
     /*
      * find starting point for encryption and length of data to be
@@ -683,8 +1375,7 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
     /*
      * if we're using rindael counter mode, set nonce and seq
      */
-    if (stream->rtp_cipher->type == &aes_icm) {
-        v128_t iv;
+    if (cipher_type_is_aes_icm(stream->rtp_cipher->type)) {
 
         iv.v32[0] = 0;
         iv.v32[1] = hdr->ssrc;
@@ -694,10 +1385,8 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
 #else
         iv.v64[1] = be64_to_cpu(est << 16);
 #endif
-        status = cipher_set_iv(stream->rtp_cipher, &iv);
 
     } else {
-        v128_t iv;
 
         /* otherwise, set the index to est */
 #ifdef NO_64BIT_MATH
@@ -707,10 +1396,7 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
         iv.v64[0] = 0;
 #endif
         iv.v64[1] = be64_to_cpu(est);
-        status = cipher_set_iv(stream->rtp_cipher, &iv);
     }
-    if (status)
-        return err_status_cipher_fail;
 
     /* shift est, put into network byte order */
 #ifdef NO_64BIT_MATH
@@ -721,6 +1407,28 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
     est = be64_to_cpu(est << 16);
 #endif
 
+    /*
+     * the aes_icm encryption can be left to a batch caller, unless a
+     * keystream prefix is needed for the authentication
+     */
+    if (job != NULL && enc_start != NULL && cipher_type_is_aes_icm(
+            stream->rtp_cipher->type) && (auth_start == NULL
+            || auth_get_prefix_length(stream->rtp_auth) == 0)) {
+        job->cipher = stream->rtp_cipher;
+        v128_copy(&job->iv, &iv);
+        job->enc_start = (uint8_t *) enc_start;
+        job->enc_octet_len = enc_octet_len;
+        job->auth = stream->rtp_auth;
+        job->auth_start = auth_start;
+        job->auth_tag = auth_tag;
+        job->est = est;
+        return err_status_ok;
+    }
+
+    status = cipher_set_iv(stream->rtp_cipher, &iv);
+    if (status)
+        return err_status_cipher_fail;
+
     /*
      * if we're authenticating using a universal hash, put the keystream
      * prefix into the authentication tag
@@ -745,45 +1453,23 @@ err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
             return err_status_cipher_fail;
     }
 
-    /*
-     *  if we're authenticating, run authentication function and put result
-     *  into the auth_tag
-     */
-    if (auth_start) {
-
-        /* initialize auth func context */
-        status = auth_start(stream->rtp_auth);
-        if (status)
-            return status;
-
-        /* run auth func over packet */
-        status = auth_update(stream->rtp_auth, (uint8_t *) auth_start,
-                *pkt_octet_len);
-        if (status)
-            return status;
-
-        /* run auth func over ROC, put result into auth_tag */
-        debug_print(mod_srtp, "estimated packet index: %016llx", est);
-        status = auth_compute(stream->rtp_auth, (uint8_t *) &est, 4, auth_tag);
-        debug_print(mod_srtp, "srtp auth tag:    %s", octet_string_hex_string(
-                auth_tag, tag_len));
-        if (status)
-            return err_status_auth_fail;
-
-    }
-
-    if (auth_tag) {
-
-        /* increase the packet length by the length of the auth tag */
-        *pkt_octet_len += tag_len;
-    }
+    return srtp_protect_auth(stream->rtp_auth, auth_start, auth_tag, est,
+            pkt_octet_len);
+}
 
-    return err_status_ok;
+err_status_t srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
+    return srtp_protect_packet(ctx, rtp_hdr, pkt_octet_len, NULL);
 }
 
-err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
-    LOGE("[SRTP] Calling srtp_unprotect() here!");
-    printf("[SRTP]printf Calling srtp_unprotect() here!");
+/*
+ * srtp_unprotect_packet(ctx, hdr, len, job) is srtp_unprotect(),
+ * except that if job is not NULL and the packet is to be decrypted
+ * with an aes_icm cipher, the decryption is left to the caller and
+ * described in *job
+ */
+
+static err_status_t srtp_unprotect_packet(srtp_ctx_t *ctx, void *srtp_hdr,
+        int *pkt_octet_len, srtp_crypt_job_t *job) {
     srtp_hdr_t *hdr = (srtp_hdr_t *) srtp_hdr;
     uint32_t *enc_start; /* pointer to start of encrypted portion  */
     uint32_t *auth_start; /* pointer to start of auth. portion      */
@@ -796,10 +1482,9 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
     srtp_stream_ctx_t *stream;
     uint8_t tmp_tag[SRTP_MAX_TAG_LEN];
     int tag_len, prefix_len;
+    int defer;
 
     debug_print(mod_srtpu, "function srtp_unprotect", NULL);
-    LOGE("[SRTP] srtp_unprotect(), after first debug_print...");
-    printf("[SRTP]printf srtp_unprotect(), after first debug_print...");
 
     /* we assume the hdr is 32-bit aligned to start */
 
@@ -857,14 +1542,21 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
     debug_print(mod_srtpu, "estimated u_packet index: %016llx", est);
 #endif
 
+    if (cipher_is_aead(stream->rtp_cipher))
+        return srtp_unprotect_aead(ctx, stream, delta, est, hdr, pkt_octet_len);
+
+    if (stream->rtp_fast_path != srtp_fast_none && job == NULL)
+        return srtp_unprotect_aes_cm_hmac(ctx, stream, delta, est, hdr,
+                pkt_octet_len);
+
     /* get tag length from stream */
     tag_len = auth_get_tag_length(stream->rtp_auth);
 
     /*
-     * set the cipher's IV properly, depending on whatever cipher we
-     * happen to be using
+     * compute the cipher's IV, depending on whatever cipher we happen
+     * to be using
      */
-    if (stream->rtp_cipher->type == &aes_icm) {
+    if (cipher_type_is_aes_icm(stream->rtp_cipher->type)) {
 
         /* aes counter mode */
         iv.v32[0] = 0;
@@ -875,9 +1567,6 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
 #else
         iv.v64[1] = be64_to_cpu(est << 16);
 #endif
-        status
-                = aes_icm_set_iv((aes_icm_ctx_t*) stream->rtp_cipher->state,
-                        &iv);
     } else {
 
         /* no particular format - set the iv to the pakcet index */
@@ -888,10 +1577,7 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
         iv.v64[0] = 0;
 #endif
         iv.v64[1] = be64_to_cpu(est);
-        status = cipher_set_iv(stream->rtp_cipher, &iv);
     }
-    if (status)
-        return err_status_cipher_fail;
 
     /* shift est, put into network byte order */
 #ifdef NO_64BIT_MATH
@@ -935,6 +1621,20 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
         auth_tag = NULL;
     }
 
+    /*
+     * the aes_icm decryption can be left to a batch caller, unless a
+     * keystream prefix is needed for the authentication; otherwise set
+     * the cipher's IV now
+     */
+    defer = job != NULL && enc_start != NULL && cipher_type_is_aes_icm(
+            stream->rtp_cipher->type) && (auth_start == NULL
+            || stream->rtp_auth->prefix_len == 0);
+    if (!defer) {
+        status = cipher_set_iv(stream->rtp_cipher, &iv);
+        if (status)
+            return err_status_cipher_fail;
+    }
+
     /*
      * if we expect message authentication, run the authentication
      * function and compare the result with the value of the auth_tag
@@ -1000,7 +1700,12 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
     }
 
     /* if we're encrypting, add keystream into ciphertext */
-    if (enc_start) {
+    if (defer) {
+        job->cipher = stream->rtp_cipher;
+        v128_copy(&job->iv, &iv);
+        job->enc_start = (uint8_t *) enc_start;
+        job->enc_octet_len = enc_octet_len;
+    } else if (enc_start) {
         status = cipher_encrypt(stream->rtp_cipher, (uint8_t *) enc_start,
                 &enc_octet_len);
         if (status)
@@ -1047,8 +1752,7 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
             return status;
 
         /* add new stream to the head of the stream_list */
-        new_stream->next = ctx->stream_list;
-        ctx->stream_list = new_stream;
+        srtp_insert_stream(ctx, new_stream);
 
         /* set stream (the pointer used in this function) */
         stream = new_stream;
@@ -1066,6 +1770,132 @@ err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
     return err_status_ok;
 }
 
+err_status_t srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
+    return srtp_unprotect_packet(ctx, srtp_hdr, pkt_octet_len, NULL);
+}
+
+/*
+ * srtp_crypt_vec(jobs, num_jobs, status) runs the aes_icm encryptions
+ * (or decryptions) that srtp_protect_packet() or
+ * srtp_unprotect_packet() left in jobs, those with the same cipher in
+ * one aes_icm_crypt_vec() call, and sets status[jobs[k].pkt] for each
+ * job that fails.  jobs[k].cipher is NULL for packets without a job.
+ */
+
+static void srtp_crypt_vec(srtp_crypt_job_t *jobs, int num_jobs,
+        err_status_t *status) {
+    v128_t ivs[SRTP_VEC_MAX_PKTS];
+    uint8_t *bufs[SRTP_VEC_MAX_PKTS];
+    unsigned int lens[SRTP_VEC_MAX_PKTS];
+    int pkts[SRTP_VEC_MAX_PKTS];
+    cipher_t *cipher;
+    err_status_t err;
+    int j, k, n;
+
+    for (k = 0; k < num_jobs; k++) {
+        cipher = jobs[k].cipher;
+        if (cipher == NULL)
+            continue;
+
+        /* gather this job and all the later ones with the same cipher */
+        n = 0;
+        for (j = k; j < num_jobs; j++) {
+            if (jobs[j].cipher != cipher)
+                continue;
+            v128_copy(&ivs[n], &jobs[j].iv);
+            bufs[n] = jobs[j].enc_start;
+            lens[n] = jobs[j].enc_octet_len;
+            pkts[n] = jobs[j].pkt;
+            n++;
+            jobs[j].cipher = NULL;
+        }
+
+        if (cipher->type == &aes_icm_hw)
+            err = aes_icm_hw_encrypt_vec((aes_icm_ctx_t *) cipher->state, ivs,
+                    bufs, lens, n);
+        else
+            err = aes_icm_encrypt_vec((aes_icm_ctx_t *) cipher->state, ivs,
+                    bufs, lens, n);
+        if (err) {
+            for (j = 0; j < n; j++)
+                status[pkts[j]] = err_status_cipher_fail;
+        }
+    }
+}
+
+err_status_t srtp_protect_vec(srtp_t ctx, void *rtp_hdr[],
+        int pkt_octet_len[], err_status_t status[], int num_pkts) {
+    srtp_crypt_job_t jobs[SRTP_VEC_MAX_PKTS];
+    int base, num, i;
+
+    for (base = 0; base < num_pkts; base += num) {
+        num = num_pkts - base;
+        if (num > SRTP_VEC_MAX_PKTS)
+            num = SRTP_VEC_MAX_PKTS;
+
+        /* index the packets, in order, and queue their encryption */
+        for (i = 0; i < num; i++) {
+            jobs[i].cipher = NULL;
+            jobs[i].pkt = base + i;
+            status[base + i] = srtp_protect_packet(ctx, rtp_hdr[base + i],
+                    &pkt_octet_len[base + i], &jobs[i]);
+            if (status[base + i])
+                jobs[i].cipher = NULL;
+        }
+
+        /* encrypt them, then authenticate the ones that were queued */
+        for (i = 0; i < num; i++)
+            jobs[i].queued = jobs[i].cipher != NULL;
+        srtp_crypt_vec(jobs, num, status);
+        for (i = 0; i < num; i++) {
+            if (jobs[i].queued && status[base + i] == err_status_ok)
+                status[base + i] = srtp_protect_auth(jobs[i].auth,
+                        jobs[i].auth_start, jobs[i].auth_tag, jobs[i].est,
+                        &pkt_octet_len[base + i]);
+        }
+    }
+
+    for (i = 0; i < num_pkts; i++) {
+        if (status[i])
+            return status[i];
+    }
+    return err_status_ok;
+}
+
+err_status_t srtp_unprotect_vec(srtp_t ctx, void *srtp_hdr[],
+        int pkt_octet_len[], err_status_t status[], int num_pkts) {
+    srtp_crypt_job_t jobs[SRTP_VEC_MAX_PKTS];
+    int base, num, i;
+
+    for (base = 0; base < num_pkts; base += num) {
+        num = num_pkts - base;
+        if (num > SRTP_VEC_MAX_PKTS)
+            num = SRTP_VEC_MAX_PKTS;
+
+        /*
+         * authenticate the packets and update the replay databases, in
+         * order, queueing their decryption
+         */
+        for (i = 0; i < num; i++) {
+            jobs[i].cipher = NULL;
+            jobs[i].pkt = base + i;
+            status[base + i] = srtp_unprotect_packet(ctx, srtp_hdr[base + i],
+                    &pkt_octet_len[base + i], &jobs[i]);
+            if (status[base + i])
+                jobs[i].cipher = NULL;
+        }
+
+        /* then decrypt the ones that were accepted */
+        srtp_crypt_vec(jobs, num, status);
+    }
+
+    for (i = 0; i < num_pkts; i++) {
+        if (status[i])
+            return status[i];
+    }
+    return err_status_ok;
+}
+
 err_status_t srtp_init(int forceInit) {
     err_status_t status;
 
@@ -1110,21 +1940,42 @@ srtp_get_trailer_length(const srtp_stream_t s) {
 #endif
 
 /*
- * srtp_get_stream(ssrc) returns a pointer to the stream corresponding
- * to ssrc, or NULL if no stream exists for that ssrc
- *
- * this is an internal function
+ * srtp_find_stream(srtp, ssrc, last) returns a pointer to the stream
+ * corresponding to ssrc, or NULL if no stream exists for that ssrc,
+ * checking first the stream found by the last lookup that used the
+ * cache *last
  */
 
-srtp_stream_ctx_t *
-srtp_get_stream(srtp_t srtp, uint32_t ssrc) {
+static inline srtp_stream_ctx_t *
+srtp_find_stream(srtp_t srtp, uint32_t ssrc, srtp_stream_ctx_t **last) {
     srtp_stream_ctx_t *stream;
+    unsigned int i;
+
+    /* check the stream found by the last lookup */
+    stream = *last;
+    if (stream != NULL && stream->ssrc == ssrc)
+        return stream;
+
+    if (srtp->stream_index != NULL) {
+        /* probe the index until ssrc or an empty slot is found */
+        i = srtp_index_hash(ssrc, srtp->index_size);
+        while ((stream = srtp->stream_index[i]) != NULL) {
+            if (stream->ssrc == ssrc) {
+                *last = stream;
+                return stream;
+            }
+            i = (i + 1) & (srtp->index_size - 1);
+        }
+        return NULL;
+    }
 
     /* walk down list until ssrc is found */
     stream = srtp->stream_list;
     while (stream != NULL) {
-        if (stream->ssrc == ssrc)
+        if (stream->ssrc == ssrc) {
+            *last = stream;
             return stream;
+        }
         stream = stream->next;
     }
 
@@ -1132,6 +1983,28 @@ srtp_get_stream(srtp_t srtp, uint32_t ssrc) {
     return NULL;
 }
 
+/*
+ * srtp_get_stream(ssrc) returns a pointer to the stream corresponding
+ * to ssrc, or NULL if no stream exists for that ssrc
+ *
+ * this is an internal function
+ */
+
+srtp_stream_ctx_t *
+srtp_get_stream(srtp_t srtp, uint32_t ssrc) {
+    return srtp_find_stream(srtp, ssrc, &srtp->stream_last);
+}
+
+/*
+ * srtp_get_stream_rtcp(ssrc) is srtp_get_stream() for the RTCP
+ * functions
+ */
+
+static srtp_stream_ctx_t *
+srtp_get_stream_rtcp(srtp_t srtp, uint32_t ssrc) {
+    return srtp_find_stream(srtp, ssrc, &srtp->stream_last_rtcp);
+}
+
 err_status_t srtp_dealloc(srtp_t session) {
     srtp_stream_ctx_t *stream;
     err_status_t status;
@@ -1167,9 +2040,13 @@ err_status_t srtp_dealloc(srtp_t session) {
         status = auth_dealloc(session->stream_template->rtp_auth);
         if (status)
             return status;
+        rdbx_dealloc(&session->stream_template->rtp_rdbx);
         crypto_free(session->stream_template);
     }
 
+    /* deallocate stream index */
+    srtp_index_clear(session);
+
     /* deallocate session context */
     crypto_free(session);
 
@@ -1221,8 +2098,7 @@ err_status_t srtp_add_stream(srtp_t session, const srtp_policy_t *policy) {
         session->stream_template->direction = dir_srtp_receiver;
         break;
     case (ssrc_specific):
-        tmp->next = session->stream_list;
-        session->stream_list = tmp;
+        srtp_insert_stream(session, tmp);
         break;
     case (ssrc_undefined):
     default:
@@ -1230,11 +2106,15 @@ err_status_t srtp_add_stream(srtp_t session, const srtp_policy_t *policy) {
         return err_status_bad_param;
     }
 
+    /* the streams of one half of a session pair have its direction */
+    if (session->direction != dir_unknown)
+        tmp->direction = session->direction;
+
     return err_status_ok;
 }
 
-err_status_t srtp_create(srtp_t *session, /* handle for session     */
-const srtp_policy_t *policy) { /* SRTP policy (list)     */
+static err_status_t srtp_create_session(srtp_t *session,
+        const srtp_policy_t *policy, direction_t direction) {
     err_status_t stat;
     srtp_ctx_t *ctx;
 
@@ -1254,6 +2134,12 @@ const srtp_policy_t *policy) { /* SRTP policy (list)     */
      */
     ctx->stream_template = NULL;
     ctx->stream_list = NULL;
+    ctx->stream_index = NULL;
+    ctx->index_size = 0;
+    ctx->index_count = 0;
+    ctx->stream_last = NULL;
+    ctx->stream_last_rtcp = NULL;
+    ctx->direction = direction;
     while (policy != NULL) {
 
         stat = srtp_add_stream(ctx, policy);
@@ -1270,6 +2156,30 @@ const srtp_policy_t *policy) { /* SRTP policy (list)     */
     return err_status_ok;
 }
 
+err_status_t srtp_create(srtp_t *session, /* handle for session     */
+const srtp_policy_t *policy) { /* SRTP policy (list)     */
+    return srtp_create_session(session, policy, dir_unknown);
+}
+
+err_status_t srtp_create_pair(srtp_t *sender, srtp_t *receiver,
+        const srtp_policy_t *policy) {
+    err_status_t stat;
+
+    if (sender == NULL || receiver == NULL)
+        return err_status_bad_param;
+
+    stat = srtp_create_session(sender, policy, dir_srtp_sender);
+    if (stat)
+        return stat;
+    stat = srtp_create_session(receiver, policy, dir_srtp_receiver);
+    if (stat) {
+        srtp_dealloc(*sender);
+        return stat;
+    }
+
+    return err_status_ok;
+}
+
 err_status_t srtp_remove_stream(srtp_t session, uint32_t ssrc) {
     srtp_stream_ctx_t *stream, *last_stream;
     err_status_t status;
@@ -1279,7 +2189,8 @@ err_status_t srtp_remove_stream(srtp_t session, uint32_t ssrc) {
         return err_status_bad_param;
 
     /* find stream in list; complain if not found */
-    last_stream = stream = session->stream_list;
+    last_stream = NULL;
+    stream = session->stream_list;
     while ((stream != NULL) && (ssrc != stream->ssrc)) {
         last_stream = stream;
         stream = stream->next;
@@ -1288,7 +2199,25 @@ err_status_t srtp_remove_stream(srtp_t session, uint32_t ssrc) {
         return err_status_no_ctx;
 
     /* remove stream from the list */
-    last_stream->next = stream->next;
+    if (last_stream == NULL)
+        session->stream_list = stream->next;
+    else
+        last_stream->next = stream->next;
+
+    /*
+     * remove it from the index too, and let the index point to the
+     * next stream in the list with the same ssrc, if there is one
+     */
+    srtp_index_remove(session, stream);
+    if (session->stream_index != NULL) {
+        for (last_stream = stream->next; last_stream != NULL; last_stream
+                = last_stream->next) {
+            if (last_stream->ssrc == ssrc) {
+                srtp_index_insert(session, last_stream, 0);
+                break;
+            }
+        }
+    }
 
     /* deallocate the stream */
     status = srtp_stream_dealloc(session, stream);
@@ -1383,10 +2312,180 @@ void crypto_policy_set_null_cipher_hmac_sha1_80(crypto_policy_t *p) {
 
 }
 
+void crypto_policy_set_aes_gcm_128_16_auth(crypto_policy_t *p) {
+
+    /*
+     * corresponds to AEAD_AES_128_GCM of RFC 7714; the tag is computed
+     * by the cipher, so the auth function is the null one
+     */
+
+    p->cipher_type = AES_128_GCM;
+    p->cipher_key_len = 28; /* 128 bit key, 96 bit salt  */
+    p->auth_type = NULL_AUTH;
+    p->auth_key_len = 0;
+    p->auth_tag_len = 16; /* 128 bit tag                */
+    p->sec_serv = sec_serv_conf_and_auth;
+
+}
+
+void crypto_policy_set_aes_gcm_256_16_auth(crypto_policy_t *p) {
+
+    /*
+     * corresponds to AEAD_AES_256_GCM of RFC 7714
+     */
+
+    p->cipher_type = AES_256_GCM;
+    p->cipher_key_len = 44; /* 256 bit key, 96 bit salt  */
+    p->auth_type = NULL_AUTH;
+    p->auth_key_len = 0;
+    p->auth_tag_len = 16; /* 128 bit tag                */
+    p->sec_serv = sec_serv_conf_and_auth;
+
+}
+
 /*
  * secure rtcp functions
  */
 
+/*
+ * SRTCP with an AEAD transform (RFC 7714 section 9): the header and
+ * the E bit and index word are the additional data, and the packet
+ * becomes header || ciphertext || tag || E+index
+ */
+
+static err_status_t srtp_protect_rtcp_aead(srtp_stream_ctx_t *stream,
+        srtcp_hdr_t *hdr, int *pkt_octet_len) {
+    unsigned int aad_len; /* octets authenticated only             */
+    unsigned int enc_octet_len; /* octets encrypted                   */
+    uint8_t *enc_start;
+    uint32_t trailer; /* E bit and index, in network order     */
+    uint32_t seq_num;
+    int tag_len = SRTP_MAX_TAG_LEN;
+    v128_t iv;
+    err_status_t status;
+
+    if (*pkt_octet_len < octets_in_rtcp_header)
+        return err_status_bad_param;
+
+    /* without confidentiality, all of the packet is additional data */
+    if (stream->rtcp_services & sec_serv_conf)
+        aad_len = octets_in_rtcp_header;
+    else
+        aad_len = *pkt_octet_len;
+    enc_start = (uint8_t *) hdr + aad_len;
+    enc_octet_len = *pkt_octet_len - aad_len;
+
+    status = rdb_increment(&stream->rtcp_rdb);
+    if (status)
+        return status;
+    seq_num = rdb_get_value(&stream->rtcp_rdb);
+    trailer = htonl(seq_num);
+    if (stream->rtcp_services & sec_serv_conf)
+        trailer |= htonl(SRTCP_E_BIT);
+    debug_print(mod_srtp, "srtcp index: %x", seq_num);
+
+    srtp_calc_aead_iv(&iv, hdr->ssrc, seq_num >> 16, seq_num);
+    status = cipher_set_iv(stream->rtcp_cipher, &iv);
+    if (status == err_status_ok)
+        status = cipher_set_aad(stream->rtcp_cipher, (uint8_t *) hdr, aad_len);
+    if (status == err_status_ok)
+        status = cipher_set_aad(stream->rtcp_cipher, (uint8_t *) &trailer,
+                sizeof(srtcp_trailer_t));
+    if (status == err_status_ok)
+        status = cipher_encrypt(stream->rtcp_cipher, enc_start, &enc_octet_len);
+    if (status == err_status_ok)
+        status = cipher_get_tag(stream->rtcp_cipher, enc_start + enc_octet_len,
+                &tag_len);
+    if (status)
+        return err_status_cipher_fail;
+
+    memcpy(enc_start + enc_octet_len + tag_len, &trailer,
+            sizeof(srtcp_trailer_t));
+
+    /* increase the packet length by the length of the tag and seq_num */
+    *pkt_octet_len += (tag_len + sizeof(srtcp_trailer_t));
+
+    return err_status_ok;
+}
+
+static err_status_t srtp_unprotect_rtcp_aead(srtp_t ctx,
+        srtp_stream_ctx_t *stream, srtcp_hdr_t *hdr, int *pkt_octet_len) {
+    unsigned int aad_len; /* octets authenticated only             */
+    unsigned int enc_octet_len; /* octets of ciphertext and tag       */
+    uint32_t trailer; /* E bit and index, in network order     */
+    uint32_t seq_num;
+    int tag_len = auth_get_tag_length(stream->rtcp_auth);
+    v128_t iv;
+    err_status_t status;
+
+    if (*pkt_octet_len < (int) (octets_in_rtcp_header + tag_len
+            + sizeof(srtcp_trailer_t)))
+        return err_status_bad_param;
+
+    memcpy(&trailer, (uint8_t *) hdr + *pkt_octet_len
+            - sizeof(srtcp_trailer_t), sizeof(srtcp_trailer_t));
+    if (*((unsigned char *) &trailer) & SRTCP_E_BYTE_BIT)
+        aad_len = octets_in_rtcp_header;
+    else
+        aad_len = *pkt_octet_len - tag_len - sizeof(srtcp_trailer_t);
+    enc_octet_len = *pkt_octet_len - sizeof(srtcp_trailer_t) - aad_len;
+
+    /* check the index for replays */
+    seq_num = ntohl(trailer) & SRTCP_INDEX_MASK;
+    debug_print(mod_srtp, "srtcp index: %x", seq_num);
+    status = rdb_check(&stream->rtcp_rdb, seq_num);
+    if (status)
+        return status;
+
+    srtp_calc_aead_iv(&iv, hdr->ssrc, seq_num >> 16, seq_num);
+    status = cipher_set_iv(stream->rtcp_cipher, &iv);
+    if (status == err_status_ok)
+        status = cipher_set_aad(stream->rtcp_cipher, (uint8_t *) hdr, aad_len);
+    if (status == err_status_ok)
+        status = cipher_set_aad(stream->rtcp_cipher, (uint8_t *) &trailer,
+                sizeof(srtcp_trailer_t));
+    if (status)
+        return err_status_cipher_fail;
+
+    /* the cipher checks the tag before decrypting anything */
+    status = cipher_decrypt(stream->rtcp_cipher, (uint8_t *) hdr + aad_len,
+            &enc_octet_len);
+    if (status == err_status_auth_fail)
+        return err_status_auth_fail;
+    if (status)
+        return err_status_cipher_fail;
+
+    /* decrease the packet length by the length of the tag and seq_num */
+    *pkt_octet_len -= (tag_len + sizeof(srtcp_trailer_t));
+
+    /* see srtp_unprotect_rtcp() for these checks */
+    if (stream->direction != dir_srtp_receiver) {
+        if (stream->direction == dir_unknown) {
+            stream->direction = dir_srtp_receiver;
+        } else {
+            srtp_handle_event(ctx, stream, event_ssrc_collision);
+        }
+    }
+    if (stream == ctx->stream_template) {
+        srtp_stream_ctx_t *new_stream;
+
+        status = srtp_stream_clone(ctx->stream_template, hdr->ssrc,
+                &new_stream);
+        if (status)
+            return status;
+
+        /* add new stream to the head of the stream_list */
+        srtp_insert_stream(ctx, new_stream);
+
+        /* set stream (the pointer used in this function) */
+        stream = new_stream;
+    }
+
+    rdb_add_index(&stream->rtcp_rdb, seq_num);
+
+    return err_status_ok;
+}
+
 err_status_t srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
     srtcp_hdr_t *hdr = (srtcp_hdr_t *) rtcp_hdr;
     uint32_t *enc_start; /* pointer to start of encrypted portion  */
@@ -1408,7 +2507,7 @@ err_status_t srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
      * supports key-sharing, then we assume that a new stream using
      * that key has just started up
      */
-    stream = srtp_get_stream(ctx, hdr->ssrc);
+    stream = srtp_get_stream_rtcp(ctx, hdr->ssrc);
     if (stream == NULL) {
         if (ctx->stream_template != NULL) {
             srtp_stream_ctx_t *new_stream;
@@ -1420,8 +2519,7 @@ err_status_t srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
                 return status;
 
             /* add new stream to the head of the stream_list */
-            new_stream->next = ctx->stream_list;
-            ctx->stream_list = new_stream;
+            srtp_insert_stream(ctx, new_stream);
 
             /* set stream (the pointer used in this function) */
             stream = new_stream;
@@ -1445,6 +2543,10 @@ err_status_t srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
         }
     }
 
+    /* AEAD transforms encrypt and authenticate in one pass */
+    if (cipher_is_aead(stream->rtcp_cipher))
+        return srtp_protect_rtcp_aead(stream, hdr, pkt_octet_len);
+
     /* get tag length from stream context */
     tag_len = auth_get_tag_length(stream->rtcp_auth);
 
@@ -1493,7 +2595,7 @@ err_status_t srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
     /*
      * if we're using rindael counter mode, set nonce and seq
      */
-    if (stream->rtcp_cipher->type == &aes_icm) {
+    if (cipher_type_is_aes_icm(stream->rtcp_cipher->type)) {
         v128_t iv;
 
         iv.v32[0] = 0;
@@ -1586,7 +2688,7 @@ err_status_t srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr,
      * supports key-sharing, then we assume that a new stream using
      * that key has just started up
      */
-    stream = srtp_get_stream(ctx, hdr->ssrc);
+    stream = srtp_get_stream_rtcp(ctx, hdr->ssrc);
     if (stream == NULL) {
         if (ctx->stream_template != NULL) {
             stream = ctx->stream_template;
@@ -1598,6 +2700,9 @@ err_status_t srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr,
         }
     }
 
+    if (cipher_is_aead(stream->rtcp_cipher))
+        return srtp_unprotect_rtcp_aead(ctx, stream, hdr, pkt_octet_len);
+
     /* get tag length from stream context */
     tag_len = auth_get_tag_length(stream->rtcp_auth);
 
@@ -1644,7 +2749,7 @@ err_status_t srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr,
     /*
      * if we're using aes counter mode, set nonce and seq
      */
-    if (stream->rtcp_cipher->type == &aes_icm) {
+    if (cipher_type_is_aes_icm(stream->rtcp_cipher->type)) {
         v128_t iv;
 
         iv.v32[0] = 0;
@@ -1749,8 +2854,7 @@ err_status_t srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr,
             return status;
 
         /* add new stream to the head of the stream_list */
-        new_stream->next = ctx->stream_list;
-        ctx->stream_list = new_stream;
+        srtp_insert_stream(ctx, new_stream);
 
         /* set stream (the pointer used in this function) */
         stream = new_stream;
@@ -21,3 +21,21 @@ LOCAL_C_INCLUDES        := $(LOCAL_PATH)/../include $(LOCAL_PATH)/../crypto/incl
 LOCAL_SHARED_LIBRARIES  := liblog libSrtp
 
 include $(BUILD_STATIC_LIBRARY)
+
+# Build the srtp_bench benchmark
+# ============================================================
+# run it as: srtp_bench -b srtp_bench_baseline.json > results.json
+# it exits with status 1 if a combination is slower than the baseline
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS       := optional test
+
+LOCAL_MODULE            := srtp_bench
+LOCAL_SRC_FILES         := \
+    srtp_bench.c \
+    getopt_s.c \
+
+LOCAL_C_INCLUDES        := $(LOCAL_PATH)/../include $(LOCAL_PATH)/../crypto/include
+
+LOCAL_SHARED_LIBRARIES  := liblog libSrtp
+
+include $(BUILD_EXECUTABLE)
@@ -150,6 +150,7 @@ err_status_t test_dtls_srtp() {
     if (err)
         return err;
     policy.ssrc.type = ssrc_any_inbound;
+    policy.window_size = 128;
     policy.next = NULL;
 
     err = srtp_add_stream(s, &policy);
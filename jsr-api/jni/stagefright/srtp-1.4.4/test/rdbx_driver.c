@@ -44,6 +44,7 @@
  */
 
 #include <stdio.h>    /* for printf()          */
+#include <stdlib.h>   /* for malloc(), free()  */
 #include "getopt_s.h" /* for local getopt()    */
 
 #include "rdbx.h"
@@ -54,42 +55,56 @@
 
 #include "ut_sim.h"
 
-err_status_t test_replay_dbx(int num_trials);
+err_status_t test_replay_dbx(int num_trials, unsigned long ws);
 
-double rdbx_check_adds_per_second(int num_trials);
+double rdbx_check_adds_per_second(int num_trials, unsigned long ws,
+        int reorder);
+
+/* the replay window sizes that are tested and timed */
+
+static const unsigned long rdbx_test_window_sizes[] = {
+        rdbx_default_window_size, 1024, rdbx_max_window_size, 0 };
 
 // int main(int argc, char *argv[]) {
 int rdbx_driver(unsigned do_timing_test, unsigned do_validation) {
     double rate;
     err_status_t status;
-    char q;
+    const unsigned long *ws;
 
     printf("rdbx (replay database w/ extended range) test driver\n"
         "David A. McGrew\n"
         "Cisco Systems, Inc.\n");
 
     if (do_validation) {
-        printf("testing rdbx_t...\n");
-
-        status = test_replay_dbx(1 << 12);
-        if (status) {
-            printf("failed\n");
-            return(1);
+        for (ws = rdbx_test_window_sizes; *ws != 0; ws++) {
+            printf("testing rdbx_t (window size %lu)...\n", *ws);
+
+            status = test_replay_dbx(1 << 12, *ws);
+            if (status) {
+                printf("failed\n");
+                return(1);
+            }
+            printf("passed\n");
         }
-        printf("passed\n");
     }
 
     if (do_timing_test) {
-        rate = rdbx_check_adds_per_second(1 << 18);
-        printf("rdbx_check/replay_adds per second: %e\n", rate);
+        for (ws = rdbx_test_window_sizes; *ws != 0; ws++) {
+            rate = rdbx_check_adds_per_second(1 << 18, *ws, 0);
+            printf("rdbx_check/replay_adds per second "
+                "(window size %lu, in order): %e\n", *ws, rate);
+            rate = rdbx_check_adds_per_second(1 << 18, *ws, 1);
+            printf("rdbx_check/replay_adds per second "
+                "(window size %lu, reordered): %e\n", *ws, rate);
+        }
     }
 
     return 0;
 }
 
 void print_rdbx(rdbx_t *rdbx) {
-    printf("rdbx: {%llu, %s}\n", (unsigned long long) (rdbx->index),
-            v128_bit_string(&rdbx->bitmask));
+    printf("rdbx: {%llu, window size %lu}\n",
+            (unsigned long long) (rdbx->index), rdbx_get_window_size(rdbx));
 }
 
 /*
@@ -161,14 +176,14 @@ err_status_t rdbx_check_unordered(rdbx_t *rdbx, uint32_t idx) {
 
 #define MAX_IDX 160
 
-err_status_t test_replay_dbx(int num_trials) {
+err_status_t test_replay_dbx(int num_trials, unsigned long ws) {
     rdbx_t rdbx;
-    uint32_t idx, ircvd;
+    uint32_t idx, ircvd, top, block;
     ut_connection utc;
     err_status_t status;
     int num_fp_trials;
 
-    status = rdbx_init(&rdbx);
+    status = rdbx_init(&rdbx, ws);
     if (status) {
         printf("replay_init failed with error code %d\n", status);
         return(1);
@@ -205,7 +220,8 @@ err_status_t test_replay_dbx(int num_trials) {
     printf("passed\n");
 
     /* re-initialize */
-    if (rdbx_init(&rdbx) != err_status_ok) {
+    rdbx_dealloc(&rdbx);
+    if (rdbx_init(&rdbx, ws) != err_status_ok) {
         printf("replay_init failed\n");
         return err_status_init_fail;
     }
@@ -227,22 +243,106 @@ err_status_t test_replay_dbx(int num_trials) {
     }
     printf("passed\n");
 
+    /* re-initialize */
+    rdbx_dealloc(&rdbx);
+    if (rdbx_init(&rdbx, ws) != err_status_ok) {
+        printf("replay_init failed\n");
+        return err_status_init_fail;
+    }
+
+    /*
+     * test replays of reordered packets: add the indices in blocks of
+     * half a window, each block in reverse order, then check that each
+     * index still in the window is rejected
+     */
+    printf("\ttesting reordered replays...");
+    block = ws / 2;
+    top = 8 * block;
+    for (idx = 0; idx < top; idx += block) {
+        for (ircvd = idx + block; ircvd > idx; ircvd--) {
+            status = rdbx_check_add(&rdbx, ircvd - 1);
+            if (status)
+                return status;
+        }
+    }
+    for (idx = top - ws; idx < top; idx++) {
+        status = rdbx_check_expect_failure(&rdbx, idx);
+        if (status)
+            return status;
+    }
+    printf("passed\n");
+
+    /* re-initialize */
+    rdbx_dealloc(&rdbx);
+    if (rdbx_init(&rdbx, ws) != err_status_ok) {
+        printf("replay_init failed\n");
+        return err_status_init_fail;
+    }
+
+    /*
+     * test the edge of the window: with the oldest index in the window
+     * and the one just below it missing, the former must be accepted
+     * (once) and the latter rejected as too old
+     */
+    printf("\ttesting the window edge...");
+    top = 2 * ws;
+    for (idx = 0; idx <= top; idx++) {
+        if (idx == top - ws || idx == top - ws + 1)
+            continue;
+        status = rdbx_check_add(&rdbx, idx);
+        if (status)
+            return status;
+    }
+    if (rdbx_check(&rdbx, -(int) ws) != err_status_replay_old) {
+        printf("index %lu below the window not rejected\n", top - ws);
+        return err_status_algo_fail;
+    }
+    status = rdbx_check_add(&rdbx, top - ws + 1);
+    if (status)
+        return status;
+    status = rdbx_check_expect_failure(&rdbx, top - ws + 1);
+    if (status)
+        return status;
+    printf("passed\n");
+
+    rdbx_dealloc(&rdbx);
+
     return err_status_ok;
 }
 
 #include <time.h>       /* for clock()  */
-#include <stdlib.h>     /* for random() */
 
-double rdbx_check_adds_per_second(int num_trials) {
+/*
+ * rdbx_check_adds_per_second(num_trials, ws, reorder) returns the
+ * number of packet indices per second that can be estimated, checked
+ * and added to an rdbx with a window of ws, for in order indices, or
+ * for indices reordered by the ut_sim if reorder is nonzero
+ */
+
+double rdbx_check_adds_per_second(int num_trials, unsigned long ws,
+        int reorder) {
     uint32_t i;
     int delta;
     rdbx_t rdbx;
     xtd_seq_num_t est;
     clock_t timer;
     int failures; /* count number of failures        */
+    uint32_t *seq;
+    ut_connection utc;
 
-    if (rdbx_init(&rdbx) != err_status_ok) {
+    /* compute the packet indices before starting the timer */
+    seq = (uint32_t *) malloc(num_trials * sizeof(uint32_t));
+    if (seq == NULL) {
+        printf("couldn't allocate memory for test\n");
+        return(0.0);
+    }
+    ut_init(&utc);
+    for (i = 0; i < num_trials; i++)
+        seq[i] = reorder ? ut_next_index(&utc) : i;
+
+    if (rdbx_init(&rdbx, ws) != err_status_ok) {
         printf("replay_init failed\n");
+        free(seq);
         // Hacky way to tell the test is failing...
         return(0.0);
     }
@@ -251,7 +351,7 @@ double rdbx_check_adds_per_second(int num_trials) {
     timer = clock();
     for (i = 0; i < num_trials; i++) {
 
-        delta = index_guess(&rdbx.index, &est, i);
+        delta = rdbx_estimate_index(&rdbx, &est, (sequence_number_t) seq[i]);
 
         if (rdbx_check(&rdbx, delta) != err_status_ok)
             ++failures;
@@ -262,6 +362,11 @@ double rdbx_check_adds_per_second(int num_trials) {
 
     printf("number of failures: %d \n", failures);
 
+    rdbx_dealloc(&rdbx);
+    free(seq);
+
+    if (timer == 0)
+        timer = 1;
+
     return (double) CLOCKS_PER_SEC * num_trials / timer;
 }
-
@@ -326,6 +326,7 @@ int rtpw(int argc, char *argv[]) {
         policy.ssrc.type = ssrc_specific;
         policy.ssrc.value = ssrc;
         policy.key = (uint8_t *) key;
+        policy.window_size = 128;
         policy.next = NULL;
         policy.rtp.sec_serv = sec_servs;
         policy.rtcp.sec_serv = sec_serv_none; /* we don't do RTCP anyway */
@@ -377,6 +378,7 @@ int rtpw(int argc, char *argv[]) {
         policy.rtcp.auth_key_len = 0;
         policy.rtcp.auth_tag_len = 0;
         policy.rtcp.sec_serv = sec_serv_none;
+        policy.window_size = 128;
         policy.next = NULL;
     }
 
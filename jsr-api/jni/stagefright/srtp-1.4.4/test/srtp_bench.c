@@ -0,0 +1,680 @@
+/*
+ * srtp_bench.c
+ *
+ * a throughput and latency benchmark of srtp_protect(),
+ * srtp_unprotect() and their SRTCP counterparts
+ *
+ */
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * srtp_bench sweeps packet sizes, policies, stream counts and thread
+ * counts over each of the four operations, and writes one JSON record
+ * per combination to stdout, with the packets per second of all the
+ * threads together, the cycles per packet, and the median and 99th
+ * percentile of the time spent in a single call.  Each thread has a
+ * session of its own for each direction, and prepares its packets
+ * (protecting them, for the unprotect operations) before the threads
+ * start the timed calls together.  The packets of a thread are spread
+ * over its streams in turn.  Each combination is run -i times, and
+ * the run with the most packets per second is reported.
+ *
+ * Given a baseline (-b), which is the output of an earlier run,
+ * srtp_bench exits with status 1 if any combination lost more than
+ * the tolerance (-r, in percent) of its packets per second.
+ * Combinations missing from the baseline are not compared: the
+ * baseline kept here was recorded on a single CPU, so it only has the
+ * single thread ones.
+ *
+ * usage: srtp_bench [ -n packets ] [ -i runs ] [ -b baseline ]
+ *                   [ -r tolerance ] [ -p policy ] [ -o op ] [ -s size ]
+ *                   [ -m streams ] [ -t threads ]
+ */
+
+#include <string.h>   /* for memcpy()          */
+#include <stdlib.h>   /* for malloc(), free()  */
+#include <stdio.h>    /* for printf(), fopen() */
+#include <time.h>     /* for clock_gettime()   */
+#include <pthread.h>
+#include "getopt_s.h" /* for local getopt()    */
+
+#include "srtp_priv.h"
+
+#ifdef HAVE_NETINET_IN_H
+# include <netinet/in.h>
+#elif defined HAVE_WINSOCK2_H
+# include <winsock2.h>
+#endif
+
+#ifdef __linux__
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+# include <x86intrin.h>      /* for __rdtsc()         */
+#endif
+
+#define BENCH_DEFAULT_PACKETS  5000 /* per thread and combination */
+#define BENCH_MAX_PACKETS    100000
+#define BENCH_DEFAULT_RUNS        3
+#define BENCH_DEFAULT_TOLERANCE  15 /* percent                    */
+#define BENCH_MAX_THREADS        16
+#define BENCH_MAX_RESULTS      1024
+#define BENCH_MAX_PACKET_LEN   1400
+
+/* octets for a packet of len octets and its trailer, rounded up */
+#define bench_slot_len(len) (((len) + SRTP_MAX_TRAILER_LEN + 4 + 15) & ~15)
+
+typedef enum {
+    bench_protect = 0,
+    bench_unprotect = 1,
+    bench_protect_rtcp = 2,
+    bench_unprotect_rtcp = 3
+} bench_op_t;
+
+static const char *bench_op_name[] = {
+    "protect", "unprotect", "protect_rtcp", "unprotect_rtcp"
+};
+
+typedef struct {
+    const char *name;
+    void (*set_rtp)(crypto_policy_t *p);
+    void (*set_rtcp)(crypto_policy_t *p);
+} bench_policy_t;
+
+static const bench_policy_t bench_policies[] = {
+    { "aes_cm_128_hmac_sha1_80", crypto_policy_set_rtp_default,
+      crypto_policy_set_rtcp_default },
+    { "aes_cm_128_hmac_sha1_32", crypto_policy_set_aes_cm_128_hmac_sha1_32,
+      crypto_policy_set_rtcp_default },
+    { "aead_aes_128_gcm", crypto_policy_set_aes_gcm_128_16_auth,
+      crypto_policy_set_aes_gcm_128_16_auth },
+};
+
+#define BENCH_NUM_POLICIES \
+    ((int) (sizeof(bench_policies) / sizeof(bench_policies[0])))
+
+static int bench_sizes[] = { 40, 160, 320, 640, 1000, 1400 };
+static int bench_streams[] = { 1, 64 };
+static int bench_threads[] = { 1, 4 };
+
+#define BENCH_COUNT(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+/* the source of cycle counts: perf_event_open(), the TSC, or none */
+
+typedef enum {
+    bench_cycles_none = 0,
+    bench_cycles_perf = 1,
+    bench_cycles_tsc = 2
+} bench_cycles_t;
+
+static bench_cycles_t bench_cycles = bench_cycles_none;
+
+static const char *bench_cycles_name[] = { "none", "perf", "tsc" };
+
+/*
+ * a bench_job_t is the work of one thread for one combination; the
+ * latencies of all the threads of a combination share one array
+ */
+
+typedef struct {
+    const bench_policy_t *policy;
+    bench_op_t op;
+    int size; /* packet octets, with the header */
+    int streams;
+    int packets;
+    uint32_t *latency_ns; /* packets entries                */
+    unsigned long long start_ns; /* when the timed calls started   */
+    unsigned long long end_ns; /* when they ended                */
+    unsigned long long cycles;
+    err_status_t status;
+} bench_job_t;
+
+/*
+ * the start gate: the threads of a combination wait at it, once their
+ * packets are prepared, until all of them are
+ */
+
+static pthread_mutex_t bench_gate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_gate_cond = PTHREAD_COND_INITIALIZER;
+static int bench_gate_waiting = 0;
+static int bench_gate_size = 0;
+static int bench_gate_round = 0;
+
+static void bench_gate_set(int num_threads) {
+    pthread_mutex_lock(&bench_gate_mutex);
+    bench_gate_size = num_threads;
+    bench_gate_waiting = 0;
+    pthread_mutex_unlock(&bench_gate_mutex);
+}
+
+static void bench_gate_wait(void) {
+    int round;
+
+    pthread_mutex_lock(&bench_gate_mutex);
+    round = bench_gate_round;
+    if (++bench_gate_waiting == bench_gate_size) {
+        bench_gate_round++;
+        pthread_cond_broadcast(&bench_gate_cond);
+    }
+    while (round == bench_gate_round)
+        pthread_cond_wait(&bench_gate_cond, &bench_gate_mutex);
+    pthread_mutex_unlock(&bench_gate_mutex);
+}
+
+typedef struct {
+    char name[96];
+    double pps;
+} bench_result_t;
+
+static uint8_t bench_key[46] = {
+    0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0,
+    0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39,
+    0x0e, 0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb,
+    0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6, 0xc1, 0x73,
+    0xc3, 0x17, 0xf2, 0xda, 0xbe, 0x35, 0x77, 0x93,
+    0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6
+};
+
+static unsigned long long bench_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * bench_cycles_open() returns a perf_event_open() descriptor counting
+ * the cycles of the calling thread, or -1
+ */
+
+static int bench_cycles_open(void) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static unsigned long long bench_cycles_read(int fd) {
+    unsigned long long count = 0;
+
+#ifdef __linux__
+    if (fd >= 0 && read(fd, &count, sizeof(count)) == sizeof(count))
+        return count;
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+    if (bench_cycles == bench_cycles_tsc)
+        return __rdtsc();
+#endif
+    return count;
+}
+
+static void bench_cycles_select(void) {
+    int fd = bench_cycles_open();
+
+    if (fd >= 0) {
+        bench_cycles = bench_cycles_perf;
+        close(fd);
+        return;
+    }
+#if defined(__i386__) || defined(__x86_64__)
+    bench_cycles = bench_cycles_tsc;
+#endif
+}
+
+/*
+ * bench_fill() writes the packets of a job: RTP packets with a payload
+ * of 0xab octets, or RTCP sender reports of the same length, with the
+ * SSRCs of the streams in turn
+ */
+
+static void bench_fill(bench_job_t *job, uint8_t *slots, int *len,
+        uint16_t *seq) {
+    int slot_len = bench_slot_len(job->size);
+    int i;
+
+    for (i = 0; i < job->packets; i++) {
+        uint8_t *pkt = slots + i * slot_len;
+        int stream = i % job->streams;
+        uint32_t ssrc = 0xcafe0000 + stream;
+
+        memset(pkt, 0xab, job->size);
+        if (job->op == bench_protect || job->op == bench_unprotect) {
+            srtp_hdr_t *hdr = (srtp_hdr_t *) pkt;
+
+            hdr->version = 2;
+            hdr->p = 0;
+            hdr->x = 0;
+            hdr->cc = 0;
+            hdr->m = 0;
+            hdr->pt = 0xf;
+            hdr->seq = htons(seq[stream]++);
+            hdr->ts = htonl(160 * i);
+            hdr->ssrc = htonl(ssrc);
+        } else {
+            srtcp_hdr_t *hdr = (srtcp_hdr_t *) pkt;
+
+            hdr->version = 2;
+            hdr->p = 0;
+            hdr->rc = 0;
+            hdr->pt = 200;
+            hdr->len = htons(job->size / 4 - 1);
+            hdr->ssrc = htonl(ssrc);
+        }
+        len[i] = job->size;
+    }
+}
+
+static err_status_t bench_call(bench_op_t op, srtp_t snd, srtp_t rcv,
+        void *pkt, int *len) {
+    switch (op) {
+    case bench_protect:
+        return srtp_protect(snd, pkt, len);
+    case bench_unprotect:
+        return srtp_unprotect(rcv, pkt, len);
+    case bench_protect_rtcp:
+        return srtp_protect_rtcp(snd, pkt, len);
+    default:
+        return srtp_unprotect_rtcp(rcv, pkt, len);
+    }
+}
+
+/*
+ * bench_run() is the body of a thread: it creates its sessions,
+ * prepares its packets, and waits at the gate before the timed calls;
+ * a thread that failed still passes the gate, without calls
+ */
+
+static void *bench_run(void *arg) {
+    bench_job_t *job = (bench_job_t *) arg;
+    srtp_policy_t out, in;
+    srtp_t snd = NULL, rcv = NULL;
+    int slot_len = bench_slot_len(job->size);
+    uint8_t *slots;
+    uint16_t *seq;
+    int *len;
+    int fd = -1;
+    int i;
+    unsigned long long cycles;
+    err_status_t status;
+
+    memset(&out, 0, sizeof(out));
+    job->policy->set_rtp(&out.rtp);
+    job->policy->set_rtcp(&out.rtcp);
+    out.key = bench_key;
+    out.ssrc.type = ssrc_any_outbound;
+    in = out;
+    in.ssrc.type = ssrc_any_inbound;
+
+    status = srtp_create(&snd, &out);
+    if (status == err_status_ok)
+        status = srtp_create(&rcv, &in);
+    slots = (uint8_t *) malloc(job->packets * slot_len);
+    seq = (uint16_t *) calloc(job->streams, sizeof(uint16_t));
+    len = (int *) malloc(job->packets * sizeof(int));
+    if (status == err_status_ok && (slots == NULL || seq == NULL
+            || len == NULL))
+        status = err_status_alloc_fail;
+
+    if (status == err_status_ok) {
+        bench_fill(job, slots, len, seq);
+        if (job->op == bench_unprotect || job->op == bench_unprotect_rtcp)
+            for (i = 0; status == err_status_ok && i < job->packets; i++)
+                status = bench_call((bench_op_t) (job->op - 1), snd, rcv,
+                        slots + i * slot_len, &len[i]);
+    }
+    if (bench_cycles == bench_cycles_perf)
+        fd = bench_cycles_open();
+
+    bench_gate_wait();
+
+    cycles = bench_cycles_read(fd);
+    job->start_ns = bench_now_ns();
+    for (i = 0; status == err_status_ok && i < job->packets; i++) {
+        unsigned long long t = bench_now_ns();
+
+        status = bench_call(job->op, snd, rcv, slots + i * slot_len, &len[i]);
+        job->latency_ns[i] = (uint32_t) (bench_now_ns() - t);
+    }
+    job->end_ns = bench_now_ns();
+    job->cycles = bench_cycles_read(fd) - cycles;
+
+    if (fd >= 0)
+        close(fd);
+    free(len);
+    free(seq);
+    free(slots);
+    if (rcv)
+        srtp_dealloc(rcv);
+    if (snd)
+        srtp_dealloc(snd);
+    job->status = status;
+    return NULL;
+}
+
+static int bench_compare_latency(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * bench_combination() runs one combination on num_threads threads,
+ * runs times, and writes the JSON record of the fastest run; it
+ * returns the packets per second of that run, or a negative value on
+ * failure
+ */
+
+static double bench_combination(const bench_policy_t *policy, bench_op_t op,
+        int size, int streams, int num_threads, int packets, int runs,
+        const char *name, int first) {
+    bench_job_t job[BENCH_MAX_THREADS];
+    pthread_t thread[BENCH_MAX_THREADS];
+    uint32_t *latency, *best_latency;
+    unsigned long long cycles, best_cycles = 0;
+    int total = packets * num_threads;
+    double best_pps = -1;
+    int i, run;
+
+    latency = (uint32_t *) malloc(total * sizeof(uint32_t));
+    best_latency = (uint32_t *) malloc(total * sizeof(uint32_t));
+    if (latency == NULL || best_latency == NULL) {
+        free(latency);
+        free(best_latency);
+        return -1;
+    }
+
+    for (run = 0; run < runs; run++) {
+        unsigned long long start = 0, end = 0;
+        double pps;
+
+        bench_gate_set(num_threads);
+        for (i = 0; i < num_threads; i++) {
+            job[i].policy = policy;
+            job[i].op = op;
+            job[i].size = size;
+            job[i].streams = streams;
+            job[i].packets = packets;
+            job[i].latency_ns = latency + i * packets;
+            job[i].status = err_status_fail;
+            if (pthread_create(&thread[i], NULL, bench_run, &job[i])) {
+                fprintf(stderr, "error: can't start the threads of %s\n",
+                        name);
+                exit(1);
+            }
+        }
+        for (i = 0; i < num_threads; i++)
+            pthread_join(thread[i], NULL);
+
+        cycles = 0;
+        for (i = 0; i < num_threads; i++) {
+            if (job[i].status) {
+                fprintf(stderr, "error: %s failed with error code %d\n",
+                        name, job[i].status);
+                free(latency);
+                free(best_latency);
+                return -1;
+            }
+            if (i == 0 || job[i].start_ns < start)
+                start = job[i].start_ns;
+            if (job[i].end_ns > end)
+                end = job[i].end_ns;
+            cycles += job[i].cycles;
+        }
+
+        pps = total * 1.0E9 / (end - start);
+        if (pps > best_pps) {
+            uint32_t *tmp = best_latency;
+
+            best_pps = pps;
+            best_cycles = cycles;
+            best_latency = latency;
+            latency = tmp;
+        }
+    }
+
+    qsort(best_latency, total, sizeof(uint32_t), bench_compare_latency);
+
+    printf("%s    {\"name\": \"%s\", \"policy\": \"%s\", \"op\": \"%s\", "
+           "\"size\": %d, \"streams\": %d, \"threads\": %d, "
+           "\"pps\": %.0f, ", first ? "" : ",\n", name, policy->name,
+           bench_op_name[op], size, streams, num_threads, best_pps);
+    if (bench_cycles == bench_cycles_none)
+        printf("\"cycles_per_packet\": null, ");
+    else
+        printf("\"cycles_per_packet\": %.1f, ", (double) best_cycles / total);
+    printf("\"p50_ns\": %u, \"p99_ns\": %u}", best_latency[total / 2],
+            best_latency[(int) (total * 0.99)]);
+    fflush(stdout);
+
+    free(latency);
+    free(best_latency);
+    return best_pps;
+}
+
+/*
+ * bench_read_baseline() reads the name and pps of each record of a
+ * file written by srtp_bench; records are one per line
+ */
+
+static int bench_read_baseline(const char *path, bench_result_t *base,
+        int max) {
+    char line[512];
+    FILE *f = fopen(path, "r");
+    int num = 0;
+
+    if (f == NULL)
+        return -1;
+
+    while (num < max && fgets(line, sizeof(line), f)) {
+        char *name = strstr(line, "\"name\": \"");
+        char *pps = strstr(line, "\"pps\": ");
+        char *end;
+
+        if (name == NULL || pps == NULL)
+            continue;
+        name += strlen("\"name\": \"");
+        end = strchr(name, '"');
+        if (end == NULL || end - name >= (int) sizeof(base[num].name))
+            continue;
+        memcpy(base[num].name, name, end - name);
+        base[num].name[end - name] = 0;
+        base[num].pps = strtod(pps + strlen("\"pps\": "), NULL);
+        num++;
+    }
+    fclose(f);
+
+    return num;
+}
+
+static void usage(char *prog_name) {
+    printf("usage: %s [ -n packets ] [ -i runs ] [ -b baseline ]\n"
+           "       [ -r tolerance ] [ -p policy ] [ -o op ] [ -s size ]\n"
+           "       [ -m streams ] [ -t threads ]\n"
+           "  -n packets per thread and combination (default %d)\n"
+           "  -i runs per combination, of which the fastest is reported "
+           "(default %d)\n"
+           "  -b compare with the JSON written by an earlier run\n"
+           "  -r allowed loss of packets per second, in percent "
+           "(default %d)\n"
+           "  -p, -o, -s, -m, -t run only the given policy, operation,\n"
+           "     packet size, stream count or thread count\n",
+           prog_name, BENCH_DEFAULT_PACKETS, BENCH_DEFAULT_RUNS,
+           BENCH_DEFAULT_TOLERANCE);
+    exit(255);
+}
+
+int main(int argc, char *argv[]) {
+    static bench_result_t base[BENCH_MAX_RESULTS];
+    const char *baseline = NULL;
+    const char *only_policy = NULL, *only_op = NULL;
+    int only_size = 0, only_streams = 0, only_threads = 0;
+    int packets = BENCH_DEFAULT_PACKETS;
+    int runs = BENCH_DEFAULT_RUNS;
+    int tolerance = BENCH_DEFAULT_TOLERANCE;
+    int num_base = 0, regressions = 0, first = 1;
+    int p, o, s, m, t, i;
+    err_status_t status;
+
+    while (1) {
+        int c = getopt_s(argc, argv, "n:i:b:r:p:o:s:m:t:");
+        if (c == -1)
+            break;
+        switch (c) {
+        case 'n':
+            packets = atoi(optarg_s);
+            break;
+        case 'i':
+            runs = atoi(optarg_s);
+            break;
+        case 'b':
+            baseline = optarg_s;
+            break;
+        case 'r':
+            tolerance = atoi(optarg_s);
+            break;
+        case 'p':
+            only_policy = optarg_s;
+            break;
+        case 'o':
+            only_op = optarg_s;
+            break;
+        case 's':
+            only_size = atoi(optarg_s);
+            break;
+        case 'm':
+            only_streams = atoi(optarg_s);
+            break;
+        case 't':
+            only_threads = atoi(optarg_s);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (packets <= 0 || packets > BENCH_MAX_PACKETS || runs <= 0
+            || tolerance < 0 || tolerance > 100 || only_threads < 0 || only_threads > BENCH_MAX_THREADS
+            || only_size < 0 || only_size > BENCH_MAX_PACKET_LEN
+            || (only_size && only_size < 16) || only_streams < 0)
+        usage(argv[0]);
+
+    if (baseline) {
+        num_base = bench_read_baseline(baseline, base, BENCH_MAX_RESULTS);
+        if (num_base < 0) {
+            fprintf(stderr, "error: can't read baseline %s\n", baseline);
+            exit(1);
+        }
+    }
+
+    status = srtp_init(0);
+    if (status) {
+        fprintf(stderr, "error: srtp initialization failed with error code %d\n",
+                status);
+        exit(1);
+    }
+    bench_cycles_select();
+
+    printf("{\n  \"benchmark\": \"srtp_bench\",\n  \"packets\": %d,\n"
+           "  \"cycle_source\": \"%s\",\n  \"results\": [\n", packets,
+            bench_cycles_name[bench_cycles]);
+
+    for (p = 0; p < BENCH_NUM_POLICIES; p++)
+        for (o = bench_protect; o <= bench_unprotect_rtcp; o++)
+            for (s = 0; s < BENCH_COUNT(bench_sizes); s++)
+                for (m = 0; m < BENCH_COUNT(bench_streams); m++)
+                    for (t = 0; t < BENCH_COUNT(bench_threads); t++) {
+        const bench_policy_t *policy = &bench_policies[p];
+        int size = only_size ? only_size : bench_sizes[s];
+        int streams = only_streams ? only_streams : bench_streams[m];
+        int threads = only_threads ? only_threads : bench_threads[t];
+        char name[96];
+        double pps;
+
+        if ((only_policy && strcmp(only_policy, policy->name))
+                || (only_op && strcmp(only_op, bench_op_name[o]))
+                || (only_size && s) || (only_streams && m)
+                || (only_threads && t))
+            continue;
+
+        snprintf(name, sizeof(name), "%s/%s/%d/s%d/t%d", policy->name,
+                bench_op_name[o], size, streams, threads);
+        pps = bench_combination(policy, (bench_op_t) o, size, streams,
+                threads, packets, runs, name, first);
+        if (pps < 0)
+            exit(1);
+        first = 0;
+
+        for (i = 0; i < num_base; i++) {
+            if (strcmp(base[i].name, name))
+                continue;
+            if (pps < base[i].pps * (100 - tolerance) / 100) {
+                fprintf(stderr, "regression: %s: %.0f packets/s, baseline "
+                        "%.0f\n", name, pps, base[i].pps);
+                regressions++;
+            }
+            break;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    status = srtp_deinit();
+    if (status) {
+        fprintf(stderr, "error: srtp shutdown failed with error code %d\n",
+                status);
+        exit(1);
+    }
+
+    if (regressions) {
+        fprintf(stderr, "%d combinations regressed by more than %d%%\n",
+                regressions, tolerance);
+        return 1;
+    }
+
+    return 0;
+}
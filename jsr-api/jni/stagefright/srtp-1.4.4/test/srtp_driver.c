@@ -61,10 +61,14 @@
 
 err_status_t srtp_validate(void);
 
+err_status_t srtp_validate_aes_gcm(void);
+
 err_status_t srtp_create_big_policy(srtp_policy_t **list);
 
 err_status_t srtp_test_remove_stream(void);
 
+err_status_t srtp_test_pair(void);
+
 double srtp_bits_per_second(int msg_len_octets, const srtp_policy_t *policy);
 
 double srtp_rejections_per_second(int msg_len_octets,
@@ -76,6 +80,10 @@ void srtp_do_rejection_timing(const srtp_policy_t *policy);
 
 err_status_t srtp_test(const srtp_policy_t *policy);
 
+err_status_t srtp_test_vec(const srtp_policy_t *policy);
+
+err_status_t srtp_test_fast_path(const srtp_policy_t *policy);
+
 err_status_t srtcp_test(const srtp_policy_t *policy);
 
 err_status_t srtp_session_print_policy(srtp_t srtp);
@@ -96,6 +104,10 @@ extern uint8_t test_key[30];
 
 extern const srtp_policy_t *policy_array[];
 
+/* the default_policy is declared below; it protects a single stream */
+
+extern const srtp_policy_t default_policy;
+
 /* the wildcard_policy is declared below; it has a wildcard ssrc */
 
 extern const srtp_policy_t wildcard_policy;
@@ -174,6 +186,20 @@ int srtp_driver() {
                 printf("failed\n");
                 return(1);
             }
+            printf("testing srtp_protect_vec and srtp_unprotect_vec...");
+            if (srtp_test_vec(*policy) == err_status_ok)
+                printf("passed\n\n");
+            else {
+                printf("failed\n");
+                return(1);
+            }
+            printf("testing fused srtp path against generic path...");
+            if (srtp_test_fast_path(*policy) == err_status_ok)
+                printf("passed\n\n");
+            else {
+                printf("failed\n");
+                return(1);
+            }
             policy++;
         }
 
@@ -214,6 +240,15 @@ int srtp_driver() {
             return(1);
         }
 
+        printf("testing srtp_protect and srtp_unprotect against "
+            "aes gcm reference packets\n");
+        if (srtp_validate_aes_gcm() == err_status_ok)
+            printf("passed\n\n");
+        else {
+            printf("failed\n");
+            return(1);
+        }
+
         /*
          * test the function srtp_remove_stream()
          */
@@ -224,6 +259,17 @@ int srtp_driver() {
             printf("failed\n");
             return(1);
         }
+
+        /*
+         * test the function srtp_create_pair()
+         */
+        printf("testing srtp_create_pair()...");
+        if (srtp_test_pair() == err_status_ok)
+            printf("passed\n");
+        else {
+            printf("failed\n");
+            return(1);
+        }
     }
 
     if (do_timing_test) {
@@ -258,6 +304,7 @@ int srtp_driver() {
         policy.ssrc.type = ssrc_specific;
         policy.ssrc.value = 0xdecafbad;
         policy.key = test_key;
+        policy.window_size = 128;
         policy.next = NULL;
 
         printf("mips estimate: %e\n", mips);
@@ -680,6 +727,280 @@ err_status_t srtp_test(const srtp_policy_t *policy) {
     return err_status_ok;
 }
 
+/*
+ * srtp_test_vec(policy) checks that srtp_protect_vec() produces the
+ * same packets as srtp_protect() does, and that srtp_unprotect_vec()
+ * recovers them, including across more packets than are processed
+ * in one batch.  If the policy has authentication, a replayed and a
+ * tampered packet are slipped into the batch to check that their
+ * status is reported without disturbing the other packets.
+ */
+
+#define VEC_TEST_PKTS 40
+
+err_status_t srtp_test_vec(const srtp_policy_t *policy) {
+    srtp_t srtp_sender, srtp_vec_sender, srtp_rcvr;
+    srtp_policy_t *rcvr_policy;
+    srtp_hdr_t *pkt[VEC_TEST_PKTS + 2], *ref;
+    void *hdr[VEC_TEST_PKTS + 2];
+    int len[VEC_TEST_PKTS + 2], msg_len[VEC_TEST_PKTS];
+    err_status_t status[VEC_TEST_PKTS + 2];
+    err_status_t expected[VEC_TEST_PKTS + 2];
+    err_status_t result = err_status_ok;
+    uint32_t ssrc;
+    int ref_len, num, i;
+
+    if (policy->ssrc.type != ssrc_specific)
+        ssrc = 0xdecafbad;
+    else
+        ssrc = policy->ssrc.value;
+
+    rcvr_policy = (srtp_policy_t*) malloc(sizeof(srtp_policy_t));
+    if (rcvr_policy == NULL)
+        return err_status_alloc_fail;
+    memcpy(rcvr_policy, policy, sizeof(srtp_policy_t));
+    if (policy->ssrc.type == ssrc_any_outbound)
+        rcvr_policy->ssrc.type = ssrc_any_inbound;
+
+    err_check(srtp_create(&srtp_sender, policy));
+    err_check(srtp_create(&srtp_vec_sender, policy));
+    err_check(srtp_create(&srtp_rcvr, rcvr_policy));
+
+    /* packets of assorted lengths, with consecutive sequence numbers */
+    for (i = 0; i < VEC_TEST_PKTS + 2; i++)
+        pkt[i] = NULL;
+    for (i = 0; i < VEC_TEST_PKTS; i++) {
+        msg_len[i] = (i * 37) % 181;
+        pkt[i] = srtp_create_test_packet(msg_len[i], ssrc);
+        if (pkt[i] == NULL) {
+            result = err_status_alloc_fail;
+            goto done;
+        }
+        pkt[i]->seq = htons(0x1234 + i);
+        hdr[i] = pkt[i];
+        len[i] = msg_len[i] + 12;
+    }
+
+    if (srtp_protect_vec(srtp_vec_sender, hdr, len, status, VEC_TEST_PKTS)
+            != err_status_ok) {
+        result = err_status_algo_fail;
+        goto done;
+    }
+
+    /* compare each packet with the one srtp_protect() makes */
+    for (i = 0; i < VEC_TEST_PKTS; i++) {
+        ref = srtp_create_test_packet(msg_len[i], ssrc);
+        if (ref == NULL) {
+            result = err_status_alloc_fail;
+            goto done;
+        }
+        ref->seq = htons(0x1234 + i);
+        ref_len = msg_len[i] + 12;
+        result = srtp_protect(srtp_sender, ref, &ref_len);
+        if (result == err_status_ok && (status[i] != err_status_ok
+                || len[i] != ref_len || memcmp(ref, pkt[i], ref_len) != 0
+                || ((uint8_t *) pkt[i])[ref_len] != 0xff))
+            result = err_status_algo_fail;
+        free(ref);
+        if (result)
+            goto done;
+    }
+
+    /*
+     * if the policy includes authentication, append a replay of the
+     * first packet and a copy of the last one with a flipped bit
+     */
+    num = VEC_TEST_PKTS;
+    for (i = 0; i < VEC_TEST_PKTS; i++)
+        expected[i] = err_status_ok;
+    if (policy->rtp.sec_serv & sec_serv_auth) {
+        pkt[num] = (srtp_hdr_t*) malloc(len[0]);
+        pkt[num + 1] = (srtp_hdr_t*) malloc(len[VEC_TEST_PKTS - 1]);
+        if (pkt[num] == NULL || pkt[num + 1] == NULL) {
+            result = err_status_alloc_fail;
+            goto done;
+        }
+        memcpy(pkt[num], pkt[0], len[0]);
+        len[num] = len[0];
+        expected[num] = err_status_replay_fail;
+        hdr[num] = pkt[num];
+        num++;
+        memcpy(pkt[num], pkt[VEC_TEST_PKTS - 1], len[VEC_TEST_PKTS - 1]);
+        len[num] = len[VEC_TEST_PKTS - 1];
+        ((uint8_t *) pkt[num])[len[num] - 1] ^= 0x01;
+        pkt[num]->seq = htons(0x1234 + VEC_TEST_PKTS);
+        expected[num] = err_status_auth_fail;
+        hdr[num] = pkt[num];
+        num++;
+    }
+
+    srtp_unprotect_vec(srtp_rcvr, hdr, len, status, num);
+
+    for (i = 0; i < num; i++)
+        if (status[i] != expected[i]) {
+            printf("packet %d: expected status %d, found %d\n", i,
+                    expected[i], status[i]);
+            result = err_status_algo_fail;
+            goto done;
+        }
+
+    /* verify that the unprotected packets match the original ones */
+    for (i = 0; i < VEC_TEST_PKTS; i++) {
+        ref = srtp_create_test_packet(msg_len[i], ssrc);
+        if (ref == NULL) {
+            result = err_status_alloc_fail;
+            goto done;
+        }
+        ref->seq = htons(0x1234 + i);
+        if (len[i] != msg_len[i] + 12 || memcmp(ref, pkt[i], len[i]) != 0)
+            result = err_status_algo_fail;
+        free(ref);
+        if (result) {
+            printf("mismatch in packet %d\n", i);
+            goto done;
+        }
+    }
+
+done:
+    for (i = 0; i < VEC_TEST_PKTS + 2; i++)
+        free(pkt[i]);
+    free(rcvr_policy);
+    srtp_dealloc(srtp_sender);
+    srtp_dealloc(srtp_vec_sender);
+    srtp_dealloc(srtp_rcvr);
+
+    return result;
+}
+
+/*
+ * srtp_test_fast_path(policy) checks that the fused AES-CM/HMAC-SHA1
+ * path of srtp_protect() and srtp_unprotect() agrees with the generic
+ * path, which is forced by clearing rtp_fast_path in the streams of a
+ * second pair of sessions.  The payload lengths cross the chunk size
+ * of the fused path.  A tampered packet must be rejected by both
+ * paths and left as it was.  For policies that the fused path does
+ * not cover both pairs use the generic path.
+ */
+
+static void srtp_force_generic_path(srtp_t session) {
+    srtp_stream_ctx_t *stream;
+
+    if (session->stream_template != NULL)
+        session->stream_template->rtp_fast_path = srtp_fast_none;
+    for (stream = session->stream_list; stream != NULL; stream = stream->next)
+        stream->rtp_fast_path = srtp_fast_none;
+}
+
+err_status_t srtp_test_fast_path(const srtp_policy_t *policy) {
+    srtp_t fast_sender, fast_rcvr, slow_sender, slow_rcvr;
+    srtp_policy_t *rcvr_policy;
+    srtp_hdr_t *fast_pkt = NULL, *slow_pkt = NULL;
+    uint8_t *saved = NULL;
+    err_status_t result = err_status_ok, fast_status, slow_status;
+    int msg_lens[] = { 0, 1, 15, 16, 160, 511, 512, 513, 1024, 1400 };
+    int num_lens = sizeof(msg_lens) / sizeof(msg_lens[0]);
+    int fast_len, slow_len, i;
+    uint32_t ssrc;
+
+    if (policy->ssrc.type != ssrc_specific)
+        ssrc = 0xdecafbad;
+    else
+        ssrc = policy->ssrc.value;
+
+    rcvr_policy = (srtp_policy_t*) malloc(sizeof(srtp_policy_t));
+    if (rcvr_policy == NULL)
+        return err_status_alloc_fail;
+    memcpy(rcvr_policy, policy, sizeof(srtp_policy_t));
+    if (policy->ssrc.type == ssrc_any_outbound)
+        rcvr_policy->ssrc.type = ssrc_any_inbound;
+
+    err_check(srtp_create(&fast_sender, policy));
+    err_check(srtp_create(&fast_rcvr, rcvr_policy));
+    err_check(srtp_create(&slow_sender, policy));
+    err_check(srtp_create(&slow_rcvr, rcvr_policy));
+    srtp_force_generic_path(slow_sender);
+    srtp_force_generic_path(slow_rcvr);
+
+    for (i = 0; i < num_lens && result == err_status_ok; i++) {
+        fast_pkt = srtp_create_test_packet(msg_lens[i], ssrc);
+        slow_pkt = srtp_create_test_packet(msg_lens[i], ssrc);
+        saved = (uint8_t *) malloc(msg_lens[i] + 12 + SRTP_MAX_TRAILER_LEN);
+        if (fast_pkt == NULL || slow_pkt == NULL || saved == NULL) {
+            result = err_status_alloc_fail;
+            break;
+        }
+        fast_pkt->seq = slow_pkt->seq = htons(0x1234 + i);
+        fast_len = slow_len = msg_lens[i] + 12;
+
+        /* the protected packets must be identical */
+        fast_status = srtp_protect(fast_sender, fast_pkt, &fast_len);
+        slow_status = srtp_protect(slow_sender, slow_pkt, &slow_len);
+        if (fast_status || slow_status || fast_len != slow_len
+                || memcmp(fast_pkt, slow_pkt, fast_len) != 0) {
+            printf("protect mismatch with %d octets of payload\n",
+                    msg_lens[i]);
+            result = err_status_algo_fail;
+            break;
+        }
+
+        /* a tampered packet must be rejected, and left unchanged */
+        if (policy->rtp.sec_serv & sec_serv_auth) {
+            ((uint8_t *) fast_pkt)[fast_len - 1] ^= 0x80;
+            ((uint8_t *) slow_pkt)[slow_len - 1] ^= 0x80;
+            memcpy(saved, fast_pkt, fast_len);
+            fast_status = srtp_unprotect(fast_rcvr, fast_pkt, &fast_len);
+            slow_status = srtp_unprotect(slow_rcvr, slow_pkt, &slow_len);
+            if (fast_status != err_status_auth_fail
+                    || slow_status != err_status_auth_fail
+                    || memcmp(fast_pkt, saved, fast_len) != 0
+                    || memcmp(slow_pkt, saved, slow_len) != 0) {
+                printf("tampered packet with %d octets of payload accepted "
+                    "or changed\n", msg_lens[i]);
+                result = err_status_algo_fail;
+                break;
+            }
+            ((uint8_t *) fast_pkt)[fast_len - 1] ^= 0x80;
+            ((uint8_t *) slow_pkt)[slow_len - 1] ^= 0x80;
+        }
+
+        /* each receiver recovers the original packet */
+        fast_status = srtp_unprotect(fast_rcvr, fast_pkt, &fast_len);
+        slow_status = srtp_unprotect(slow_rcvr, slow_pkt, &slow_len);
+        free(saved);
+        saved = (uint8_t *) srtp_create_test_packet(msg_lens[i], ssrc);
+        if (saved == NULL) {
+            result = err_status_alloc_fail;
+            break;
+        }
+        ((srtp_hdr_t *) saved)->seq = htons(0x1234 + i);
+        if (fast_status || slow_status || fast_len != msg_lens[i] + 12
+                || slow_len != fast_len || memcmp(fast_pkt, saved, fast_len)
+                != 0 || memcmp(slow_pkt, saved, slow_len) != 0) {
+            printf("unprotect mismatch with %d octets of payload\n",
+                    msg_lens[i]);
+            result = err_status_algo_fail;
+            break;
+        }
+
+        free(fast_pkt);
+        free(slow_pkt);
+        free(saved);
+        fast_pkt = slow_pkt = NULL;
+        saved = NULL;
+    }
+
+    free(fast_pkt);
+    free(slow_pkt);
+    free(saved);
+    free(rcvr_policy);
+    srtp_dealloc(fast_sender);
+    srtp_dealloc(fast_rcvr);
+    srtp_dealloc(slow_sender);
+    srtp_dealloc(slow_rcvr);
+
+    return result;
+}
+
 err_status_t srtcp_test(const srtp_policy_t *policy) {
     int i;
     srtp_t srtcp_sender;
@@ -896,13 +1217,15 @@ err_status_t srtp_session_print_policy(srtp_t srtp) {
             "# rtp services:  %s\r\n"
             "# rtcp cipher:   %s\r\n"
             "# rtcp auth:     %s\r\n"
-            "# rtcp services: %s\r\n", direction[stream->direction],
+            "# rtcp services: %s\r\n"
+            "# window size:   %lu\r\n", direction[stream->direction],
                 stream->rtp_cipher->type->description,
                 stream->rtp_auth->type->description,
                 serv_descr[stream->rtp_services],
                 stream->rtcp_cipher->type->description,
                 stream->rtcp_auth->type->description,
-                serv_descr[stream->rtcp_services]);
+                serv_descr[stream->rtcp_services],
+                rdbx_get_window_size(&stream->rtp_rdbx));
     }
 
     /* loop over streams in session, printing the policy of each */
@@ -917,13 +1240,15 @@ err_status_t srtp_session_print_policy(srtp_t srtp) {
             "# rtp services:  %s\r\n"
             "# rtcp cipher:   %s\r\n"
             "# rtcp auth:     %s\r\n"
-            "# rtcp services: %s\r\n", stream->ssrc,
+            "# rtcp services: %s\r\n"
+            "# window size:   %lu\r\n", stream->ssrc,
                 stream->rtp_cipher->type->description,
                 stream->rtp_auth->type->description,
                 serv_descr[stream->rtp_services],
                 stream->rtcp_cipher->type->description,
                 stream->rtcp_auth->type->description,
-                serv_descr[stream->rtcp_services]);
+                serv_descr[stream->rtcp_services],
+                rdbx_get_window_size(&stream->rtp_rdbx));
 
         /* advance to next stream in the list */
         stream = stream->next;
@@ -1051,6 +1376,7 @@ err_status_t srtp_validate() {
     policy.ssrc.type = ssrc_specific;
     policy.ssrc.value = 0xcafebabe;
     policy.key = test_key;
+    policy.window_size = 128;
     policy.next = NULL;
 
     status = srtp_create(&srtp_snd, &policy);
@@ -1095,6 +1421,102 @@ err_status_t srtp_validate() {
     return err_status_ok;
 }
 
+/*
+ * srtp_validate_aes_gcm() checks the AEAD_AES_128_GCM and
+ * AEAD_AES_256_GCM transforms against reference packets computed with
+ * an independent AES-GCM implementation, starting from the same master
+ * key and salt (the key derivation is covered as well)
+ */
+
+err_status_t srtp_validate_aes_gcm() {
+    unsigned char test_key_gcm[44] = { 0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01,
+            0x8b, 0xe0, 0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39, 0x0e,
+            0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb, 0xb6, 0x96, 0x0b, 0x3a,
+            0xab, 0xe6, 0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0, 0xd6,
+            0x4f, 0xa3, 0x2c, 0x06, 0xde };
+    uint8_t srtp_plaintext_ref[28] = { 0x80, 0x0f, 0x12, 0x34, 0xde, 0xca,
+            0xfb, 0xad, 0xca, 0xfe, 0xba, 0xbe, 0xab, 0xab, 0xab, 0xab, 0xab,
+            0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab };
+    uint8_t srtp_ciphertext_128[44] = { 0x80, 0x0f, 0x12, 0x34, 0xde, 0xca,
+            0xfb, 0xad, 0xca, 0xfe, 0xba, 0xbe, 0x0e, 0xca, 0x0c, 0xf9, 0x5e,
+            0xe9, 0x55, 0xb2, 0x6c, 0xd3, 0xd2, 0x88, 0xb4, 0x9f, 0x6c, 0xa9,
+            0x59, 0x17, 0x14, 0x50, 0x97, 0x5f, 0x41, 0x44, 0xda, 0x9c, 0xdd,
+            0x7a, 0xe9, 0x89, 0xa2, 0x77 };
+    uint8_t srtp_ciphertext_256[44] = { 0x80, 0x0f, 0x12, 0x34, 0xde, 0xca,
+            0xfb, 0xad, 0xca, 0xfe, 0xba, 0xbe, 0xb9, 0x0f, 0x1a, 0x82, 0xd5,
+            0x98, 0x0d, 0x68, 0xbd, 0x0d, 0x7c, 0xa7, 0xfc, 0xb8, 0xea, 0x49,
+            0x62, 0x30, 0x20, 0x69, 0x07, 0x6f, 0x91, 0x53, 0x55, 0x3a, 0xbd,
+            0x29, 0x8f, 0xa0, 0x6e, 0xa0 };
+    uint8_t buffer[44];
+    uint8_t *ciphertext;
+    srtp_t srtp_snd, srtp_recv;
+    err_status_t status;
+    int len, i;
+    srtp_policy_t policy;
+
+    for (i = 0; i < 2; i++) {
+        if (i == 0) {
+            crypto_policy_set_aes_gcm_128_16_auth(&policy.rtp);
+            crypto_policy_set_aes_gcm_128_16_auth(&policy.rtcp);
+            ciphertext = srtp_ciphertext_128;
+        } else {
+            crypto_policy_set_aes_gcm_256_16_auth(&policy.rtp);
+            crypto_policy_set_aes_gcm_256_16_auth(&policy.rtcp);
+            ciphertext = srtp_ciphertext_256;
+        }
+        policy.ssrc.type = ssrc_specific;
+        policy.ssrc.value = 0xcafebabe;
+        policy.key = test_key_gcm;
+        policy.window_size = 128;
+        policy.next = NULL;
+
+        status = srtp_create(&srtp_snd, &policy);
+        if (status)
+            return status;
+
+        /* protect plaintext, then compare with ciphertext */
+        memcpy(buffer, srtp_plaintext_ref, 28);
+        len = 28;
+        status = srtp_protect(srtp_snd, buffer, &len);
+        if (status || (len != 44))
+            return err_status_fail;
+
+        debug_print(mod_driver, "ciphertext:\n  %s", octet_string_hex_string(
+                buffer, len));
+        debug_print(mod_driver, "ciphertext reference:\n  %s",
+                octet_string_hex_string(ciphertext, len));
+
+        if (octet_string_is_eq(buffer, ciphertext, len))
+            return err_status_fail;
+
+        status = srtp_create(&srtp_recv, &policy);
+        if (status)
+            return status;
+
+        /* a modified packet must be rejected (before the replay check) */
+        memcpy(buffer, ciphertext, 44);
+        buffer[20] ^= 0x01;
+        len = 44;
+        if (srtp_unprotect(srtp_recv, buffer, &len) != err_status_auth_fail)
+            return err_status_fail;
+
+        /* unprotect ciphertext, then compare with plaintext */
+        memcpy(buffer, ciphertext, 44);
+        len = 44;
+        status = srtp_unprotect(srtp_recv, buffer, &len);
+        if (status || (len != 28))
+            return err_status_fail;
+
+        if (octet_string_is_eq(buffer, srtp_plaintext_ref, len))
+            return err_status_fail;
+
+        srtp_dealloc(srtp_snd);
+        srtp_dealloc(srtp_recv);
+    }
+
+    return err_status_ok;
+}
+
 err_status_t srtp_create_big_policy(srtp_policy_t **list) {
     extern const srtp_policy_t *policy_array[];
     srtp_policy_t *p = NULL, *tmp;
@@ -1128,9 +1550,12 @@ err_status_t srtp_create_big_policy(srtp_policy_t **list) {
 
 err_status_t srtp_test_remove_stream() {
     err_status_t status;
-    srtp_policy_t *policy_list;
+    srtp_policy_t *policy_list, *tmp;
+    srtp_policy_t policy;
     srtp_t session;
     srtp_stream_t stream;
+    uint32_t ssrc;
+    uint32_t i;
     /*
      * srtp_get_stream() is a libSRTP internal function that we declare
      * here so that we can use it to verify the correct operation of the
@@ -1168,6 +1593,168 @@ err_status_t srtp_test_remove_stream() {
     if (stream == NULL)
         return err_status_fail;
 
+    /*
+     * remove the streams with the lowest and the highest ssrc, which
+     * are at the ends of the stream list, then check that each of the
+     * remaining streams can be found and the removed ones cannot
+     */
+    for (i = 0, tmp = policy_list; tmp->next != NULL; tmp = tmp->next)
+        i++;
+    status = srtp_remove_stream(session, htonl(0x0));
+    if (status != err_status_ok)
+        return err_status_fail;
+    status = srtp_remove_stream(session, htonl(i));
+    if (status != err_status_ok)
+        return err_status_fail;
+    for (ssrc = 0; ssrc <= i; ssrc++) {
+        stream = srtp_get_stream(session, htonl(ssrc));
+        if ((stream == NULL) != (ssrc == 0 || ssrc == 1 || ssrc == i))
+            return err_status_fail;
+        if (stream != NULL && stream->ssrc != htonl(ssrc))
+            return err_status_fail;
+    }
+
+    status = srtp_dealloc(session);
+    if (status)
+        return status;
+
+    /*
+     * exercise the stream index with many streams: add them, remove
+     * every third one, then look each of them up
+     */
+    status = srtp_create(&session, NULL);
+    if (status)
+        return status;
+    memcpy(&policy, &default_policy, sizeof(policy));
+    policy.ssrc.type = ssrc_specific;
+    for (ssrc = 0; ssrc < 300; ssrc++) {
+        policy.ssrc.value = ssrc * 0x10000;
+        status = srtp_add_stream(session, &policy);
+        if (status)
+            return status;
+    }
+    for (ssrc = 0; ssrc < 300; ssrc += 3) {
+        status = srtp_remove_stream(session, htonl(ssrc * 0x10000));
+        if (status != err_status_ok)
+            return err_status_fail;
+    }
+    for (ssrc = 0; ssrc < 300; ssrc++) {
+        stream = srtp_get_stream(session, htonl(ssrc * 0x10000));
+        if ((stream == NULL) != (ssrc % 3 == 0))
+            return err_status_fail;
+        if (stream != NULL && stream->ssrc != htonl(ssrc * 0x10000))
+            return err_status_fail;
+    }
+    status = srtp_remove_stream(session, htonl(0x10000 * 3));
+    if (status != err_status_no_ctx)
+        return err_status_fail;
+
+    status = srtp_dealloc(session);
+    if (status)
+        return status;
+
+    return err_status_ok;
+}
+
+/*
+ * srtp_test_pair() checks that the streams of the sessions made by
+ * srtp_create_pair(), including those added or cloned later, have the
+ * direction of their session, and that packets protected with the
+ * sending session are accepted by the receiving one
+ */
+
+err_status_t srtp_test_pair() {
+    srtp_t sender, receiver;
+    srtp_policy_t policy[2];
+    srtp_stream_t stream;
+    srtp_hdr_t *hdr, *ref;
+    err_status_t status = err_status_ok;
+    int len, i;
+    extern srtp_stream_t srtp_get_stream(srtp_t srtp, uint32_t ssrc);
+
+    memcpy(&policy[0], &default_policy, sizeof(srtp_policy_t));
+    policy[0].ssrc.type = ssrc_specific;
+    policy[0].ssrc.value = 0xcafebabe;
+    policy[0].next = &policy[1];
+    memcpy(&policy[1], &default_policy, sizeof(srtp_policy_t));
+    policy[1].ssrc.type = ssrc_any_outbound;
+    policy[1].next = NULL;
+
+    err_check(srtp_create_pair(&sender, &receiver, policy));
+
+    /* a stream added later, and the templates */
+    policy[0].ssrc.value = 0x12345678;
+    policy[0].next = NULL;
+    err_check(srtp_add_stream(sender, &policy[0]));
+    err_check(srtp_add_stream(receiver, &policy[0]));
+    if (sender->stream_template->direction != dir_srtp_sender
+            || receiver->stream_template->direction != dir_srtp_receiver)
+        status = err_status_algo_fail;
+    for (stream = sender->stream_list; stream != NULL; stream = stream->next)
+        if (stream->direction != dir_srtp_sender)
+            status = err_status_algo_fail;
+    for (stream = receiver->stream_list; stream != NULL; stream
+            = stream->next)
+        if (stream->direction != dir_srtp_receiver)
+            status = err_status_algo_fail;
+    if (status)
+        return status;
+
+    /* rtp and rtcp round trips, over fixed and template streams */
+    for (i = 0; i < 3; i++) {
+        uint32_t ssrc = i == 0 ? 0xcafebabe : i == 1 ? 0x12345678
+                : 0xdecafbad;
+
+        hdr = srtp_create_test_packet(80, ssrc);
+        ref = srtp_create_test_packet(80, ssrc);
+        if (hdr == NULL || ref == NULL) {
+            free(hdr);
+            free(ref);
+            return err_status_alloc_fail;
+        }
+        len = 80 + 12;
+        status = srtp_protect(sender, hdr, &len);
+        if (status == err_status_ok)
+            status = srtp_unprotect(receiver, hdr, &len);
+        if (status == err_status_ok && (len != 80 + 12
+                || memcmp(hdr, ref, len) != 0))
+            status = err_status_algo_fail;
+        if (status == err_status_ok) {
+            len = 80 + 12;
+            status = srtp_protect_rtcp(sender, hdr, &len);
+        }
+        if (status == err_status_ok)
+            status = srtp_unprotect_rtcp(receiver, hdr, &len);
+        if (status == err_status_ok && (len != 80 + 12
+                || memcmp(hdr, ref, len) != 0))
+            status = err_status_algo_fail;
+        free(hdr);
+        free(ref);
+        if (status)
+            return status;
+
+        stream = srtp_get_stream(receiver, htonl(ssrc));
+        if (stream == NULL || stream->direction != dir_srtp_receiver)
+            return err_status_algo_fail;
+    }
+
+    /* rtcp lookups leave the stream cached for rtp untouched */
+    stream = srtp_get_stream(sender, htonl(0xcafebabe));
+    hdr = srtp_create_test_packet(80, 0x12345678);
+    if (hdr == NULL)
+        return err_status_alloc_fail;
+    len = 80 + 12;
+    status = srtp_protect_rtcp(sender, hdr, &len);
+    free(hdr);
+    if (status)
+        return status;
+    if (stream == NULL || sender->stream_last != stream
+            || sender->stream_last_rtcp == stream)
+        return err_status_algo_fail;
+
+    err_check(srtp_dealloc(sender));
+    err_check(srtp_dealloc(receiver));
+
     return err_status_ok;
 }
 
@@ -1194,7 +1781,7 @@ HMAC_SHA1, /* authentication func type    */
 16, /* auth key length in octets   */
 10, /* auth tag length in octets   */
 sec_serv_conf_and_auth /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };
 
 const srtp_policy_t aes_tmmh_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
 { AES_128_ICM, /* cipher type                 */
@@ -1209,7 +1796,7 @@ UST_TMMHv2, /* authentication func type    */
 94, /* auth key length in octets   */
 4, /* auth tag length in octets   */
 sec_serv_conf_and_auth /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };
 
 const srtp_policy_t tmmh_only_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
 { AES_128_ICM, /* cipher type                 */
@@ -1224,7 +1811,7 @@ UST_TMMHv2, /* authentication func type    */
 94, /* auth key length in octets   */
 4, /* auth tag length in octets   */
 sec_serv_auth /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };
 
 const srtp_policy_t aes_only_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
 { AES_128_ICM, /* cipher type                 */
@@ -1239,7 +1826,7 @@ NULL_AUTH, /* authentication func type    */
 0, /* auth key length in octets   */
 0, /* auth tag length in octets   */
 sec_serv_conf /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };
 
 const srtp_policy_t hmac_only_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
 { NULL_CIPHER, /* cipher type                 */
@@ -1254,7 +1841,7 @@ HMAC_SHA1, /* authentication func type    */
 20, /* auth key length in octets   */
 4, /* auth tag length in octets   */
 sec_serv_auth /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };
 
 const srtp_policy_t null_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
 { NULL_CIPHER, /* cipher type                 */
@@ -1269,7 +1856,58 @@ NULL_AUTH, /* authentication func type    */
 0, /* auth key length in octets   */
 0, /* auth tag length in octets   */
 sec_serv_none /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };
+
+unsigned char test_key_gcm_256[44] = { 0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01,
+        0x8b, 0xe0, 0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39, 0x0e,
+        0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb, 0xb6, 0x96, 0x0b, 0x3a,
+        0xab, 0xe6, 0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0, 0xd6,
+        0x4f, 0xa3, 0x2c, 0x06, 0xde };
+
+const srtp_policy_t aes_gcm_128_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
+{ AES_128_GCM, /* cipher type                 */
+28, /* cipher key length in octets */
+NULL_AUTH, /* authentication func type    */
+0, /* auth key length in octets   */
+16, /* auth tag length in octets   */
+sec_serv_conf_and_auth /* security services flag      */
+}, { AES_128_GCM, /* cipher type                 */
+28, /* cipher key length in octets */
+NULL_AUTH, /* authentication func type    */
+0, /* auth key length in octets   */
+16, /* auth tag length in octets   */
+sec_serv_conf_and_auth /* security services flag      */
+}, test_key, 128, NULL };
+
+const srtp_policy_t aes_gcm_128_auth_only_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
+{ AES_128_GCM, /* cipher type                 */
+28, /* cipher key length in octets */
+NULL_AUTH, /* authentication func type    */
+0, /* auth key length in octets   */
+16, /* auth tag length in octets   */
+sec_serv_auth /* security services flag      */
+}, { AES_128_GCM, /* cipher type                 */
+28, /* cipher key length in octets */
+NULL_AUTH, /* authentication func type    */
+0, /* auth key length in octets   */
+16, /* auth tag length in octets   */
+sec_serv_auth /* security services flag      */
+}, test_key, 128, NULL };
+
+const srtp_policy_t aes_gcm_256_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
+{ AES_256_GCM, /* cipher type                 */
+44, /* cipher key length in octets */
+NULL_AUTH, /* authentication func type    */
+0, /* auth key length in octets   */
+16, /* auth tag length in octets   */
+sec_serv_conf_and_auth /* security services flag      */
+}, { AES_256_GCM, /* cipher type                 */
+44, /* cipher key length in octets */
+NULL_AUTH, /* authentication func type    */
+0, /* auth key length in octets   */
+16, /* auth tag length in octets   */
+sec_serv_conf_and_auth /* security services flag      */
+}, test_key_gcm_256, 128, NULL };
 
 /*
  * an array of pointers to the policies listed above
@@ -1291,7 +1929,8 @@ const srtp_policy_t * policy_array[] = { &hmac_only_policy,
 #if USE_TMMH
         &aes_tmmh_policy,
 #endif
-        &default_policy, &null_policy, NULL };
+        &default_policy, &null_policy, &aes_gcm_128_policy,
+        &aes_gcm_128_auth_only_policy, &aes_gcm_256_policy, NULL };
 
 const srtp_policy_t wildcard_policy = { { ssrc_any_outbound, 0 }, /* SSRC                        */
 { /* SRTP policy                    */
@@ -1308,4 +1947,4 @@ HMAC_SHA1, /* authentication func type    */
 16, /* auth key length in octets   */
 10, /* auth tag length in octets   */
 sec_serv_conf_and_auth /* security services flag      */
-}, test_key, NULL };
+}, test_key, 128, NULL };